@@ -0,0 +1,346 @@
+#include "async_file_writer.h"
+
+#include <chrono>
+#include <cstring>
+#include <utility>
+
+#include "time_utils.h"
+#include "video_frame_buffer.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+// Sector and page size: the unit direct I/O wants for buffer address, length
+// and file offset.
+const size_t kIoAlignment = 4096;
+
+#ifdef _WIN32
+std::wstring WidePath(const std::string& path) {
+	int length = MultiByteToWideChar(CP_UTF8, 0, path.c_str(), -1, nullptr, 0);
+	if (length <= 0) {
+		return std::wstring();
+	}
+	std::wstring wide_path(length, L'\0');
+	MultiByteToWideChar(CP_UTF8, 0, path.c_str(), -1, &wide_path[0], length);
+	return wide_path;
+}
+#endif
+
+}
+
+void WriteRequest::AddRegion(const uint8_t* data, uint32_t row_bytes, uint32_t stride, uint32_t rows) {
+	if (region_count >= 3) {
+		return;
+	}
+	Region& region = regions[region_count++];
+	region.data = data;
+	region.row_bytes = row_bytes;
+	region.stride = stride;
+	region.rows = rows;
+}
+
+size_t WriteRequest::Size() const {
+	size_t size = prefix.size() + suffix.size();
+	for (int i = 0; i < region_count; ++i) {
+		size += static_cast<size_t>(regions[i].row_bytes) * regions[i].rows;
+	}
+	return size;
+}
+
+AsyncFileWriter::AsyncFileWriter() {
+
+}
+
+AsyncFileWriter::~AsyncFileWriter() {
+	Close();
+}
+
+bool AsyncFileWriter::Open(const std::string& path, const AsyncFileWriterOptions& options) {
+	Close();
+	options_ = options;
+	options_.buffer_size = (options.buffer_size + kIoAlignment - 1) / kIoAlignment * kIoAlignment;
+	if (options_.buffer_size == 0) {
+		options_.buffer_size = kIoAlignment;
+	}
+	if (options_.queue_capacity == 0) {
+		options_.queue_capacity = 1;
+	}
+	if (options_.policy == kFrameQueueDropOldest) {
+		options_.policy = kFrameQueueDropNewest;
+	}
+	direct_io_ = false;
+#ifdef _WIN32
+	std::wstring wide_path = WidePath(path);
+	if (wide_path.empty()) {
+		return false;
+	}
+	HANDLE handle = INVALID_HANDLE_VALUE;
+	if (options_.direct_io) {
+		handle = CreateFileW(wide_path.c_str(), GENERIC_WRITE, FILE_SHARE_READ, nullptr, CREATE_ALWAYS,
+			FILE_FLAG_NO_BUFFERING | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+		direct_io_ = handle != INVALID_HANDLE_VALUE;
+	}
+	if (handle == INVALID_HANDLE_VALUE) {
+		handle = CreateFileW(wide_path.c_str(), GENERIC_WRITE, FILE_SHARE_READ, nullptr, CREATE_ALWAYS,
+			FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	}
+	if (handle == INVALID_HANDLE_VALUE) {
+		return false;
+	}
+	file_ = handle;
+#else
+#ifdef O_DIRECT
+	if (options_.direct_io) {
+		fd_ = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_DIRECT, 0644);
+		direct_io_ = fd_ >= 0;
+	}
+#endif
+	if (fd_ < 0) {
+		fd_ = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	}
+	if (fd_ < 0) {
+		return false;
+	}
+#endif
+	buffer_ = static_cast<uint8_t*>(AlignedMalloc(options_.buffer_size, kIoAlignment));
+	buffered_ = 0;
+	logical_size_ = 0;
+	path_ = path;
+	failed_ = false;
+	bytes_written_ = 0;
+	requests_written_ = 0;
+	write_calls_ = 0;
+	write_time_us_ = 0;
+	open_time_us_ = utils::TimeMicros();
+	queue_.reset(new FrameQueue<WriteRequest>(options_.queue_capacity, options_.policy));
+	thread_ = std::thread(&AsyncFileWriter::Run, this);
+	return true;
+}
+
+bool AsyncFileWriter::Close() {
+	return Close(std::string(), std::vector<FilePatch>());
+}
+
+bool AsyncFileWriter::Close(const std::string& trailer, const std::vector<FilePatch>& patches) {
+	if (!queue_) {
+		return true;
+	}
+	queue_->Close();
+	if (thread_.joinable()) {
+		thread_.join();
+	}
+	if (!failed_) {
+		Append(reinterpret_cast<const uint8_t*>(trailer.data()), trailer.size());
+	}
+	bool ok = FinishFile();
+#ifdef _WIN32
+	CloseHandle(file_);
+	file_ = nullptr;
+#else
+	if (close(fd_) != 0) {
+		ok = false;
+	}
+	fd_ = -1;
+#endif
+	AlignedFree(buffer_);
+	buffer_ = nullptr;
+	if (ok && !patches.empty()) {
+		ok = PatchFile(patches);
+	}
+	if (!ok) {
+		failed_ = true;
+	}
+	// The queue stays around for Stats() until the next Open().
+	return !failed_;
+}
+
+bool AsyncFileWriter::IsOpen() const {
+	return queue_ && !queue_->Closed();
+}
+
+bool AsyncFileWriter::Submit(WriteRequest& request) {
+	if (!queue_ || failed_) {
+		return false;
+	}
+	return queue_->Push(std::move(request));
+}
+
+AsyncFileWriterStats AsyncFileWriter::Stats() const {
+	AsyncFileWriterStats stats{};
+	if (queue_) {
+		FrameQueueStats queue_stats = queue_->Stats();
+		stats.requests_dropped = queue_stats.dropped;
+		stats.queue_depth = queue_stats.depth;
+		stats.max_queue_depth = queue_stats.max_depth;
+	}
+	stats.bytes_written = bytes_written_;
+	stats.requests_written = requests_written_;
+	stats.write_calls = write_calls_;
+	stats.write_time_us = write_time_us_;
+	stats.elapsed_us = open_time_us_ ? utils::TimeMicros() - open_time_us_ : 0;
+	stats.direct_io = direct_io_;
+	stats.failed = failed_;
+	return stats;
+}
+
+void AsyncFileWriter::Run() {
+	WriteRequest request;
+	for (;;) {
+		if (queue_->Pop(request, std::chrono::milliseconds(50))) {
+			if (!failed_) {
+				Append(reinterpret_cast<const uint8_t*>(request.prefix.data()), request.prefix.size());
+				for (int i = 0; i < request.region_count; ++i) {
+					const WriteRequest::Region& region = request.regions[i];
+					for (uint32_t row = 0; row < region.rows; ++row) {
+						Append(region.data + static_cast<size_t>(row) * region.stride, region.row_bytes);
+					}
+				}
+				Append(reinterpret_cast<const uint8_t*>(request.suffix.data()), request.suffix.size());
+				++requests_written_;
+			}
+			// The pixels are in the staging buffer now; hand the frame back.
+			request = WriteRequest();
+		} else if (queue_->Closed()) {
+			return;
+		} else if (buffered_ > 0 && !failed_) {
+			// Idle: push out what has gathered so a crash loses little.
+			Flush(true);
+		}
+	}
+}
+
+void AsyncFileWriter::Append(const uint8_t* data, size_t size) {
+	while (size > 0 && !failed_) {
+		size_t count = options_.buffer_size - buffered_;
+		if (count > size) {
+			count = size;
+		}
+		memcpy(buffer_ + buffered_, data, count);
+		buffered_ += count;
+		logical_size_ += count;
+		data += count;
+		size -= count;
+		if (buffered_ == options_.buffer_size) {
+			Flush(false);
+		}
+	}
+}
+
+bool AsyncFileWriter::Flush(bool aligned_only) {
+	size_t size = buffered_;
+	if (direct_io_ && aligned_only) {
+		size = buffered_ / kIoAlignment * kIoAlignment;
+	}
+	if (size == 0) {
+		return true;
+	}
+	if (!WriteBytes(buffer_, size)) {
+		failed_ = true;
+		return false;
+	}
+	bytes_written_ += size;
+	buffered_ -= size;
+	memmove(buffer_, buffer_ + size, buffered_);
+	return true;
+}
+
+bool AsyncFileWriter::WriteBytes(const uint8_t* data, size_t size) {
+	int64_t start_us = utils::TimeMicros();
+	while (size > 0) {
+#ifdef _WIN32
+		DWORD chunk = size > 0x40000000 ? 0x40000000 : static_cast<DWORD>(size);
+		DWORD written = 0;
+		if (!WriteFile(file_, data, chunk, &written, nullptr) || written == 0) {
+			return false;
+		}
+#else
+		ssize_t written = write(fd_, data, size);
+		if (written < 0 && errno == EINTR) {
+			continue;
+		}
+		if (written <= 0) {
+			return false;
+		}
+#endif
+		++write_calls_;
+		data += written;
+		size -= static_cast<size_t>(written);
+	}
+	write_time_us_ += utils::TimeMicros() - start_us;
+	return true;
+}
+
+bool AsyncFileWriter::FinishFile() {
+	if (failed_) {
+		return false;
+	}
+	if (!direct_io_) {
+		return Flush(false);
+	}
+	// Direct I/O only writes whole sectors: pad the tail, then cut the file
+	// back to the bytes that were actually appended.
+	if (!Flush(true)) {
+		return false;
+	}
+	if (buffered_ == 0) {
+		return true;
+	}
+	size_t padded = (buffered_ + kIoAlignment - 1) / kIoAlignment * kIoAlignment;
+	memset(buffer_ + buffered_, 0, padded - buffered_);
+	if (!WriteBytes(buffer_, padded)) {
+		return false;
+	}
+	bytes_written_ += buffered_;
+	buffered_ = 0;
+#ifdef _WIN32
+	LARGE_INTEGER size;
+	size.QuadPart = static_cast<LONGLONG>(logical_size_);
+	return SetFilePointerEx(file_, size, nullptr, FILE_BEGIN) && SetEndOfFile(file_);
+#else
+	return ftruncate(fd_, static_cast<off_t>(logical_size_)) == 0;
+#endif
+}
+
+bool AsyncFileWriter::PatchFile(const std::vector<FilePatch>& patches) {
+#ifdef _WIN32
+	HANDLE handle = CreateFileW(WidePath(path_).c_str(), GENERIC_WRITE, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+		FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (handle == INVALID_HANDLE_VALUE) {
+		return false;
+	}
+	bool ok = true;
+	for (const FilePatch& patch : patches) {
+		LARGE_INTEGER offset;
+		offset.QuadPart = static_cast<LONGLONG>(patch.offset);
+		DWORD written = 0;
+		if (!SetFilePointerEx(handle, offset, nullptr, FILE_BEGIN) ||
+			!WriteFile(handle, patch.data.data(), static_cast<DWORD>(patch.data.size()), &written, nullptr) ||
+			written != patch.data.size()) {
+			ok = false;
+			break;
+		}
+	}
+	return CloseHandle(handle) && ok;
+#else
+	int fd = open(path_.c_str(), O_WRONLY);
+	if (fd < 0) {
+		return false;
+	}
+	bool ok = true;
+	for (const FilePatch& patch : patches) {
+		ssize_t written = pwrite(fd, patch.data.data(), patch.data.size(), static_cast<off_t>(patch.offset));
+		if (written != static_cast<ssize_t>(patch.data.size())) {
+			ok = false;
+			break;
+		}
+	}
+	return close(fd) == 0 && ok;
+#endif
+}
@@ -0,0 +1,125 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "frame_queue.h"
+#include "ref_counted.h"
+
+struct AsyncFileWriterOptions {
+	// Bytes gathered before each write call; a multiple of 4096.
+	size_t buffer_size{ 4 << 20 };
+	// Requests waiting for the I/O thread before Submit() pushes back.
+	size_t queue_capacity{ 64 };
+	// Drop-newest keeps producers wait-free; block trades that for no loss.
+	// Drop-oldest is treated as drop-newest: it would discard a request after
+	// Submit() reported it queued, and callers such as FrameRecorder have
+	// already counted its bytes into file offsets and indexes by then.
+	FrameQueuePolicy policy{ kFrameQueueDropNewest };
+	// Bypass the page cache (O_DIRECT, FILE_FLAG_NO_BUFFERING). Falls back to
+	// buffered I/O where the file system refuses it.
+	bool direct_io{};
+};
+
+struct AsyncFileWriterStats {
+	uint64_t bytes_written;
+	uint64_t requests_written;
+	uint64_t requests_dropped;
+	uint64_t write_calls;
+	// Time spent inside write calls and since Open(), for throughput.
+	int64_t write_time_us;
+	int64_t elapsed_us;
+	size_t queue_depth;
+	size_t max_queue_depth;
+	bool direct_io;
+	bool failed;
+};
+
+// One unit of output, written whole or dropped whole: |prefix|, then up to
+// three strided regions packed row by row, then |suffix|. |owner| keeps the
+// region memory alive until the I/O thread has copied it.
+struct WriteRequest {
+	struct Region {
+		const uint8_t* data;
+		uint32_t row_bytes;
+		uint32_t stride;
+		uint32_t rows;
+	};
+
+	std::string prefix{};
+	Region regions[3]{};
+	int region_count{};
+	std::string suffix{};
+	RefPtr<RefCountInterface> owner{};
+
+	void AddRegion(const uint8_t* data, uint32_t row_bytes, uint32_t stride, uint32_t rows);
+	size_t Size() const;
+};
+
+// Bytes to overwrite at |offset| once the file is complete.
+struct FilePatch {
+	uint64_t offset;
+	std::string data;
+};
+
+// Appends requests to a file from a dedicated I/O thread. Submit() only
+// queues a reference, so it is cheap enough for a capture callback; the I/O
+// thread gathers requests into one large aligned buffer and issues a write
+// per full buffer.
+class AsyncFileWriter {
+public:
+	AsyncFileWriter();
+	~AsyncFileWriter();
+
+	// |path| is UTF-8, an existing file is truncated.
+	bool Open(const std::string& path, const AsyncFileWriterOptions& options = AsyncFileWriterOptions());
+	// Writes everything still queued and closes the file.
+	bool Close();
+	// Same, but appends |trailer| after the last request and then overwrites
+	// |patches| in place, for indexes and header sizes only known at the end.
+	bool Close(const std::string& trailer, const std::vector<FilePatch>& patches);
+	bool IsOpen() const;
+
+	// Returns false when the request was dropped: writer closed, failed, or
+	// (drop-newest) the queue is full. A request accepted here is written.
+	bool Submit(WriteRequest& request);
+
+	AsyncFileWriterStats Stats() const;
+
+private:
+	AsyncFileWriter(const AsyncFileWriter&) = delete;
+	AsyncFileWriter operator =(const AsyncFileWriter&) = delete;
+
+	void Run();
+	void Append(const uint8_t* data, size_t size);
+	// Writes the whole buffer, or with |aligned_only| just its aligned prefix.
+	bool Flush(bool aligned_only);
+	bool WriteBytes(const uint8_t* data, size_t size);
+	bool FinishFile();
+	// Reopens the closed file without direct I/O for the patches.
+	bool PatchFile(const std::vector<FilePatch>& patches);
+
+	AsyncFileWriterOptions options_{};
+	std::unique_ptr<FrameQueue<WriteRequest>> queue_{};
+	std::thread thread_{};
+	uint8_t* buffer_{};
+	size_t buffered_{};
+	uint64_t logical_size_{};
+	bool direct_io_{};
+#ifdef _WIN32
+	void* file_{};
+#else
+	int fd_{ -1 };
+#endif
+	std::string path_{};
+	int64_t open_time_us_{};
+	std::atomic<bool> failed_{ false };
+	std::atomic<uint64_t> bytes_written_{ 0 };
+	std::atomic<uint64_t> requests_written_{ 0 };
+	std::atomic<uint64_t> write_calls_{ 0 };
+	std::atomic<int64_t> write_time_us_{ 0 };
+};
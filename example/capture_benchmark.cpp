@@ -0,0 +1,860 @@
+// Micro and macro benchmarks for the capture pipeline. Runs without a camera:
+// conversion kernels per format pair and resolution, threaded 4K display
+// conversion, simulcast scaling, frame statistics, frame queue hand-off,
+// callback dispatch and end-to-end rate through TestPatternCapture.
+//
+//   capture_benchmark [--filter=<substring>] [--min_time=<seconds>] [--out=<file.json>]
+//
+// A summary goes to stdout; --out writes the results as JSON so runs can be
+// compared between releases. With --out=- the JSON takes stdout and the
+// summary goes to stderr.
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "cpu_features.h"
+#include "fake_video_capture.h"
+#include "frame_change_detector.h"
+#include "frame_diff_row.h"
+#include "frame_statistics.h"
+#include "frame_stats_row.h"
+#include "format_negotiation.h"
+#include "frame_queue.h"
+#include "test_pattern_capture.h"
+#include "thread_pool.h"
+#include "video_capture.h"
+#include "video_convert.h"
+#include "video_frame_buffer.h"
+#include "video_scaler.h"
+
+namespace {
+
+struct BenchmarkOptions {
+	std::string filter{};
+	double min_time{ 0.25 };
+	std::string out{};
+};
+
+struct BenchmarkResult {
+	std::string name{};
+	uint64_t iterations{};
+	double ns_per_iteration{};
+	// Frames, pixels or items per second, whichever the benchmark counts.
+	double items_per_second{};
+	double bytes_per_second{};
+	// End-to-end latency percentiles, only set by the pipeline benchmarks;
+	// the jitter benchmarks put callback jitter here.
+	int64_t p50_us{ -1 };
+	int64_t p99_us{ -1 };
+	int64_t p999_us{ -1 };
+};
+
+BenchmarkOptions g_options;
+std::vector<BenchmarkResult> g_results;
+// The summary moves to stderr when the JSON goes to stdout.
+FILE* g_report = stdout;
+
+int64_t NowNanos() {
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+bool Selected(const std::string& name) {
+	return g_options.filter.empty() || name.find(g_options.filter) != std::string::npos;
+}
+
+void Report(const BenchmarkResult& result) {
+	fprintf(g_report, "%-48s %12llu %14.1f ns", result.name.c_str(), static_cast<unsigned long long>(result.iterations),
+		result.ns_per_iteration);
+	if (result.bytes_per_second > 0.0) {
+		fprintf(g_report, " %10.1f MB/s", result.bytes_per_second / 1e6);
+	}
+	if (result.items_per_second > 0.0) {
+		fprintf(g_report, " %12.1f items/s", result.items_per_second);
+	}
+	if (result.p50_us >= 0) {
+		fprintf(g_report, "  p50 %lld us p99 %lld us", static_cast<long long>(result.p50_us),
+			static_cast<long long>(result.p99_us));
+	}
+	fprintf(g_report, "\n");
+	fflush(g_report);
+	g_results.push_back(result);
+}
+
+// Calls |body(iterations)| with growing batches until one batch takes at
+// least the minimum time, and reports the cost of one iteration from it.
+template<class Body>
+void RunBenchmark(const std::string& name, double items_per_iteration, double bytes_per_iteration, Body body) {
+	if (!Selected(name)) {
+		return;
+	}
+	body(1);
+	uint64_t iterations = 1;
+	int64_t min_ns = static_cast<int64_t>(g_options.min_time * 1e9);
+	for (;;) {
+		int64_t start = NowNanos();
+		body(iterations);
+		int64_t elapsed = NowNanos() - start;
+		if (elapsed >= min_ns || iterations >= (1ull << 40)) {
+			BenchmarkResult result;
+			result.name = name;
+			result.iterations = iterations;
+			result.ns_per_iteration = static_cast<double>(elapsed) / iterations;
+			double seconds = elapsed / 1e9;
+			result.items_per_second = items_per_iteration * iterations / seconds;
+			result.bytes_per_second = bytes_per_iteration * iterations / seconds;
+			Report(result);
+			return;
+		}
+		// Aim 40% past the minimum, but never grow more than tenfold at once.
+		double scale = elapsed > 0 ? 1.4 * min_ns / elapsed : 10.0;
+		scale = scale < 2.0 ? 2.0 : (scale > 10.0 ? 10.0 : scale);
+		iterations = static_cast<uint64_t>(iterations * scale);
+	}
+}
+
+std::string CpuFlagsName(int flags) {
+	std::string name;
+	if (flags & kCpuHasSSE2) {
+		name += "sse2,";
+	}
+	if (flags & kCpuHasAVX2) {
+		name += "avx2,";
+	}
+	if (flags & kCpuHasNEON) {
+		name += "neon,";
+	}
+	if (name.empty()) {
+		return "c";
+	}
+	name.pop_back();
+	return name;
+}
+
+std::string SizeName(uint32_t width, uint32_t height) {
+	return std::to_string(width) + "x" + std::to_string(height);
+}
+
+struct Resolution {
+	uint32_t width;
+	uint32_t height;
+};
+
+const Resolution kResolutions[] = { { 640, 480 }, { 1280, 720 }, { 1920, 1080 } };
+
+// Formats cameras deliver and formats consumers ask for.
+const VideoType kSourceTypes[] = { kVideoTypeI420, kVideoTypeNV12, kVideoTypeYUY2, kVideoTypeUYVY };
+const VideoType kDestinationTypes[] = { kVideoTypeI420, kVideoTypeNV12, kVideoTypeBGRA, kVideoTypeRGB24,
+	kVideoTypeRGB565 };
+
+void BenchmarkConversions() {
+	int cpu_flags = GetCpuFlags();
+	// The scalar reference first, then whatever the CPU dispatches to.
+	int masks[] = { 0, -1 };
+	for (const Resolution& resolution : kResolutions) {
+		for (VideoType src_type : kSourceTypes) {
+			for (VideoType dst_type : kDestinationTypes) {
+				if (src_type == dst_type || !CanConvertVideoFrame(src_type, dst_type)) {
+					continue;
+				}
+				VideoDescription description;
+				description.width = resolution.width;
+				description.height = resolution.height;
+				description.video_type = src_type;
+				VideoFrameLayout packed;
+				GetVideoFrameLayout(description, 1, packed);
+				VideoFrameBufferPool src_pool(1);
+				src_pool.Configure(description);
+				description.video_type = dst_type;
+				VideoFrameBufferPool dst_pool(1);
+				dst_pool.Configure(description);
+				RefPtr<VideoFrameBuffer> src_buffer = src_pool.CreateBuffer();
+				VideoFrame dst;
+				if (!src_buffer || !dst_pool.CreateFrame(dst)) {
+					continue;
+				}
+				// Textured mid grey, so no kernel sees a degenerate input.
+				uint8_t* data = src_buffer->Data(0);
+				for (size_t i = 0; i < src_buffer->Size(); ++i) {
+					data[i] = static_cast<uint8_t>(96 + (i * 7 & 63));
+				}
+				VideoFrame src;
+				src_buffer->WrapVideoFrame(src);
+				double pixels = static_cast<double>(resolution.width) * resolution.height;
+				for (int mask : masks) {
+					if (mask == -1 && cpu_flags == 0) {
+						continue;
+					}
+					SetCpuFlagsMask(mask);
+					std::string name = std::string("convert/") + VideoTypeName(src_type) + "->" +
+						VideoTypeName(dst_type) + "/" + SizeName(resolution.width, resolution.height) + "/" +
+						CpuFlagsName(GetCpuFlags());
+					RunBenchmark(name, pixels, static_cast<double>(packed.size), [&](uint64_t iterations) {
+						for (uint64_t i = 0; i < iterations; ++i) {
+							ConvertVideoFrame(src, dst);
+						}
+					});
+				}
+				SetCpuFlagsMask(-1);
+			}
+		}
+	}
+}
+
+// 4K camera formats to BGRA for display, on the calling thread and split
+// across a pool, for each matrix and range.
+void BenchmarkDisplayConversion() {
+	const VideoType types[] = { kVideoTypeNV12, kVideoTypeYUY2 };
+	const char* const matrix_names[] = { "bt601", "bt709" };
+	const char* const range_names[] = { "limited", "full" };
+	ThreadPool pool;
+	ThreadPool* pools[] = { nullptr, &pool };
+	for (VideoType src_type : types) {
+		VideoDescription description;
+		description.width = 3840;
+		description.height = 2160;
+		description.video_type = src_type;
+		VideoFrameBufferPool src_pool(1);
+		src_pool.Configure(description);
+		description.video_type = kVideoTypeBGRA;
+		VideoFrameBufferPool dst_pool(1);
+		dst_pool.Configure(description);
+		RefPtr<VideoFrameBuffer> src_buffer = src_pool.CreateBuffer();
+		VideoFrame dst;
+		if (!src_buffer || !dst_pool.CreateFrame(dst)) {
+			continue;
+		}
+		uint8_t* data = src_buffer->Data(0);
+		for (size_t i = 0; i < src_buffer->Size(); ++i) {
+			data[i] = static_cast<uint8_t>(96 + (i * 7 & 63));
+		}
+		VideoFrame src;
+		src_buffer->WrapVideoFrame(src);
+		double pixels = static_cast<double>(description.width) * description.height;
+		for (int matrix = kYuvColorMatrixBT601; matrix <= kYuvColorMatrixBT709; ++matrix) {
+			for (int range = kYuvColorRangeLimited; range <= kYuvColorRangeFull; ++range) {
+				const YuvConstants& yuv_constants =
+					GetYuvConstants(static_cast<YuvColorMatrix>(matrix), static_cast<YuvColorRange>(range));
+				for (ThreadPool* thread_pool : pools) {
+					std::string name = std::string("display/") + VideoTypeName(src_type) + "->BGRA/3840x2160/" +
+						matrix_names[matrix] + "_" + range_names[range] + "/" +
+						(thread_pool ? "pool" + std::to_string(thread_pool->ThreadCount()) : "single");
+					RunBenchmark(name, pixels, static_cast<double>(src_buffer->Size()), [&](uint64_t iterations) {
+						for (uint64_t i = 0; i < iterations; ++i) {
+							ConvertVideoFrame(src, dst, yuv_constants, thread_pool);
+						}
+					});
+				}
+			}
+		}
+	}
+}
+
+const char* ScaleFilterName(ScaleFilter filter) {
+	switch (filter) {
+	case kScaleFilterBox: return "box";
+	case kScaleFilterBilinear: return "bilinear";
+	case kScaleFilterBicubic: return "bicubic";
+	default: return "unknown";
+	}
+}
+
+// 1080p into 1080p, 540p and 270p layers: once as a pyramid, and once with
+// every layer scaled from the full frame for comparison.
+void BenchmarkScaling() {
+	int cpu_flags = GetCpuFlags();
+	int masks[] = { 0, -1 };
+	const VideoType types[] = { kVideoTypeI420, kVideoTypeNV12 };
+	const ScaleFilter filters[] = { kScaleFilterBox, kScaleFilterBilinear, kScaleFilterBicubic };
+	std::vector<ScaleSize> sizes(3);
+	for (size_t i = 0; i < sizes.size(); ++i) {
+		sizes[i].width = 1920 >> i;
+		sizes[i].height = 1080 >> i;
+	}
+	for (VideoType video_type : types) {
+		VideoDescription description;
+		description.width = 1920;
+		description.height = 1080;
+		description.video_type = video_type;
+		VideoFrameBufferPool src_pool(1);
+		src_pool.Configure(description);
+		RefPtr<VideoFrameBuffer> src_buffer = src_pool.CreateBuffer();
+		if (!src_buffer) {
+			continue;
+		}
+		uint8_t* data = src_buffer->Data(0);
+		for (size_t i = 0; i < src_buffer->Size(); ++i) {
+			data[i] = static_cast<uint8_t>(96 + (i * 7 & 63));
+		}
+		VideoFrame src;
+		src_buffer->WrapVideoFrame(src);
+		double bytes = static_cast<double>(src_buffer->Size());
+		std::vector<VideoFrameBufferPool> separate_pools(sizes.size() - 1);
+		std::vector<VideoFrame> separate(sizes.size() - 1);
+		for (size_t i = 1; i < sizes.size(); ++i) {
+			description.width = sizes[i].width;
+			description.height = sizes[i].height;
+			separate_pools[i - 1].Configure(description);
+			separate_pools[i - 1].CreateFrame(separate[i - 1]);
+		}
+		for (ScaleFilter filter : filters) {
+			VideoScaler scaler;
+			scaler.SetLayers(sizes, 1);
+			scaler.SetFilter(filter);
+			for (int mask : masks) {
+				if (mask == -1 && cpu_flags == 0) {
+					continue;
+				}
+				SetCpuFlagsMask(mask);
+				std::string suffix = std::string("/") + VideoTypeName(video_type) + "/1920x1080->3/" +
+					ScaleFilterName(filter) + "/" + CpuFlagsName(GetCpuFlags());
+				RunBenchmark("scale/pyramid" + suffix, 1.0, bytes, [&](uint64_t iterations) {
+					std::vector<VideoFrame> layers;
+					for (uint64_t i = 0; i < iterations; ++i) {
+						scaler.Scale(src, layers);
+					}
+				});
+				RunBenchmark("scale/separate" + suffix, 1.0, bytes, [&](uint64_t iterations) {
+					for (uint64_t i = 0; i < iterations; ++i) {
+						for (VideoFrame& layer : separate) {
+							ScaleVideoFrame(src, layer, filter);
+						}
+					}
+				});
+			}
+			SetCpuFlagsMask(-1);
+		}
+	}
+}
+
+void BenchmarkChangeDetection() {
+	int cpu_flags = GetCpuFlags();
+	int masks[] = { 0, -1 };
+	VideoDescription description;
+	description.width = 1920;
+	description.height = 1080;
+	description.video_type = kVideoTypeNV12;
+	VideoFrameBufferPool pool(2);
+	pool.Configure(description);
+	VideoFrame frames[2];
+	for (int f = 0; f < 2; ++f) {
+		if (!pool.CreateFrame(frames[f])) {
+			return;
+		}
+		for (uint32_t y = 0; y < description.height; ++y) {
+			memset(frames[f].y_data + y * frames[f].y_stride, static_cast<int>(96 + (y & 31) + f), description.width);
+		}
+	}
+	// Both frames are within the thresholds, so every one is compared and none
+	// becomes the reference.
+	double bytes = static_cast<double>(description.width) * description.height;
+	for (int mask : masks) {
+		if (mask == -1 && cpu_flags == 0) {
+			continue;
+		}
+		SetCpuFlagsMask(mask);
+		FrameChangeDetector detector;
+		detector.SetKeepAlive(0);
+		RunBenchmark("change/NV12/1920x1080/" + CpuFlagsName(GetCpuFlags()), 1.0, bytes, [&](uint64_t iterations) {
+			for (uint64_t i = 0; i < iterations; ++i) {
+				detector.Process(frames[i & 1]);
+			}
+		});
+	}
+	SetCpuFlagsMask(-1);
+}
+
+// Histogram, mean and variance and block activity of a 1080p frame in one
+// fused pass, against one pass per figure over the same kernels.
+void BenchmarkStatistics() {
+	int cpu_flags = GetCpuFlags();
+	int masks[] = { 0, -1 };
+	VideoDescription description;
+	description.width = 1920;
+	description.height = 1080;
+	description.video_type = kVideoTypeNV12;
+	VideoFrameBufferPool pool(1);
+	pool.Configure(description);
+	VideoFrame frame;
+	if (!pool.CreateFrame(frame)) {
+		return;
+	}
+	for (uint32_t y = 0; y < description.height; ++y) {
+		for (uint32_t x = 0; x < description.width; ++x) {
+			frame.y_data[y * frame.y_stride + x] = static_cast<uint8_t>(96 + ((x * 7 + y * 3) & 63));
+		}
+	}
+	for (uint32_t y = 0; y < description.height / 2; ++y) {
+		memset(frame.u_data + y * frame.u_stride, static_cast<int>(112 + (y & 31)), description.width);
+	}
+	int width = static_cast<int>(description.width);
+	int blocks = width / kFrameStatsBlockSize;
+	double bytes = description.width * description.height * 1.5;
+	for (int mask : masks) {
+		if (mask == -1 && cpu_flags == 0) {
+			continue;
+		}
+		SetCpuFlagsMask(mask);
+		std::string suffix = "/NV12/1920x1080/" + CpuFlagsName(GetCpuFlags());
+		FrameStatistics statistics;
+		RunBenchmark("stats/fused" + suffix, 1.0, bytes, [&](uint64_t iterations) {
+			for (uint64_t i = 0; i < iterations; ++i) {
+				ComputeFrameStatistics(frame, statistics);
+			}
+		});
+		FrameStatsRowFunctions stats_rows = GetFrameStatsRowFunctions(GetCpuFlags());
+		FrameDiffRowFunctions diff_rows = GetFrameDiffRowFunctions(GetCpuFlags());
+		std::vector<uint32_t> histograms(kFrameStatsHistograms * 256);
+		std::vector<uint32_t> activity(blocks);
+		RunBenchmark("stats/separate" + suffix, 1.0, bytes, [&](uint64_t iterations) {
+			for (uint64_t i = 0; i < iterations; ++i) {
+				FrameStatsSums luma = {};
+				FrameStatsSums u = {};
+				FrameStatsSums v = {};
+				for (uint32_t y = 0; y < description.height; ++y) {
+					FrameStatsHistogram_C(frame.y_data + y * frame.y_stride, width, histograms.data());
+				}
+				for (uint32_t y = 0; y < description.height; ++y) {
+					stats_rows.chroma(frame.y_data + y * frame.y_stride, width, &luma);
+				}
+				for (uint32_t y = 1; y < description.height; ++y) {
+					const uint8_t* row = frame.y_data + y * frame.y_stride;
+					for (int block = 0; block < blocks - 1; ++block) {
+						uint8_t max_difference = 0;
+						const uint8_t* src = row + block * kFrameStatsBlockSize;
+						activity[block] += diff_rows.sad(src, src + 1, kFrameStatsBlockSize, &max_difference) +
+							diff_rows.sad(src, src - frame.y_stride, kFrameStatsBlockSize, &max_difference);
+					}
+				}
+				for (uint32_t y = 0; y < description.height / 2; ++y) {
+					stats_rows.interleaved(frame.u_data + y * frame.u_stride, width / 2, &u, &v);
+				}
+			}
+		});
+	}
+	SetCpuFlagsMask(-1);
+}
+
+// A frame with a pooled buffer, so queue items carry a real reference.
+VideoFrame MakeQueueFrame(VideoFrameBufferPool& pool) {
+	VideoDescription description;
+	description.width = 64;
+	description.height = 64;
+	description.video_type = kVideoTypeI420;
+	pool.Configure(description);
+	VideoFrame video_frame;
+	pool.CreateFrame(video_frame);
+	return video_frame;
+}
+
+void BenchmarkQueue() {
+	VideoFrameBufferPool pool(1);
+	VideoFrame video_frame = MakeQueueFrame(pool);
+
+	RunBenchmark("queue/push_pop/same_thread", 1.0, 0.0, [&](uint64_t iterations) {
+		FrameQueue<VideoFrame> queue(64, kFrameQueueDropOldest);
+		VideoFrame popped;
+		for (uint64_t i = 0; i < iterations; ++i) {
+			queue.Push(video_frame);
+			queue.TryPop(popped);
+		}
+	});
+
+	// One producer, one consumer, the consumer blocking when the queue runs dry.
+	FrameQueuePolicy policies[] = { kFrameQueueBlock, kFrameQueueDropOldest };
+	const char* policy_names[] = { "block", "drop_oldest" };
+	for (int p = 0; p < 2; ++p) {
+		std::string name = std::string("queue/handoff/") + policy_names[p];
+		RunBenchmark(name, 1.0, 0.0, [&](uint64_t iterations) {
+			FrameQueue<VideoFrame> queue(16, policies[p]);
+			std::thread consumer([&queue]() {
+				VideoFrame popped;
+				while (queue.Pop(popped, std::chrono::milliseconds(100)) || !queue.Closed()) {
+				}
+			});
+			for (uint64_t i = 0; i < iterations; ++i) {
+				queue.Push(video_frame);
+			}
+			queue.Close();
+			consumer.join();
+		});
+	}
+}
+
+// Exposes the protected delivery path to the benchmark.
+class DispatchCapture : public VideoCapture {
+public:
+	void Deliver(VideoFrame& video_frame) {
+		DeliverFrame(video_frame);
+	}
+};
+
+void BenchmarkDispatch() {
+	VideoFrameBufferPool pool(1);
+	VideoFrame video_frame = MakeQueueFrame(pool);
+
+	RunBenchmark("dispatch/inline", 1.0, 0.0, [&](uint64_t iterations) {
+		DispatchCapture capture;
+		uint64_t count = 0;
+		capture.RegisterVideoFrameCallback([&count](VideoFrame&) {
+			++count;
+		});
+		for (uint64_t i = 0; i < iterations; ++i) {
+			capture.Deliver(video_frame);
+		}
+	});
+
+	// Includes waking the delivery thread and the hand-off through its queue.
+	RunBenchmark("dispatch/async", 1.0, 0.0, [&](uint64_t iterations) {
+		DispatchCapture capture;
+		std::atomic<uint64_t> count{ 0 };
+		capture.RegisterVideoFrameCallback([&count](VideoFrame&) {
+			count.fetch_add(1, std::memory_order_relaxed);
+		});
+		capture.SetAsyncDelivery(16, kFrameQueueBlock);
+		for (uint64_t i = 0; i < iterations; ++i) {
+			capture.Deliver(video_frame);
+		}
+		while (count.load(std::memory_order_relaxed) < iterations) {
+			std::this_thread::yield();
+		}
+	});
+}
+
+void BenchmarkEndToEnd() {
+	const VideoType types[] = { kVideoTypeI420, kVideoTypeNV12, kVideoTypeYUY2, kVideoTypeBGRA };
+	const Resolution resolutions[] = { { 1280, 720 }, { 1920, 1080 } };
+	for (const Resolution& resolution : resolutions) {
+		for (VideoType video_type : types) {
+			for (int async = 0; async < 2; ++async) {
+				std::string name = std::string("end_to_end/") + VideoTypeName(video_type) + "/" +
+					SizeName(resolution.width, resolution.height) + (async ? "/async" : "/inline");
+				if (!Selected(name)) {
+					continue;
+				}
+				TestPatternCapture capture;
+				capture.SetPattern(kTestPatternColorBars);
+				capture.SetFrameCounter(false);
+				if (async) {
+					capture.SetAsyncDelivery(4, kFrameQueueBlock);
+				}
+				std::atomic<uint64_t> frames{ 0 };
+				capture.RegisterVideoFrameCallback([&frames](VideoFrame&) {
+					frames.fetch_add(1, std::memory_order_relaxed);
+				});
+				VideoDescription description;
+				description.width = resolution.width;
+				description.height = resolution.height;
+				description.video_type = video_type;
+				// fps 0 renders frames as fast as the pipeline takes them.
+				if (!capture.StartCapture(VideoDevice(), description)) {
+					continue;
+				}
+				// Skip warm-up, when the buffer pool is still allocating.
+				std::this_thread::sleep_for(std::chrono::milliseconds(50));
+				capture.ResetLatencyStats();
+				uint64_t start_frames = frames.load();
+				int64_t start = NowNanos();
+				double duration = g_options.min_time > 0.5 ? g_options.min_time : 0.5;
+				std::this_thread::sleep_for(std::chrono::microseconds(static_cast<int64_t>(duration * 1e6)));
+				uint64_t count = frames.load() - start_frames;
+				int64_t elapsed = NowNanos() - start;
+				LatencySummary latency = capture.GetLatencyStats(kLatencyStageEndToEnd);
+				capture.StopCapture();
+
+				BenchmarkResult result;
+				result.name = name;
+				result.iterations = count;
+				result.ns_per_iteration = count ? static_cast<double>(elapsed) / count : 0.0;
+				result.items_per_second = count / (elapsed / 1e9);
+				result.p50_us = latency.p50_us;
+				result.p99_us = latency.p99_us;
+				result.p999_us = latency.p999_us;
+				Report(result);
+			}
+		}
+	}
+}
+
+// Callback jitter of a paced capture with the scheduler's placement against
+// pinned realtime threads; the realtime run needs the privileges for it and
+// reports as "/refused" without them.
+void BenchmarkCallbackJitter() {
+	for (int pinned = 0; pinned < 2; ++pinned) {
+		std::string name = std::string("jitter/I420/640x480/240fps/") + (pinned ? "pinned_realtime" : "default");
+		if (!Selected(name)) {
+			continue;
+		}
+		TestPatternCapture capture;
+		capture.SetPattern(kTestPatternColorBars);
+		capture.SetFrameRate(240.0);
+		capture.SetAsyncDelivery(4, kFrameQueueDropOldest);
+		if (pinned) {
+			CaptureThreadConfig config;
+			unsigned cpus = std::thread::hardware_concurrency();
+			config.capture.affinity_mask = 1;
+			config.capture.priority = utils::kThreadPriorityRealtime;
+			config.delivery.affinity_mask = cpus > 1 ? 2 : 1;
+			config.delivery.priority = utils::kThreadPriorityRealtime;
+			capture.SetThreadConfig(config);
+		}
+		std::atomic<uint64_t> frames{ 0 };
+		capture.RegisterVideoFrameCallback([&frames](VideoFrame&) {
+			frames.fetch_add(1, std::memory_order_relaxed);
+		});
+		VideoDescription description;
+		description.width = 640;
+		description.height = 480;
+		description.video_type = kVideoTypeI420;
+		if (!capture.StartCapture(VideoDevice(), description)) {
+			continue;
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(50));
+		capture.ResetLatencyStats();
+		uint64_t start_frames = frames.load();
+		int64_t start = NowNanos();
+		double duration = g_options.min_time > 1.0 ? g_options.min_time : 1.0;
+		std::this_thread::sleep_for(std::chrono::microseconds(static_cast<int64_t>(duration * 1e6)));
+		uint64_t count = frames.load() - start_frames;
+		int64_t elapsed = NowNanos() - start;
+		CaptureThreadStats stats = capture.GetThreadStats();
+		capture.StopCapture();
+
+		BenchmarkResult result;
+		result.name = name + (stats.delivery_applied && stats.capture_applied ? "" : "/refused");
+		result.iterations = count;
+		result.ns_per_iteration = count ? static_cast<double>(elapsed) / count : 0.0;
+		result.items_per_second = count / (elapsed / 1e9);
+		result.p50_us = stats.callback_jitter.p50_us;
+		result.p99_us = stats.callback_jitter.p99_us;
+		result.p999_us = stats.callback_jitter.p999_us;
+		Report(result);
+	}
+}
+
+// Time until every one of four cameras with a 50 ms open has delivered a
+// frame, bringing them up one after the other or concurrently.
+void BenchmarkStartup() {
+	const size_t kCameras = 4;
+	for (int concurrent = 0; concurrent < 2; ++concurrent) {
+		std::string name = std::string("startup/4x50ms/") + (concurrent ? "concurrent" : "serial");
+		if (!Selected(name)) {
+			continue;
+		}
+		VideoDescription description;
+		description.width = 640;
+		description.height = 480;
+		description.fps = 30;
+		description.video_type = kVideoTypeI420;
+		std::vector<std::unique_ptr<FakeVideoCapture>> captures;
+		std::atomic<size_t> cameras_with_frames{ 0 };
+		std::unique_ptr<std::atomic<bool>[]> first_frame(new std::atomic<bool>[kCameras]);
+		for (size_t camera = 0; camera < kCameras; ++camera) {
+			first_frame[camera] = false;
+			captures.push_back(std::unique_ptr<FakeVideoCapture>(new FakeVideoCapture()));
+			captures.back()->SetStartDelayMs(50);
+			std::atomic<bool>* seen = &first_frame[camera];
+			captures.back()->RegisterVideoFrameCallback([seen, &cameras_with_frames](VideoFrame&) {
+				if (!seen->exchange(true)) {
+					cameras_with_frames.fetch_add(1);
+				}
+			});
+		}
+		int64_t start = NowNanos();
+		if (concurrent) {
+			std::vector<std::shared_ptr<CaptureOperation>> operations;
+			for (std::unique_ptr<FakeVideoCapture>& capture : captures) {
+				operations.push_back(capture->StartCaptureAsync(VideoDevice(), description,
+					std::chrono::milliseconds(1000)));
+			}
+			for (const std::shared_ptr<CaptureOperation>& operation : operations) {
+				operation->Wait();
+			}
+		}
+		else {
+			for (std::unique_ptr<FakeVideoCapture>& capture : captures) {
+				capture->StartCapture(VideoDevice(), description);
+			}
+		}
+		while (cameras_with_frames.load() < kCameras && NowNanos() - start < 2000000000) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+		int64_t elapsed = NowNanos() - start;
+		for (std::unique_ptr<FakeVideoCapture>& capture : captures) {
+			capture->StopCapture();
+		}
+
+		BenchmarkResult result;
+		result.name = name;
+		result.iterations = 1;
+		result.ns_per_iteration = static_cast<double>(elapsed);
+		Report(result);
+	}
+}
+
+// Time from asking for another size to its first frame at 30 fps, stopping
+// and restarting a camera with a 50 ms open against Reconfigure() on the
+// open session.
+void BenchmarkReconfigure() {
+	const int kSwitches = 8;
+	for (int live = 0; live < 2; ++live) {
+		std::string name = std::string("reconfigure/640x480<->1280x720/") + (live ? "live" : "restart");
+		if (!Selected(name)) {
+			continue;
+		}
+		VideoDescription descriptions[2];
+		descriptions[0].width = 640;
+		descriptions[0].height = 480;
+		descriptions[0].fps = 30;
+		descriptions[0].video_type = kVideoTypeI420;
+		descriptions[1] = descriptions[0];
+		descriptions[1].width = 1280;
+		descriptions[1].height = 720;
+		FakeVideoCapture capture;
+		capture.SetStartDelayMs(50);
+		std::atomic<uint32_t> last_width{ 0 };
+		capture.RegisterVideoFrameCallback([&last_width](VideoFrame& video_frame) {
+			last_width.store(video_frame.width);
+		});
+		if (!capture.StartCapture(VideoDevice(), descriptions[0])) {
+			continue;
+		}
+		int64_t total = 0;
+		int switches = 0;
+		for (int i = 1; i <= kSwitches; ++i) {
+			const VideoDescription& description = descriptions[i % 2];
+			int64_t start = NowNanos();
+			bool switched = live ? capture.Reconfigure(description) :
+				capture.StopCapture() && capture.StartCapture(VideoDevice(), description);
+			if (!switched) {
+				break;
+			}
+			while (last_width.load() != description.width && NowNanos() - start < 2000000000) {
+				std::this_thread::sleep_for(std::chrono::microseconds(200));
+			}
+			total += NowNanos() - start;
+			++switches;
+		}
+		capture.StopCapture();
+		if (!switches) {
+			continue;
+		}
+
+		BenchmarkResult result;
+		result.name = name;
+		result.iterations = switches;
+		result.ns_per_iteration = static_cast<double>(total) / switches;
+		Report(result);
+	}
+}
+
+void WriteJsonString(FILE* file, const std::string& value) {
+	fputc('"', file);
+	for (char c : value) {
+		if (c == '"' || c == '\\') {
+			fputc('\\', file);
+		}
+		fputc(c, file);
+	}
+	fputc('"', file);
+}
+
+// Same shape as Google Benchmark's JSON, so the usual compare tools read it.
+bool WriteJson(const std::string& path) {
+	FILE* file = path == "-" ? stdout : fopen(path.c_str(), "w");
+	if (!file) {
+		return false;
+	}
+	char date[64];
+	time_t now = time(nullptr);
+	strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", localtime(&now));
+	fprintf(file, "{\n  \"context\": {\n    \"date\": \"%s\",\n    \"num_cpus\": %u,\n", date,
+		std::thread::hardware_concurrency());
+	fprintf(file, "    \"cpu_flags\": \"%s\",\n", CpuFlagsName(GetCpuFlags()).c_str());
+#ifdef NDEBUG
+	fprintf(file, "    \"library_build_type\": \"release\",\n");
+#else
+	fprintf(file, "    \"library_build_type\": \"debug\",\n");
+#endif
+	fprintf(file, "    \"min_time\": %g\n  },\n  \"benchmarks\": [", g_options.min_time);
+	for (size_t i = 0; i < g_results.size(); ++i) {
+		const BenchmarkResult& result = g_results[i];
+		fprintf(file, "%s\n    {\n      \"name\": ", i ? "," : "");
+		WriteJsonString(file, result.name);
+		fprintf(file, ",\n      \"run_type\": \"iteration\",\n      \"iterations\": %llu,\n",
+			static_cast<unsigned long long>(result.iterations));
+		fprintf(file, "      \"real_time\": %.3f,\n      \"cpu_time\": %.3f,\n      \"time_unit\": \"ns\",\n",
+			result.ns_per_iteration, result.ns_per_iteration);
+		fprintf(file, "      \"items_per_second\": %.3f", result.items_per_second);
+		if (result.bytes_per_second > 0.0) {
+			fprintf(file, ",\n      \"bytes_per_second\": %.3f", result.bytes_per_second);
+		}
+		if (result.p50_us >= 0) {
+			fprintf(file, ",\n      \"latency_p50_us\": %lld,\n      \"latency_p99_us\": %lld,\n"
+				"      \"latency_p999_us\": %lld", static_cast<long long>(result.p50_us),
+				static_cast<long long>(result.p99_us), static_cast<long long>(result.p999_us));
+		}
+		fprintf(file, "\n    }");
+	}
+	fprintf(file, "\n  ]\n}\n");
+	bool ok = !ferror(file);
+	if (file != stdout) {
+		ok = fclose(file) == 0 && ok;
+	}
+	return ok;
+}
+
+bool ParseOptions(int argc, char* argv[]) {
+	for (int i = 1; i < argc; ++i) {
+		std::string argument = argv[i];
+		if (argument.compare(0, 9, "--filter=") == 0) {
+			g_options.filter = argument.substr(9);
+		}
+		else if (argument.compare(0, 11, "--min_time=") == 0) {
+			g_options.min_time = atof(argument.c_str() + 11);
+		}
+		else if (argument.compare(0, 6, "--out=") == 0) {
+			g_options.out = argument.substr(6);
+		}
+		else {
+			fprintf(stderr, "usage: %s [--filter=<substring>] [--min_time=<seconds>] [--out=<file.json>|-]\n",
+				argv[0]);
+			return false;
+		}
+	}
+	return true;
+}
+
+}
+
+int main(int argc, char* argv[]) {
+	if (!ParseOptions(argc, argv)) {
+		return 2;
+	}
+	if (g_options.out == "-") {
+		g_report = stderr;
+	}
+	BenchmarkConversions();
+	BenchmarkDisplayConversion();
+	BenchmarkScaling();
+	BenchmarkChangeDetection();
+	BenchmarkStatistics();
+	BenchmarkQueue();
+	BenchmarkDispatch();
+	BenchmarkEndToEnd();
+	BenchmarkCallbackJitter();
+	BenchmarkStartup();
+	BenchmarkReconfigure();
+	if (!g_options.out.empty() && !WriteJson(g_options.out)) {
+		fprintf(stderr, "cannot write %s\n", g_options.out.c_str());
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,117 @@
+#include "capture_operation.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+CaptureOperation::CaptureOperation(std::chrono::milliseconds timeout, Callback callback)
+	: callback_(std::move(callback)) {
+	if (timeout.count() > 0) {
+		deadline_ = std::chrono::steady_clock::now() + timeout;
+	}
+#ifdef _WIN32
+	cancel_event_ = CreateEvent(nullptr, TRUE, FALSE, nullptr);
+#endif
+}
+
+CaptureOperation::~CaptureOperation() {
+#ifdef _WIN32
+	if (cancel_event_) {
+		CloseHandle(cancel_event_);
+	}
+#endif
+}
+
+CaptureStatus CaptureOperation::Status() const {
+	std::lock_guard<std::mutex> lock(mutex_);
+	return status_;
+}
+
+bool CaptureOperation::Done() const {
+	return Status() != kCaptureStatusPending;
+}
+
+bool CaptureOperation::Wait(std::chrono::milliseconds timeout) const {
+	std::unique_lock<std::mutex> lock(mutex_);
+	return done_.wait_for(lock, timeout, [this]() { return status_ != kCaptureStatusPending; });
+}
+
+CaptureStatus CaptureOperation::Wait() const {
+	std::unique_lock<std::mutex> lock(mutex_);
+	done_.wait(lock, [this]() { return status_ != kCaptureStatusPending; });
+	return status_;
+}
+
+void CaptureOperation::Cancel() {
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		cancelled_ = true;
+	}
+#ifdef _WIN32
+	if (cancel_event_) {
+		SetEvent(cancel_event_);
+	}
+#endif
+	Complete(kCaptureStatusCancelled);
+}
+
+bool CaptureOperation::Abandoned() const {
+	std::lock_guard<std::mutex> lock(mutex_);
+	return cancelled_ || outcome_ == kCaptureStatusTimedOut ||
+		(HasDeadline() && std::chrono::steady_clock::now() >= deadline_);
+}
+
+std::chrono::milliseconds CaptureOperation::Remaining() const {
+	if (!HasDeadline()) {
+		return std::chrono::milliseconds::max();
+	}
+	std::chrono::steady_clock::duration remaining = deadline_ - std::chrono::steady_clock::now();
+	if (remaining <= std::chrono::steady_clock::duration::zero()) {
+		return std::chrono::milliseconds(0);
+	}
+	// Rounded up, so waiting the remaining time reaches the deadline.
+	return std::chrono::duration_cast<std::chrono::milliseconds>(remaining + std::chrono::milliseconds(1) -
+		std::chrono::steady_clock::duration(1));
+}
+
+bool CaptureOperation::SleepFor(std::chrono::milliseconds duration) const {
+	std::unique_lock<std::mutex> lock(mutex_);
+	auto abandoned = [this]() { return cancelled_ || outcome_ != kCaptureStatusPending; };
+	if (HasDeadline() && duration >= Remaining()) {
+		done_.wait_until(lock, deadline_, abandoned);
+	}
+	else if (duration == std::chrono::milliseconds::max()) {
+		done_.wait(lock, abandoned);
+	}
+	else {
+		done_.wait_for(lock, duration, abandoned);
+	}
+	lock.unlock();
+	return !Abandoned();
+}
+
+bool CaptureOperation::Complete(CaptureStatus status) {
+	Callback callback;
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		if (outcome_ != kCaptureStatusPending || status == kCaptureStatusPending) {
+			return false;
+		}
+		outcome_ = status;
+		callback.swap(callback_);
+	}
+	// Waiters return only once the callback is done.
+	if (callback) {
+		callback(status);
+	}
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		status_ = status;
+	}
+	done_.notify_all();
+	return true;
+}
+
+bool CaptureOperation::HasDeadline() const {
+	return deadline_ != std::chrono::steady_clock::time_point();
+}
@@ -0,0 +1,73 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+
+enum CaptureStatus {
+	kCaptureStatusPending,
+	kCaptureStatusSucceeded,
+	kCaptureStatusFailed,
+	kCaptureStatusTimedOut,
+	kCaptureStatusCancelled,
+};
+
+// One asynchronous start or stop, see VideoCapture::StartCaptureAsync().
+// The caller waits on it or takes the callback; the backend doing the work
+// bounds its blocking waits by the deadline and gives up when the operation
+// is abandoned. The first outcome wins: an operation that times out or is
+// cancelled completes right away, whatever the backend is still doing.
+class CaptureOperation {
+public:
+	using Callback = std::function<void(CaptureStatus status)>;
+
+	// |timeout| of 0 waits as long as the backend takes. |callback| runs once,
+	// on the thread that settles the outcome, and may be empty.
+	CaptureOperation(std::chrono::milliseconds timeout, Callback callback);
+	~CaptureOperation();
+
+	CaptureStatus Status() const;
+	bool Done() const;
+	// Waits up to |timeout| for the outcome; false while still pending.
+	bool Wait(std::chrono::milliseconds timeout) const;
+	CaptureStatus Wait() const;
+	// Completes the operation as cancelled unless it already has an outcome,
+	// and tells the backend to give up.
+	void Cancel();
+
+	// Cancelled or past the deadline: the backend's work is no longer wanted.
+	bool Abandoned() const;
+	// Time left before the deadline, 0 once it has passed and
+	// std::chrono::milliseconds::max() without one.
+	std::chrono::milliseconds Remaining() const;
+	// Sleeps up to |duration|, waking early when the operation is abandoned.
+	// Returns false when it was.
+	bool SleepFor(std::chrono::milliseconds duration) const;
+#ifdef _WIN32
+	// Manual-reset event signalled by Cancel(), for backends to add to their
+	// waits.
+	void* CancelEvent() const { return cancel_event_; }
+#endif
+
+	// Settles the outcome unless it is settled; returns whether this call did.
+	bool Complete(CaptureStatus status);
+
+private:
+	CaptureOperation(const CaptureOperation&) = delete;
+	CaptureOperation operator =(const CaptureOperation&) = delete;
+
+	bool HasDeadline() const;
+
+	mutable std::mutex mutex_{};
+	mutable std::condition_variable done_{};
+	CaptureStatus status_{ kCaptureStatusPending };
+	// Set by the Complete() call that wins, before its callback runs;
+	// |status_| follows once the callback is done.
+	CaptureStatus outcome_{ kCaptureStatusPending };
+	bool cancelled_{};
+	std::chrono::steady_clock::time_point deadline_{};
+	Callback callback_{};
+#ifdef _WIN32
+	void* cancel_event_{};
+#endif
+};
@@ -0,0 +1,146 @@
+// StartCaptureAsync() and StopCaptureAsync() outcomes against FakeVideoCapture:
+// success, failure, timeout, cancel, a wedged device, and a start that
+// succeeds after its deadline and must be stopped again.
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <thread>
+
+#include "fake_video_capture.h"
+#include "test_check.h"
+
+namespace {
+
+const std::chrono::milliseconds kNoTimeout(0);
+
+VideoDescription Description() {
+	VideoDescription description;
+	description.width = 320;
+	description.height = 240;
+	description.fps = 30;
+	description.video_type = kVideoTypeI420;
+	return description;
+}
+
+// Polls |condition| for up to two seconds, for state the operation thread
+// settles after the outcome is reported.
+bool WaitFor(const std::function<bool()>& condition) {
+	std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+	while (!condition()) {
+		if (std::chrono::steady_clock::now() > deadline) {
+			return false;
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	return true;
+}
+
+int64_t ElapsedMs(std::chrono::steady_clock::time_point start) {
+	return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+void TestStartAndStop() {
+	FakeVideoCapture capture;
+	capture.SetStartDelayMs(20);
+	std::atomic<int> callbacks{ 0 };
+	std::atomic<int> callback_status{ kCaptureStatusPending };
+	std::shared_ptr<CaptureOperation> start = capture.StartCaptureAsync(VideoDevice(), Description(),
+		std::chrono::milliseconds(1000), [&](CaptureStatus status) {
+			++callbacks;
+			callback_status = status;
+		});
+	CHECK(start->Wait() == kCaptureStatusSucceeded);
+	CHECK(callbacks == 1 && callback_status == kCaptureStatusSucceeded);
+	CHECK(capture.IsCapturing());
+	std::shared_ptr<CaptureOperation> stop = capture.StopCaptureAsync(std::chrono::milliseconds(1000));
+	CHECK(stop->Wait() == kCaptureStatusSucceeded);
+	CHECK(!capture.IsCapturing());
+	CHECK(capture.StartCount() == 1 && capture.StopCount() == 1);
+}
+
+void TestStartFails() {
+	FakeVideoCapture capture;
+	capture.SetStartFails(true);
+	std::shared_ptr<CaptureOperation> start = capture.StartCaptureAsync(VideoDevice(), Description(),
+		std::chrono::milliseconds(1000));
+	CHECK(start->Wait() == kCaptureStatusFailed);
+	CHECK(!capture.IsCapturing());
+}
+
+// A slow start past its deadline reports the timeout at the deadline, and the
+// fake gives up its delay so no capture is left running.
+void TestTimeout() {
+	FakeVideoCapture capture;
+	capture.SetStartDelayMs(1000);
+	std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+	std::shared_ptr<CaptureOperation> start = capture.StartCaptureAsync(VideoDevice(), Description(),
+		std::chrono::milliseconds(50));
+	CHECK(start->Wait() == kCaptureStatusTimedOut);
+	CHECK(ElapsedMs(begin) < 500);
+	CHECK(capture.StopCaptureAsync(kNoTimeout)->Wait() == kCaptureStatusSucceeded);
+	CHECK(!capture.IsCapturing());
+	CHECK(capture.StopCount() == 0);
+}
+
+void TestCancel() {
+	FakeVideoCapture capture;
+	capture.SetStartDelayMs(1000);
+	std::shared_ptr<CaptureOperation> start = capture.StartCaptureAsync(VideoDevice(), Description(), kNoTimeout);
+	std::this_thread::sleep_for(std::chrono::milliseconds(20));
+	std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+	start->Cancel();
+	CHECK(start->Wait() == kCaptureStatusCancelled);
+	CHECK(ElapsedMs(begin) < 500);
+	CHECK(capture.StopCaptureAsync(kNoTimeout)->Wait() == kCaptureStatusSucceeded);
+	CHECK(!capture.IsCapturing());
+	// Cancelled while waiting its turn: the queued start never reaches the
+	// backend.
+	capture.SetStartDelayMs(200);
+	std::shared_ptr<CaptureOperation> first = capture.StartCaptureAsync(VideoDevice(), Description(), kNoTimeout);
+	std::shared_ptr<CaptureOperation> queued = capture.StartCaptureAsync(VideoDevice(), Description(), kNoTimeout);
+	queued->Cancel();
+	CHECK(queued->Wait() == kCaptureStatusCancelled);
+	CHECK(first->Wait() == kCaptureStatusSucceeded);
+	CHECK(capture.StopCaptureAsync(kNoTimeout)->Wait() == kCaptureStatusSucceeded);
+	CHECK(!capture.IsCapturing());
+	CHECK(capture.StartCount() == 2);
+}
+
+// A device that never answers: the timeout still fires, and the wedged start
+// unblocks once its operation is abandoned.
+void TestHang() {
+	FakeVideoCapture capture;
+	capture.SetStartHangs(true);
+	std::shared_ptr<CaptureOperation> start = capture.StartCaptureAsync(VideoDevice(), Description(),
+		std::chrono::milliseconds(50));
+	CHECK(start->Wait() == kCaptureStatusTimedOut);
+	CHECK(capture.StopCaptureAsync(std::chrono::milliseconds(1000))->Wait() == kCaptureStatusSucceeded);
+	CHECK(!capture.IsCapturing());
+}
+
+// The start times out but the backend finishes it anyway; nobody wants that
+// capture, so the operation stops it again by itself.
+void TestLateStartIsStopped() {
+	FakeVideoCapture capture;
+	capture.SetStartDelayMs(200);
+	capture.SetStartUninterruptible(true);
+	std::shared_ptr<CaptureOperation> start = capture.StartCaptureAsync(VideoDevice(), Description(),
+		std::chrono::milliseconds(50));
+	CHECK(start->Wait() == kCaptureStatusTimedOut);
+	CHECK(WaitFor([&capture]() { return capture.StopCount() == 1; }));
+	CHECK(!capture.IsCapturing());
+	CHECK(capture.StartCount() == 1);
+	CHECK(start->Status() == kCaptureStatusTimedOut);
+}
+
+}
+
+int main() {
+	TestStartAndStop();
+	TestStartFails();
+	TestTimeout();
+	TestCancel();
+	TestHang();
+	TestLateStartIsStopped();
+	return test::Result();
+}
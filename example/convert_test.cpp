@@ -0,0 +1,126 @@
+// Every SIMD level must produce exactly the bytes of the scalar reference, for
+// every format pair ConvertVideoFrame() supports, at odd sizes that leave
+// tails for each kernel. The thread pool band path must match as well.
+#include <cstring>
+#include <vector>
+
+#include "cpu_features.h"
+#include "format_negotiation.h"
+#include "test_check.h"
+#include "thread_pool.h"
+#include "video_convert.h"
+#include "video_frame_buffer.h"
+
+namespace {
+
+struct Size {
+	uint32_t width;
+	uint32_t height;
+};
+
+const Size kSizes[] = { { 1, 1 }, { 3, 5 }, { 33, 17 }, { 67, 35 }, { 641, 479 } };
+
+struct TestFrame {
+	explicit TestFrame(const VideoDescription& description) : pool(1) {
+		pool.Configure(description);
+		buffer = pool.CreateBuffer();
+		if (buffer) {
+			buffer->WrapVideoFrame(frame);
+		}
+	}
+
+	// The whole buffer, stride padding included.
+	uint8_t* Data() {
+		return buffer->Data(0);
+	}
+
+	size_t Size() const {
+		return buffer->Size();
+	}
+
+	VideoFrameBufferPool pool;
+	RefPtr<VideoFrameBuffer> buffer{};
+	VideoFrame frame{};
+};
+
+VideoDescription Describe(const Size& size, VideoType video_type) {
+	VideoDescription description;
+	description.width = size.width;
+	description.height = size.height;
+	description.video_type = video_type;
+	return description;
+}
+
+// Converts with the kernels allowed by |mask| into a destination cleared to a
+// fixed pattern, so untouched padding compares equal too.
+std::vector<uint8_t> Convert(const VideoFrame& src, TestFrame& dst, int mask, const YuvConstants& yuv_constants,
+	ThreadPool* thread_pool) {
+	SetCpuFlagsMask(mask);
+	memset(dst.Data(), 0xa5, dst.Size());
+	bool converted = ConvertVideoFrame(src, dst.frame, yuv_constants, thread_pool);
+	SetCpuFlagsMask(-1);
+	CHECK(converted);
+	return std::vector<uint8_t>(dst.Data(), dst.Data() + dst.Size());
+}
+
+void TestFormatPair(const Size& size, VideoType src_type, VideoType dst_type, ThreadPool& pool) {
+	TestFrame src(Describe(size, src_type));
+	TestFrame dst(Describe(size, dst_type));
+	CHECK(src.buffer && dst.buffer);
+	if (!src.buffer || !dst.buffer) {
+		return;
+	}
+	uint32_t seed = size.width * 31 + size.height * 17 + src_type * 7 + dst_type;
+	for (size_t i = 0; i < src.Size(); ++i) {
+		seed = seed * 1664525 + 1013904223;
+		src.Data()[i] = static_cast<uint8_t>(seed >> 24);
+	}
+
+	const YuvConstants* constants[] = { &kYuvI601Constants, &kYuvJ601Constants, &kYuvH709Constants,
+		&kYuvF709Constants };
+	const int masks[] = { kCpuHasSSE2, kCpuHasSSE2 | kCpuHasAVX2, kCpuHasNEON, -1 };
+	for (const YuvConstants* yuv_constants : constants) {
+		std::vector<uint8_t> reference = Convert(src.frame, dst, 0, *yuv_constants, nullptr);
+		for (int mask : masks) {
+			if (mask != -1 && (GetCpuFlags() & mask) != mask) {
+				continue;
+			}
+			bool same = Convert(src.frame, dst, mask, *yuv_constants, nullptr) == reference;
+			if (!same) {
+				fprintf(stderr, "%s->%s %ux%u cpu flags %d differ from scalar\n", VideoTypeName(src_type),
+					VideoTypeName(dst_type), size.width, size.height, mask);
+			}
+			CHECK(same);
+		}
+		bool same = Convert(src.frame, dst, -1, *yuv_constants, &pool) == reference;
+		if (!same) {
+			fprintf(stderr, "%s->%s %ux%u on the thread pool differs from scalar\n", VideoTypeName(src_type),
+				VideoTypeName(dst_type), size.width, size.height);
+		}
+		CHECK(same);
+	}
+}
+
+}
+
+int main() {
+	printf("cpu flags %d\n", GetCpuFlags());
+	ThreadPool pool(3);
+	int pairs = 0;
+	for (const Size& size : kSizes) {
+		for (int src = kVideoTypeI420; src <= kVideoTypeBGRA; ++src) {
+			for (int dst = kVideoTypeI420; dst <= kVideoTypeBGRA; ++dst) {
+				VideoType src_type = static_cast<VideoType>(src);
+				VideoType dst_type = static_cast<VideoType>(dst);
+				if (!CanConvertVideoFrame(src_type, dst_type)) {
+					continue;
+				}
+				TestFormatPair(size, src_type, dst_type, pool);
+				++pairs;
+			}
+		}
+	}
+	printf("%d format pairs and sizes\n", pairs);
+	CHECK(pairs > 0);
+	return test::Result();
+}
@@ -0,0 +1,80 @@
+#include "cpu_features.h"
+
+#include <atomic>
+
+#if defined(HAS_X86_SIMD)
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+namespace {
+
+std::atomic<int> cpu_flags_mask{ -1 };
+
+#if defined(HAS_X86_SIMD)
+void CpuId(uint32_t leaf, uint32_t sub_leaf, uint32_t regs[4]) {
+#if defined(_MSC_VER)
+	int info[4] = {};
+	__cpuidex(info, static_cast<int>(leaf), static_cast<int>(sub_leaf));
+	for (int i = 0; i < 4; ++i) {
+		regs[i] = static_cast<uint32_t>(info[i]);
+	}
+#else
+	regs[0] = regs[1] = regs[2] = regs[3] = 0;
+	__get_cpuid_count(leaf, sub_leaf, &regs[0], &regs[1], &regs[2], &regs[3]);
+#endif
+}
+
+uint64_t GetXcr0() {
+#if defined(_MSC_VER)
+	return _xgetbv(0);
+#else
+	uint32_t eax = 0;
+	uint32_t edx = 0;
+	__asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+	return (static_cast<uint64_t>(edx) << 32) | eax;
+#endif
+}
+#endif
+
+int DetectCpuFlags() {
+	int flags = 0;
+#if defined(HAS_X86_SIMD)
+	uint32_t regs[4] = {};
+	CpuId(0, 0, regs);
+	uint32_t max_leaf = regs[0];
+	CpuId(1, 0, regs);
+	if (regs[3] & (1u << 26)) {
+		flags |= kCpuHasSSE2;
+	}
+	bool os_saves_ymm = (regs[2] & (1u << 27)) && (GetXcr0() & 0x6) == 0x6;
+	if (max_leaf >= 7 && os_saves_ymm) {
+		CpuId(7, 0, regs);
+		if (regs[1] & (1u << 5)) {
+			flags |= kCpuHasAVX2;
+		}
+	}
+#endif
+#if defined(HAS_NEON_SIMD)
+	flags |= kCpuHasNEON;
+#endif
+	return flags;
+}
+
+}
+
+int GetCpuFlags() {
+	static const int detected = DetectCpuFlags();
+	return detected & cpu_flags_mask.load(std::memory_order_relaxed);
+}
+
+bool HasCpuFeature(CpuFeature feature) {
+	return (GetCpuFlags() & feature) != 0;
+}
+
+void SetCpuFlagsMask(int mask) {
+	cpu_flags_mask.store(mask, std::memory_order_relaxed);
+}
@@ -0,0 +1,24 @@
+#pragma once
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define HAS_X86_SIMD 1
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(__aarch64__) || defined(_M_ARM64)
+#define HAS_NEON_SIMD 1
+#endif
+
+enum CpuFeature {
+	kCpuHasSSE2 = 1 << 0,
+	kCpuHasAVX2 = 1 << 1,
+	kCpuHasNEON = 1 << 2,
+};
+
+// Features detected on this machine, restricted by SetCpuFlagsMask().
+int GetCpuFlags();
+bool HasCpuFeature(CpuFeature feature);
+
+// Limits which kernels are dispatched, e.g. 0 forces the scalar reference
+// code. Pass -1 to allow everything the CPU supports.
+void SetCpuFlagsMask(int mask);
@@ -0,0 +1,354 @@
+#include "device_capability_cache.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <sstream>
+
+#include "thread_utils.h"
+
+namespace {
+
+// Bump when the file layout or the VideoType numbering changes.
+const char kCacheHeader[] = "video-capture-device-cache 1";
+
+std::string Escape(const std::string& value) {
+	std::string result;
+	for (char c : value) {
+		switch (c) {
+		case '\\': result += "\\\\"; break;
+		case '\t': result += "\\t"; break;
+		case '\n': result += "\\n"; break;
+		case '\r': result += "\\r"; break;
+		default: result += c; break;
+		}
+	}
+	return result;
+}
+
+bool Unescape(const std::string& value, std::string& result) {
+	result.clear();
+	for (size_t i = 0; i < value.size(); ++i) {
+		if (value[i] != '\\') {
+			result += value[i];
+			continue;
+		}
+		if (++i == value.size()) {
+			return false;
+		}
+		switch (value[i]) {
+		case '\\': result += '\\'; break;
+		case 't': result += '\t'; break;
+		case 'n': result += '\n'; break;
+		case 'r': result += '\r'; break;
+		default: return false;
+		}
+	}
+	return true;
+}
+
+std::vector<std::string> SplitTabs(const std::string& line) {
+	std::vector<std::string> fields;
+	size_t start = 0;
+	for (;;) {
+		size_t end = line.find('\t', start);
+		fields.push_back(line.substr(start, end == std::string::npos ? std::string::npos : end - start));
+		if (end == std::string::npos) {
+			return fields;
+		}
+		start = end + 1;
+	}
+}
+
+bool SameEntry(const DeviceCapabilities& a, const DeviceCapabilities& b) {
+	if (a.video_device.device_id != b.video_device.device_id ||
+		a.video_device.device_name != b.video_device.device_name ||
+		a.video_device.index != b.video_device.index || a.fingerprint != b.fingerprint ||
+		a.formats.size() != b.formats.size()) {
+		return false;
+	}
+	for (size_t i = 0; i < a.formats.size(); ++i) {
+		const VideoDescription& x = a.formats[i];
+		const VideoDescription& y = b.formats[i];
+		if (x.width != y.width || x.height != y.height || x.fps != y.fps || x.video_type != y.video_type) {
+			return false;
+		}
+	}
+	return true;
+}
+
+const DeviceCapabilities* FindEntry(const std::vector<DeviceCapabilities>& entries, const std::string& device_id) {
+	for (const DeviceCapabilities& entry : entries) {
+		if (entry.video_device.device_id == device_id) {
+			return &entry;
+		}
+	}
+	return nullptr;
+}
+
+}
+
+DeviceCapabilityCache::DeviceCapabilityCache(VideoDeviceEnumerator* enumerator, const std::string& path)
+	: enumerator_(enumerator), path_(path) {
+
+}
+
+DeviceCapabilityCache::~DeviceCapabilityCache() {
+	WaitForRefresh();
+}
+
+bool DeviceCapabilityCache::Load() {
+	std::vector<DeviceCapabilities> entries;
+	std::ifstream file(path_.c_str(), std::ios::binary);
+	std::string line;
+	if (path_.empty() || !file || !std::getline(file, line) || line != kCacheHeader) {
+		return false;
+	}
+	while (std::getline(file, line)) {
+		std::vector<std::string> fields = SplitTabs(line);
+		if (fields.size() != 6 || fields[0] != "device") {
+			return false;
+		}
+		DeviceCapabilities entry;
+		if (!Unescape(fields[1], entry.video_device.device_id) || entry.video_device.device_id.empty() ||
+			!Unescape(fields[2], entry.video_device.device_name) || !Unescape(fields[3], entry.fingerprint)) {
+			return false;
+		}
+		entry.video_device.index = static_cast<uint32_t>(entries.size());
+		entry.probe_time = strtoll(fields[4].c_str(), nullptr, 10);
+		unsigned long count = strtoul(fields[5].c_str(), nullptr, 10);
+		for (unsigned long i = 0; i < count; ++i) {
+			unsigned width = 0;
+			unsigned height = 0;
+			unsigned fps = 0;
+			int video_type = 0;
+			if (!std::getline(file, line) ||
+				sscanf(line.c_str(), "%u %u %u %d", &width, &height, &fps, &video_type) != 4 ||
+				video_type <= kVideoTypeUnknown || video_type > kVideoTypeBGRA) {
+				return false;
+			}
+			VideoDescription format;
+			format.width = width;
+			format.height = height;
+			format.fps = fps;
+			format.video_type = static_cast<VideoType>(video_type);
+			entry.formats.push_back(format);
+		}
+		entries.push_back(entry);
+	}
+	std::lock_guard<std::mutex> lock(mutex_);
+	entries_ = entries;
+	return true;
+}
+
+bool DeviceCapabilityCache::Save() {
+	return SaveEntries(GetEntries());
+}
+
+void DeviceCapabilityCache::SetMaxAge(int64_t seconds) {
+	max_age_ = seconds;
+}
+
+std::vector<VideoDevice> DeviceCapabilityCache::GetDevices() {
+	std::vector<VideoDevice> devices;
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		for (const DeviceCapabilities& entry : entries_) {
+			devices.push_back(entry.video_device);
+		}
+	}
+	if (!devices.empty()) {
+		return devices;
+	}
+	// Nothing cached: list the devices now, their formats follow on demand.
+	devices = enumerator_->EnumerateDevices();
+	std::vector<DeviceCapabilities> entries;
+	for (const VideoDevice& video_device : devices) {
+		DeviceCapabilities entry;
+		entry.video_device = video_device;
+		entry.fingerprint = enumerator_->DeviceFingerprint(video_device);
+		entries.push_back(entry);
+	}
+	std::lock_guard<std::mutex> lock(mutex_);
+	if (entries_.empty()) {
+		entries_ = entries;
+	}
+	return devices;
+}
+
+bool DeviceCapabilityCache::GetVideoFormats(const VideoDevice& video_device, std::vector<VideoDescription>& formats) {
+	std::unique_lock<std::mutex> lock(mutex_);
+	// A probe of the device already running, e.g. from a refresh, is waited
+	// for instead of opening the camera a second time.
+	for (;;) {
+		const DeviceCapabilities* entry = FindEntry(entries_, video_device.device_id);
+		if (entry && entry->probe_time) {
+			formats = entry->formats;
+			return true;
+		}
+		if (!IsProbing(video_device.device_id)) {
+			break;
+		}
+		probe_done_.wait(lock);
+	}
+	if (!ProbeLocked(video_device, lock)) {
+		return false;
+	}
+	formats = FindEntry(entries_, video_device.device_id)->formats;
+	lock.unlock();
+	Save();
+	return true;
+}
+
+std::vector<DeviceCapabilities> DeviceCapabilityCache::GetEntries() const {
+	std::lock_guard<std::mutex> lock(mutex_);
+	return entries_;
+}
+
+bool DeviceCapabilityCache::Refresh() {
+	std::vector<VideoDevice> devices = enumerator_->EnumerateDevices();
+	std::vector<DeviceCapabilities> cached = GetEntries();
+	int64_t now = static_cast<int64_t>(time(nullptr));
+	bool probed = false;
+	std::vector<std::string> fingerprints;
+	for (const VideoDevice& video_device : devices) {
+		std::string fingerprint = enumerator_->DeviceFingerprint(video_device);
+		fingerprints.push_back(fingerprint);
+		std::unique_lock<std::mutex> lock(mutex_);
+		// Devices probed by GetVideoFormats() meanwhile are fresh by now.
+		while (IsProbing(video_device.device_id)) {
+			probe_done_.wait(lock);
+		}
+		const DeviceCapabilities* entry = FindEntry(entries_, video_device.device_id);
+		bool fresh = entry && entry->probe_time && entry->fingerprint == fingerprint &&
+			(max_age_ <= 0 || now - entry->probe_time < max_age_);
+		if (!fresh) {
+			// A failed probe keeps the old formats and fingerprint, so the next
+			// refresh tries again; stale formats beat none.
+			probed = ProbeLocked(video_device, lock) || probed;
+		}
+	}
+	// Entries follow the enumeration: indices are updated, new devices get an
+	// entry even when their probe failed and unplugged devices are dropped.
+	std::vector<DeviceCapabilities> entries;
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		for (size_t i = 0; i < devices.size(); ++i) {
+			const DeviceCapabilities* entry = FindEntry(entries_, devices[i].device_id);
+			DeviceCapabilities updated;
+			if (entry) {
+				updated = *entry;
+			}
+			else {
+				updated.fingerprint = fingerprints[i];
+			}
+			updated.video_device = devices[i];
+			entries.push_back(updated);
+		}
+		entries_ = entries;
+	}
+	bool changed = entries.size() != cached.size();
+	for (size_t i = 0; !changed && i < entries.size(); ++i) {
+		changed = !SameEntry(entries[i], cached[i]);
+	}
+	if (changed || probed) {
+		SaveEntries(entries);
+	}
+	return changed;
+}
+
+void DeviceCapabilityCache::RefreshAsync(RefreshCallback callback) {
+	WaitForRefresh();
+	refresh_thread_ = std::thread([this, callback]() {
+		utils::ScopedComApartment com_apartment;
+		bool changed = Refresh();
+		if (callback) {
+			callback(changed);
+		}
+	});
+}
+
+void DeviceCapabilityCache::WaitForRefresh() {
+	if (refresh_thread_.joinable()) {
+		refresh_thread_.join();
+	}
+}
+
+bool DeviceCapabilityCache::IsProbing(const std::string& device_id) const {
+	for (const std::string& probing : probing_) {
+		if (probing == device_id) {
+			return true;
+		}
+	}
+	return false;
+}
+
+bool DeviceCapabilityCache::ProbeLocked(const VideoDevice& video_device, std::unique_lock<std::mutex>& lock) {
+	probing_.push_back(video_device.device_id);
+	lock.unlock();
+	std::vector<VideoDescription> formats;
+	bool ok = enumerator_->QueryVideoFormats(video_device, formats);
+	std::string fingerprint = ok ? enumerator_->DeviceFingerprint(video_device) : std::string();
+	lock.lock();
+	for (size_t i = 0; i < probing_.size(); ++i) {
+		if (probing_[i] == video_device.device_id) {
+			probing_.erase(probing_.begin() + i);
+			break;
+		}
+	}
+	probe_done_.notify_all();
+	if (!ok) {
+		return false;
+	}
+	DeviceCapabilities* entry = nullptr;
+	for (DeviceCapabilities& candidate : entries_) {
+		if (candidate.video_device.device_id == video_device.device_id) {
+			entry = &candidate;
+		}
+	}
+	if (!entry) {
+		entries_.push_back(DeviceCapabilities());
+		entry = &entries_.back();
+		entry->video_device = video_device;
+	}
+	entry->fingerprint = fingerprint;
+	entry->formats = formats;
+	entry->probe_time = static_cast<int64_t>(time(nullptr));
+	return true;
+}
+
+bool DeviceCapabilityCache::SaveEntries(const std::vector<DeviceCapabilities>& entries) {
+	if (path_.empty()) {
+		return true;
+	}
+	std::ostringstream stream;
+	stream << kCacheHeader << '\n';
+	for (const DeviceCapabilities& entry : entries) {
+		stream << "device\t" << Escape(entry.video_device.device_id) << '\t' <<
+			Escape(entry.video_device.device_name) << '\t' << Escape(entry.fingerprint) << '\t' <<
+			entry.probe_time << '\t' << entry.formats.size() << '\n';
+		for (const VideoDescription& format : entry.formats) {
+			stream << format.width << ' ' << format.height << ' ' << format.fps << ' ' <<
+				static_cast<int>(format.video_type) << '\n';
+		}
+	}
+	std::string contents = stream.str();
+	std::lock_guard<std::mutex> lock(save_mutex_);
+	std::string temporary = path_ + ".tmp";
+	FILE* file = fopen(temporary.c_str(), "wb");
+	if (!file) {
+		return false;
+	}
+	bool ok = fwrite(contents.data(), 1, contents.size(), file) == contents.size();
+	ok = fclose(file) == 0 && ok;
+	if (!ok) {
+		remove(temporary.c_str());
+		return false;
+	}
+#ifdef _WIN32
+	// rename() does not replace an existing file on Windows.
+	remove(path_.c_str());
+#endif
+	return rename(temporary.c_str(), path_.c_str()) == 0;
+}
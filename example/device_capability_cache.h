@@ -0,0 +1,85 @@
+#pragma once
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "video_device_enumerator.h"
+#include "video_frame.h"
+
+struct DeviceCapabilities {
+	VideoDevice video_device{};
+	std::string fingerprint{};
+	std::vector<VideoDescription> formats{};
+	// Wall clock seconds when |formats| were read from the device.
+	int64_t probe_time{};
+};
+
+// Device list and formats keyed by device_id, kept in a file so the next
+// start is served without opening a single camera. Cached entries are checked
+// against a fresh enumeration and the device fingerprint, which is cheap;
+// only new, changed or expired devices are probed again. Refresh() does that
+// work and RefreshAsync() moves it off the caller's thread.
+//
+// Device indices in cached entries can be stale until a refresh completed;
+// backends look devices up by device_id.
+class DeviceCapabilityCache {
+public:
+	using RefreshCallback = std::function<void(bool changed)>;
+
+	// |enumerator| must outlive the cache. An empty |path| keeps the cache in
+	// memory only.
+	DeviceCapabilityCache(VideoDeviceEnumerator* enumerator, const std::string& path);
+	~DeviceCapabilityCache();
+
+	// Replaces the entries with the file's. Returns false and leaves the
+	// entries as they were when the file is missing, from another version or
+	// damaged.
+	bool Load();
+	// Written to a temporary file first, so a crash never leaves half a cache.
+	bool Save();
+
+	// Entries probed more than |seconds| ago are probed again on refresh.
+	// 0 keeps them until the device changes.
+	void SetMaxAge(int64_t seconds);
+
+	// Returns the cached devices at once; enumerates only when nothing is
+	// cached yet.
+	std::vector<VideoDevice> GetDevices();
+	// Returns cached formats at once; probes the device only on a miss.
+	bool GetVideoFormats(const VideoDevice& video_device, std::vector<VideoDescription>& formats);
+	std::vector<DeviceCapabilities> GetEntries() const;
+
+	// Brings the cache in line with the devices present now and saves it if
+	// anything changed. Returns whether it did.
+	bool Refresh();
+	// Runs Refresh() on a background thread, then |callback| on that thread.
+	// A refresh still running is waited for first.
+	void RefreshAsync(RefreshCallback callback = nullptr);
+	void WaitForRefresh();
+
+private:
+	DeviceCapabilityCache(const DeviceCapabilityCache&) = delete;
+	DeviceCapabilityCache operator =(const DeviceCapabilityCache&) = delete;
+
+	bool IsProbing(const std::string& device_id) const;
+	// Reads the formats with |lock| released and stores them in |entries_|.
+	// Other callers wanting the same device wait on |probe_done_| meanwhile.
+	bool ProbeLocked(const VideoDevice& video_device, std::unique_lock<std::mutex>& lock);
+	bool SaveEntries(const std::vector<DeviceCapabilities>& entries);
+
+	VideoDeviceEnumerator* enumerator_{};
+	std::string path_{};
+	int64_t max_age_{};
+
+	mutable std::mutex mutex_{};
+	std::vector<DeviceCapabilities> entries_{};
+	// Device ids being probed right now.
+	std::vector<std::string> probing_{};
+	std::condition_variable probe_done_{};
+	std::mutex save_mutex_{};
+	std::thread refresh_thread_{};
+};
@@ -0,0 +1,232 @@
+// DeviceCapabilityCache against FakeVideoDeviceEnumerator: the cache file,
+// when cached entries are probed again, and that a camera is never opened for
+// formats the cache already has or is reading right now.
+#include <chrono>
+#include <cstdio>
+#include <ctime>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "device_capability_cache.h"
+#include "fake_video_device_enumerator.h"
+#include "test_check.h"
+
+namespace {
+
+const char kPath[] = "device_capability_cache_test.txt";
+
+VideoDevice MakeDevice(const std::string& device_id, const std::string& device_name) {
+	VideoDevice video_device;
+	video_device.device_id = device_id;
+	video_device.device_name = device_name;
+	return video_device;
+}
+
+std::vector<VideoDescription> MakeFormats(uint32_t width, uint32_t height, VideoType video_type) {
+	VideoDescription format;
+	format.width = width;
+	format.height = height;
+	format.fps = 30;
+	format.video_type = video_type;
+	return std::vector<VideoDescription>(1, format);
+}
+
+bool HasFormat(const std::vector<VideoDescription>& formats, uint32_t width, VideoType video_type) {
+	return formats.size() == 1 && formats[0].width == width && formats[0].video_type == video_type;
+}
+
+void WriteFile(const std::string& contents) {
+	FILE* file = fopen(kPath, "wb");
+	CHECK(file);
+	if (file) {
+		fwrite(contents.data(), 1, contents.size(), file);
+		fclose(file);
+	}
+}
+
+void TestSaveAndLoad() {
+	remove(kPath);
+	FakeVideoDeviceEnumerator enumerator;
+	enumerator.AddDevice(MakeDevice("usb#1", "Front\tCamera"), MakeFormats(640, 480, kVideoTypeNV12));
+	enumerator.AddDevice(MakeDevice("usb#2", "Back Camera"), MakeFormats(1280, 720, kVideoTypeMJPEG));
+	{
+		DeviceCapabilityCache cache(&enumerator, kPath);
+		CHECK(!cache.Load());
+		CHECK(cache.Refresh());
+		CHECK(enumerator.QueryCount() == 2);
+	}
+	// A new run is served from the file without touching the devices.
+	DeviceCapabilityCache cache(&enumerator, kPath);
+	CHECK(cache.Load());
+	int enumerate_count = enumerator.EnumerateCount();
+	std::vector<VideoDevice> devices = cache.GetDevices();
+	CHECK(devices.size() == 2);
+	if (devices.size() != 2) {
+		return;
+	}
+	CHECK(devices[0].device_id == "usb#1" && devices[0].device_name == "Front\tCamera");
+	std::vector<VideoDescription> formats;
+	CHECK(cache.GetVideoFormats(devices[1], formats) && HasFormat(formats, 1280, kVideoTypeMJPEG));
+	CHECK(enumerator.EnumerateCount() == enumerate_count);
+	CHECK(enumerator.QueryCount() == 2);
+
+	// A damaged file is refused and the loaded entries stay.
+	WriteFile("video-capture-device-cache 1\ndevice\tusb#3\tName\tName\t1\t1\n640 480\n");
+	CHECK(!cache.Load());
+	WriteFile("some other file\n");
+	CHECK(!cache.Load());
+	CHECK(cache.GetEntries().size() == 2);
+	remove(kPath);
+}
+
+void TestCacheHit() {
+	FakeVideoDeviceEnumerator enumerator;
+	enumerator.AddDevice(MakeDevice("usb#1", "Camera"), MakeFormats(640, 480, kVideoTypeNV12));
+	DeviceCapabilityCache cache(&enumerator, "");
+	std::vector<VideoDevice> devices = cache.GetDevices();
+	CHECK(devices.size() == 1 && enumerator.QueryCount() == 0);
+	if (devices.empty()) {
+		return;
+	}
+	std::vector<VideoDescription> formats;
+	CHECK(cache.GetVideoFormats(devices[0], formats) && HasFormat(formats, 640, kVideoTypeNV12));
+	CHECK(cache.GetVideoFormats(devices[0], formats) && HasFormat(formats, 640, kVideoTypeNV12));
+	CHECK(enumerator.QueryCount() == 1);
+	// Already probed and unchanged: a refresh only enumerates.
+	CHECK(!cache.Refresh());
+	CHECK(enumerator.QueryCount() == 1);
+}
+
+void TestFingerprintChange() {
+	FakeVideoDeviceEnumerator enumerator;
+	enumerator.AddDevice(MakeDevice("usb#1", "Camera"), MakeFormats(640, 480, kVideoTypeNV12));
+	DeviceCapabilityCache cache(&enumerator, "");
+	CHECK(cache.Refresh());
+	CHECK(enumerator.QueryCount() == 1);
+	// New driver, new formats, same device_id.
+	enumerator.AddDevice(MakeDevice("usb#1", "Camera"), MakeFormats(1920, 1080, kVideoTypeYUY2));
+	CHECK(!cache.Refresh());
+	CHECK(enumerator.QueryCount() == 1);
+	enumerator.SetFingerprint("usb#1", "Camera driver 2");
+	CHECK(cache.Refresh());
+	CHECK(enumerator.QueryCount() == 2);
+	std::vector<DeviceCapabilities> entries = cache.GetEntries();
+	CHECK(entries.size() == 1 && HasFormat(entries[0].formats, 1920, kVideoTypeYUY2));
+	CHECK(entries.size() == 1 && entries[0].fingerprint == "Camera driver 2");
+}
+
+void TestMaxAge() {
+	// An entry probed an hour ago.
+	char contents[256];
+	snprintf(contents, sizeof(contents), "video-capture-device-cache 1\ndevice\tusb#1\tCamera\tCamera\t%lld\t1\n"
+		"640 480 30 %d\n", static_cast<long long>(time(nullptr)) - 3600, static_cast<int>(kVideoTypeNV12));
+	WriteFile(contents);
+	FakeVideoDeviceEnumerator enumerator;
+	enumerator.AddDevice(MakeDevice("usb#1", "Camera"), MakeFormats(320, 240, kVideoTypeI420));
+	{
+		DeviceCapabilityCache cache(&enumerator, kPath);
+		CHECK(cache.Load());
+		CHECK(!cache.Refresh());
+		CHECK(enumerator.QueryCount() == 0);
+		cache.SetMaxAge(7200);
+		CHECK(!cache.Refresh());
+		CHECK(enumerator.QueryCount() == 0);
+	}
+	DeviceCapabilityCache cache(&enumerator, kPath);
+	CHECK(cache.Load());
+	cache.SetMaxAge(60);
+	CHECK(cache.Refresh());
+	CHECK(enumerator.QueryCount() == 1);
+	std::vector<DeviceCapabilities> entries = cache.GetEntries();
+	CHECK(entries.size() == 1 && HasFormat(entries[0].formats, 320, kVideoTypeI420));
+	CHECK(entries.size() == 1 && time(nullptr) - entries[0].probe_time < 60);
+	remove(kPath);
+}
+
+void TestFailedProbe() {
+	FakeVideoDeviceEnumerator enumerator;
+	enumerator.AddDevice(MakeDevice("usb#1", "Camera"), MakeFormats(640, 480, kVideoTypeNV12));
+	DeviceCapabilityCache cache(&enumerator, "");
+	CHECK(cache.Refresh());
+	enumerator.AddDevice(MakeDevice("usb#1", "Camera"), MakeFormats(1920, 1080, kVideoTypeYUY2));
+	enumerator.SetFingerprint("usb#1", "Camera driver 2");
+	enumerator.SetQueryFails("usb#1", true);
+	// The camera is busy: the old formats and fingerprint stay, so the next
+	// refresh tries again.
+	CHECK(!cache.Refresh());
+	CHECK(enumerator.QueryCount() == 2);
+	std::vector<DeviceCapabilities> entries = cache.GetEntries();
+	CHECK(entries.size() == 1 && HasFormat(entries[0].formats, 640, kVideoTypeNV12));
+	CHECK(entries.size() == 1 && entries[0].fingerprint == "Camera");
+	enumerator.SetQueryFails("usb#1", false);
+	CHECK(cache.Refresh());
+	CHECK(enumerator.QueryCount() == 3);
+	entries = cache.GetEntries();
+	CHECK(entries.size() == 1 && HasFormat(entries[0].formats, 1920, kVideoTypeYUY2));
+
+	// A new device whose probe fails is listed without formats and probed on
+	// demand.
+	enumerator.AddDevice(MakeDevice("usb#2", "Other"), MakeFormats(320, 240, kVideoTypeI420));
+	enumerator.SetQueryFails("usb#2", true);
+	CHECK(cache.Refresh());
+	std::vector<VideoDescription> formats;
+	CHECK(!cache.GetVideoFormats(MakeDevice("usb#2", "Other"), formats));
+	enumerator.SetQueryFails("usb#2", false);
+	CHECK(cache.GetVideoFormats(MakeDevice("usb#2", "Other"), formats) && HasFormat(formats, 320, kVideoTypeI420));
+}
+
+// The startup sequence of main(): a background refresh and a format request
+// for the first camera at once. Each camera is opened once and both results
+// end up in the cache.
+void TestNoDuplicateProbe() {
+	FakeVideoDeviceEnumerator enumerator;
+	enumerator.AddDevice(MakeDevice("usb#1", "Front"), MakeFormats(640, 480, kVideoTypeNV12));
+	enumerator.AddDevice(MakeDevice("usb#2", "Back"), MakeFormats(1280, 720, kVideoTypeMJPEG));
+	enumerator.SetQueryDelayMs(100);
+	DeviceCapabilityCache cache(&enumerator, "");
+	std::vector<VideoDevice> devices = cache.GetDevices();
+	CHECK(devices.size() == 2);
+	if (devices.size() != 2) {
+		return;
+	}
+	cache.RefreshAsync();
+	std::this_thread::sleep_for(std::chrono::milliseconds(20));
+	std::vector<VideoDescription> formats;
+	CHECK(cache.GetVideoFormats(devices[0], formats) && HasFormat(formats, 640, kVideoTypeNV12));
+	CHECK(cache.GetVideoFormats(devices[1], formats) && HasFormat(formats, 1280, kVideoTypeMJPEG));
+	cache.WaitForRefresh();
+	CHECK(enumerator.QueryCount() == 2);
+	std::vector<DeviceCapabilities> entries = cache.GetEntries();
+	CHECK(entries.size() == 2);
+	for (const DeviceCapabilities& entry : entries) {
+		CHECK(entry.probe_time != 0 && entry.formats.size() == 1);
+	}
+
+	// The other way round: a format request already probing when the refresh
+	// gets to the device.
+	enumerator.SetFingerprint("usb#1", "Front 2");
+	DeviceCapabilityCache second(&enumerator, "");
+	devices = second.GetDevices();
+	std::thread request([&second, &devices]() {
+		std::vector<VideoDescription> formats;
+		CHECK(second.GetVideoFormats(devices[0], formats));
+	});
+	std::this_thread::sleep_for(std::chrono::milliseconds(20));
+	second.Refresh();
+	request.join();
+	CHECK(enumerator.QueryCount() == 4);
+}
+
+}
+
+int main() {
+	TestSaveAndLoad();
+	TestCacheHit();
+	TestFingerprintChange();
+	TestMaxAge();
+	TestFailedProbe();
+	TestNoDuplicateProbe();
+	remove(kPath);
+	return test::Result();
+}
@@ -0,0 +1,160 @@
+#include "device_registry.h"
+
+#include <algorithm>
+
+#include "thread_utils.h"
+
+DeviceRegistry::DeviceRegistry(VideoDeviceEnumerator* enumerator) : enumerator_(enumerator) {
+
+}
+
+DeviceRegistry::~DeviceRegistry() {
+	StopMonitoring();
+}
+
+std::vector<DeviceEvent> DeviceRegistry::Update() {
+	std::lock_guard<std::mutex> update_lock(update_mutex_);
+	std::vector<VideoDevice> devices = enumerator_->EnumerateDevices();
+	std::vector<std::string> fingerprints;
+	for (const VideoDevice& video_device : devices) {
+		fingerprints.push_back(enumerator_->DeviceFingerprint(video_device));
+	}
+
+	std::vector<DeviceEvent> events;
+	std::vector<std::pair<int, EventCallback>> subscribers;
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		std::vector<DeviceHandle> present;
+		for (size_t i = 0; i < devices.size(); ++i) {
+			const VideoDevice& video_device = devices[i];
+			DeviceEntry& entry = entries_[video_device.device_id];
+			if (!entry.handle) {
+				entry.handle = next_handle_++;
+			}
+			if (std::find(present.begin(), present.end(), entry.handle) != present.end()) {
+				// Listed twice in one enumeration; the first listing counts.
+				continue;
+			}
+			present.push_back(entry.handle);
+			DeviceEvent event;
+			event.handle = entry.handle;
+			event.video_device = video_device;
+			if (!entry.present) {
+				event.type = kDeviceArrived;
+				events.push_back(event);
+			}
+			else if (entry.video_device.device_name != video_device.device_name ||
+				entry.fingerprint != fingerprints[i]) {
+				event.type = kDeviceChanged;
+				events.push_back(event);
+			}
+			// An index that merely shifted is no event.
+			entry.video_device = video_device;
+			entry.fingerprint = fingerprints[i];
+			entry.present = true;
+		}
+		for (std::map<std::string, DeviceEntry>::value_type& item : entries_) {
+			DeviceEntry& entry = item.second;
+			if (entry.present && std::find(present.begin(), present.end(), entry.handle) == present.end()) {
+				entry.present = false;
+				DeviceEvent event;
+				event.type = kDeviceRemoved;
+				event.handle = entry.handle;
+				event.video_device = entry.video_device;
+				events.push_back(event);
+			}
+		}
+		present_.swap(present);
+		subscribers = subscribers_;
+	}
+	if (!events.empty()) {
+		for (const std::pair<int, EventCallback>& subscriber : subscribers) {
+			subscriber.second(events);
+		}
+	}
+	return events;
+}
+
+void DeviceRegistry::StartMonitoring(std::chrono::milliseconds interval) {
+	StopMonitoring();
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		monitor_stopped_ = false;
+		update_requested_ = false;
+	}
+	monitor_thread_ = std::thread(&DeviceRegistry::Monitor, this, interval);
+}
+
+void DeviceRegistry::StopMonitoring() {
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		monitor_stopped_ = true;
+	}
+	monitor_wake_.notify_all();
+	if (monitor_thread_.joinable()) {
+		monitor_thread_.join();
+	}
+}
+
+void DeviceRegistry::RequestUpdate() {
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		update_requested_ = true;
+	}
+	monitor_wake_.notify_all();
+}
+
+int DeviceRegistry::Subscribe(EventCallback callback) {
+	std::lock_guard<std::mutex> lock(mutex_);
+	int id = next_subscriber_++;
+	subscribers_.push_back(std::make_pair(id, std::move(callback)));
+	return id;
+}
+
+void DeviceRegistry::Unsubscribe(int id) {
+	std::lock_guard<std::mutex> lock(mutex_);
+	subscribers_.erase(std::remove_if(subscribers_.begin(), subscribers_.end(),
+		[id](const std::pair<int, EventCallback>& subscriber) { return subscriber.first == id; }),
+		subscribers_.end());
+}
+
+std::vector<DeviceHandle> DeviceRegistry::GetDevices() const {
+	std::lock_guard<std::mutex> lock(mutex_);
+	return present_;
+}
+
+bool DeviceRegistry::GetDevice(DeviceHandle handle, VideoDevice& video_device) const {
+	std::lock_guard<std::mutex> lock(mutex_);
+	for (const std::map<std::string, DeviceEntry>::value_type& item : entries_) {
+		if (item.second.handle == handle) {
+			video_device = item.second.video_device;
+			return true;
+		}
+	}
+	return false;
+}
+
+bool DeviceRegistry::IsPresent(DeviceHandle handle) const {
+	std::lock_guard<std::mutex> lock(mutex_);
+	return std::find(present_.begin(), present_.end(), handle) != present_.end();
+}
+
+DeviceHandle DeviceRegistry::FindDevice(const std::string& device_id) const {
+	std::lock_guard<std::mutex> lock(mutex_);
+	std::map<std::string, DeviceEntry>::const_iterator it = entries_.find(device_id);
+	return it != entries_.end() ? it->second.handle : 0;
+}
+
+void DeviceRegistry::Monitor(std::chrono::milliseconds interval) {
+	// Media Foundation enumerators hand out COM objects made on this thread.
+	utils::ScopedComApartment com_apartment;
+	for (;;) {
+		Update();
+		std::unique_lock<std::mutex> lock(mutex_);
+		monitor_wake_.wait_for(lock, interval, [this]() { return monitor_stopped_ || update_requested_; });
+		if (monitor_stopped_) {
+			return;
+		}
+		update_requested_ = false;
+	}
+}
@@ -0,0 +1,104 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "video_device_enumerator.h"
+#include "video_frame.h"
+
+// Stays with a device_id for the life of the registry, across unplugging and
+// plugging back in. 0 is never a device.
+using DeviceHandle = uint64_t;
+
+enum DeviceEventType {
+	kDeviceArrived,
+	kDeviceRemoved,
+	// Same device_id, but another name or fingerprint, e.g. a driver swap;
+	// its formats may have changed.
+	kDeviceChanged,
+};
+
+struct DeviceEvent {
+	DeviceEventType type{};
+	DeviceHandle handle{};
+	// As last enumerated; for removals, as it was before it went.
+	VideoDevice video_device{};
+};
+
+// Tracks the devices an enumerator reports and turns every enumeration into
+// arrival, removal and change events against the one before, so consumers
+// react to what changed instead of rebuilding their device list. Devices are
+// known by device_id, never by index, which shifts as others come and go;
+// devices that stay are not touched, so running captures carry on.
+//
+// Update() enumerates once; StartMonitoring() does it periodically, and at
+// once after RequestUpdate(), on a thread of its own. Thread safe.
+class DeviceRegistry {
+public:
+	using EventCallback = std::function<void(const std::vector<DeviceEvent>& events)>;
+
+	// |enumerator| must outlive the registry.
+	explicit DeviceRegistry(VideoDeviceEnumerator* enumerator);
+	~DeviceRegistry();
+
+	// Enumerates and returns what changed since the last update, after
+	// handing it to the subscribers. The first update reports every device
+	// as arrived.
+	std::vector<DeviceEvent> Update();
+
+	void StartMonitoring(std::chrono::milliseconds interval);
+	void StopMonitoring();
+	// Wakes the monitor for an update now, e.g. on WM_DEVICECHANGE or a udev
+	// event.
+	void RequestUpdate();
+
+	// Callbacks run on the updating thread, one update at a time and in
+	// order; they may call back into the registry but not Update().
+	int Subscribe(EventCallback callback);
+	void Unsubscribe(int id);
+
+	// Handles of the devices present, in enumeration order.
+	std::vector<DeviceHandle> GetDevices() const;
+	// Last known state of the device, also after it was removed. False for
+	// handles the registry never gave out.
+	bool GetDevice(DeviceHandle handle, VideoDevice& video_device) const;
+	bool IsPresent(DeviceHandle handle) const;
+	// 0 when |device_id| was never seen.
+	DeviceHandle FindDevice(const std::string& device_id) const;
+
+private:
+	struct DeviceEntry {
+		DeviceHandle handle{};
+		VideoDevice video_device{};
+		std::string fingerprint{};
+		bool present{};
+	};
+
+	DeviceRegistry(const DeviceRegistry&) = delete;
+	DeviceRegistry operator =(const DeviceRegistry&) = delete;
+
+	void Monitor(std::chrono::milliseconds interval);
+
+	VideoDeviceEnumerator* enumerator_{};
+	// Serializes updates, so events reach subscribers in order.
+	std::mutex update_mutex_{};
+
+	mutable std::mutex mutex_{};
+	// Keyed by device_id; entries stay after removal to keep their handle.
+	std::map<std::string, DeviceEntry> entries_{};
+	std::vector<DeviceHandle> present_{};
+	DeviceHandle next_handle_{ 1 };
+	std::vector<std::pair<int, EventCallback>> subscribers_{};
+	int next_subscriber_{ 1 };
+
+	std::thread monitor_thread_{};
+	std::condition_variable monitor_wake_{};
+	bool monitor_stopped_{};
+	bool update_requested_{};
+};
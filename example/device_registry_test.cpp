@@ -0,0 +1,174 @@
+// DeviceRegistry against FakeVideoDeviceEnumerator: the events each update
+// reports, handles that stay with a device_id, and the monitor thread.
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "device_registry.h"
+#include "fake_video_device_enumerator.h"
+#include "test_check.h"
+
+namespace {
+
+VideoDevice MakeDevice(const std::string& device_id, const std::string& device_name) {
+	VideoDevice video_device;
+	video_device.device_id = device_id;
+	video_device.device_name = device_name;
+	return video_device;
+}
+
+std::vector<VideoDescription> NoFormats() {
+	return std::vector<VideoDescription>();
+}
+
+bool IsEvent(const DeviceEvent& event, DeviceEventType type, DeviceHandle handle, const std::string& device_id) {
+	return event.type == type && event.handle == handle && event.video_device.device_id == device_id;
+}
+
+void TestArrivalAndRemoval() {
+	FakeVideoDeviceEnumerator enumerator;
+	enumerator.AddDevice(MakeDevice("usb#1", "Front"), NoFormats());
+	enumerator.AddDevice(MakeDevice("usb#2", "Back"), NoFormats());
+	DeviceRegistry registry(&enumerator);
+	std::vector<std::vector<DeviceEvent>> delivered;
+	int id = registry.Subscribe([&delivered](const std::vector<DeviceEvent>& events) {
+		delivered.push_back(events);
+	});
+
+	std::vector<DeviceEvent> events = registry.Update();
+	CHECK(events.size() == 2);
+	if (events.size() != 2) {
+		return;
+	}
+	DeviceHandle front = registry.FindDevice("usb#1");
+	DeviceHandle back = registry.FindDevice("usb#2");
+	CHECK(front != 0 && back != 0 && front != back);
+	CHECK(IsEvent(events[0], kDeviceArrived, front, "usb#1"));
+	CHECK(IsEvent(events[1], kDeviceArrived, back, "usb#2"));
+	CHECK(delivered.size() == 1 && delivered[0].size() == 2);
+	CHECK(registry.GetDevices() == std::vector<DeviceHandle>({ front, back }));
+	CHECK(registry.FindDevice("usb#3") == 0);
+
+	// Nothing changed: no events and no callback.
+	CHECK(registry.Update().empty());
+	CHECK(delivered.size() == 1);
+
+	enumerator.RemoveDevice("usb#1");
+	events = registry.Update();
+	CHECK(events.size() == 1 && IsEvent(events[0], kDeviceRemoved, front, "usb#1"));
+	CHECK(events.size() == 1 && events[0].video_device.device_name == "Front");
+	CHECK(delivered.size() == 2);
+	CHECK(!registry.IsPresent(front) && registry.IsPresent(back));
+	CHECK(registry.GetDevices() == std::vector<DeviceHandle>(1, back));
+	// The last known state stays available.
+	VideoDevice video_device;
+	CHECK(registry.GetDevice(front, video_device) && video_device.device_name == "Front");
+	CHECK(!registry.GetDevice(12345, video_device));
+
+	registry.Unsubscribe(id);
+	enumerator.RemoveDevice("usb#2");
+	CHECK(registry.Update().size() == 1);
+	CHECK(delivered.size() == 2);
+}
+
+void TestChange() {
+	FakeVideoDeviceEnumerator enumerator;
+	enumerator.AddDevice(MakeDevice("usb#1", "Camera"), NoFormats());
+	DeviceRegistry registry(&enumerator);
+	registry.Update();
+	DeviceHandle handle = registry.FindDevice("usb#1");
+
+	enumerator.SetFingerprint("usb#1", "Camera driver 2");
+	std::vector<DeviceEvent> events = registry.Update();
+	CHECK(events.size() == 1 && IsEvent(events[0], kDeviceChanged, handle, "usb#1"));
+	CHECK(registry.Update().empty());
+
+	// A new name is a change too.
+	enumerator.AddDevice(MakeDevice("usb#1", "Camera HD"), NoFormats());
+	events = registry.Update();
+	CHECK(events.size() == 1 && IsEvent(events[0], kDeviceChanged, handle, "usb#1"));
+	CHECK(events.size() == 1 && events[0].video_device.device_name == "Camera HD");
+	CHECK(registry.FindDevice("usb#1") == handle);
+}
+
+void TestReplug() {
+	FakeVideoDeviceEnumerator enumerator;
+	enumerator.AddDevice(MakeDevice("usb#1", "Front"), NoFormats());
+	enumerator.AddDevice(MakeDevice("usb#2", "Back"), NoFormats());
+	DeviceRegistry registry(&enumerator);
+	registry.Update();
+	DeviceHandle front = registry.FindDevice("usb#1");
+
+	enumerator.RemoveDevice("usb#1");
+	registry.Update();
+	CHECK(!registry.IsPresent(front));
+	// Back in, now listed after usb#2 and so at another index.
+	enumerator.AddDevice(MakeDevice("usb#1", "Front"), NoFormats());
+	std::vector<DeviceEvent> events = registry.Update();
+	CHECK(events.size() == 1 && IsEvent(events[0], kDeviceArrived, front, "usb#1"));
+	CHECK(events.size() == 1 && events[0].video_device.index == 1);
+	CHECK(registry.IsPresent(front) && registry.FindDevice("usb#1") == front);
+}
+
+void TestIndexShift() {
+	FakeVideoDeviceEnumerator enumerator;
+	enumerator.AddDevice(MakeDevice("usb#1", "First"), NoFormats());
+	enumerator.AddDevice(MakeDevice("usb#2", "Second"), NoFormats());
+	enumerator.AddDevice(MakeDevice("usb#3", "Third"), NoFormats());
+	DeviceRegistry registry(&enumerator);
+	registry.Update();
+	DeviceHandle second = registry.FindDevice("usb#2");
+	DeviceHandle third = registry.FindDevice("usb#3");
+
+	// usb#2 and usb#3 move up an index; only the removal is an event.
+	enumerator.RemoveDevice("usb#1");
+	std::vector<DeviceEvent> events = registry.Update();
+	CHECK(events.size() == 1 && events[0].type == kDeviceRemoved);
+	CHECK(registry.GetDevices() == std::vector<DeviceHandle>({ second, third }));
+	VideoDevice video_device;
+	CHECK(registry.GetDevice(second, video_device) && video_device.index == 0);
+	CHECK(registry.GetDevice(third, video_device) && video_device.index == 1);
+}
+
+void TestMonitor() {
+	FakeVideoDeviceEnumerator enumerator;
+	enumerator.AddDevice(MakeDevice("usb#1", "Front"), NoFormats());
+	DeviceRegistry registry(&enumerator);
+	std::atomic<int> arrived{ 0 };
+	registry.Subscribe([&arrived](const std::vector<DeviceEvent>& events) {
+		for (const DeviceEvent& event : events) {
+			if (event.type == kDeviceArrived) {
+				++arrived;
+			}
+		}
+	});
+	// Far longer than the test: after the first update only RequestUpdate()
+	// can bring the second arrival.
+	registry.StartMonitoring(std::chrono::seconds(60));
+	std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+	while (arrived < 1 && std::chrono::steady_clock::now() < deadline) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	CHECK(arrived == 1);
+	enumerator.AddDevice(MakeDevice("usb#2", "Back"), NoFormats());
+	registry.RequestUpdate();
+	while (arrived < 2 && std::chrono::steady_clock::now() < deadline) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	registry.StopMonitoring();
+	CHECK(arrived == 2);
+	CHECK(registry.IsPresent(registry.FindDevice("usb#2")));
+}
+
+}
+
+int main() {
+	TestArrivalAndRemoval();
+	TestChange();
+	TestReplug();
+	TestIndexShift();
+	TestMonitor();
+	return test::Result();
+}
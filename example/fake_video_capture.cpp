@@ -0,0 +1,91 @@
+#include "fake_video_capture.h"
+
+#include <thread>
+
+FakeVideoCapture::FakeVideoCapture() {
+
+}
+
+FakeVideoCapture::~FakeVideoCapture() {
+	FinishOperations();
+	StopCapture();
+}
+
+bool FakeVideoCapture::StartCapture(const VideoDevice& video_device, const VideoDescription& video_description) {
+	++start_count_;
+	if (start_hangs_) {
+		std::shared_ptr<CaptureOperation> operation = CurrentOperation();
+		if (operation) {
+			operation->SleepFor(std::chrono::milliseconds::max());
+		}
+		return false;
+	}
+	if (start_uninterruptible_) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(start_delay_ms_.load()));
+	}
+	else if (!Delay(start_delay_ms_)) {
+		return false;
+	}
+	if (start_fails_) {
+		return false;
+	}
+	if (!TestPatternCapture::StartCapture(video_device, video_description)) {
+		return false;
+	}
+	capturing_ = true;
+	return true;
+}
+
+bool FakeVideoCapture::StopCapture() {
+	if (!capturing_) {
+		return true;
+	}
+	++stop_count_;
+	Delay(stop_delay_ms_);
+	capturing_ = false;
+	return TestPatternCapture::StopCapture();
+}
+
+void FakeVideoCapture::SetStartDelayMs(int delay_ms) {
+	start_delay_ms_ = delay_ms;
+}
+
+void FakeVideoCapture::SetStartFails(bool fails) {
+	start_fails_ = fails;
+}
+
+void FakeVideoCapture::SetStartHangs(bool hangs) {
+	start_hangs_ = hangs;
+}
+
+void FakeVideoCapture::SetStartUninterruptible(bool uninterruptible) {
+	start_uninterruptible_ = uninterruptible;
+}
+
+void FakeVideoCapture::SetStopDelayMs(int delay_ms) {
+	stop_delay_ms_ = delay_ms;
+}
+
+int FakeVideoCapture::StartCount() const {
+	return start_count_;
+}
+
+int FakeVideoCapture::StopCount() const {
+	return stop_count_;
+}
+
+bool FakeVideoCapture::IsCapturing() const {
+	return capturing_;
+}
+
+bool FakeVideoCapture::Delay(int delay_ms) {
+	if (delay_ms <= 0) {
+		return true;
+	}
+	std::shared_ptr<CaptureOperation> operation = CurrentOperation();
+	if (operation) {
+		return operation->SleepFor(std::chrono::milliseconds(delay_ms));
+	}
+	std::this_thread::sleep_for(std::chrono::milliseconds(delay_ms));
+	return true;
+}
@@ -0,0 +1,45 @@
+#pragma once
+#include <atomic>
+
+#include "test_pattern_capture.h"
+
+// Scripted TestPatternCapture for exercising start and stop handling without
+// a camera: starts and stops can be made slow, failing or wedged. Waits give
+// up early when the asynchronous operation running them is abandoned, like a
+// well-behaved backend. Set the script while no operation is pending.
+class FakeVideoCapture : public TestPatternCapture {
+public:
+	FakeVideoCapture();
+	~FakeVideoCapture();
+
+	bool StartCapture(const VideoDevice& video_device, const VideoDescription& video_description) override;
+	bool StopCapture() override;
+
+	// Added to every StartCapture(), like opening a real camera.
+	void SetStartDelayMs(int delay_ms);
+	void SetStartFails(bool fails);
+	// StartCapture() blocks until its operation is abandoned, like a device
+	// that never answers; blocking calls then fail at once instead.
+	void SetStartHangs(bool hangs);
+	// The start delay runs in full even once the operation is abandoned, like
+	// an open call that cannot be interrupted, so the start succeeds late.
+	void SetStartUninterruptible(bool uninterruptible);
+	void SetStopDelayMs(int delay_ms);
+
+	int StartCount() const;
+	int StopCount() const;
+	bool IsCapturing() const;
+
+private:
+	// Sleeps |delay_ms|; false when the current operation gave up first.
+	bool Delay(int delay_ms);
+
+	std::atomic<int> start_delay_ms_{ 0 };
+	std::atomic<bool> start_fails_{};
+	std::atomic<bool> start_hangs_{};
+	std::atomic<bool> start_uninterruptible_{};
+	std::atomic<int> stop_delay_ms_{ 0 };
+	std::atomic<int> start_count_{ 0 };
+	std::atomic<int> stop_count_{ 0 };
+	std::atomic<bool> capturing_{};
+};
@@ -0,0 +1,111 @@
+#include "fake_video_device_enumerator.h"
+
+#include <chrono>
+#include <thread>
+
+FakeVideoDeviceEnumerator::FakeVideoDeviceEnumerator() {
+
+}
+
+FakeVideoDeviceEnumerator::~FakeVideoDeviceEnumerator() {
+
+}
+
+void FakeVideoDeviceEnumerator::AddDevice(const VideoDevice& video_device,
+	const std::vector<VideoDescription>& formats) {
+	std::lock_guard<std::mutex> lock(mutex_);
+	FakeDevice* device = Find(video_device.device_id);
+	if (!device) {
+		devices_.push_back(FakeDevice());
+		device = &devices_.back();
+	}
+	device->video_device = video_device;
+	device->formats = formats;
+	device->fingerprint = video_device.device_name;
+}
+
+void FakeVideoDeviceEnumerator::RemoveDevice(const std::string& device_id) {
+	std::lock_guard<std::mutex> lock(mutex_);
+	for (size_t i = 0; i < devices_.size(); ++i) {
+		if (devices_[i].video_device.device_id == device_id) {
+			devices_.erase(devices_.begin() + i);
+			return;
+		}
+	}
+}
+
+void FakeVideoDeviceEnumerator::SetFingerprint(const std::string& device_id, const std::string& fingerprint) {
+	std::lock_guard<std::mutex> lock(mutex_);
+	FakeDevice* device = Find(device_id);
+	if (device) {
+		device->fingerprint = fingerprint;
+	}
+}
+
+void FakeVideoDeviceEnumerator::SetQueryFails(const std::string& device_id, bool fails) {
+	std::lock_guard<std::mutex> lock(mutex_);
+	FakeDevice* device = Find(device_id);
+	if (device) {
+		device->query_fails = fails;
+	}
+}
+
+void FakeVideoDeviceEnumerator::SetQueryDelayMs(int delay_ms) {
+	std::lock_guard<std::mutex> lock(mutex_);
+	query_delay_ms_ = delay_ms;
+}
+
+std::vector<VideoDevice> FakeVideoDeviceEnumerator::EnumerateDevices() {
+	++enumerate_count_;
+	std::lock_guard<std::mutex> lock(mutex_);
+	std::vector<VideoDevice> result;
+	for (size_t i = 0; i < devices_.size(); ++i) {
+		VideoDevice video_device = devices_[i].video_device;
+		video_device.index = static_cast<uint32_t>(i);
+		result.push_back(video_device);
+	}
+	return result;
+}
+
+bool FakeVideoDeviceEnumerator::QueryVideoFormats(const VideoDevice& video_device,
+	std::vector<VideoDescription>& formats) {
+	++query_count_;
+	int delay_ms = 0;
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		delay_ms = query_delay_ms_;
+	}
+	if (delay_ms > 0) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(delay_ms));
+	}
+	std::lock_guard<std::mutex> lock(mutex_);
+	FakeDevice* device = Find(video_device.device_id);
+	if (!device || device->query_fails) {
+		return false;
+	}
+	formats = device->formats;
+	return true;
+}
+
+std::string FakeVideoDeviceEnumerator::DeviceFingerprint(const VideoDevice& video_device) {
+	std::lock_guard<std::mutex> lock(mutex_);
+	FakeDevice* device = Find(video_device.device_id);
+	return device ? device->fingerprint : std::string();
+}
+
+int FakeVideoDeviceEnumerator::EnumerateCount() const {
+	return enumerate_count_;
+}
+
+int FakeVideoDeviceEnumerator::QueryCount() const {
+	return query_count_;
+}
+
+FakeVideoDeviceEnumerator::FakeDevice* FakeVideoDeviceEnumerator::Find(const std::string& device_id) {
+	for (FakeDevice& device : devices_) {
+		if (device.video_device.device_id == device_id) {
+			return &device;
+		}
+	}
+	return nullptr;
+}
@@ -0,0 +1,51 @@
+#pragma once
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "video_device_enumerator.h"
+
+// Scripted VideoDeviceEnumerator. Devices are listed in the order they were
+// added and numbered from 0. Thread safe, so the device list can change while
+// another thread enumerates.
+class FakeVideoDeviceEnumerator : public VideoDeviceEnumerator {
+public:
+	FakeVideoDeviceEnumerator();
+	~FakeVideoDeviceEnumerator();
+
+	// Adds the device or replaces the one with the same device_id.
+	void AddDevice(const VideoDevice& video_device, const std::vector<VideoDescription>& formats);
+	void RemoveDevice(const std::string& device_id);
+	void SetFingerprint(const std::string& device_id, const std::string& fingerprint);
+	// QueryVideoFormats() fails for the device until cleared.
+	void SetQueryFails(const std::string& device_id, bool fails);
+	// Added to every QueryVideoFormats() call, like opening a real camera.
+	void SetQueryDelayMs(int delay_ms);
+
+	std::vector<VideoDevice> EnumerateDevices() override;
+	bool QueryVideoFormats(const VideoDevice& video_device, std::vector<VideoDescription>& formats) override;
+	std::string DeviceFingerprint(const VideoDevice& video_device) override;
+
+	int EnumerateCount() const;
+	int QueryCount() const;
+
+private:
+	struct FakeDevice {
+		VideoDevice video_device{};
+		std::vector<VideoDescription> formats{};
+		std::string fingerprint{};
+		bool query_fails{};
+	};
+
+	FakeVideoDeviceEnumerator(const FakeVideoDeviceEnumerator&) = delete;
+	FakeVideoDeviceEnumerator operator =(const FakeVideoDeviceEnumerator&) = delete;
+
+	FakeDevice* Find(const std::string& device_id);
+
+	mutable std::mutex mutex_{};
+	std::vector<FakeDevice> devices_{};
+	int query_delay_ms_{};
+	std::atomic<int> enumerate_count_{ 0 };
+	std::atomic<int> query_count_{ 0 };
+};
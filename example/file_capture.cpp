@@ -0,0 +1,201 @@
+#include "file_capture.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include "time_utils.h"
+
+namespace {
+
+const char kY4mMagic[] = "YUV4MPEG2 ";
+const char kY4mFrameMagic[] = "FRAME";
+
+// Finds the end of the header line starting at |offset|.
+bool FindLineEnd(const uint8_t* data, size_t size, size_t offset, size_t& line_end) {
+	const void* end = memchr(data + offset, '\n', size - offset);
+	if (!end) {
+		return false;
+	}
+	line_end = static_cast<const uint8_t*>(end) - data;
+	return true;
+}
+
+}
+
+FileCapture::FileCapture() {
+
+}
+
+FileCapture::~FileCapture() {
+	FinishOperations();
+	StopCapture();
+}
+
+bool FileCapture::StartCapture(const VideoDevice& video_device, const VideoDescription& video_description) {
+	StopCapture();
+	file_ = MappedFile::Open(video_device.device_id);
+	if (!file_) {
+		return false;
+	}
+	frame_offsets_.clear();
+	double fps = 0.0;
+	video_description_ = video_description;
+	bool y4m = file_->Size() >= sizeof(kY4mMagic) - 1 &&
+		memcmp(file_->Data(), kY4mMagic, sizeof(kY4mMagic) - 1) == 0;
+	if (y4m ? !ParseY4mHeader(fps) : !IndexRawFrames()) {
+		file_.Reset();
+		return false;
+	}
+	if (frame_offsets_.empty()) {
+		file_.Reset();
+		return false;
+	}
+	if (video_description.fps != 0 || !y4m) {
+		fps = video_description.fps;
+		video_description_.fps = video_description.fps;
+	}
+	file_->Prefetch(frame_offsets_[0], layout_.size);
+	frames_delivered_ = 0;
+	finished_ = false;
+	clock_.Start(pacing_ == kFilePacingRealTime ? fps : 0.0);
+	thread_ = std::thread(&FileCapture::Run, this);
+	return true;
+}
+
+bool FileCapture::StopCapture() {
+	clock_.Stop();
+	if (thread_.joinable()) {
+		thread_.join();
+	}
+	return true;
+}
+
+void FileCapture::SetPacing(FilePacing pacing) {
+	pacing_ = pacing;
+}
+
+void FileCapture::SetLoop(bool loop) {
+	loop_ = loop;
+}
+
+const VideoDescription& FileCapture::Description() const {
+	return video_description_;
+}
+
+size_t FileCapture::FrameCount() const {
+	return frame_offsets_.size();
+}
+
+uint64_t FileCapture::FramesDelivered() const {
+	return frames_delivered_;
+}
+
+bool FileCapture::Finished() const {
+	return finished_;
+}
+
+bool FileCapture::ParseY4mHeader(double& fps) {
+	const uint8_t* data = file_->Data();
+	size_t size = file_->Size();
+	size_t header_end = 0;
+	if (!FindLineEnd(data, size, 0, header_end)) {
+		return false;
+	}
+	std::string header(reinterpret_cast<const char*>(data), header_end);
+	VideoDescription description;
+	description.video_type = kVideoTypeI420;
+	size_t position = sizeof(kY4mMagic) - 1;
+	while (position < header.size()) {
+		size_t end = header.find(' ', position);
+		if (end == std::string::npos) {
+			end = header.size();
+		}
+		std::string token = header.substr(position, end - position);
+		position = end + 1;
+		if (token.empty()) {
+			continue;
+		}
+		const char* value = token.c_str() + 1;
+		switch (token[0]) {
+		case 'W':
+			description.width = static_cast<uint32_t>(strtoul(value, nullptr, 10));
+			break;
+		case 'H':
+			description.height = static_cast<uint32_t>(strtoul(value, nullptr, 10));
+			break;
+		case 'F': {
+			char* colon = nullptr;
+			double numerator = strtod(value, &colon);
+			double denominator = (colon && *colon == ':') ? strtod(colon + 1, nullptr) : 1.0;
+			fps = denominator > 0.0 ? numerator / denominator : 0.0;
+			break;
+		}
+		case 'C':
+			// Every 4:2:0 siting variant maps to I420; other subsamplings do not.
+			if (strcmp(value, "420") != 0 && strcmp(value, "420jpeg") != 0 && strcmp(value, "420paldv") != 0 &&
+				strcmp(value, "420mpeg2") != 0) {
+				return false;
+			}
+			break;
+		default:
+			// Interlacing, aspect ratio and X extensions do not change the layout.
+			break;
+		}
+	}
+	if (!GetVideoFrameLayout(description, 1, layout_)) {
+		return false;
+	}
+	description.fps = static_cast<uint32_t>(fps + 0.5);
+	video_description_ = description;
+	// Every frame starts with a FRAME line that may carry its own parameters.
+	size_t offset = header_end + 1;
+	while (offset + sizeof(kY4mFrameMagic) - 1 <= size &&
+		memcmp(data + offset, kY4mFrameMagic, sizeof(kY4mFrameMagic) - 1) == 0) {
+		size_t line_end = 0;
+		if (!FindLineEnd(data, size, offset, line_end) || size - (line_end + 1) < layout_.size) {
+			break;
+		}
+		frame_offsets_.push_back(line_end + 1);
+		offset = line_end + 1 + layout_.size;
+	}
+	return true;
+}
+
+bool FileCapture::IndexRawFrames() {
+	if (video_description_.video_type == kVideoTypeMJPEG ||
+		!GetVideoFrameLayout(video_description_, 1, layout_)) {
+		return false;
+	}
+	size_t count = file_->Size() / layout_.size;
+	frame_offsets_.reserve(count);
+	for (size_t i = 0; i < count; ++i) {
+		frame_offsets_.push_back(i * layout_.size);
+	}
+	return true;
+}
+
+void FileCapture::Run() {
+	size_t index = 0;
+	while (clock_.Wait()) {
+		// Start paging in the next frame while this one is consumed.
+		size_t next = index + 1 < frame_offsets_.size() ? index + 1 : 0;
+		file_->Prefetch(frame_offsets_[next], layout_.size);
+
+		int64_t timestamp_us = utils::TimeMicros();
+		if (AcceptFrame(timestamp_us)) {
+			VideoFrameView view;
+			GetContiguousFrameView(video_description_, file_->Data() + frame_offsets_[index], layout_.size, 0, view);
+			view.owner = file_;
+			++frames_delivered_;
+			DeliverFrameView(view, timestamp_us, timestamp_us);
+		}
+		if (++index == frame_offsets_.size()) {
+			if (!loop_) {
+				finished_ = true;
+				return;
+			}
+			index = 0;
+		}
+	}
+}
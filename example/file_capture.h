@@ -0,0 +1,63 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include "frame_clock.h"
+#include "mapped_file.h"
+#include "video_capture.h"
+
+enum FilePacing {
+	// Frames are delivered at the stream rate, like a camera would.
+	kFilePacingRealTime,
+	// Frames are delivered as fast as the callback takes them.
+	kFilePacingFreeRunning,
+};
+
+// Replays a recording from a memory mapping of the file named by
+// VideoDevice::device_id. Delivered frames point straight into the mapping,
+// without a copy unless SetZeroCopy(false), and keep it alive; their planes
+// are read-only.
+//
+// Y4M files (4:2:0 only) carry their own size and rate. Anything else is read
+// as headerless frames back to back, sized by the description passed to
+// StartCapture(). A non-zero description fps overrides the Y4M rate. The file
+// fixes the format, so Reconfigure() is refused.
+class FileCapture : public VideoCapture {
+public:
+	FileCapture();
+	~FileCapture();
+
+	bool StartCapture(const VideoDevice& video_device, const VideoDescription& video_description) override;
+	bool StopCapture() override;
+
+	// Both apply from the next StartCapture().
+	void SetPacing(FilePacing pacing);
+	void SetLoop(bool loop);
+
+	// Format of the open file, valid after StartCapture() succeeded.
+	const VideoDescription& Description() const;
+	size_t FrameCount() const;
+	uint64_t FramesDelivered() const;
+	// True once a non-looping replay delivered its last frame.
+	bool Finished() const;
+
+private:
+	bool ParseY4mHeader(double& fps);
+	bool IndexRawFrames();
+	void Run();
+
+	FilePacing pacing_{ kFilePacingRealTime };
+	bool loop_{};
+
+	RefPtr<MappedFile> file_{};
+	VideoFrameLayout layout_{};
+	std::vector<size_t> frame_offsets_{};
+
+	std::thread thread_{};
+	FrameClock clock_{};
+	std::atomic<uint64_t> frames_delivered_{ 0 };
+	std::atomic<bool> finished_{ false };
+};
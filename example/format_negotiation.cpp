@@ -0,0 +1,175 @@
+#include "format_negotiation.h"
+
+#include <cmath>
+#include <cstdio>
+
+#include "video_convert.h"
+#include "video_frame_view.h"
+#include "video_scaler.h"
+
+namespace {
+
+// Rough per-pixel prices relative to a copy, from the capture benchmark.
+const double kDecodeCost = 6.0;
+const double kYuvConvertCost = 0.5;
+const double kRgbConvertCost = 1.0;
+const double kScaleCost = 1.0;
+const double kExtraFrameCost = 0.05;
+// Missing a tenth of the requested pixels or frames outweighs an MJPEG decode.
+const double kShortfallCost = 100.0;
+const double kAspectCost = 4.0;
+
+bool CanDecodeMjpegTo(VideoType video_type) {
+	return video_type == kVideoTypeI420 || video_type == kVideoTypeIYUV || video_type == kVideoTypeNV12;
+}
+
+double ConvertCost(VideoType src_type, VideoType dst_type) {
+	if (GetPixelLayout(src_type) == kPixelLayoutPacked || GetPixelLayout(dst_type) == kPixelLayoutPacked) {
+		return kRgbConvertCost;
+	}
+	return kYuvConvertCost;
+}
+
+double Shortfall(double have, double want) {
+	return have < want ? 1.0 - have / want : 0.0;
+}
+
+}
+
+bool GetFormatCost(const VideoDescription& format, const VideoDescription& requested, FormatChoice& choice) {
+	choice = FormatChoice();
+	choice.format = format;
+	if (format.width == 0 || format.height == 0 || format.video_type == kVideoTypeUnknown) {
+		return false;
+	}
+	uint32_t width = requested.width ? requested.width : format.width;
+	uint32_t height = requested.height ? requested.height : format.height;
+	uint32_t fps = requested.fps ? requested.fps : format.fps;
+	VideoType video_type = requested.video_type != kVideoTypeUnknown ? requested.video_type : format.video_type;
+	choice.output.width = width;
+	choice.output.height = height;
+	choice.output.fps = fps;
+	choice.output.video_type = video_type;
+	bool same_size = format.width == width && format.height == height;
+	// Frames above the requested rate are dropped before they are touched.
+	double frames = format.fps && format.fps < fps ? format.fps : fps;
+	if (frames == 0.0) {
+		frames = 1.0;
+	}
+	double source_pixels = static_cast<double>(format.width) * format.height * frames;
+	double output_pixels = static_cast<double>(width) * height * frames;
+	double unit = static_cast<double>(width) * height * (fps ? fps : 1);
+	if (unit <= 0.0) {
+		return false;
+	}
+
+	FormatCost& cost = choice.cost;
+	VideoType decoded_type = format.video_type;
+	if (format.video_type == kVideoTypeMJPEG) {
+		if (video_type == kVideoTypeMJPEG) {
+			// Compressed data cannot be scaled.
+			if (!same_size) {
+				return false;
+			}
+			choice.decode_type = kVideoTypeMJPEG;
+		}
+		else {
+			decoded_type = CanDecodeMjpegTo(video_type) ? video_type : kVideoTypeI420;
+			choice.decode_type = decoded_type;
+			cost.decode = kDecodeCost * source_pixels / unit;
+		}
+	}
+	else if (video_type == kVideoTypeMJPEG) {
+		return false;
+	}
+	if (decoded_type != video_type) {
+		if (!CanConvertVideoFrame(decoded_type, video_type)) {
+			return false;
+		}
+		choice.convert = true;
+	}
+	if (!same_size) {
+		// Scale in whichever of the two formats the scaler takes, converting at
+		// the smaller of the two sizes when there is a choice.
+		bool scale_source = CanScaleVideoFrame(decoded_type);
+		bool scale_output = CanScaleVideoFrame(video_type);
+		if (!scale_source && !scale_output) {
+			return false;
+		}
+		choice.scale = true;
+		cost.scale = kScaleCost * (scale_source ? source_pixels : output_pixels) / unit;
+		if (choice.convert) {
+			bool convert_small = scale_source && (!scale_output || output_pixels < source_pixels);
+			cost.convert = ConvertCost(decoded_type, video_type) * (convert_small ? output_pixels : source_pixels) / unit;
+		}
+	}
+	else if (choice.convert) {
+		cost.convert = ConvertCost(decoded_type, video_type) * source_pixels / unit;
+	}
+	if (format.fps > fps) {
+		cost.frame_overhead = kExtraFrameCost * (format.fps - fps) / (fps ? fps : 1);
+	}
+	cost.resolution = kShortfallCost * (Shortfall(format.width, width) + Shortfall(format.height, height));
+	cost.frame_rate = kShortfallCost * Shortfall(format.fps, fps);
+	double aspect = std::log((static_cast<double>(format.width) * height) / (static_cast<double>(format.height) * width));
+	cost.aspect = kAspectCost * std::fabs(aspect);
+	cost.total = cost.decode + cost.convert + cost.scale + cost.frame_overhead + cost.resolution + cost.frame_rate +
+		cost.aspect;
+
+	choice.reason = std::to_string(format.width) + "x" + std::to_string(format.height) + "@" +
+		std::to_string(format.fps) + " " + VideoTypeName(format.video_type);
+	if (cost.decode > 0.0) {
+		choice.reason += std::string(", decode to ") + VideoTypeName(decoded_type);
+	}
+	if (choice.scale) {
+		choice.reason += ", scale to " + std::to_string(width) + "x" + std::to_string(height);
+	}
+	if (choice.convert) {
+		choice.reason += std::string(", convert to ") + VideoTypeName(video_type);
+	}
+	char summary[160];
+	snprintf(summary, sizeof(summary),
+		"; cost %.2f (decode %.2f, convert %.2f, scale %.2f, frames %.2f, shortfall %.2f, aspect %.2f)",
+		cost.total, cost.decode, cost.convert, cost.scale, cost.frame_overhead, cost.resolution + cost.frame_rate,
+		cost.aspect);
+	choice.reason += summary;
+	return true;
+}
+
+bool NegotiateVideoFormat(const std::vector<VideoDescription>& formats, const VideoDescription& requested,
+	FormatChoice& choice) {
+	bool found = false;
+	for (size_t i = 0; i < formats.size(); ++i) {
+		FormatChoice candidate;
+		if (!GetFormatCost(formats[i], requested, candidate)) {
+			continue;
+		}
+		if (!found || candidate.cost.total < choice.cost.total) {
+			candidate.index = i;
+			choice = candidate;
+			found = true;
+		}
+	}
+	return found;
+}
+
+const char* VideoTypeName(VideoType video_type) {
+	switch (video_type) {
+	case kVideoTypeI420: return "I420";
+	case kVideoTypeIYUV: return "IYUV";
+	case kVideoTypeRGB24: return "RGB24";
+	case kVideoTypeABGR: return "ABGR";
+	case kVideoTypeARGB: return "ARGB";
+	case kVideoTypeARGB4444: return "ARGB4444";
+	case kVideoTypeRGB565: return "RGB565";
+	case kVideoTypeARGB1555: return "ARGB1555";
+	case kVideoTypeYUY2: return "YUY2";
+	case kVideoTypeYV12: return "YV12";
+	case kVideoTypeUYVY: return "UYVY";
+	case kVideoTypeMJPEG: return "MJPEG";
+	case kVideoTypeNV21: return "NV21";
+	case kVideoTypeNV12: return "NV12";
+	case kVideoTypeBGRA: return "BGRA";
+	default: return "Unknown";
+	}
+}
@@ -0,0 +1,57 @@
+#pragma once
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "video_frame.h"
+
+// Price of reaching the requested format from one device mode. CPU terms are
+// work per second in units of copying the requested stream once, so 1.0 is
+// one extra pass over every delivered pixel. Shortfall terms price missing
+// pixels and frames high enough that a mode meeting the request wins over a
+// cheaper one that does not, unless nothing meets it.
+struct FormatCost {
+	double decode{};
+	double convert{};
+	double scale{};
+	// Extra frames the device sends above the requested rate, which still
+	// cost a wake-up and a buffer each.
+	double frame_overhead{};
+	double resolution{};
+	double frame_rate{};
+	double aspect{};
+	double total{};
+};
+
+struct FormatChoice {
+	// Position of the mode in the list passed to NegotiateVideoFormat().
+	size_t index{};
+	// The device mode to open.
+	VideoDescription format{};
+	// What the consumer gets: the request with the mode's values where it
+	// left them open. VideoCapture converts and scales to it on delivery.
+	VideoDescription output{};
+	// What to pass to VideoCapture::SetMjpegDecodeType() for an MJPEG mode,
+	// kVideoTypeMJPEG when the compressed data is wanted. kVideoTypeUnknown
+	// for raw modes.
+	VideoType decode_type{};
+	// Steps between the decoded frame and the consumer.
+	bool convert{};
+	bool scale{};
+	FormatCost cost{};
+	// One line on the mode and its path, for logs.
+	std::string reason{};
+};
+
+// Prices |format| against |requested|. A zero width, height or fps in
+// |requested| takes the mode's, kVideoTypeUnknown takes the mode's type.
+// Returns false when the requested type cannot be reached from |format|,
+// e.g. compressed output from a raw mode.
+bool GetFormatCost(const VideoDescription& format, const VideoDescription& requested, FormatChoice& choice);
+
+// Picks the cheapest reachable mode of |formats|; ties go to the earlier one.
+// Returns false when none is reachable.
+bool NegotiateVideoFormat(const std::vector<VideoDescription>& formats, const VideoDescription& requested,
+	FormatChoice& choice);
+
+const char* VideoTypeName(VideoType video_type);
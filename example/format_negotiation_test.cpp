@@ -0,0 +1,214 @@
+// NegotiateVideoFormat() and what VideoCapture does with its choice: frames of
+// a mode that differs from the request reach the callback converted and
+// scaled to the requested type and size.
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include "format_negotiation.h"
+#include "test_check.h"
+#include "video_capture.h"
+#include "video_convert.h"
+#include "video_frame_buffer.h"
+#include "video_scaler.h"
+
+namespace {
+
+VideoDescription Describe(uint32_t width, uint32_t height, uint32_t fps, VideoType video_type) {
+	VideoDescription description;
+	description.width = width;
+	description.height = height;
+	description.fps = fps;
+	description.video_type = video_type;
+	return description;
+}
+
+bool SameDescription(const VideoDescription& a, const VideoDescription& b) {
+	return a.width == b.width && a.height == b.height && a.fps == b.fps && a.video_type == b.video_type;
+}
+
+void TestNegotiate() {
+	VideoDescription requested = Describe(640, 480, 30, kVideoTypeNV12);
+	std::vector<VideoDescription> formats;
+	formats.push_back(Describe(1280, 720, 30, kVideoTypeYUY2));
+	formats.push_back(Describe(640, 480, 30, kVideoTypeMJPEG));
+	formats.push_back(Describe(640, 480, 30, kVideoTypeNV12));
+	FormatChoice choice;
+	CHECK(NegotiateVideoFormat(formats, requested, choice));
+	CHECK(choice.index == 2 && !choice.convert && !choice.scale);
+	CHECK(SameDescription(choice.output, requested));
+
+	// Without the exact mode, converting and scaling YUY2 is cheaper than a
+	// decode.
+	formats.pop_back();
+	CHECK(NegotiateVideoFormat(formats, requested, choice));
+	CHECK(choice.index == 0 && choice.convert && choice.scale);
+	CHECK(SameDescription(choice.output, requested));
+	CHECK(GetFormatCost(formats[1], requested, choice));
+	CHECK(choice.decode_type == kVideoTypeNV12 && !choice.convert && !choice.scale);
+	CHECK(SameDescription(choice.output, requested));
+
+	CHECK(GetFormatCost(Describe(640, 480, 30, kVideoTypeYUY2), requested, choice));
+	CHECK(choice.convert && !choice.scale && choice.cost.scale == 0.0 && choice.cost.convert > 0.0);
+	CHECK(SameDescription(choice.output, requested));
+	CHECK(GetFormatCost(Describe(1280, 960, 30, kVideoTypeYUY2), requested, choice));
+	CHECK(choice.convert && choice.scale && choice.cost.scale > 0.0);
+	CHECK(SameDescription(choice.output, requested));
+
+	// Whatever the request leaves open comes from the mode.
+	CHECK(GetFormatCost(Describe(1280, 720, 60, kVideoTypeNV12), VideoDescription(), choice));
+	CHECK(!choice.convert && !choice.scale);
+	CHECK(SameDescription(choice.output, Describe(1280, 720, 60, kVideoTypeNV12)));
+
+	CHECK(!GetFormatCost(Describe(640, 480, 30, kVideoTypeYUY2), Describe(640, 480, 30, kVideoTypeMJPEG), choice));
+	CHECK(!GetFormatCost(Describe(1280, 720, 30, kVideoTypeMJPEG), Describe(640, 480, 30, kVideoTypeMJPEG), choice));
+}
+
+// Plays a device backend: opens |mode| for |requested| the way the Media
+// Foundation backends do and hands in frames in the mode's layout.
+class NegotiatedCapture : public VideoCapture {
+public:
+	bool Open(const VideoDescription& mode, const VideoDescription& requested) {
+		FormatChoice choice;
+		if (!GetFormatCost(mode, requested, choice)) {
+			return false;
+		}
+		SetFormatChoice(choice);
+		video_description_ = choice.format;
+		if (choice.decode_type != kVideoTypeUnknown) {
+			SetMjpegDecodeType(choice.decode_type);
+		}
+		return true;
+	}
+
+	bool Push(const std::vector<uint8_t>& data, int64_t timestamp_us) {
+		return DeliverContiguousFrame(data.data(), data.size(), 0, timestamp_us);
+	}
+};
+
+struct TestFrame {
+	explicit TestFrame(const VideoDescription& description) : pool(1) {
+		pool.Configure(description);
+		pool.CreateFrame(frame);
+	}
+
+	VideoFrameBufferPool pool;
+	VideoFrame frame{};
+};
+
+// A device frame of |mode| with random samples, planes back to back.
+std::vector<uint8_t> MakeDeviceFrame(const VideoDescription& mode, uint32_t seed) {
+	VideoFrameLayout layout;
+	GetVideoFrameLayout(mode, 1, layout);
+	std::vector<uint8_t> data(layout.size);
+	for (size_t i = 0; i < data.size(); ++i) {
+		seed = seed * 1664525 + 1013904223;
+		data[i] = static_cast<uint8_t>(seed >> 24);
+	}
+	return data;
+}
+
+bool SameRows(const uint8_t* a, uint32_t a_stride, const uint8_t* b, uint32_t b_stride, uint32_t bytes,
+	uint32_t rows) {
+	for (uint32_t y = 0; y < rows; ++y) {
+		if (memcmp(a + static_cast<size_t>(y) * a_stride, b + static_cast<size_t>(y) * b_stride, bytes) != 0) {
+			return false;
+		}
+	}
+	return true;
+}
+
+// Visible samples of two I420 or NV12 frames.
+bool SamePixels(const VideoFrame& a, const VideoFrame& b) {
+	if (a.video_type != b.video_type || a.width != b.width || a.height != b.height) {
+		return false;
+	}
+	uint32_t chroma_width = (a.width + 1) / 2;
+	uint32_t chroma_height = (a.height + 1) / 2;
+	if (!SameRows(a.y_data, a.y_stride, b.y_data, b.y_stride, a.width, a.height)) {
+		return false;
+	}
+	if (a.video_type == kVideoTypeNV12) {
+		return SameRows(a.u_data, a.u_stride, b.u_data, b.u_stride, chroma_width * 2, chroma_height);
+	}
+	return SameRows(a.u_data, a.u_stride, b.u_data, b.u_stride, chroma_width, chroma_height) &&
+		SameRows(a.v_data, a.v_stride, b.v_data, b.v_stride, chroma_width, chroma_height);
+}
+
+// Delivers two frames of |mode| opened for |requested| and compares them
+// with the device frame put through |steps|: the types and sizes it is
+// expected to pass through, starting with the mode.
+void TestDelivery(const VideoDescription& mode, const VideoDescription& requested,
+	const std::vector<VideoDescription>& steps) {
+	NegotiatedCapture capture;
+	CHECK(capture.Open(mode, requested));
+	std::vector<VideoFrame> delivered;
+	capture.RegisterVideoFrameCallback([&delivered](VideoFrame& video_frame) {
+		delivered.push_back(video_frame);
+	});
+	std::vector<uint8_t> data = MakeDeviceFrame(mode, mode.width + mode.video_type);
+	CHECK(capture.Push(data, 1000));
+	CHECK(capture.Push(data, 2000));
+	CHECK(delivered.size() == 2);
+	if (delivered.size() != 2) {
+		return;
+	}
+	const VideoFrame& frame = delivered[1];
+	CHECK(frame.width == requested.width && frame.height == requested.height);
+	CHECK(frame.video_type == requested.video_type);
+	CHECK(frame.timestamp_us == 2000 && frame.sequence == 1);
+	CHECK(delivered[0].y_data != frame.y_data && SamePixels(delivered[0], frame));
+
+	VideoFrameView view;
+	CHECK(GetContiguousFrameView(mode, data.data(), data.size(), 0, view));
+	TestFrame source(mode);
+	CHECK(CopyVideoFrameView(view, source.frame));
+	std::vector<std::unique_ptr<TestFrame>> frames;
+	const VideoFrame* previous = &source.frame;
+	for (const VideoDescription& step : steps) {
+		frames.emplace_back(new TestFrame(step));
+		VideoFrame& next = frames.back()->frame;
+		CHECK(previous->video_type == step.video_type ? ScaleVideoFrame(*previous, next) :
+			ConvertVideoFrame(*previous, next));
+		previous = &next;
+	}
+	CHECK(SamePixels(frame, *previous));
+}
+
+void TestDeliveries() {
+	// YUY2 cannot be scaled: converted at the device size first.
+	std::vector<VideoDescription> steps;
+	steps.push_back(Describe(320, 240, 30, kVideoTypeNV12));
+	steps.push_back(Describe(160, 120, 30, kVideoTypeNV12));
+	TestDelivery(Describe(320, 240, 30, kVideoTypeYUY2), Describe(160, 120, 30, kVideoTypeNV12), steps);
+
+	// Both scalable: converted at the smaller size.
+	steps.clear();
+	steps.push_back(Describe(160, 120, 30, kVideoTypeNV12));
+	steps.push_back(Describe(160, 120, 30, kVideoTypeI420));
+	TestDelivery(Describe(320, 240, 30, kVideoTypeNV12), Describe(160, 120, 30, kVideoTypeI420), steps);
+	steps.clear();
+	steps.push_back(Describe(100, 60, 30, kVideoTypeI420));
+	steps.push_back(Describe(202, 122, 30, kVideoTypeI420));
+	TestDelivery(Describe(100, 60, 30, kVideoTypeNV12), Describe(202, 122, 30, kVideoTypeI420), steps);
+
+	// One step only.
+	steps.clear();
+	steps.push_back(Describe(64, 48, 30, kVideoTypeI420));
+	TestDelivery(Describe(64, 48, 30, kVideoTypeYUY2), Describe(64, 48, 30, kVideoTypeI420), steps);
+	steps.clear();
+	steps.push_back(Describe(33, 17, 30, kVideoTypeNV12));
+	TestDelivery(Describe(64, 48, 30, kVideoTypeNV12), Describe(33, 17, 30, kVideoTypeNV12), steps);
+
+	// The mode is the request: delivered as it came.
+	steps.clear();
+	TestDelivery(Describe(64, 48, 30, kVideoTypeNV12), Describe(64, 48, 30, kVideoTypeNV12), steps);
+}
+
+}
+
+int main() {
+	TestNegotiate();
+	TestDeliveries();
+	return test::Result();
+}
@@ -0,0 +1,229 @@
+#include "frame_bus.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <thread>
+#include <utility>
+
+#include "frame_decimator.h"
+#include "thread_pool.h"
+#include "video_capture.h"
+#include "video_convert.h"
+#include "video_frame_buffer.h"
+
+class FrameBus::Subscriber {
+public:
+	Subscriber(int id, Callback callback, const SubscriberOptions& options, ThreadPool* thread_pool)
+		: id_(id), callback_(std::move(callback)), options_(options), thread_pool_(thread_pool),
+		queue_(options.queue_capacity ? options.queue_capacity : 1, options.policy) {
+		decimator_.SetTargetFps(options.max_fps);
+		if (!thread_pool_) {
+			thread_ = std::thread(&Subscriber::Run, this);
+		}
+	}
+
+	~Subscriber() {
+		Stop();
+	}
+
+	int Id() const {
+		return id_;
+	}
+
+	void Offer(const VideoFrame& video_frame) {
+		if ((options_.skip_unchanged && video_frame.unchanged) ||
+			(options_.max_fps > 0.0 && !decimator_.ShouldKeep(video_frame.timestamp_us))) {
+			filtered_.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+		if (queue_.Push(video_frame) && thread_pool_) {
+			ScheduleDrain();
+		}
+	}
+
+	// Refuses new frames, throws queued ones away and waits for the callback.
+	void Stop() {
+		{
+			std::lock_guard<std::mutex> lock(drain_mutex_);
+			stopped_ = true;
+		}
+		queue_.Close();
+		if (thread_.joinable()) {
+			thread_.join();
+		}
+		std::unique_lock<std::mutex> lock(drain_mutex_);
+		drain_done_.wait(lock, [this]() { return !drain_scheduled_; });
+	}
+
+	SubscriberStats Stats() const {
+		SubscriberStats stats;
+		stats.queue = queue_.Stats();
+		stats.delivered = delivered_.load(std::memory_order_relaxed);
+		stats.filtered = filtered_.load(std::memory_order_relaxed);
+		stats.conversion_failures = conversion_failures_.load(std::memory_order_relaxed);
+		return stats;
+	}
+
+private:
+	void Run() {
+		for (;;) {
+			VideoFrame video_frame;
+			if (queue_.Pop(video_frame, std::chrono::milliseconds(100))) {
+				Deliver(video_frame);
+			}
+			else if (queue_.Closed()) {
+				return;
+			}
+		}
+	}
+
+	void ScheduleDrain() {
+		{
+			std::lock_guard<std::mutex> lock(drain_mutex_);
+			if (drain_scheduled_ || stopped_) {
+				return;
+			}
+			drain_scheduled_ = true;
+		}
+		thread_pool_->PostTask([this]() {
+			Drain();
+		});
+	}
+
+	void Drain() {
+		for (;;) {
+			VideoFrame video_frame;
+			while (queue_.TryPop(video_frame)) {
+				Deliver(video_frame);
+			}
+			// Same hand-over as VideoCapture::DrainDelivery().
+			std::lock_guard<std::mutex> lock(drain_mutex_);
+			if (queue_.Size() == 0) {
+				drain_scheduled_ = false;
+				drain_done_.notify_all();
+				return;
+			}
+		}
+	}
+
+	void Deliver(VideoFrame& video_frame) {
+		if (queue_.Closed()) {
+			return;
+		}
+		if (options_.video_type == kVideoTypeUnknown || options_.video_type == video_frame.video_type) {
+			callback_(video_frame);
+			delivered_.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+		VideoDescription description;
+		description.width = video_frame.width;
+		description.height = video_frame.height;
+		description.video_type = options_.video_type;
+		VideoFrame converted;
+		if (!convert_pool_.Configure(description) || !convert_pool_.CreateFrame(converted) ||
+			!ConvertVideoFrame(video_frame, converted)) {
+			conversion_failures_.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+		converted.timestamp_us = video_frame.timestamp_us;
+		converted.arrival_us = video_frame.arrival_us;
+		converted.sequence = video_frame.sequence;
+		converted.unchanged = video_frame.unchanged;
+		callback_(converted);
+		delivered_.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	const int id_;
+	Callback callback_{};
+	const SubscriberOptions options_{};
+	ThreadPool* thread_pool_{};
+	FrameQueue<VideoFrame> queue_;
+	FrameDecimator decimator_{};
+	VideoFrameBufferPool convert_pool_{};
+	std::thread thread_{};
+	std::mutex drain_mutex_{};
+	std::condition_variable drain_done_{};
+	bool drain_scheduled_{};
+	bool stopped_{};
+	std::atomic<uint64_t> delivered_{ 0 };
+	std::atomic<uint64_t> filtered_{ 0 };
+	std::atomic<uint64_t> conversion_failures_{ 0 };
+};
+
+FrameBus::FrameBus(ThreadPool* thread_pool)
+	: thread_pool_(thread_pool), subscribers_(std::make_shared<const SubscriberList>()) {
+
+}
+
+FrameBus::~FrameBus() {
+	std::shared_ptr<const SubscriberList> subscribers;
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		subscribers.swap(subscribers_);
+	}
+	for (const std::shared_ptr<Subscriber>& subscriber : *subscribers) {
+		subscriber->Stop();
+	}
+}
+
+int FrameBus::Subscribe(Callback callback, const SubscriberOptions& options) {
+	std::lock_guard<std::mutex> lock(mutex_);
+	int id = next_id_++;
+	std::shared_ptr<SubscriberList> subscribers = std::make_shared<SubscriberList>(*subscribers_);
+	subscribers->push_back(std::make_shared<Subscriber>(id, std::move(callback), options, thread_pool_));
+	subscribers_ = subscribers;
+	return id;
+}
+
+bool FrameBus::Unsubscribe(int id) {
+	std::shared_ptr<Subscriber> removed;
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		std::shared_ptr<SubscriberList> subscribers = std::make_shared<SubscriberList>(*subscribers_);
+		auto it = std::find_if(subscribers->begin(), subscribers->end(),
+			[id](const std::shared_ptr<Subscriber>& subscriber) { return subscriber->Id() == id; });
+		if (it == subscribers->end()) {
+			return false;
+		}
+		removed = *it;
+		subscribers->erase(it);
+		subscribers_ = subscribers;
+	}
+	// A Publish() still holding the old list only finds a closed queue.
+	removed->Stop();
+	return true;
+}
+
+size_t FrameBus::SubscriberCount() const {
+	return Subscribers()->size();
+}
+
+bool FrameBus::GetStats(int id, SubscriberStats& stats) const {
+	std::shared_ptr<const SubscriberList> subscribers = Subscribers();
+	for (const std::shared_ptr<Subscriber>& subscriber : *subscribers) {
+		if (subscriber->Id() == id) {
+			stats = subscriber->Stats();
+			return true;
+		}
+	}
+	return false;
+}
+
+void FrameBus::Publish(const VideoFrame& video_frame) {
+	std::shared_ptr<const SubscriberList> subscribers = Subscribers();
+	for (const std::shared_ptr<Subscriber>& subscriber : *subscribers) {
+		subscriber->Offer(video_frame);
+	}
+}
+
+void FrameBus::Attach(VideoCapture& capture) {
+	capture.RegisterVideoFrameCallback([this](VideoFrame& video_frame) {
+		Publish(video_frame);
+	});
+}
+
+std::shared_ptr<const FrameBus::SubscriberList> FrameBus::Subscribers() const {
+	std::lock_guard<std::mutex> lock(mutex_);
+	return subscribers_;
+}
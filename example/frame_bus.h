@@ -0,0 +1,87 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "frame_queue.h"
+#include "video_frame.h"
+
+class ThreadPool;
+class VideoCapture;
+
+struct SubscriberOptions {
+	// Frames waiting for this subscriber, and what happens when it falls
+	// behind. kFrameQueueBlock stalls the publisher, and with it every other
+	// subscriber; use it only for subscribers that must not miss frames.
+	size_t queue_capacity{ 4 };
+	FrameQueuePolicy policy{ kFrameQueueDropOldest };
+	// Thins the stream by capture timestamp before it is queued, 0 for every
+	// frame.
+	double max_fps{};
+	// Converts frames on the subscriber's side; kVideoTypeUnknown takes them
+	// as published.
+	VideoType video_type{};
+	// Leaves out frames marked VideoFrame::unchanged.
+	bool skip_unchanged{};
+};
+
+struct SubscriberStats {
+	FrameQueueStats queue;
+	// Frames that reached the callback.
+	uint64_t delivered;
+	// Frames left out by |max_fps| or |skip_unchanged|.
+	uint64_t filtered;
+	uint64_t conversion_failures;
+};
+
+// Hands every published frame to any number of subscribers, each behind its
+// own bounded queue and running on its own thread, or one at a time on a
+// shared ThreadPool. Subscribers get references to the same frame buffer;
+// only subscribers asking for another format get a converted copy, made on
+// their side. A slow subscriber drops its own frames by its policy and never
+// delays the publisher or the others.
+//
+// Queued frames keep the capture's pooled buffers, see
+// VideoCapture::SetMaxPooledFrames().
+class FrameBus {
+public:
+	using Callback = std::function<void(VideoFrame& video_frame)>;
+
+	// With |thread_pool|, callbacks run on its workers instead of a thread
+	// per subscriber; it must outlive the bus.
+	explicit FrameBus(ThreadPool* thread_pool = nullptr);
+	~FrameBus();
+
+	// Returns the id for Unsubscribe(). Callbacks of one subscriber are called
+	// one at a time and in order.
+	int Subscribe(Callback callback, const SubscriberOptions& options = SubscriberOptions());
+	// Drops the subscriber's queued frames and waits for a running callback.
+	// Must not be called from that subscriber's own callback.
+	bool Unsubscribe(int id);
+	size_t SubscriberCount() const;
+	bool GetStats(int id, SubscriberStats& stats) const;
+
+	// Safe from any thread, concurrently with Subscribe() and Unsubscribe().
+	void Publish(const VideoFrame& video_frame);
+	// Makes the bus the frame callback of |capture|.
+	void Attach(VideoCapture& capture);
+
+private:
+	class Subscriber;
+	using SubscriberList = std::vector<std::shared_ptr<Subscriber>>;
+
+	FrameBus(const FrameBus&) = delete;
+	FrameBus operator =(const FrameBus&) = delete;
+
+	std::shared_ptr<const SubscriberList> Subscribers() const;
+
+	ThreadPool* thread_pool_{};
+	mutable std::mutex mutex_{};
+	// Replaced, never modified, so Publish() only holds the lock for a copy
+	// of the pointer.
+	std::shared_ptr<const SubscriberList> subscribers_{};
+	int next_id_{ 1 };
+};
@@ -0,0 +1,135 @@
+#include "frame_change_detector.h"
+
+#include <algorithm>
+
+#include "frame_diff_row.h"
+#include "video_frame_view.h"
+
+namespace {
+
+const int kBlockHeight = 16;
+// Rows read per block; motion big enough to matter spans several of them.
+const int kRowStep = 4;
+
+}
+
+FrameDiffRowFunctions GetFrameDiffRowFunctions(int cpu_flags) {
+	FrameDiffRowFunctions functions = { FrameDiffBlockSum_C, FrameDiffSad_C };
+#if defined(HAS_X86_SIMD)
+	if (cpu_flags & kCpuHasSSE2) {
+		FrameDiffRowFunctions sse2 = { FrameDiffBlockSum_SSE2, FrameDiffSad_SSE2 };
+		functions = sse2;
+	}
+	if ((cpu_flags & kCpuHasSSE2) && (cpu_flags & kCpuHasAVX2)) {
+		FrameDiffRowFunctions avx2 = { FrameDiffBlockSum_AVX2, FrameDiffSad_AVX2 };
+		functions = avx2;
+	}
+#endif
+#if defined(HAS_NEON_SIMD)
+	if (cpu_flags & kCpuHasNEON) {
+		FrameDiffRowFunctions neon = { FrameDiffBlockSum_NEON, FrameDiffSad_NEON };
+		functions = neon;
+	}
+#endif
+	return functions;
+}
+
+FrameChangeDetector::FrameChangeDetector() {
+
+}
+
+FrameChangeDetector::~FrameChangeDetector() {
+
+}
+
+void FrameChangeDetector::SetThresholds(double mean_threshold, int block_threshold) {
+	std::lock_guard<std::mutex> lock(mutex_);
+	mean_threshold_ = mean_threshold;
+	block_threshold_ = block_threshold;
+}
+
+void FrameChangeDetector::SetKeepAlive(int64_t keep_alive_us) {
+	std::lock_guard<std::mutex> lock(mutex_);
+	keep_alive_us_ = keep_alive_us;
+}
+
+FrameChange FrameChangeDetector::Process(const VideoFrame& video_frame) {
+	std::lock_guard<std::mutex> lock(mutex_);
+	FrameChange change = {};
+	++stats_.frames;
+	bool same_size = video_frame.width == width_ && video_frame.height == height_;
+	if (!BuildThumbnail(video_frame) || !same_size || reference_.size() != thumbnail_.size()) {
+		width_ = video_frame.width;
+		height_ = video_frame.height;
+		change.changed = true;
+	}
+	else {
+		FrameDiffRowFunctions rows = GetFrameDiffRowFunctions(GetCpuFlags());
+		uint8_t max_difference = 0;
+		uint32_t sad = rows.sad(thumbnail_.data(), reference_.data(), static_cast<int>(thumbnail_.size()),
+			&max_difference);
+		change.mean_difference = static_cast<double>(sad) / thumbnail_.size();
+		change.max_block_difference = max_difference;
+		change.changed = change.mean_difference > mean_threshold_ || max_difference > block_threshold_;
+		change.keep_alive = !change.changed && keep_alive_us_ > 0 &&
+			video_frame.timestamp_us - reference_us_ >= keep_alive_us_;
+	}
+	if (change.changed || change.keep_alive) {
+		reference_.swap(thumbnail_);
+		reference_us_ = video_frame.timestamp_us;
+	}
+	if (change.changed) {
+		++stats_.changed;
+	}
+	else {
+		++stats_.unchanged;
+	}
+	if (change.keep_alive) {
+		++stats_.keep_alive;
+	}
+	return change;
+}
+
+FrameChangeStats FrameChangeDetector::Stats() const {
+	std::lock_guard<std::mutex> lock(mutex_);
+	return stats_;
+}
+
+void FrameChangeDetector::Reset() {
+	std::lock_guard<std::mutex> lock(mutex_);
+	width_ = 0;
+	height_ = 0;
+	reference_.clear();
+	reference_us_ = 0;
+	stats_ = FrameChangeStats();
+}
+
+bool FrameChangeDetector::BuildThumbnail(const VideoFrame& video_frame) {
+	VideoPixelLayout layout = GetPixelLayout(video_frame.video_type);
+	int blocks_x = static_cast<int>(video_frame.width / kFrameDiffBlockWidth);
+	if ((layout != kPixelLayoutPlanar && layout != kPixelLayoutSemiPlanar) || !video_frame.y_data || blocks_x == 0) {
+		thumbnail_.clear();
+		return false;
+	}
+	// Columns past the last whole block are left out.
+	int blocks_y = static_cast<int>((video_frame.height + kBlockHeight - 1) / kBlockHeight);
+	thumbnail_.resize(static_cast<size_t>(blocks_x) * blocks_y);
+	sums_.resize(blocks_x);
+	FrameDiffRowFunctions rows = GetFrameDiffRowFunctions(GetCpuFlags());
+	for (int block_y = 0; block_y < blocks_y; ++block_y) {
+		std::fill(sums_.begin(), sums_.end(), 0u);
+		uint32_t row_end = static_cast<uint32_t>(block_y + 1) * kBlockHeight;
+		row_end = row_end < video_frame.height ? row_end : video_frame.height;
+		uint32_t samples = 0;
+		for (uint32_t row = static_cast<uint32_t>(block_y) * kBlockHeight; row < row_end; row += kRowStep) {
+			rows.block_sum(video_frame.y_data + static_cast<size_t>(row) * video_frame.y_stride, sums_.data(), blocks_x);
+			++samples;
+		}
+		uint32_t pixels = samples * kFrameDiffBlockWidth;
+		uint8_t* thumbnail_row = thumbnail_.data() + static_cast<size_t>(block_y) * blocks_x;
+		for (int block_x = 0; block_x < blocks_x; ++block_x) {
+			thumbnail_row[block_x] = static_cast<uint8_t>((sums_[block_x] + pixels / 2) / pixels);
+		}
+	}
+	return true;
+}
@@ -0,0 +1,73 @@
+#pragma once
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include "video_frame.h"
+
+struct FrameChange {
+	// Differs enough from the reference frame to count as new content.
+	bool changed;
+	// Unchanged, but due because the keep-alive interval ran out.
+	bool keep_alive;
+	// Mean and largest absolute difference of the block means against the
+	// reference, in 8-bit luma levels.
+	double mean_difference;
+	int max_block_difference;
+};
+
+struct FrameChangeStats {
+	uint64_t frames;
+	uint64_t changed;
+	uint64_t unchanged;
+	uint64_t keep_alive;
+};
+
+// Spots frames that repeat the last one, for cameras watching static scenes.
+// Each frame's luma is reduced to a thumbnail of 16x16 block means, reading
+// only every fourth row, and compared with the thumbnail of the last frame
+// that was passed on, so slow drift still adds up to a change. Frames are
+// changed when the mean block difference or any single block passes its
+// threshold; the second catches small movement in a big static picture.
+//
+// Frames without a separate luma plane (packed, RGB, MJPEG), and the first
+// frame after a size change, always count as changed. Thread safe.
+class FrameChangeDetector {
+public:
+	FrameChangeDetector();
+	~FrameChangeDetector();
+
+	// Defaults to 1.5 levels mean and 24 levels for one block.
+	void SetThresholds(double mean_threshold, int block_threshold);
+	// Unchanged frames are due again |keep_alive_us| of capture time after the
+	// last frame that was passed on, so consumers can tell an idle scene from a
+	// dead camera. 0 never. Defaults to one second.
+	void SetKeepAlive(int64_t keep_alive_us);
+
+	// Compares |video_frame| with the reference; changed and keep-alive frames
+	// become the new reference.
+	FrameChange Process(const VideoFrame& video_frame);
+
+	FrameChangeStats Stats() const;
+	// Forgets the reference and the counters.
+	void Reset();
+
+private:
+	FrameChangeDetector(const FrameChangeDetector&) = delete;
+	FrameChangeDetector operator =(const FrameChangeDetector&) = delete;
+
+	bool BuildThumbnail(const VideoFrame& video_frame);
+
+	mutable std::mutex mutex_{};
+	double mean_threshold_{ 1.5 };
+	int block_threshold_{ 24 };
+	int64_t keep_alive_us_{ 1000000 };
+
+	uint32_t width_{};
+	uint32_t height_{};
+	std::vector<uint8_t> thumbnail_{};
+	std::vector<uint8_t> reference_{};
+	std::vector<uint32_t> sums_{};
+	int64_t reference_us_{};
+	FrameChangeStats stats_{};
+};
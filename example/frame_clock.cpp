@@ -0,0 +1,55 @@
+#include "frame_clock.h"
+
+#include <chrono>
+
+#include "time_utils.h"
+
+FrameClock::FrameClock() {
+
+}
+
+FrameClock::~FrameClock() {
+
+}
+
+void FrameClock::Start(double fps) {
+	std::lock_guard<std::mutex> lock(mutex_);
+	running_ = true;
+	fps_ = fps > 0.0 ? fps : 0.0;
+	interval_us_ = fps > 0.0 ? 1000000.0 / fps : 0.0;
+	start_us_ = utils::TimeMicros();
+	due_index_ = 0;
+}
+
+void FrameClock::Stop() {
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		running_ = false;
+	}
+	condition_.notify_all();
+}
+
+bool FrameClock::Wait() {
+	std::unique_lock<std::mutex> lock(mutex_);
+	if (running_ && interval_us_ > 0.0) {
+		int64_t due_us = start_us_ + static_cast<int64_t>(due_index_ * interval_us_);
+		int64_t now_us = utils::TimeMicros();
+		if (now_us - due_us > interval_us_) {
+			start_us_ = now_us;
+			due_index_ = 0;
+			due_us = now_us;
+		}
+		if (due_us > now_us) {
+			condition_.wait_for(lock, std::chrono::microseconds(due_us - now_us), [this]() { return !running_; });
+		}
+	}
+	if (!running_) {
+		return false;
+	}
+	++due_index_;
+	return true;
+}
+
+double FrameClock::Fps() const {
+	return fps_;
+}
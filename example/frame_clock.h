@@ -0,0 +1,34 @@
+#pragma once
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+
+// Paces a producer loop to a fixed frame rate. Frames are due on a fixed grid
+// from Start(); falling more than a frame behind restarts the grid instead of
+// bursting to catch up. Stop() wakes a sleeping Wait() from any thread.
+class FrameClock {
+public:
+	FrameClock();
+	~FrameClock();
+
+	// 0 fps never sleeps, for free-running producers.
+	void Start(double fps);
+	void Stop();
+
+	// Sleeps until the next frame is due. Returns false once stopped.
+	bool Wait();
+
+	double Fps() const;
+
+private:
+	FrameClock(const FrameClock&) = delete;
+	FrameClock operator =(const FrameClock&) = delete;
+
+	std::mutex mutex_{};
+	std::condition_variable condition_{};
+	bool running_{};
+	double fps_{};
+	double interval_us_{};
+	int64_t start_us_{};
+	uint64_t due_index_{};
+};
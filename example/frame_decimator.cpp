@@ -0,0 +1,101 @@
+#include "frame_decimator.h"
+
+#include <cmath>
+
+namespace {
+
+// Weight of the newest interval in the running averages, about the last 16
+// frames.
+const double kAverageWeight = 1.0 / 16.0;
+
+void UpdateAverage(double& average, double value) {
+	average = average > 0.0 ? average + (value - average) * kAverageWeight : value;
+}
+
+}
+
+FrameDecimator::FrameDecimator() {
+
+}
+
+FrameDecimator::~FrameDecimator() {
+
+}
+
+void FrameDecimator::SetTargetFps(double fps) {
+	std::lock_guard<std::mutex> lock(mutex_);
+	target_fps_ = fps > 0.0 ? fps : 0.0;
+	interval_us_ = fps > 0.0 ? 1000000.0 / fps : 0.0;
+	started_ = false;
+	output_jitter_us_ = 0.0;
+}
+
+double FrameDecimator::TargetFps() const {
+	std::lock_guard<std::mutex> lock(mutex_);
+	return target_fps_;
+}
+
+bool FrameDecimator::ShouldKeep(int64_t timestamp_us) {
+	std::lock_guard<std::mutex> lock(mutex_);
+	++frames_in_;
+	if (last_input_us_ && timestamp_us > last_input_us_) {
+		UpdateAverage(input_interval_us_, static_cast<double>(timestamp_us - last_input_us_));
+	}
+	last_input_us_ = timestamp_us;
+	if (interval_us_ > 0.0) {
+		// Half a source interval early still counts as due; without a measured
+		// source rate, a quarter of the target interval.
+		double margin = input_interval_us_ > 0.0 ? input_interval_us_ / 2.0 : interval_us_ / 4.0;
+		if (margin > interval_us_ / 2.0) {
+			margin = interval_us_ / 2.0;
+		}
+		double time_us = static_cast<double>(timestamp_us);
+		// Timestamps that jump back by more than a frame mean a new stream.
+		if (started_ && time_us + interval_us_ < next_due_us_ - interval_us_) {
+			started_ = false;
+		}
+		if (started_ && time_us + margin < next_due_us_) {
+			return false;
+		}
+		next_due_us_ = started_ ? next_due_us_ + interval_us_ : time_us + interval_us_;
+		if (next_due_us_ <= time_us + margin) {
+			next_due_us_ = time_us + interval_us_;
+		}
+		started_ = true;
+	}
+	++frames_out_;
+	if (last_output_us_ && timestamp_us > last_output_us_) {
+		double interval = static_cast<double>(timestamp_us - last_output_us_);
+		UpdateAverage(output_interval_us_, interval);
+		if (interval_us_ > 0.0) {
+			UpdateAverage(output_jitter_us_, std::fabs(interval - interval_us_));
+		}
+	}
+	last_output_us_ = timestamp_us;
+	return true;
+}
+
+FrameRateStats FrameDecimator::Stats() const {
+	std::lock_guard<std::mutex> lock(mutex_);
+	FrameRateStats stats;
+	stats.frames_in = frames_in_;
+	stats.frames_out = frames_out_;
+	stats.frames_dropped = frames_in_ - frames_out_;
+	stats.target_fps = target_fps_;
+	stats.input_fps = input_interval_us_ > 0.0 ? 1000000.0 / input_interval_us_ : 0.0;
+	stats.output_fps = output_interval_us_ > 0.0 ? 1000000.0 / output_interval_us_ : 0.0;
+	stats.output_jitter_us = output_jitter_us_;
+	return stats;
+}
+
+void FrameDecimator::Reset() {
+	std::lock_guard<std::mutex> lock(mutex_);
+	started_ = false;
+	last_input_us_ = 0;
+	last_output_us_ = 0;
+	input_interval_us_ = 0.0;
+	output_interval_us_ = 0.0;
+	output_jitter_us_ = 0.0;
+	frames_in_ = 0;
+	frames_out_ = 0;
+}
@@ -0,0 +1,56 @@
+#pragma once
+#include <cstdint>
+#include <mutex>
+
+struct FrameRateStats {
+	uint64_t frames_in;
+	uint64_t frames_out;
+	uint64_t frames_dropped;
+	double target_fps;
+	// Recent rates from capture timestamps, 0 until two frames were seen.
+	double input_fps;
+	double output_fps;
+	// Recent mean distance of output intervals from the target interval.
+	double output_jitter_us;
+};
+
+// Thins a stream to a target rate by capture timestamp, not by counting: kept
+// frames sit on an even grid of 1/fps, so 30 -> 10 fps keeps every third frame
+// and 30 -> 12 fps alternates gaps of two and three frames instead of drifting.
+// A frame counts as due when it is nearer to the grid point than the next
+// source frame would be, which absorbs timestamp jitter. Gaps and sources
+// slower than the target restart the grid, so nothing is dropped to catch up.
+//
+// ShouldKeep() is meant to run on the capture thread before a sample is
+// locked or copied; all calls are thread safe.
+class FrameDecimator {
+public:
+	FrameDecimator();
+	~FrameDecimator();
+
+	// 0 keeps every frame. Restarts the grid but keeps the counters.
+	void SetTargetFps(double fps);
+	double TargetFps() const;
+
+	bool ShouldKeep(int64_t timestamp_us);
+
+	FrameRateStats Stats() const;
+	void Reset();
+
+private:
+	FrameDecimator(const FrameDecimator&) = delete;
+	FrameDecimator operator =(const FrameDecimator&) = delete;
+
+	mutable std::mutex mutex_{};
+	double target_fps_{};
+	double interval_us_{};
+	bool started_{};
+	double next_due_us_{};
+	int64_t last_input_us_{};
+	int64_t last_output_us_{};
+	double input_interval_us_{};
+	double output_interval_us_{};
+	double output_jitter_us_{};
+	uint64_t frames_in_{};
+	uint64_t frames_out_{};
+};
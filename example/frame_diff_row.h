@@ -0,0 +1,40 @@
+#pragma once
+#include <cstdint>
+
+#include "cpu_features.h"
+
+// Row kernels behind FrameChangeDetector. All variants return exactly the
+// same sums; SIMD versions finish the tail with the _C version.
+
+// Pixels per block of a luma thumbnail row.
+static const int kFrameDiffBlockWidth = 16;
+
+// Adds the sum of each run of kFrameDiffBlockWidth pixels of |src| to
+// sums[0..blocks).
+typedef void (*FrameDiffBlockSumFunction)(const uint8_t* src, uint32_t* sums, int blocks);
+// Sum of absolute differences of |count| bytes; raises |*max_difference| to
+// the largest single one.
+typedef uint32_t (*FrameDiffSadFunction)(const uint8_t* a, const uint8_t* b, int count, uint8_t* max_difference);
+
+struct FrameDiffRowFunctions {
+	FrameDiffBlockSumFunction block_sum;
+	FrameDiffSadFunction sad;
+};
+
+FrameDiffRowFunctions GetFrameDiffRowFunctions(int cpu_flags);
+
+void FrameDiffBlockSum_C(const uint8_t* src, uint32_t* sums, int blocks);
+uint32_t FrameDiffSad_C(const uint8_t* a, const uint8_t* b, int count, uint8_t* max_difference);
+
+#if defined(HAS_X86_SIMD)
+void FrameDiffBlockSum_SSE2(const uint8_t* src, uint32_t* sums, int blocks);
+uint32_t FrameDiffSad_SSE2(const uint8_t* a, const uint8_t* b, int count, uint8_t* max_difference);
+
+void FrameDiffBlockSum_AVX2(const uint8_t* src, uint32_t* sums, int blocks);
+uint32_t FrameDiffSad_AVX2(const uint8_t* a, const uint8_t* b, int count, uint8_t* max_difference);
+#endif
+
+#if defined(HAS_NEON_SIMD)
+void FrameDiffBlockSum_NEON(const uint8_t* src, uint32_t* sums, int blocks);
+uint32_t FrameDiffSad_NEON(const uint8_t* a, const uint8_t* b, int count, uint8_t* max_difference);
+#endif
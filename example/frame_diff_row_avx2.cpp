@@ -0,0 +1,53 @@
+#include "frame_diff_row.h"
+
+// Built with AVX2 code generation enabled, only called when the CPU has it.
+#if defined(HAS_X86_SIMD)
+#include <immintrin.h>
+
+namespace {
+
+__m256i LoadU(const uint8_t* src) {
+	return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src));
+}
+
+}
+
+void FrameDiffBlockSum_AVX2(const uint8_t* src, uint32_t* sums, int blocks) {
+	const __m256i zero = _mm256_setzero_si256();
+	int block = 0;
+	for (; block + 2 <= blocks; block += 2) {
+		// One psadbw covers two blocks, each as two 64-bit halves.
+		__m256i sad = _mm256_sad_epu8(LoadU(src), zero);
+		sad = _mm256_add_epi32(sad, _mm256_srli_si256(sad, 8));
+		sums[block] += static_cast<uint32_t>(_mm_cvtsi128_si32(_mm256_castsi256_si128(sad)));
+		sums[block + 1] += static_cast<uint32_t>(_mm_cvtsi128_si32(_mm256_extracti128_si256(sad, 1)));
+		src += 2 * kFrameDiffBlockWidth;
+	}
+	FrameDiffBlockSum_C(src, sums + block, blocks - block);
+}
+
+uint32_t FrameDiffSad_AVX2(const uint8_t* a, const uint8_t* b, int count, uint8_t* max_difference) {
+	__m256i sums = _mm256_setzero_si256();
+	__m256i max = _mm256_setzero_si256();
+	int i = 0;
+	for (; i + 32 <= count; i += 32) {
+		__m256i x = LoadU(a + i);
+		__m256i y = LoadU(b + i);
+		sums = _mm256_add_epi64(sums, _mm256_sad_epu8(x, y));
+		max = _mm256_max_epu8(max, _mm256_or_si256(_mm256_subs_epu8(x, y), _mm256_subs_epu8(y, x)));
+	}
+	__m128i half = _mm_add_epi64(_mm256_castsi256_si128(sums), _mm256_extracti128_si256(sums, 1));
+	uint32_t sad = static_cast<uint32_t>(_mm_cvtsi128_si32(_mm_add_epi32(half, _mm_srli_si128(half, 8))));
+	__m128i max_half = _mm_max_epu8(_mm256_castsi256_si128(max), _mm256_extracti128_si256(max, 1));
+	max_half = _mm_max_epu8(max_half, _mm_srli_si128(max_half, 8));
+	max_half = _mm_max_epu8(max_half, _mm_srli_si128(max_half, 4));
+	max_half = _mm_max_epu8(max_half, _mm_srli_si128(max_half, 2));
+	max_half = _mm_max_epu8(max_half, _mm_srli_si128(max_half, 1));
+	uint8_t lane = static_cast<uint8_t>(_mm_cvtsi128_si32(max_half));
+	if (lane > *max_difference) {
+		*max_difference = lane;
+	}
+	return sad + FrameDiffSad_C(a + i, b + i, count - i, max_difference);
+}
+
+#endif
@@ -0,0 +1,24 @@
+#include "frame_diff_row.h"
+
+void FrameDiffBlockSum_C(const uint8_t* src, uint32_t* sums, int blocks) {
+	for (int block = 0; block < blocks; ++block) {
+		uint32_t sum = 0;
+		for (int x = 0; x < kFrameDiffBlockWidth; ++x) {
+			sum += src[x];
+		}
+		sums[block] += sum;
+		src += kFrameDiffBlockWidth;
+	}
+}
+
+uint32_t FrameDiffSad_C(const uint8_t* a, const uint8_t* b, int count, uint8_t* max_difference) {
+	uint32_t sad = 0;
+	uint8_t max = *max_difference;
+	for (int i = 0; i < count; ++i) {
+		uint8_t difference = static_cast<uint8_t>(a[i] > b[i] ? a[i] - b[i] : b[i] - a[i]);
+		sad += difference;
+		max = difference > max ? difference : max;
+	}
+	*max_difference = max;
+	return sad;
+}
@@ -0,0 +1,42 @@
+#include "frame_diff_row.h"
+
+#if defined(HAS_NEON_SIMD)
+#include <arm_neon.h>
+
+namespace {
+
+uint32_t AddLanes(uint32x4_t sums) {
+	uint64x2_t pairs = vpaddlq_u32(sums);
+	return static_cast<uint32_t>(vgetq_lane_u64(pairs, 0) + vgetq_lane_u64(pairs, 1));
+}
+
+}
+
+void FrameDiffBlockSum_NEON(const uint8_t* src, uint32_t* sums, int blocks) {
+	for (int block = 0; block < blocks; ++block) {
+		sums[block] += AddLanes(vpaddlq_u16(vpaddlq_u8(vld1q_u8(src))));
+		src += kFrameDiffBlockWidth;
+	}
+}
+
+uint32_t FrameDiffSad_NEON(const uint8_t* a, const uint8_t* b, int count, uint8_t* max_difference) {
+	uint32x4_t sums = vdupq_n_u32(0);
+	uint8x16_t max = vdupq_n_u8(0);
+	int i = 0;
+	for (; i + 16 <= count; i += 16) {
+		uint8x16_t difference = vabdq_u8(vld1q_u8(a + i), vld1q_u8(b + i));
+		sums = vpadalq_u16(sums, vpaddlq_u8(difference));
+		max = vmaxq_u8(max, difference);
+	}
+	uint8x8_t max_half = vpmax_u8(vget_low_u8(max), vget_high_u8(max));
+	max_half = vpmax_u8(max_half, max_half);
+	max_half = vpmax_u8(max_half, max_half);
+	max_half = vpmax_u8(max_half, max_half);
+	uint8_t lane = vget_lane_u8(max_half, 0);
+	if (lane > *max_difference) {
+		*max_difference = lane;
+	}
+	return AddLanes(sums) + FrameDiffSad_C(a + i, b + i, count - i, max_difference);
+}
+
+#endif
@@ -0,0 +1,50 @@
+#include "frame_diff_row.h"
+
+#if defined(HAS_X86_SIMD)
+#include <emmintrin.h>
+
+namespace {
+
+__m128i LoadU(const uint8_t* src) {
+	return _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+}
+
+// Adds the two 64-bit halves of a psadbw result.
+uint32_t AddHalves(__m128i sums) {
+	return static_cast<uint32_t>(_mm_cvtsi128_si32(_mm_add_epi32(sums, _mm_srli_si128(sums, 8))));
+}
+
+uint8_t MaxByte(__m128i value, uint8_t max) {
+	value = _mm_max_epu8(value, _mm_srli_si128(value, 8));
+	value = _mm_max_epu8(value, _mm_srli_si128(value, 4));
+	value = _mm_max_epu8(value, _mm_srli_si128(value, 2));
+	value = _mm_max_epu8(value, _mm_srli_si128(value, 1));
+	uint8_t lane = static_cast<uint8_t>(_mm_cvtsi128_si32(value));
+	return lane > max ? lane : max;
+}
+
+}
+
+void FrameDiffBlockSum_SSE2(const uint8_t* src, uint32_t* sums, int blocks) {
+	const __m128i zero = _mm_setzero_si128();
+	for (int block = 0; block < blocks; ++block) {
+		sums[block] += AddHalves(_mm_sad_epu8(LoadU(src), zero));
+		src += kFrameDiffBlockWidth;
+	}
+}
+
+uint32_t FrameDiffSad_SSE2(const uint8_t* a, const uint8_t* b, int count, uint8_t* max_difference) {
+	__m128i sums = _mm_setzero_si128();
+	__m128i max = _mm_setzero_si128();
+	int i = 0;
+	for (; i + 16 <= count; i += 16) {
+		__m128i x = LoadU(a + i);
+		__m128i y = LoadU(b + i);
+		sums = _mm_add_epi64(sums, _mm_sad_epu8(x, y));
+		max = _mm_max_epu8(max, _mm_or_si128(_mm_subs_epu8(x, y), _mm_subs_epu8(y, x)));
+	}
+	*max_difference = MaxByte(max, *max_difference);
+	return AddHalves(sums) + FrameDiffSad_C(a + i, b + i, count - i, max_difference);
+}
+
+#endif
@@ -0,0 +1,295 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <new>
+#include <utility>
+
+#include "video_frame_buffer.h"
+
+enum FrameQueuePolicy {
+	// Push on a full queue throws the oldest queued item away.
+	kFrameQueueDropOldest,
+	// Push on a full queue throws the new item away.
+	kFrameQueueDropNewest,
+	// Push on a full queue waits for a consumer.
+	kFrameQueueBlock,
+};
+
+struct FrameQueueStats {
+	uint64_t pushed;
+	uint64_t popped;
+	uint64_t dropped;
+	size_t depth;
+	size_t max_depth;
+};
+
+// Bounded lock-free ring (Vyukov's array queue) for handing frames from the
+// capture callback to consumer threads. Any number of producers and consumers
+// may use it; a drop-oldest producer acts as a consumer for the evicted item.
+// Push and TryPop never take a lock. Threads only touch the mutex when they
+// have to sleep in a blocking Push or Pop, or to wake such a sleeper.
+template<class T>
+class FrameQueue {
+public:
+	// |capacity| is rounded up to a power of two, and to at least 2: with a
+	// single cell a full slot's sequence equals the free sequence of the next
+	// lap, so a second push would overwrite the unconsumed item.
+	explicit FrameQueue(size_t capacity = 4, FrameQueuePolicy policy = kFrameQueueDropOldest)
+		: policy_(policy) {
+		size_t size = 2;
+		while (size < capacity) {
+			size <<= 1;
+		}
+		mask_ = size - 1;
+		cells_ = static_cast<Cell*>(AlignedMalloc(sizeof(Cell) * size, alignof(Cell)));
+		if (!cells_) {
+			throw std::bad_alloc();
+		}
+		for (size_t i = 0; i < size; ++i) {
+			new (&cells_[i]) Cell();
+			cells_[i].sequence.store(i, std::memory_order_relaxed);
+		}
+	}
+
+	~FrameQueue() {
+		for (size_t i = 0; i <= mask_; ++i) {
+			cells_[i].~Cell();
+		}
+		AlignedFree(cells_);
+	}
+
+	// Returns false when |item| was dropped or the queue is closed. With
+	// kFrameQueueDropOldest the push itself always succeeds.
+	bool Push(T item) {
+		for (;;) {
+			if (closed_.load(std::memory_order_acquire)) {
+				dropped_.fetch_add(1, std::memory_order_relaxed);
+				return false;
+			}
+			if (TryEnqueue(item)) {
+				Pushed();
+				return true;
+			}
+			switch (policy_) {
+			case kFrameQueueDropNewest:
+				dropped_.fetch_add(1, std::memory_order_relaxed);
+				return false;
+			case kFrameQueueDropOldest: {
+				T oldest;
+				if (TryDequeue(oldest)) {
+					popped_or_evicted_.fetch_add(1, std::memory_order_relaxed);
+					dropped_.fetch_add(1, std::memory_order_relaxed);
+				}
+				break;
+			}
+			case kFrameQueueBlock:
+				Wait([this]() {
+					return closed_.load(std::memory_order_acquire) || !Full();
+				});
+				break;
+			}
+		}
+	}
+
+	bool TryPop(T& item) {
+		if (!TryDequeue(item)) {
+			return false;
+		}
+		popped_or_evicted_.fetch_add(1, std::memory_order_relaxed);
+		popped_.fetch_add(1, std::memory_order_relaxed);
+		Notify();
+		return true;
+	}
+
+	// Waits up to |timeout| for an item. Returns false on timeout or once the
+	// queue is closed and drained.
+	template<class Rep, class Period>
+	bool Pop(T& item, const std::chrono::duration<Rep, Period>& timeout) {
+		std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + timeout;
+		for (;;) {
+			if (TryPop(item)) {
+				return true;
+			}
+			if (closed_.load(std::memory_order_acquire)) {
+				return false;
+			}
+			if (!WaitUntil(deadline, [this]() {
+				return closed_.load(std::memory_order_acquire) || !Empty();
+			})) {
+				return TryPop(item);
+			}
+		}
+	}
+
+	// Wakes every waiter; later pushes are refused and pops drain what is left.
+	void Close() {
+		closed_.store(true, std::memory_order_release);
+		std::lock_guard<std::mutex> lock(mutex_);
+		condition_.notify_all();
+	}
+
+	void Reopen() {
+		closed_.store(false, std::memory_order_release);
+	}
+
+	bool Closed() const {
+		return closed_.load(std::memory_order_acquire);
+	}
+
+	FrameQueuePolicy Policy() const {
+		return policy_;
+	}
+
+	size_t Capacity() const {
+		return mask_ + 1;
+	}
+
+	// Approximate while producers or consumers are active.
+	size_t Size() const {
+		uint64_t pushed = pushed_.load(std::memory_order_acquire);
+		uint64_t removed = popped_or_evicted_.load(std::memory_order_acquire);
+		size_t depth = pushed > removed ? static_cast<size_t>(pushed - removed) : 0;
+		return depth < Capacity() ? depth : Capacity();
+	}
+
+	FrameQueueStats Stats() const {
+		FrameQueueStats stats;
+		stats.pushed = pushed_.load(std::memory_order_relaxed);
+		stats.popped = popped_.load(std::memory_order_relaxed);
+		stats.dropped = dropped_.load(std::memory_order_relaxed);
+		stats.depth = Size();
+		stats.max_depth = max_depth_.load(std::memory_order_relaxed);
+		return stats;
+	}
+
+private:
+	// Each cell sits on its own cache line so producers and consumers working
+	// on neighbouring slots do not false-share.
+	struct alignas(64) Cell {
+		std::atomic<size_t> sequence;
+		T item;
+	};
+
+	FrameQueue(const FrameQueue&) = delete;
+	FrameQueue operator =(const FrameQueue&) = delete;
+
+	bool TryEnqueue(T& item) {
+		size_t position = enqueue_position_.load(std::memory_order_relaxed);
+		for (;;) {
+			Cell& cell = cells_[position & mask_];
+			size_t sequence = cell.sequence.load(std::memory_order_acquire);
+			intptr_t difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+			if (difference == 0) {
+				if (enqueue_position_.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+					cell.item = std::move(item);
+					cell.sequence.store(position + 1, std::memory_order_release);
+					return true;
+				}
+			}
+			else if (difference < 0) {
+				return false;
+			}
+			else {
+				position = enqueue_position_.load(std::memory_order_relaxed);
+			}
+		}
+	}
+
+	bool TryDequeue(T& item) {
+		size_t position = dequeue_position_.load(std::memory_order_relaxed);
+		for (;;) {
+			Cell& cell = cells_[position & mask_];
+			size_t sequence = cell.sequence.load(std::memory_order_acquire);
+			intptr_t difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position + 1);
+			if (difference == 0) {
+				if (dequeue_position_.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+					// Move out and reset so the cell does not keep a frame alive.
+					item = std::move(cell.item);
+					cell.item = T();
+					cell.sequence.store(position + mask_ + 1, std::memory_order_release);
+					return true;
+				}
+			}
+			else if (difference < 0) {
+				return false;
+			}
+			else {
+				position = dequeue_position_.load(std::memory_order_relaxed);
+			}
+		}
+	}
+
+	bool Empty() const {
+		size_t position = dequeue_position_.load(std::memory_order_acquire);
+		return cells_[position & mask_].sequence.load(std::memory_order_acquire) != position + 1;
+	}
+
+	bool Full() const {
+		size_t position = enqueue_position_.load(std::memory_order_acquire);
+		return cells_[position & mask_].sequence.load(std::memory_order_acquire) != position;
+	}
+
+	void Pushed() {
+		pushed_.fetch_add(1, std::memory_order_acq_rel);
+		size_t depth = Size();
+		size_t max_depth = max_depth_.load(std::memory_order_relaxed);
+		while (depth > max_depth && !max_depth_.compare_exchange_weak(max_depth, depth, std::memory_order_relaxed)) {
+		}
+		Notify();
+	}
+
+	// A sleeper registers in |waiters_| under the mutex before re-checking its
+	// condition, so a state change either is seen by that check or finds the
+	// waiter and notifies it.
+	void Notify() {
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (waiters_.load(std::memory_order_seq_cst) == 0) {
+			return;
+		}
+		std::lock_guard<std::mutex> lock(mutex_);
+		condition_.notify_all();
+	}
+
+	template<class Predicate>
+	void Wait(Predicate ready) {
+		std::unique_lock<std::mutex> lock(mutex_);
+		waiters_.fetch_add(1, std::memory_order_seq_cst);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		condition_.wait(lock, ready);
+		waiters_.fetch_sub(1, std::memory_order_relaxed);
+	}
+
+	template<class Predicate>
+	bool WaitUntil(const std::chrono::steady_clock::time_point& deadline, Predicate ready) {
+		std::unique_lock<std::mutex> lock(mutex_);
+		waiters_.fetch_add(1, std::memory_order_seq_cst);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		bool result = condition_.wait_until(lock, deadline, ready);
+		waiters_.fetch_sub(1, std::memory_order_relaxed);
+		return result;
+	}
+
+	FrameQueuePolicy policy_;
+	size_t mask_{};
+	Cell* cells_{};
+	// Padding keeps the producer and consumer indices on separate cache lines
+	// without over-aligning the queue itself, which C++11 new cannot honour.
+	char padding0_[64]{};
+	std::atomic<size_t> enqueue_position_{ 0 };
+	char padding1_[64]{};
+	std::atomic<size_t> dequeue_position_{ 0 };
+	char padding2_[64]{};
+	std::atomic<uint64_t> pushed_{ 0 };
+	std::atomic<uint64_t> popped_{ 0 };
+	std::atomic<uint64_t> popped_or_evicted_{ 0 };
+	std::atomic<uint64_t> dropped_{ 0 };
+	std::atomic<size_t> max_depth_{ 0 };
+	std::atomic<bool> closed_{ false };
+	std::atomic<int> waiters_{ 0 };
+	std::mutex mutex_{};
+	std::condition_variable condition_{};
+};
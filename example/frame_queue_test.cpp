@@ -0,0 +1,75 @@
+// FrameQueue drop policies, capacity rounding and close semantics.
+#include <chrono>
+#include <thread>
+
+#include "frame_queue.h"
+#include "test_check.h"
+
+namespace {
+
+// Capacity 1 used to give a one-cell ring that accepted a second push over
+// the unconsumed item and then spun forever in TryPop.
+void TestCapacityOne() {
+	FrameQueue<int> queue(1, kFrameQueueDropNewest);
+	CHECK(queue.Capacity() == 2);
+	CHECK(queue.Push(1));
+	CHECK(queue.Push(2));
+	CHECK(!queue.Push(3));
+	int item = 0;
+	CHECK(queue.TryPop(item) && item == 1);
+	CHECK(queue.TryPop(item) && item == 2);
+	CHECK(!queue.TryPop(item));
+	CHECK(queue.Stats().dropped == 1);
+}
+
+void TestDropOldest() {
+	FrameQueue<int> queue(1, kFrameQueueDropOldest);
+	for (int i = 1; i <= 5; ++i) {
+		CHECK(queue.Push(i));
+	}
+	int item = 0;
+	CHECK(queue.TryPop(item) && item == 4);
+	CHECK(queue.TryPop(item) && item == 5);
+	CHECK(!queue.TryPop(item));
+	CHECK(queue.Stats().dropped == 3);
+}
+
+void TestRounding() {
+	FrameQueue<int> queue(5, kFrameQueueDropNewest);
+	CHECK(queue.Capacity() == 8);
+	for (int i = 0; i < 8; ++i) {
+		CHECK(queue.Push(i));
+	}
+	CHECK(!queue.Push(8));
+	CHECK(queue.Size() == 8);
+}
+
+void TestBlockAndClose() {
+	FrameQueue<int> queue(2, kFrameQueueBlock);
+	CHECK(queue.Push(1));
+	CHECK(queue.Push(2));
+	std::thread consumer([&queue]() {
+		std::this_thread::sleep_for(std::chrono::milliseconds(20));
+		int item = 0;
+		queue.TryPop(item);
+	});
+	// Waits for the consumer to make room.
+	CHECK(queue.Push(3));
+	consumer.join();
+	queue.Close();
+	CHECK(!queue.Push(4));
+	int item = 0;
+	CHECK(queue.Pop(item, std::chrono::milliseconds(10)) && item == 2);
+	CHECK(queue.Pop(item, std::chrono::milliseconds(10)) && item == 3);
+	CHECK(!queue.Pop(item, std::chrono::milliseconds(10)));
+}
+
+}
+
+int main() {
+	TestCapacityOne();
+	TestDropOldest();
+	TestRounding();
+	TestBlockAndClose();
+	return test::Result();
+}
@@ -0,0 +1,345 @@
+#include "frame_recorder.h"
+
+#include <cmath>
+#include <cstdio>
+
+namespace {
+
+const char kY4mFrameHeader[] = "FRAME\n";
+
+// Bytes before the first frame chunk of an AVI file: RIFF, hdrl and the movi
+// list header. The movi fourcc idx1 offsets count from sits 4 bytes earlier.
+const uint32_t kAviHeaderSize = 224;
+const uint32_t kAviMoviOffset = 220;
+const uint32_t kAviTotalFramesOffset = 48;
+const uint32_t kAviSuggestedBufferOffset = 60;
+const uint32_t kAviStreamLengthOffset = 140;
+const uint32_t kAviStreamBufferOffset = 144;
+const uint32_t kAviMoviSizeOffset = 216;
+const uint32_t kAviHasIndex = 0x10;
+const uint32_t kAviKeyFrame = 0x10;
+// Chunk header, padding and idx1 entry a frame adds beyond its data.
+const uint64_t kAviFrameOverhead = 8 + 1 + 16;
+
+void PutU16(std::string& data, uint16_t value) {
+	data += static_cast<char>(value & 0xff);
+	data += static_cast<char>(value >> 8);
+}
+
+void PutU32(std::string& data, uint32_t value) {
+	for (int i = 0; i < 4; ++i) {
+		data += static_cast<char>((value >> (i * 8)) & 0xff);
+	}
+}
+
+std::string U32(uint32_t value) {
+	std::string data;
+	PutU32(data, value);
+	return data;
+}
+
+// Y4M wants the rate as a ratio; NTSC style rates get their 1001 back.
+void Y4mRate(double fps, unsigned& numerator, unsigned& denominator) {
+	if (fps <= 0.0) {
+		fps = 30.0;
+	}
+	unsigned ntsc = static_cast<unsigned>(fps * 1.001 + 0.5);
+	if (fps != floor(fps) && fabs(fps * 1.001 - ntsc) < 0.01) {
+		numerator = ntsc * 1000;
+		denominator = 1001;
+		return;
+	}
+	numerator = static_cast<unsigned>(fps * 1000.0 + 0.5);
+	denominator = 1000;
+	if (numerator % 1000 == 0) {
+		numerator /= 1000;
+		denominator = 1;
+	}
+}
+
+}
+
+FrameRecorder::FrameRecorder() {
+
+}
+
+FrameRecorder::~FrameRecorder() {
+	Close();
+}
+
+bool FrameRecorder::Open(const std::string& path, RecordingFormat format, double fps,
+	const AsyncFileWriterOptions& options) {
+	Close();
+	format_ = format;
+	fps_ = fps;
+	started_ = false;
+	offset_ = 0;
+	avi_index_.clear();
+	max_frame_size_ = 0;
+	frames_recorded_ = 0;
+	frames_dropped_ = 0;
+	frames_rejected_ = 0;
+	if (!writer_.Open(path, options)) {
+		return false;
+	}
+	// Index lines are tiny; a small buffered file is plenty.
+	AsyncFileWriterOptions index_options;
+	index_options.buffer_size = 64 << 10;
+	index_options.queue_capacity = options.queue_capacity;
+	index_options.policy = options.policy;
+	if (!index_writer_.Open(path + ".idx", index_options)) {
+		writer_.Close();
+		return false;
+	}
+	return true;
+}
+
+bool FrameRecorder::Close() {
+	bool ok = true;
+	if (format_ == kRecordingFormatAvi && started_ && writer_.IsOpen()) {
+		std::string index = "idx1";
+		PutU32(index, static_cast<uint32_t>(avi_index_.size()));
+		index += avi_index_;
+		ok = writer_.Close(index, AviPatches());
+	}
+	else {
+		ok = writer_.Close();
+	}
+	started_ = false;
+	avi_index_.clear();
+	return index_writer_.Close() && ok;
+}
+
+bool FrameRecorder::AddFrame(const VideoFrame& video_frame) {
+	if (!writer_.IsOpen()) {
+		return false;
+	}
+	if (!started_) {
+		VideoDescription description;
+		description.width = video_frame.width;
+		description.height = video_frame.height;
+		description.fps = static_cast<uint32_t>(fps_ + 0.5);
+		description.video_type = video_frame.video_type;
+		bool planar420 = description.video_type == kVideoTypeI420 || description.video_type == kVideoTypeIYUV ||
+			description.video_type == kVideoTypeYV12;
+		bool mjpeg = description.video_type == kVideoTypeMJPEG;
+		if (mjpeg != IsCompressed() || (format_ == kRecordingFormatY4m && !planar420) ||
+			!GetVideoFrameLayout(description, 1, layout_)) {
+			++frames_rejected_;
+			return false;
+		}
+		description_ = description;
+	}
+	else if (video_frame.width != description_.width || video_frame.height != description_.height ||
+		video_frame.video_type != description_.video_type) {
+		++frames_rejected_;
+		return false;
+	}
+
+	WriteRequest request;
+	uint32_t compressed_size = video_frame.compressed_size;
+	if (IsCompressed() && (compressed_size == 0 || !video_frame.y_data)) {
+		++frames_rejected_;
+		return false;
+	}
+	if (format_ == kRecordingFormatAvi) {
+		if (!started_) {
+			request.prefix = AviHeader();
+		}
+		uint64_t file_size = offset_ + request.prefix.size() + avi_index_.size() + 8;
+		if (file_size + compressed_size + kAviFrameOverhead > UINT32_MAX) {
+			++frames_rejected_;
+			return false;
+		}
+		request.prefix += "00dc";
+		PutU32(request.prefix, compressed_size);
+		request.AddRegion(video_frame.y_data, compressed_size, compressed_size, 1);
+		// Chunks start on even offsets.
+		if (compressed_size & 1) {
+			request.suffix.assign(1, '\0');
+		}
+	}
+	else if (format_ == kRecordingFormatMjpeg) {
+		request.AddRegion(video_frame.y_data, compressed_size, compressed_size, 1);
+	}
+	else if (format_ == kRecordingFormatY4m) {
+		if (!started_) {
+			unsigned numerator = 0;
+			unsigned denominator = 0;
+			Y4mRate(fps_, numerator, denominator);
+			char header[128];
+			snprintf(header, sizeof(header), "YUV4MPEG2 W%u H%u F%u:%u Ip A1:1 C420jpeg\n", description_.width,
+				description_.height, numerator, denominator);
+			request.prefix = header;
+		}
+		request.prefix += kY4mFrameHeader;
+	}
+	if (!IsCompressed() && !AddRegions(video_frame, request)) {
+		++frames_rejected_;
+		return false;
+	}
+	request.owner = video_frame.buffer;
+	uint64_t pixels_offset = offset_ + request.prefix.size();
+	uint64_t size = request.Size();
+	if (!writer_.Submit(request)) {
+		++frames_dropped_;
+		return false;
+	}
+	started_ = true;
+	offset_ += size;
+	if (format_ == kRecordingFormatAvi) {
+		uint64_t chunk_offset = pixels_offset - 8;
+		avi_index_ += "00dc";
+		PutU32(avi_index_, kAviKeyFrame);
+		PutU32(avi_index_, static_cast<uint32_t>(chunk_offset - kAviMoviOffset));
+		PutU32(avi_index_, compressed_size);
+		max_frame_size_ = compressed_size > max_frame_size_ ? compressed_size : max_frame_size_;
+	}
+
+	char line[80];
+	if (IsCompressed()) {
+		snprintf(line, sizeof(line), "%llu,%llu,%lld,%u\n", static_cast<unsigned long long>(frames_recorded_.load()),
+			static_cast<unsigned long long>(pixels_offset), static_cast<long long>(video_frame.timestamp_us),
+			compressed_size);
+	}
+	else {
+		snprintf(line, sizeof(line), "%llu,%llu,%lld\n", static_cast<unsigned long long>(frames_recorded_.load()),
+			static_cast<unsigned long long>(pixels_offset), static_cast<long long>(video_frame.timestamp_us));
+	}
+	WriteRequest index_request;
+	index_request.prefix = line;
+	index_writer_.Submit(index_request);
+	++frames_recorded_;
+	return true;
+}
+
+FrameRecorderStats FrameRecorder::Stats() const {
+	FrameRecorderStats stats;
+	stats.frames_recorded = frames_recorded_;
+	stats.frames_dropped = frames_dropped_;
+	stats.frames_rejected = frames_rejected_;
+	stats.file = writer_.Stats();
+	return stats;
+}
+
+bool FrameRecorder::AddRegions(const VideoFrame& video_frame, WriteRequest& request) const {
+	const VideoPlaneLayout* planes = layout_.planes;
+	if (!video_frame.y_data) {
+		return false;
+	}
+	request.AddRegion(video_frame.y_data, planes[0].stride, video_frame.y_stride, planes[0].height);
+	if (layout_.plane_count == 3) {
+		if (!video_frame.u_data || !video_frame.v_data) {
+			return false;
+		}
+		// Y4M is always U then V; raw keeps YV12's own order.
+		bool v_first = format_ == kRecordingFormatRaw && description_.video_type == kVideoTypeYV12;
+		const uint8_t* first = v_first ? video_frame.v_data : video_frame.u_data;
+		const uint8_t* second = v_first ? video_frame.u_data : video_frame.v_data;
+		request.AddRegion(first, planes[1].stride, v_first ? video_frame.v_stride : video_frame.u_stride,
+			planes[1].height);
+		request.AddRegion(second, planes[2].stride, v_first ? video_frame.u_stride : video_frame.v_stride,
+			planes[2].height);
+	}
+	else if (layout_.plane_count == 2) {
+		if (!video_frame.u_data || !video_frame.v_data) {
+			return false;
+		}
+		// The interleaved plane starts at whichever of U and V comes first.
+		const uint8_t* chroma = video_frame.u_data < video_frame.v_data ? video_frame.u_data : video_frame.v_data;
+		request.AddRegion(chroma, planes[1].stride, video_frame.u_stride, planes[1].height);
+	}
+	return true;
+}
+
+bool FrameRecorder::IsCompressed() const {
+	return format_ == kRecordingFormatMjpeg || format_ == kRecordingFormatAvi;
+}
+
+std::string FrameRecorder::AviHeader() const {
+	unsigned rate = 0;
+	unsigned scale = 0;
+	Y4mRate(fps_, rate, scale);
+	uint32_t width = description_.width;
+	uint32_t height = description_.height;
+	std::string header = "RIFF";
+	// Sizes, frame counts and buffer sizes are patched in by Close().
+	PutU32(header, 0);
+	header += "AVI LIST";
+	PutU32(header, 192);
+	header += "hdrlavih";
+	PutU32(header, 56);
+	PutU32(header, static_cast<uint32_t>(1000000.0 * scale / rate + 0.5));
+	PutU32(header, 0);
+	PutU32(header, 0);
+	PutU32(header, kAviHasIndex);
+	PutU32(header, 0);
+	PutU32(header, 0);
+	PutU32(header, 1);
+	PutU32(header, 0);
+	PutU32(header, width);
+	PutU32(header, height);
+	header.append(16, '\0');
+	header += "LIST";
+	PutU32(header, 116);
+	header += "strlstrh";
+	PutU32(header, 56);
+	header += "vidsMJPG";
+	PutU32(header, 0);
+	PutU16(header, 0);
+	PutU16(header, 0);
+	PutU32(header, 0);
+	PutU32(header, scale);
+	PutU32(header, rate);
+	PutU32(header, 0);
+	PutU32(header, 0);
+	PutU32(header, 0);
+	PutU32(header, UINT32_MAX);
+	PutU32(header, 0);
+	PutU16(header, 0);
+	PutU16(header, 0);
+	PutU16(header, static_cast<uint16_t>(width));
+	PutU16(header, static_cast<uint16_t>(height));
+	// BITMAPINFOHEADER of the decoded picture.
+	header += "strf";
+	PutU32(header, 40);
+	PutU32(header, 40);
+	PutU32(header, width);
+	PutU32(header, height);
+	PutU16(header, 1);
+	PutU16(header, 24);
+	header += "MJPG";
+	PutU32(header, width * height * 3);
+	header.append(16, '\0');
+	header += "LIST";
+	PutU32(header, 4);
+	header += "movi";
+	return header;
+}
+
+std::vector<FilePatch> FrameRecorder::AviPatches() const {
+	uint32_t frames = static_cast<uint32_t>(frames_recorded_.load());
+	uint32_t movi_size = static_cast<uint32_t>(offset_ - kAviMoviOffset);
+	uint32_t file_size = static_cast<uint32_t>(offset_ + 8 + avi_index_.size());
+	std::vector<FilePatch> patches;
+	FilePatch patch;
+	patch.offset = 4;
+	patch.data = U32(file_size - 8);
+	patches.push_back(patch);
+	patch.offset = kAviTotalFramesOffset;
+	patch.data = U32(frames);
+	patches.push_back(patch);
+	patch.offset = kAviSuggestedBufferOffset;
+	patch.data = U32(max_frame_size_ + 8);
+	patches.push_back(patch);
+	patch.offset = kAviStreamLengthOffset;
+	patch.data = U32(frames);
+	patches.push_back(patch);
+	patch.offset = kAviStreamBufferOffset;
+	patch.data = U32(max_frame_size_ + 8);
+	patches.push_back(patch);
+	patch.offset = kAviMoviSizeOffset;
+	patch.data = U32(movi_size);
+	patches.push_back(patch);
+	return patches;
+}
@@ -0,0 +1,88 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "async_file_writer.h"
+#include "video_frame.h"
+#include "video_frame_buffer.h"
+
+enum RecordingFormat {
+	// Frames back to back in their native plane order, no header. FileCapture
+	// replays them given the same description.
+	kRecordingFormatRaw,
+	// YUV4MPEG2, 4:2:0 input only (I420, IYUV or YV12).
+	kRecordingFormatY4m,
+	// The camera's JPEG frames back to back exactly as they arrived, for
+	// captures passing MJPEG through (SetMjpegDecodeType(kVideoTypeMJPEG)).
+	// Plays as a raw MJPEG stream; the .idx file has each frame's timing.
+	kRecordingFormatMjpeg,
+	// The same JPEG frames as chunks of an AVI file with an idx1 index,
+	// nominally at the |fps| given to Open(). AVI sizes are 32 bits, so frames
+	// that would take the file past 4 GB are rejected.
+	kRecordingFormatAvi,
+};
+
+struct FrameRecorderStats {
+	uint64_t frames_recorded;
+	// Frames the writer queue had no room for.
+	uint64_t frames_dropped;
+	// Frames refused for their format or for changing size mid-recording.
+	uint64_t frames_rejected;
+	AsyncFileWriterStats file;
+};
+
+// Records delivered frames without blocking the capture callback. AddFrame()
+// only takes a reference to the frame and queues it; an AsyncFileWriter thread
+// packs the planes into large sequential writes. Next to the recording,
+// <path>.idx gets one "frame,offset,timestamp_us" line per recorded frame,
+// where offset is the byte position of the frame's pixels; MJPEG and AVI
+// recordings add the frame's size in bytes as a fourth field. Compressed
+// frames are written as they came, never decoded.
+//
+// Frames are held until the I/O thread copies them, so a stalled disk drains
+// the capture's buffer pool rather than growing memory.
+class FrameRecorder {
+public:
+	FrameRecorder();
+	~FrameRecorder();
+
+	// |fps| only fills the Y4M and AVI rate; 0 writes 30. A full writer queue
+	// drops the new frame (see AsyncFileWriterOptions::policy), so offsets and
+	// the index only ever count frames that reach the file.
+	bool Open(const std::string& path, RecordingFormat format, double fps = 0.0,
+		const AsyncFileWriterOptions& options = AsyncFileWriterOptions());
+	bool Close();
+
+	// Call from one thread at a time, normally the frame callback. The first
+	// frame fixes the size and type of the recording.
+	bool AddFrame(const VideoFrame& video_frame);
+
+	FrameRecorderStats Stats() const;
+
+private:
+	FrameRecorder(const FrameRecorder&) = delete;
+	FrameRecorder operator =(const FrameRecorder&) = delete;
+
+	bool AddRegions(const VideoFrame& video_frame, WriteRequest& request) const;
+	bool IsCompressed() const;
+	std::string AviHeader() const;
+	// Sizes in the AVI header that are only known once the last frame is in.
+	std::vector<FilePatch> AviPatches() const;
+
+	RecordingFormat format_{ kRecordingFormatRaw };
+	double fps_{};
+	AsyncFileWriter writer_{};
+	AsyncFileWriter index_writer_{};
+	VideoDescription description_{};
+	VideoFrameLayout layout_{};
+	bool started_{};
+	uint64_t offset_{};
+	// AVI only: idx1 entries so far and the largest frame chunk.
+	std::string avi_index_{};
+	uint32_t max_frame_size_{};
+	std::atomic<uint64_t> frames_recorded_{ 0 };
+	std::atomic<uint64_t> frames_dropped_{ 0 };
+	std::atomic<uint64_t> frames_rejected_{ 0 };
+};
@@ -0,0 +1,70 @@
+// FrameRecorder must only count frames that reach the file, so the recording
+// and its .idx agree however many frames a full writer queue drops.
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+
+#include "frame_recorder.h"
+#include "test_check.h"
+
+namespace {
+
+const char kPath[] = "frame_recorder_test.yuv";
+
+uint64_t FileSize(const std::string& path) {
+	std::ifstream file(path, std::ios::binary | std::ios::ate);
+	return file ? static_cast<uint64_t>(file.tellg()) : 0;
+}
+
+// Drop-oldest used to evict requests Submit() had already accepted, leaving
+// offsets and the index past the end of the file.
+void TestFullQueue(FrameQueuePolicy policy) {
+	VideoDescription description;
+	description.width = 320;
+	description.height = 240;
+	description.video_type = kVideoTypeI420;
+	VideoFrameBufferPool pool(256);
+	pool.Configure(description);
+	uint64_t frame_size = 320 * 240 * 3 / 2;
+
+	AsyncFileWriterOptions options;
+	options.queue_capacity = 2;
+	options.policy = policy;
+	FrameRecorder recorder;
+	CHECK(recorder.Open(kPath, kRecordingFormatRaw, 30.0, options));
+	for (int i = 0; i < 200; ++i) {
+		VideoFrame frame;
+		CHECK(pool.CreateFrame(frame));
+		memset(const_cast<uint8_t*>(frame.y_data), i, frame.y_stride * frame.height);
+		frame.timestamp_us = i * 33333;
+		recorder.AddFrame(frame);
+	}
+	CHECK(recorder.Close());
+	FrameRecorderStats stats = recorder.Stats();
+	CHECK(stats.frames_recorded + stats.frames_dropped == 200);
+	CHECK(stats.file.requests_dropped == stats.frames_dropped);
+	CHECK(FileSize(kPath) == stats.frames_recorded * frame_size);
+
+	std::ifstream index(std::string(kPath) + ".idx");
+	std::string line;
+	while (std::getline(index, line)) {
+		unsigned long long number = 0;
+		unsigned long long offset = 0;
+		long long timestamp_us = 0;
+		CHECK(sscanf(line.c_str(), "%llu,%llu,%lld", &number, &offset, &timestamp_us) == 3);
+		CHECK(number < stats.frames_recorded);
+		CHECK(offset == number * frame_size);
+	}
+	remove(kPath);
+	remove((std::string(kPath) + ".idx").c_str());
+}
+
+}
+
+int main() {
+	TestFullQueue(kFrameQueueDropNewest);
+	TestFullQueue(kFrameQueueDropOldest);
+	TestFullQueue(kFrameQueueBlock);
+	return test::Result();
+}
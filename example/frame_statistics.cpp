@@ -0,0 +1,132 @@
+#include "frame_statistics.h"
+
+#include <algorithm>
+
+#include "frame_stats_row.h"
+#include "video_frame_view.h"
+
+namespace {
+
+void FinishSums(const FrameStatsSums& sums, uint64_t count, double& mean, double& variance) {
+	if (count == 0) {
+		mean = 0.0;
+		variance = 0.0;
+		return;
+	}
+	mean = static_cast<double>(sums.sum) / count;
+	variance = static_cast<double>(sums.sum_squares) / count - mean * mean;
+	variance = variance > 0.0 ? variance : 0.0;
+}
+
+}
+
+FrameStatsRowFunctions GetFrameStatsRowFunctions(int cpu_flags) {
+	FrameStatsRowFunctions functions = { FrameStatsLumaRow_C, FrameStatsChromaRow_C, FrameStatsInterleavedRow_C };
+#if defined(HAS_X86_SIMD)
+	if (cpu_flags & kCpuHasSSE2) {
+		FrameStatsRowFunctions sse2 = { FrameStatsLumaRow_SSE2, FrameStatsChromaRow_SSE2,
+			FrameStatsInterleavedRow_SSE2 };
+		functions = sse2;
+	}
+	if ((cpu_flags & kCpuHasSSE2) && (cpu_flags & kCpuHasAVX2)) {
+		FrameStatsRowFunctions avx2 = { FrameStatsLumaRow_AVX2, FrameStatsChromaRow_AVX2,
+			FrameStatsInterleavedRow_AVX2 };
+		functions = avx2;
+	}
+#endif
+#if defined(HAS_NEON_SIMD)
+	if (cpu_flags & kCpuHasNEON) {
+		FrameStatsRowFunctions neon = { FrameStatsLumaRow_NEON, FrameStatsChromaRow_NEON,
+			FrameStatsInterleavedRow_NEON };
+		functions = neon;
+	}
+#endif
+	return functions;
+}
+
+bool ComputeFrameStatistics(const VideoFrame& video_frame, FrameStatistics& statistics) {
+	VideoPixelLayout layout = GetPixelLayout(video_frame.video_type);
+	if ((layout != kPixelLayoutPlanar && layout != kPixelLayoutSemiPlanar) || !video_frame.y_data ||
+		!video_frame.u_data || !video_frame.v_data || video_frame.width == 0 || video_frame.height == 0) {
+		return false;
+	}
+	FrameStatsRowFunctions rows = GetFrameStatsRowFunctions(GetCpuFlags());
+	int width = static_cast<int>(video_frame.width);
+	uint32_t height = video_frame.height;
+	statistics.width = video_frame.width;
+	statistics.height = height;
+	statistics.blocks_x = (video_frame.width + kFrameStatsBlockSize - 1) / kFrameStatsBlockSize;
+	statistics.blocks_y = (height + kFrameStatsBlockSize - 1) / kFrameStatsBlockSize;
+	statistics.block_activity.assign(static_cast<size_t>(statistics.blocks_x) * statistics.blocks_y, 0.0f);
+
+	// Every luma row is read once, with the row above it still in cache.
+	uint32_t histograms[kFrameStatsHistograms * 256] = {};
+	// Reused across frames so steady-state capture does not allocate.
+	static thread_local std::vector<uint32_t> activity;
+	activity.resize(statistics.blocks_x);
+	FrameStatsSums luma = {};
+	uint64_t total_activity = 0;
+	for (uint32_t block_y = 0; block_y < statistics.blocks_y; ++block_y) {
+		std::fill(activity.begin(), activity.end(), 0u);
+		uint32_t row_begin = block_y * kFrameStatsBlockSize;
+		uint32_t row_end = std::min(row_begin + kFrameStatsBlockSize, height);
+		for (uint32_t row = row_begin; row < row_end; ++row) {
+			const uint8_t* src = video_frame.y_data + static_cast<size_t>(row) * video_frame.y_stride;
+			const uint8_t* above = row ? src - video_frame.y_stride : nullptr;
+			rows.luma(src, above, width, &luma, histograms, activity.data());
+		}
+		float* block_row = statistics.block_activity.data() + static_cast<size_t>(block_y) * statistics.blocks_x;
+		uint32_t block_height = row_end - row_begin;
+		for (uint32_t block_x = 0; block_x < statistics.blocks_x; ++block_x) {
+			uint32_t block_width = std::min<uint32_t>(kFrameStatsBlockSize,
+				video_frame.width - block_x * kFrameStatsBlockSize);
+			block_row[block_x] = static_cast<float>(activity[block_x]) / (block_width * block_height);
+			total_activity += activity[block_x];
+		}
+	}
+	uint64_t pixels = static_cast<uint64_t>(video_frame.width) * height;
+	for (int level = 0; level < 256; ++level) {
+		uint32_t count = 0;
+		for (int table = 0; table < kFrameStatsHistograms; ++table) {
+			count += histograms[table * 256 + level];
+		}
+		statistics.luma_histogram[level] = count;
+	}
+	FinishSums(luma, pixels, statistics.luma_mean, statistics.luma_variance);
+	statistics.mean_activity = static_cast<float>(static_cast<double>(total_activity) / pixels);
+
+	int chroma_width = static_cast<int>((video_frame.width + 1) / 2);
+	uint32_t chroma_height = (height + 1) / 2;
+	FrameStatsSums u = {};
+	FrameStatsSums v = {};
+	for (uint32_t row = 0; row < chroma_height; ++row) {
+		if (layout == kPixelLayoutSemiPlanar) {
+			// NV12 has U first in each pair, NV21 V.
+			bool u_first = video_frame.u_data < video_frame.v_data;
+			const uint8_t* src = (u_first ? video_frame.u_data : video_frame.v_data) +
+				static_cast<size_t>(row) * video_frame.u_stride;
+			rows.interleaved(src, chroma_width, u_first ? &u : &v, u_first ? &v : &u);
+		}
+		else {
+			rows.chroma(video_frame.u_data + static_cast<size_t>(row) * video_frame.u_stride, chroma_width, &u);
+			rows.chroma(video_frame.v_data + static_cast<size_t>(row) * video_frame.v_stride, chroma_width, &v);
+		}
+	}
+	uint64_t chroma_samples = static_cast<uint64_t>(chroma_width) * chroma_height;
+	FinishSums(u, chroma_samples, statistics.u_mean, statistics.u_variance);
+	FinishSums(v, chroma_samples, statistics.v_mean, statistics.v_variance);
+	return true;
+}
+
+uint8_t GetLumaPercentile(const FrameStatistics& statistics, double fraction) {
+	uint64_t pixels = static_cast<uint64_t>(statistics.width) * statistics.height;
+	double target = fraction * pixels;
+	uint64_t count = 0;
+	for (int level = 0; level < 256; ++level) {
+		count += statistics.luma_histogram[level];
+		if (count >= target) {
+			return static_cast<uint8_t>(level);
+		}
+	}
+	return 255;
+}
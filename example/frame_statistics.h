@@ -0,0 +1,35 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include "video_frame.h"
+
+// Exposure, brightness and texture figures of one frame, gathered in a single
+// pass over its planes.
+struct FrameStatistics {
+	uint32_t width{};
+	uint32_t height{};
+	// Pixels per luma level.
+	uint32_t luma_histogram[256]{};
+	double luma_mean{};
+	double luma_variance{};
+	double u_mean{};
+	double u_variance{};
+	double v_mean{};
+	double v_variance{};
+	// Mean absolute luma difference of each pixel to its right and lower
+	// neighbours, per 16x16 block, row by row. Flat areas are near 0; texture,
+	// edges and noise raise it.
+	uint32_t blocks_x{};
+	uint32_t blocks_y{};
+	std::vector<float> block_activity{};
+	float mean_activity{};
+};
+
+// Fills |statistics| from the Y, U and V planes of |video_frame|. Planar and
+// semi-planar frames only; packed, RGB and MJPEG frames return false.
+bool ComputeFrameStatistics(const VideoFrame& video_frame, FrameStatistics& statistics);
+
+// Lowest luma level with at least |fraction| of the pixels at or below it,
+// e.g. 0.99 for the highlights an exposure loop should keep off 255.
+uint8_t GetLumaPercentile(const FrameStatistics& statistics, double fraction);
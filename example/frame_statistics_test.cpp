@@ -0,0 +1,228 @@
+// FrameStatistics values on a known frame and on random frames at odd sizes,
+// where every SIMD level must match the scalar kernels and a direct reference,
+// and reuse of the statistics objects VideoCapture attaches to delivered frames.
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+
+#include "cpu_features.h"
+#include "format_negotiation.h"
+#include "frame_statistics.h"
+#include "test_check.h"
+#include "test_pattern_capture.h"
+
+namespace {
+
+void TestFlatFrame() {
+	VideoDescription description;
+	description.width = 65;
+	description.height = 33;
+	description.video_type = kVideoTypeNV12;
+	VideoFrameBufferPool pool(1);
+	pool.Configure(description);
+	RefPtr<VideoFrameBuffer> buffer = pool.CreateBuffer();
+	CHECK(buffer);
+	if (!buffer) {
+		return;
+	}
+	memset(buffer->Data(0), 100, buffer->Size());
+	VideoFrame frame;
+	buffer->WrapVideoFrame(frame);
+	FrameStatistics statistics;
+	// Twice into the same object: nothing of the first pass may leak through.
+	CHECK(ComputeFrameStatistics(frame, statistics));
+	CHECK(ComputeFrameStatistics(frame, statistics));
+	CHECK(statistics.luma_histogram[100] == 65 * 33);
+	CHECK(statistics.luma_mean == 100.0 && statistics.luma_variance == 0.0);
+	CHECK(statistics.u_mean == 100.0 && statistics.v_mean == 100.0);
+	CHECK(statistics.blocks_x == 5 && statistics.blocks_y == 3);
+	CHECK(statistics.block_activity.size() == 15);
+	CHECK(statistics.mean_activity == 0.0f);
+	CHECK(GetLumaPercentile(statistics, 0.5) == 100);
+}
+
+bool Near(double value, double expected) {
+	return fabs(value - expected) <= 1e-6 * (fabs(expected) + 1.0);
+}
+
+void MeanAndVariance(const std::vector<uint8_t>& samples, double& mean, double& variance) {
+	double sum = 0.0;
+	for (size_t i = 0; i < samples.size(); ++i) {
+		sum += samples[i];
+	}
+	mean = sum / samples.size();
+	double squares = 0.0;
+	for (size_t i = 0; i < samples.size(); ++i) {
+		squares += (samples[i] - mean) * (samples[i] - mean);
+	}
+	variance = squares / samples.size();
+}
+
+bool SameStatistics(const FrameStatistics& a, const FrameStatistics& b) {
+	return a.width == b.width && a.height == b.height &&
+		memcmp(a.luma_histogram, b.luma_histogram, sizeof(a.luma_histogram)) == 0 &&
+		a.luma_mean == b.luma_mean && a.luma_variance == b.luma_variance && a.u_mean == b.u_mean &&
+		a.u_variance == b.u_variance && a.v_mean == b.v_mean && a.v_variance == b.v_variance &&
+		a.blocks_x == b.blocks_x && a.blocks_y == b.blocks_y && a.block_activity == b.block_activity &&
+		a.mean_activity == b.mean_activity;
+}
+
+// Random samples, stride padding included, so kernels that read past a row or
+// mix up planes show up in the sums.
+void TestRandomFrame(uint32_t width, uint32_t height, VideoType video_type) {
+	VideoDescription description;
+	description.width = width;
+	description.height = height;
+	description.video_type = video_type;
+	VideoFrameBufferPool pool(1);
+	pool.Configure(description);
+	RefPtr<VideoFrameBuffer> buffer = pool.CreateBuffer();
+	CHECK(buffer);
+	if (!buffer) {
+		return;
+	}
+	uint32_t seed = width * 31 + height * 17 + video_type;
+	for (size_t i = 0; i < buffer->Size(); ++i) {
+		seed = seed * 1664525 + 1013904223;
+		buffer->Data(0)[i] = static_cast<uint8_t>(seed >> 24);
+	}
+	VideoFrame frame;
+	buffer->WrapVideoFrame(frame);
+
+	SetCpuFlagsMask(0);
+	FrameStatistics reference;
+	CHECK(ComputeFrameStatistics(frame, reference));
+	SetCpuFlagsMask(-1);
+	const int masks[] = { kCpuHasSSE2, kCpuHasSSE2 | kCpuHasAVX2, kCpuHasNEON, -1 };
+	for (int mask : masks) {
+		if (mask != -1 && (GetCpuFlags() & mask) != mask) {
+			continue;
+		}
+		SetCpuFlagsMask(mask);
+		FrameStatistics statistics;
+		CHECK(ComputeFrameStatistics(frame, statistics));
+		SetCpuFlagsMask(-1);
+		bool same = SameStatistics(statistics, reference);
+		if (!same) {
+			fprintf(stderr, "%s %ux%u cpu flags %d differ from scalar\n", VideoTypeName(video_type), width, height,
+				mask);
+		}
+		CHECK(same);
+	}
+
+	// Straight from the definitions, pixel by pixel.
+	std::vector<uint8_t> luma;
+	std::vector<uint32_t> histogram(256);
+	uint32_t blocks_x = (width + 15) / 16;
+	uint32_t blocks_y = (height + 15) / 16;
+	std::vector<uint32_t> activity(blocks_x * blocks_y);
+	for (uint32_t y = 0; y < height; ++y) {
+		const uint8_t* row = frame.y_data + static_cast<size_t>(y) * frame.y_stride;
+		const uint8_t* above = row - frame.y_stride;
+		for (uint32_t x = 0; x < width; ++x) {
+			luma.push_back(row[x]);
+			++histogram[row[x]];
+			uint32_t gradient = 0;
+			if (x + 1 < width) {
+				gradient += abs(row[x] - row[x + 1]);
+			}
+			if (y > 0) {
+				gradient += abs(row[x] - above[x]);
+			}
+			activity[(y / 16) * blocks_x + x / 16] += gradient;
+		}
+	}
+	double mean = 0.0;
+	double variance = 0.0;
+	MeanAndVariance(luma, mean, variance);
+	CHECK(Near(reference.luma_mean, mean));
+	CHECK(Near(reference.luma_variance, variance));
+	CHECK(memcmp(reference.luma_histogram, histogram.data(), sizeof(reference.luma_histogram)) == 0);
+	CHECK(reference.blocks_x == blocks_x && reference.blocks_y == blocks_y);
+	CHECK(reference.block_activity.size() == activity.size());
+	uint64_t total_activity = 0;
+	for (size_t block = 0; block < activity.size() && block < reference.block_activity.size(); ++block) {
+		uint32_t block_width = std::min<uint32_t>(16, width - (block % blocks_x) * 16);
+		uint32_t block_height = std::min<uint32_t>(16, height - (block / blocks_x) * 16);
+		CHECK(Near(reference.block_activity[block], static_cast<double>(activity[block]) / (block_width * block_height)));
+		total_activity += activity[block];
+	}
+	CHECK(Near(reference.mean_activity, static_cast<double>(total_activity) / (width * height)));
+	CHECK(reference.mean_activity > 0.0f || width * height == 1);
+
+	std::vector<uint8_t> u;
+	std::vector<uint8_t> v;
+	bool semi_planar = video_type == kVideoTypeNV12 || video_type == kVideoTypeNV21;
+	for (uint32_t y = 0; y < (height + 1) / 2; ++y) {
+		for (uint32_t x = 0; x < (width + 1) / 2; ++x) {
+			size_t step = semi_planar ? 2 : 1;
+			u.push_back(frame.u_data[static_cast<size_t>(y) * frame.u_stride + x * step]);
+			v.push_back(frame.v_data[static_cast<size_t>(y) * frame.v_stride + x * step]);
+		}
+	}
+	MeanAndVariance(u, mean, variance);
+	CHECK(Near(reference.u_mean, mean) && Near(reference.u_variance, variance));
+	MeanAndVariance(v, mean, variance);
+	CHECK(Near(reference.v_mean, mean) && Near(reference.v_variance, variance));
+}
+
+// Frames released by the callback give their statistics back, so a long
+// capture cycles through a handful of objects instead of allocating per frame.
+void TestReuse() {
+	TestPatternCapture capture;
+	capture.SetFrameStatistics(true);
+	std::mutex mutex;
+	std::set<const FrameStatistics*> objects;
+	std::atomic<int> frames{ 0 };
+	std::atomic<int> missing{ 0 };
+	std::atomic<int> unpooled{ 0 };
+	capture.RegisterVideoFrameCallback([&](VideoFrame& frame) {
+		if (!frame.statistics || frame.statistics->width != frame.width) {
+			++missing;
+		}
+		// The capture keeps a reference to every object it can reuse.
+		else if (frame.statistics.use_count() < 2) {
+			++unpooled;
+		}
+		std::lock_guard<std::mutex> lock(mutex);
+		objects.insert(frame.statistics.get());
+		++frames;
+	});
+	VideoDescription description;
+	description.width = 320;
+	description.height = 240;
+	description.fps = 200;
+	description.video_type = kVideoTypeI420;
+	CHECK(capture.StartCapture(VideoDevice(), description));
+	std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+	while (frames < 100 && std::chrono::steady_clock::now() < deadline) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(5));
+	}
+	capture.StopCapture();
+	CHECK(frames >= 100);
+	CHECK(missing == 0);
+	CHECK(unpooled == 0);
+	std::lock_guard<std::mutex> lock(mutex);
+	CHECK(objects.size() <= 2);
+}
+
+}
+
+int main() {
+	TestFlatFrame();
+	const VideoType types[] = { kVideoTypeI420, kVideoTypeYV12, kVideoTypeNV12, kVideoTypeNV21 };
+	for (VideoType video_type : types) {
+		TestRandomFrame(67, 35, video_type);
+		TestRandomFrame(641, 479, video_type);
+		TestRandomFrame(1, 1, video_type);
+	}
+	TestReuse();
+	return test::Result();
+}
@@ -0,0 +1,66 @@
+#pragma once
+#include <cstdint>
+
+#include "cpu_features.h"
+
+// Row kernels behind ComputeFrameStatistics(). Each luma row is read once for
+// the sums, the gradient activity and the histogram. All variants return
+// exactly the same results; SIMD versions finish the tail with the _C version.
+
+// Pixels per block of the activity map, horizontally and vertically.
+static const int kFrameStatsBlockSize = 16;
+// Pixel i of a row counts into histogram table i % kFrameStatsHistograms, so
+// neighbouring equal pixels do not wait on each other's increment.
+static const int kFrameStatsHistograms = 4;
+
+struct FrameStatsSums {
+	uint64_t sum;
+	uint64_t sum_squares;
+};
+
+// Adds |width| luma pixels of |src| to |sums| and |histograms|
+// (kFrameStatsHistograms tables of 256), and the absolute difference of every
+// pixel to its right neighbour and, with |above|, to the pixel above it, to
+// activity[x / kFrameStatsBlockSize].
+typedef void (*FrameStatsLumaRowFunction)(const uint8_t* src, const uint8_t* above, int width, FrameStatsSums* sums,
+	uint32_t* histograms, uint32_t* activity);
+// Adds |count| samples of one chroma plane to |sums|.
+typedef void (*FrameStatsChromaRowFunction)(const uint8_t* src, int count, FrameStatsSums* sums);
+// Adds |pairs| interleaved sample pairs to |even| and |odd|, e.g. U and V of
+// an NV12 row.
+typedef void (*FrameStatsInterleavedRowFunction)(const uint8_t* src, int pairs, FrameStatsSums* even,
+	FrameStatsSums* odd);
+
+struct FrameStatsRowFunctions {
+	FrameStatsLumaRowFunction luma;
+	FrameStatsChromaRowFunction chroma;
+	FrameStatsInterleavedRowFunction interleaved;
+};
+
+FrameStatsRowFunctions GetFrameStatsRowFunctions(int cpu_flags);
+
+void FrameStatsLumaRow_C(const uint8_t* src, const uint8_t* above, int width, FrameStatsSums* sums,
+	uint32_t* histograms, uint32_t* activity);
+void FrameStatsChromaRow_C(const uint8_t* src, int count, FrameStatsSums* sums);
+void FrameStatsInterleavedRow_C(const uint8_t* src, int pairs, FrameStatsSums* even, FrameStatsSums* odd);
+// The histogram half of FrameStatsLumaRow_C(), for the SIMD versions.
+void FrameStatsHistogram_C(const uint8_t* src, int width, uint32_t* histograms);
+
+#if defined(HAS_X86_SIMD)
+void FrameStatsLumaRow_SSE2(const uint8_t* src, const uint8_t* above, int width, FrameStatsSums* sums,
+	uint32_t* histograms, uint32_t* activity);
+void FrameStatsChromaRow_SSE2(const uint8_t* src, int count, FrameStatsSums* sums);
+void FrameStatsInterleavedRow_SSE2(const uint8_t* src, int pairs, FrameStatsSums* even, FrameStatsSums* odd);
+
+void FrameStatsLumaRow_AVX2(const uint8_t* src, const uint8_t* above, int width, FrameStatsSums* sums,
+	uint32_t* histograms, uint32_t* activity);
+void FrameStatsChromaRow_AVX2(const uint8_t* src, int count, FrameStatsSums* sums);
+void FrameStatsInterleavedRow_AVX2(const uint8_t* src, int pairs, FrameStatsSums* even, FrameStatsSums* odd);
+#endif
+
+#if defined(HAS_NEON_SIMD)
+void FrameStatsLumaRow_NEON(const uint8_t* src, const uint8_t* above, int width, FrameStatsSums* sums,
+	uint32_t* histograms, uint32_t* activity);
+void FrameStatsChromaRow_NEON(const uint8_t* src, int count, FrameStatsSums* sums);
+void FrameStatsInterleavedRow_NEON(const uint8_t* src, int pairs, FrameStatsSums* even, FrameStatsSums* odd);
+#endif
@@ -0,0 +1,105 @@
+#include "frame_stats_row.h"
+
+// Built with AVX2 code generation enabled, only called when the CPU has it.
+#if defined(HAS_X86_SIMD)
+#include <immintrin.h>
+
+namespace {
+
+__m256i LoadU(const uint8_t* src) {
+	return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src));
+}
+
+uint64_t AddLanes64(__m256i sums) {
+	__m128i half = _mm_add_epi64(_mm256_castsi256_si128(sums), _mm256_extracti128_si256(sums, 1));
+	uint64_t lanes[2];
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), half);
+	return lanes[0] + lanes[1];
+}
+
+uint64_t AddLanes32(__m256i sums) {
+	uint32_t lanes[8];
+	_mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes), sums);
+	uint64_t total = 0;
+	for (int i = 0; i < 8; ++i) {
+		total += lanes[i];
+	}
+	return total;
+}
+
+__m256i SumSquares(__m256i value) {
+	const __m256i zero = _mm256_setzero_si256();
+	__m256i low = _mm256_unpacklo_epi8(value, zero);
+	__m256i high = _mm256_unpackhi_epi8(value, zero);
+	return _mm256_add_epi32(_mm256_madd_epi16(low, low), _mm256_madd_epi16(high, high));
+}
+
+}
+
+void FrameStatsLumaRow_AVX2(const uint8_t* src, const uint8_t* above, int width, FrameStatsSums* sums,
+	uint32_t* histograms, uint32_t* activity) {
+	const __m256i zero = _mm256_setzero_si256();
+	__m256i sum = _mm256_setzero_si256();
+	__m256i sum_squares = _mm256_setzero_si256();
+	int x = 0;
+	for (; x + 2 * kFrameStatsBlockSize < width; x += 2 * kFrameStatsBlockSize) {
+		__m256i pixels = LoadU(src + x);
+		sum = _mm256_add_epi64(sum, _mm256_sad_epu8(pixels, zero));
+		sum_squares = _mm256_add_epi32(sum_squares, SumSquares(pixels));
+		__m256i gradient = _mm256_sad_epu8(pixels, LoadU(src + x + 1));
+		if (above) {
+			gradient = _mm256_add_epi64(gradient, _mm256_sad_epu8(pixels, LoadU(above + x)));
+		}
+		// Each 128-bit half covers one block.
+		gradient = _mm256_add_epi32(gradient, _mm256_srli_si256(gradient, 8));
+		uint32_t* block = activity + x / kFrameStatsBlockSize;
+		block[0] += static_cast<uint32_t>(_mm_cvtsi128_si32(_mm256_castsi256_si128(gradient)));
+		block[1] += static_cast<uint32_t>(_mm_cvtsi128_si32(_mm256_extracti128_si256(gradient, 1)));
+	}
+	sums->sum += AddLanes64(sum);
+	sums->sum_squares += AddLanes32(sum_squares);
+	FrameStatsHistogram_C(src, x, histograms);
+	FrameStatsLumaRow_C(src + x, above ? above + x : nullptr, width - x, sums, histograms,
+		activity + x / kFrameStatsBlockSize);
+}
+
+void FrameStatsChromaRow_AVX2(const uint8_t* src, int count, FrameStatsSums* sums) {
+	const __m256i zero = _mm256_setzero_si256();
+	__m256i sum = _mm256_setzero_si256();
+	__m256i sum_squares = _mm256_setzero_si256();
+	int i = 0;
+	for (; i + 32 <= count; i += 32) {
+		__m256i samples = LoadU(src + i);
+		sum = _mm256_add_epi64(sum, _mm256_sad_epu8(samples, zero));
+		sum_squares = _mm256_add_epi32(sum_squares, SumSquares(samples));
+	}
+	sums->sum += AddLanes64(sum);
+	sums->sum_squares += AddLanes32(sum_squares);
+	FrameStatsChromaRow_C(src + i, count - i, sums);
+}
+
+void FrameStatsInterleavedRow_AVX2(const uint8_t* src, int pairs, FrameStatsSums* even, FrameStatsSums* odd) {
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i low_bytes = _mm256_set1_epi16(0x00ff);
+	__m256i even_sum = _mm256_setzero_si256();
+	__m256i odd_sum = _mm256_setzero_si256();
+	__m256i even_squares = _mm256_setzero_si256();
+	__m256i odd_squares = _mm256_setzero_si256();
+	int i = 0;
+	for (; i + 16 <= pairs; i += 16) {
+		__m256i samples = LoadU(src + i * 2);
+		__m256i first = _mm256_and_si256(samples, low_bytes);
+		__m256i second = _mm256_srli_epi16(samples, 8);
+		even_sum = _mm256_add_epi64(even_sum, _mm256_sad_epu8(first, zero));
+		odd_sum = _mm256_add_epi64(odd_sum, _mm256_sad_epu8(second, zero));
+		even_squares = _mm256_add_epi32(even_squares, _mm256_madd_epi16(first, first));
+		odd_squares = _mm256_add_epi32(odd_squares, _mm256_madd_epi16(second, second));
+	}
+	even->sum += AddLanes64(even_sum);
+	odd->sum += AddLanes64(odd_sum);
+	even->sum_squares += AddLanes32(even_squares);
+	odd->sum_squares += AddLanes32(odd_squares);
+	FrameStatsInterleavedRow_C(src + i * 2, pairs - i, even, odd);
+}
+
+#endif
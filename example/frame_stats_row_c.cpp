@@ -0,0 +1,66 @@
+#include "frame_stats_row.h"
+
+void FrameStatsHistogram_C(const uint8_t* src, int width, uint32_t* histograms) {
+	int x = 0;
+	for (; x + 4 <= width; x += 4) {
+		++histograms[src[x]];
+		++histograms[256 + src[x + 1]];
+		++histograms[512 + src[x + 2]];
+		++histograms[768 + src[x + 3]];
+	}
+	for (; x < width; ++x) {
+		++histograms[(x % kFrameStatsHistograms) * 256 + src[x]];
+	}
+}
+
+void FrameStatsLumaRow_C(const uint8_t* src, const uint8_t* above, int width, FrameStatsSums* sums,
+	uint32_t* histograms, uint32_t* activity) {
+	uint64_t sum = 0;
+	uint64_t sum_squares = 0;
+	for (int begin = 0; begin < width; begin += kFrameStatsBlockSize) {
+		int end = begin + kFrameStatsBlockSize < width ? begin + kFrameStatsBlockSize : width;
+		// The last pixel of the row has no right neighbour.
+		int horizontal_end = end < width ? end : width - 1;
+		uint32_t gradient = 0;
+		for (int x = begin; x < end; ++x) {
+			uint32_t pixel = src[x];
+			sum += pixel;
+			sum_squares += pixel * pixel;
+		}
+		for (int x = begin; x < horizontal_end; ++x) {
+			gradient += static_cast<uint8_t>(src[x] > src[x + 1] ? src[x] - src[x + 1] : src[x + 1] - src[x]);
+		}
+		if (above) {
+			for (int x = begin; x < end; ++x) {
+				gradient += static_cast<uint8_t>(src[x] > above[x] ? src[x] - above[x] : above[x] - src[x]);
+			}
+		}
+		activity[begin / kFrameStatsBlockSize] += gradient;
+	}
+	sums->sum += sum;
+	sums->sum_squares += sum_squares;
+	FrameStatsHistogram_C(src, width, histograms);
+}
+
+void FrameStatsChromaRow_C(const uint8_t* src, int count, FrameStatsSums* sums) {
+	uint64_t sum = 0;
+	uint64_t sum_squares = 0;
+	for (int i = 0; i < count; ++i) {
+		uint32_t sample = src[i];
+		sum += sample;
+		sum_squares += sample * sample;
+	}
+	sums->sum += sum;
+	sums->sum_squares += sum_squares;
+}
+
+void FrameStatsInterleavedRow_C(const uint8_t* src, int pairs, FrameStatsSums* even, FrameStatsSums* odd) {
+	for (int i = 0; i < pairs; ++i) {
+		uint32_t first = src[i * 2];
+		uint32_t second = src[i * 2 + 1];
+		even->sum += first;
+		even->sum_squares += first * first;
+		odd->sum += second;
+		odd->sum_squares += second * second;
+	}
+}
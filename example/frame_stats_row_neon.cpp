@@ -0,0 +1,78 @@
+#include "frame_stats_row.h"
+
+#if defined(HAS_NEON_SIMD)
+#include <arm_neon.h>
+
+namespace {
+
+uint64_t AddLanes(uint32x4_t sums) {
+	uint64x2_t pairs = vpaddlq_u32(sums);
+	return vgetq_lane_u64(pairs, 0) + vgetq_lane_u64(pairs, 1);
+}
+
+// Squares of the 16 bytes of |value|, added pairwise into 32-bit lanes.
+uint32x4_t SumSquares(uint32x4_t sum_squares, uint8x16_t value) {
+	uint16x8_t low = vmull_u8(vget_low_u8(value), vget_low_u8(value));
+	uint16x8_t high = vmull_u8(vget_high_u8(value), vget_high_u8(value));
+	return vpadalq_u16(vpadalq_u16(sum_squares, low), high);
+}
+
+}
+
+void FrameStatsLumaRow_NEON(const uint8_t* src, const uint8_t* above, int width, FrameStatsSums* sums,
+	uint32_t* histograms, uint32_t* activity) {
+	uint32x4_t sum = vdupq_n_u32(0);
+	uint32x4_t sum_squares = vdupq_n_u32(0);
+	int x = 0;
+	for (; x + kFrameStatsBlockSize < width; x += kFrameStatsBlockSize) {
+		uint8x16_t pixels = vld1q_u8(src + x);
+		sum = vpadalq_u16(sum, vpaddlq_u8(pixels));
+		sum_squares = SumSquares(sum_squares, pixels);
+		uint16x8_t gradient = vpaddlq_u8(vabdq_u8(pixels, vld1q_u8(src + x + 1)));
+		if (above) {
+			gradient = vpadalq_u8(gradient, vabdq_u8(pixels, vld1q_u8(above + x)));
+		}
+		activity[x / kFrameStatsBlockSize] += static_cast<uint32_t>(AddLanes(vpaddlq_u16(gradient)));
+	}
+	sums->sum += AddLanes(sum);
+	sums->sum_squares += AddLanes(sum_squares);
+	FrameStatsHistogram_C(src, x, histograms);
+	FrameStatsLumaRow_C(src + x, above ? above + x : nullptr, width - x, sums, histograms,
+		activity + x / kFrameStatsBlockSize);
+}
+
+void FrameStatsChromaRow_NEON(const uint8_t* src, int count, FrameStatsSums* sums) {
+	uint32x4_t sum = vdupq_n_u32(0);
+	uint32x4_t sum_squares = vdupq_n_u32(0);
+	int i = 0;
+	for (; i + 16 <= count; i += 16) {
+		uint8x16_t samples = vld1q_u8(src + i);
+		sum = vpadalq_u16(sum, vpaddlq_u8(samples));
+		sum_squares = SumSquares(sum_squares, samples);
+	}
+	sums->sum += AddLanes(sum);
+	sums->sum_squares += AddLanes(sum_squares);
+	FrameStatsChromaRow_C(src + i, count - i, sums);
+}
+
+void FrameStatsInterleavedRow_NEON(const uint8_t* src, int pairs, FrameStatsSums* even, FrameStatsSums* odd) {
+	uint32x4_t even_sum = vdupq_n_u32(0);
+	uint32x4_t odd_sum = vdupq_n_u32(0);
+	uint32x4_t even_squares = vdupq_n_u32(0);
+	uint32x4_t odd_squares = vdupq_n_u32(0);
+	int i = 0;
+	for (; i + 16 <= pairs; i += 16) {
+		uint8x16x2_t samples = vld2q_u8(src + i * 2);
+		even_sum = vpadalq_u16(even_sum, vpaddlq_u8(samples.val[0]));
+		odd_sum = vpadalq_u16(odd_sum, vpaddlq_u8(samples.val[1]));
+		even_squares = SumSquares(even_squares, samples.val[0]);
+		odd_squares = SumSquares(odd_squares, samples.val[1]);
+	}
+	even->sum += AddLanes(even_sum);
+	odd->sum += AddLanes(odd_sum);
+	even->sum_squares += AddLanes(even_squares);
+	odd->sum_squares += AddLanes(odd_squares);
+	FrameStatsInterleavedRow_C(src + i * 2, pairs - i, even, odd);
+}
+
+#endif
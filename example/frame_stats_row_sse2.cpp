@@ -0,0 +1,98 @@
+#include "frame_stats_row.h"
+
+#if defined(HAS_X86_SIMD)
+#include <emmintrin.h>
+
+namespace {
+
+__m128i LoadU(const uint8_t* src) {
+	return _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+}
+
+// Adds the two 64-bit halves of a psadbw result.
+uint64_t AddHalves(__m128i sums) {
+	return static_cast<uint64_t>(_mm_cvtsi128_si32(_mm_add_epi32(sums, _mm_srli_si128(sums, 8))));
+}
+
+uint64_t AddLanes(__m128i sums) {
+	uint32_t lanes[4];
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), sums);
+	return static_cast<uint64_t>(lanes[0]) + lanes[1] + lanes[2] + lanes[3];
+}
+
+// Squares of the 16 bytes of |value|, added pairwise into 32-bit lanes.
+__m128i SumSquares(__m128i value) {
+	const __m128i zero = _mm_setzero_si128();
+	__m128i low = _mm_unpacklo_epi8(value, zero);
+	__m128i high = _mm_unpackhi_epi8(value, zero);
+	return _mm_add_epi32(_mm_madd_epi16(low, low), _mm_madd_epi16(high, high));
+}
+
+}
+
+void FrameStatsLumaRow_SSE2(const uint8_t* src, const uint8_t* above, int width, FrameStatsSums* sums,
+	uint32_t* histograms, uint32_t* activity) {
+	const __m128i zero = _mm_setzero_si128();
+	__m128i sum = _mm_setzero_si128();
+	__m128i sum_squares = _mm_setzero_si128();
+	int x = 0;
+	// The right neighbours come from one byte further on, which must still be
+	// in the row.
+	for (; x + kFrameStatsBlockSize < width; x += kFrameStatsBlockSize) {
+		__m128i pixels = LoadU(src + x);
+		sum = _mm_add_epi64(sum, _mm_sad_epu8(pixels, zero));
+		sum_squares = _mm_add_epi32(sum_squares, SumSquares(pixels));
+		__m128i gradient = _mm_sad_epu8(pixels, LoadU(src + x + 1));
+		if (above) {
+			gradient = _mm_add_epi64(gradient, _mm_sad_epu8(pixels, LoadU(above + x)));
+		}
+		activity[x / kFrameStatsBlockSize] += static_cast<uint32_t>(AddHalves(gradient));
+	}
+	sums->sum += AddHalves(sum);
+	sums->sum_squares += AddLanes(sum_squares);
+	FrameStatsHistogram_C(src, x, histograms);
+	FrameStatsLumaRow_C(src + x, above ? above + x : nullptr, width - x, sums, histograms,
+		activity + x / kFrameStatsBlockSize);
+}
+
+void FrameStatsChromaRow_SSE2(const uint8_t* src, int count, FrameStatsSums* sums) {
+	const __m128i zero = _mm_setzero_si128();
+	__m128i sum = _mm_setzero_si128();
+	__m128i sum_squares = _mm_setzero_si128();
+	int i = 0;
+	for (; i + 16 <= count; i += 16) {
+		__m128i samples = LoadU(src + i);
+		sum = _mm_add_epi64(sum, _mm_sad_epu8(samples, zero));
+		sum_squares = _mm_add_epi32(sum_squares, SumSquares(samples));
+	}
+	sums->sum += AddHalves(sum);
+	sums->sum_squares += AddLanes(sum_squares);
+	FrameStatsChromaRow_C(src + i, count - i, sums);
+}
+
+void FrameStatsInterleavedRow_SSE2(const uint8_t* src, int pairs, FrameStatsSums* even, FrameStatsSums* odd) {
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i low_bytes = _mm_set1_epi16(0x00ff);
+	__m128i even_sum = _mm_setzero_si128();
+	__m128i odd_sum = _mm_setzero_si128();
+	__m128i even_squares = _mm_setzero_si128();
+	__m128i odd_squares = _mm_setzero_si128();
+	int i = 0;
+	for (; i + 8 <= pairs; i += 8) {
+		__m128i samples = LoadU(src + i * 2);
+		// Each 16-bit lane holds one sample of each plane.
+		__m128i first = _mm_and_si128(samples, low_bytes);
+		__m128i second = _mm_srli_epi16(samples, 8);
+		even_sum = _mm_add_epi64(even_sum, _mm_sad_epu8(first, zero));
+		odd_sum = _mm_add_epi64(odd_sum, _mm_sad_epu8(second, zero));
+		even_squares = _mm_add_epi32(even_squares, _mm_madd_epi16(first, first));
+		odd_squares = _mm_add_epi32(odd_squares, _mm_madd_epi16(second, second));
+	}
+	even->sum += AddHalves(even_sum);
+	odd->sum += AddHalves(odd_sum);
+	even->sum_squares += AddLanes(even_squares);
+	odd->sum_squares += AddLanes(odd_squares);
+	FrameStatsInterleavedRow_C(src + i * 2, pairs - i, even, odd);
+}
+
+#endif
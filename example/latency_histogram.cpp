@@ -0,0 +1,123 @@
+#include "latency_histogram.h"
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace {
+
+int HighestBit(uint64_t value) {
+#ifdef _MSC_VER
+	unsigned long index = 0;
+	_BitScanReverse64(&index, value);
+	return static_cast<int>(index);
+#else
+	return 63 - __builtin_clzll(value);
+#endif
+}
+
+}
+
+LatencyHistogram::LatencyHistogram() {
+	Reset();
+}
+
+void LatencyHistogram::Record(int64_t value_us) {
+	const int64_t max_value = (int64_t(1) << kMaxValueBits) - 1;
+	if (value_us < 0) {
+		value_us = 0;
+	}
+	else if (value_us > max_value) {
+		value_us = max_value;
+	}
+	uint64_t value = static_cast<uint64_t>(value_us);
+	buckets_[BucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+	sum_.fetch_add(value, std::memory_order_relaxed);
+	int64_t current = min_.load(std::memory_order_relaxed);
+	while (value_us < current && !min_.compare_exchange_weak(current, value_us, std::memory_order_relaxed)) {
+	}
+	current = max_.load(std::memory_order_relaxed);
+	while (value_us > current && !max_.compare_exchange_weak(current, value_us, std::memory_order_relaxed)) {
+	}
+	// Counted last, so a reader that sees the count also finds the bucket.
+	count_.fetch_add(1, std::memory_order_release);
+}
+
+uint64_t LatencyHistogram::Count() const {
+	return count_.load(std::memory_order_acquire);
+}
+
+int64_t LatencyHistogram::Min() const {
+	return Count() ? min_.load(std::memory_order_relaxed) : 0;
+}
+
+int64_t LatencyHistogram::Max() const {
+	return max_.load(std::memory_order_relaxed);
+}
+
+double LatencyHistogram::Mean() const {
+	uint64_t count = Count();
+	return count ? static_cast<double>(sum_.load(std::memory_order_relaxed)) / count : 0.0;
+}
+
+int64_t LatencyHistogram::Percentile(double percentile) const {
+	uint64_t count = Count();
+	if (count == 0) {
+		return 0;
+	}
+	if (percentile > 100.0) {
+		percentile = 100.0;
+	}
+	uint64_t rank = static_cast<uint64_t>(percentile / 100.0 * count + 0.5);
+	if (rank == 0) {
+		rank = 1;
+	}
+	uint64_t seen = 0;
+	for (size_t i = 0; i < kBucketCount; ++i) {
+		seen += buckets_[i].load(std::memory_order_relaxed);
+		if (seen >= rank) {
+			int64_t value = static_cast<int64_t>(BucketHighestValue(i));
+			int64_t max = Max();
+			return value < max ? value : max;
+		}
+	}
+	return Max();
+}
+
+LatencySummary LatencyHistogram::Summary() const {
+	LatencySummary summary;
+	summary.count = Count();
+	summary.min_us = Min();
+	summary.p50_us = Percentile(50.0);
+	summary.p99_us = Percentile(99.0);
+	summary.p999_us = Percentile(99.9);
+	summary.max_us = Max();
+	summary.mean_us = Mean();
+	return summary;
+}
+
+void LatencyHistogram::Reset() {
+	for (size_t i = 0; i < kBucketCount; ++i) {
+		buckets_[i].store(0, std::memory_order_relaxed);
+	}
+	count_.store(0, std::memory_order_relaxed);
+	sum_.store(0, std::memory_order_relaxed);
+	min_.store(INT64_MAX, std::memory_order_relaxed);
+	max_.store(0, std::memory_order_relaxed);
+}
+
+size_t LatencyHistogram::BucketIndex(uint64_t value) {
+	// Values below 64 map one to one; above that each power of two [2^k, 2^(k+1))
+	// is cut into 32 buckets that are 2^(k-5) wide.
+	int shift = value < (1u << kSubBucketBits) ? 0 : HighestBit(value) - kSubBucketBits;
+	return (static_cast<size_t>(shift) << kSubBucketBits) + static_cast<size_t>(value >> shift);
+}
+
+uint64_t LatencyHistogram::BucketHighestValue(size_t index) {
+	int shift = static_cast<int>(index >> kSubBucketBits) - 1;
+	if (shift < 0) {
+		shift = 0;
+	}
+	uint64_t lowest = static_cast<uint64_t>(index - (static_cast<size_t>(shift) << kSubBucketBits)) << shift;
+	return lowest + (1ull << shift) - 1;
+}
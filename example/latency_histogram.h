@@ -0,0 +1,57 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+struct LatencySummary {
+	uint64_t count;
+	int64_t min_us;
+	int64_t p50_us;
+	int64_t p99_us;
+	int64_t p999_us;
+	int64_t max_us;
+	double mean_us;
+};
+
+// Log-linear histogram of microsecond latencies in the style of HdrHistogram:
+// every power of two is split into 32 linear buckets, so a percentile is
+// within about 3% of the true value from 1 us up to the 2^36 us clamp.
+// Record() is a handful of relaxed atomic adds and never takes a lock, so it
+// can sit on the capture path; queries run concurrently and are approximate
+// while values are being recorded.
+class LatencyHistogram {
+public:
+	LatencyHistogram();
+
+	// Negative values count as 0, values past 2^36 us as 2^36 - 1.
+	void Record(int64_t value_us);
+
+	uint64_t Count() const;
+	int64_t Min() const;
+	int64_t Max() const;
+	double Mean() const;
+	// |percentile| in [0, 100]. Returns the highest value of the bucket that
+	// holds it, 0 when nothing was recorded.
+	int64_t Percentile(double percentile) const;
+	LatencySummary Summary() const;
+
+	// Not atomic with respect to concurrent Record() calls.
+	void Reset();
+
+private:
+	LatencyHistogram(const LatencyHistogram&) = delete;
+	LatencyHistogram operator =(const LatencyHistogram&) = delete;
+
+	static const int kSubBucketBits = 5;
+	static const int kMaxValueBits = 36;
+	static const size_t kBucketCount = ((kMaxValueBits - 1 - kSubBucketBits) << kSubBucketBits) + (2 << kSubBucketBits);
+
+	static size_t BucketIndex(uint64_t value);
+	static uint64_t BucketHighestValue(size_t index);
+
+	std::atomic<uint64_t> buckets_[kBucketCount];
+	std::atomic<uint64_t> count_{ 0 };
+	std::atomic<uint64_t> sum_{ 0 };
+	std::atomic<int64_t> min_{ INT64_MAX };
+	std::atomic<int64_t> max_{ 0 };
+};
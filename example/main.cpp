@@ -1,39 +1,47 @@
-#include <iostream>
-#include <vector>
-
-#include "video_device_manager.h"
-#include "string_utils.h"
-#include "video_capture_engine.h"
-#include "video_capture_reader.h"
-#include "video_capture.h"
-
-int main(void) {
-	auto devices = VideoDeviceManager::Instance().GetAllVideoDevcies();
-	std::cout << "devices size : " << devices.size() << std::endl;
-	for (size_t i = 0; i < devices.size(); ++i) {
-		std::cout << utils::Utf8ToAnsi(devices[i].device_name) << std::endl;
-	}
-	auto formats = VideoDeviceManager::Instance().GetVideoFormats(devices[0]);
-	VideoDescription format;
-	std::cout << "format size:" << formats.size() << std::endl;
-	for (size_t i = 0; i < formats.size(); ++i) {
-		std::cout << "width:" << formats[i].width << " height:" << formats[i].height << std::endl;
-		if (640 == formats[i].width && 480 == formats[i].height && formats[i].video_type == kVideoTypeNV12) {
-			format = formats[i];
-			break;
-		}
-	}
-#if 1
-	VideoCaptureEngine capture;
-	capture.StartCapture(devices[1], format);
-	getchar();
-	capture.StopCapture();
-#else if
-	VideoCaptureReader video_capture;
-	video_capture.StartCapture(devices[0], format);
-	getchar();
-	video_capture.StopCapture();
-#endif
-	
-	return 0;
+#include <iostream>
+#include <vector>
+
+#include "device_capability_cache.h"
+#include "video_device_manager.h"
+#include "string_utils.h"
+#include "video_capture_engine.h"
+#include "video_capture_reader.h"
+#include "video_capture.h"
+
+int main(void) {
+	// Served from the last run's cache when there is one, checked in the background.
+	DeviceCapabilityCache cache(&VideoDeviceManager::Instance(), "video_device_cache.txt");
+	cache.Load();
+	auto devices = cache.GetDevices();
+	cache.RefreshAsync();
+	std::cout << "devices size : " << devices.size() << std::endl;
+	for (size_t i = 0; i < devices.size(); ++i) {
+		std::cout << utils::Utf8ToAnsi(devices[i].device_name) << std::endl;
+	}
+	std::vector<VideoDescription> formats;
+	cache.GetVideoFormats(devices[0], formats);
+	VideoDescription format;
+	std::cout << "format size:" << formats.size() << std::endl;
+	for (size_t i = 0; i < formats.size(); ++i) {
+		std::cout << "width:" << formats[i].width << " height:" << formats[i].height << std::endl;
+		if (640 == formats[i].width && 480 == formats[i].height && formats[i].video_type == kVideoTypeNV12) {
+			format = formats[i];
+			break;
+		}
+	}
+#if 1
+	VideoCaptureEngine capture;
+	capture.StartCapture(devices[1], format);
+	std::cout << "capture format " << capture.GetFormatChoice().reason << std::endl;
+	getchar();
+	capture.StopCapture();
+#else if
+	VideoCaptureReader video_capture;
+	video_capture.StartCapture(devices[0], format);
+	std::cout << "capture format " << video_capture.GetFormatChoice().reason << std::endl;
+	getchar();
+	video_capture.StopCapture();
+#endif
+	
+	return 0;
 }
\ No newline at end of file
@@ -0,0 +1,103 @@
+#include "mapped_file.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+RefPtr<MappedFile> MappedFile::Open(const std::string& path) {
+	RefPtr<MappedFile> file(new MappedFile());
+#ifdef _WIN32
+	int length = MultiByteToWideChar(CP_UTF8, 0, path.c_str(), -1, nullptr, 0);
+	if (length <= 0) {
+		return nullptr;
+	}
+	std::wstring wide_path(length, L'\0');
+	MultiByteToWideChar(CP_UTF8, 0, path.c_str(), -1, &wide_path[0], length);
+	HANDLE handle = CreateFileW(wide_path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+		FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (handle == INVALID_HANDLE_VALUE) {
+		return nullptr;
+	}
+	file->file_ = handle;
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(handle, &size) || size.QuadPart == 0) {
+		return nullptr;
+	}
+	file->mapping_ = CreateFileMappingW(handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (!file->mapping_) {
+		return nullptr;
+	}
+	file->data_ = static_cast<const uint8_t*>(MapViewOfFile(file->mapping_, FILE_MAP_READ, 0, 0, 0));
+	if (!file->data_) {
+		return nullptr;
+	}
+	file->size_ = static_cast<size_t>(size.QuadPart);
+#else
+	file->fd_ = open(path.c_str(), O_RDONLY);
+	if (file->fd_ < 0) {
+		return nullptr;
+	}
+	struct stat status;
+	if (fstat(file->fd_, &status) != 0 || status.st_size <= 0) {
+		return nullptr;
+	}
+	void* data = mmap(nullptr, static_cast<size_t>(status.st_size), PROT_READ, MAP_SHARED, file->fd_, 0);
+	if (data == MAP_FAILED) {
+		return nullptr;
+	}
+	file->data_ = static_cast<const uint8_t*>(data);
+	file->size_ = static_cast<size_t>(status.st_size);
+	madvise(data, file->size_, MADV_SEQUENTIAL);
+#endif
+	return file;
+}
+
+void MappedFile::Prefetch(size_t offset, size_t size) const {
+	if (offset >= size_) {
+		return;
+	}
+	if (size > size_ - offset) {
+		size = size_ - offset;
+	}
+#ifdef _WIN32
+	WIN32_MEMORY_RANGE_ENTRY range;
+	range.VirtualAddress = const_cast<uint8_t*>(data_ + offset);
+	range.NumberOfBytes = size;
+	PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+#else
+	// madvise wants a page aligned start.
+	size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+	size_t begin = offset / page * page;
+	madvise(const_cast<uint8_t*>(data_ + begin), size + offset - begin, MADV_WILLNEED);
+#endif
+}
+
+MappedFile::MappedFile() {
+
+}
+
+MappedFile::~MappedFile() {
+#ifdef _WIN32
+	if (data_) {
+		UnmapViewOfFile(data_);
+	}
+	if (mapping_) {
+		CloseHandle(mapping_);
+	}
+	if (file_) {
+		CloseHandle(file_);
+	}
+#else
+	if (data_) {
+		munmap(const_cast<uint8_t*>(data_), size_);
+	}
+	if (fd_ >= 0) {
+		close(fd_);
+	}
+#endif
+}
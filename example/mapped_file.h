@@ -0,0 +1,37 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "ref_counted.h"
+
+// Read-only memory mapping of a whole file. Frames that point into the
+// mapping hold a reference to it, so it stays valid after the reader that
+// opened it has gone.
+class MappedFile : public RefCountedBase {
+public:
+	// |path| is UTF-8. Returns null when the file cannot be opened or is empty.
+	static RefPtr<MappedFile> Open(const std::string& path);
+
+	const uint8_t* Data() const { return data_; }
+	size_t Size() const { return size_; }
+
+	// Asks the OS to read [offset, offset + size) ahead of use.
+	void Prefetch(size_t offset, size_t size) const;
+
+private:
+	MappedFile();
+	~MappedFile();
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile operator =(const MappedFile&) = delete;
+
+	const uint8_t* data_{};
+	size_t size_{};
+#ifdef _WIN32
+	void* file_{};
+	void* mapping_{};
+#else
+	int fd_{ -1 };
+#endif
+};
@@ -0,0 +1,768 @@
+#include "mjpeg_decoder.h"
+
+#include <atomic>
+#include <cstring>
+
+#include "thread_pool.h"
+
+namespace {
+
+const int kFastBits = 9;
+
+// Natural order index of the n-th coefficient in zigzag order.
+const uint8_t kZigzag[64] = {
+	0, 1, 8, 16, 9, 2, 3, 10, 17, 24, 32, 25, 18, 11, 4, 5,
+	12, 19, 26, 33, 40, 48, 41, 34, 27, 20, 13, 6, 7, 14, 21, 28,
+	35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23, 30, 37, 44, 51,
+	58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63,
+};
+
+// Default tables from ITU-T T.81 annex K.3, used by the many UVC cameras that
+// leave DHT out of their MJPEG frames.
+const uint8_t kDcLuminanceBits[16] = { 0, 1, 5, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0 };
+const uint8_t kDcChrominanceBits[16] = { 0, 3, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0 };
+const uint8_t kDcValues[12] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11 };
+const uint8_t kAcLuminanceBits[16] = { 0, 2, 1, 3, 3, 2, 4, 3, 5, 5, 4, 4, 0, 0, 1, 0x7d };
+const uint8_t kAcLuminanceValues[162] = {
+	0x01, 0x02, 0x03, 0x00, 0x04, 0x11, 0x05, 0x12, 0x21, 0x31, 0x41, 0x06, 0x13, 0x51, 0x61, 0x07,
+	0x22, 0x71, 0x14, 0x32, 0x81, 0x91, 0xa1, 0x08, 0x23, 0x42, 0xb1, 0xc1, 0x15, 0x52, 0xd1, 0xf0,
+	0x24, 0x33, 0x62, 0x72, 0x82, 0x09, 0x0a, 0x16, 0x17, 0x18, 0x19, 0x1a, 0x25, 0x26, 0x27, 0x28,
+	0x29, 0x2a, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49,
+	0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69,
+	0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89,
+	0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a, 0xa2, 0xa3, 0xa4, 0xa5, 0xa6, 0xa7,
+	0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3, 0xc4, 0xc5,
+	0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda, 0xe1, 0xe2,
+	0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xf1, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8,
+	0xf9, 0xfa,
+};
+const uint8_t kAcChrominanceBits[16] = { 0, 2, 1, 2, 4, 4, 3, 4, 7, 5, 4, 4, 0, 1, 2, 0x77 };
+const uint8_t kAcChrominanceValues[162] = {
+	0x00, 0x01, 0x02, 0x03, 0x11, 0x04, 0x05, 0x21, 0x31, 0x06, 0x12, 0x41, 0x51, 0x07, 0x61, 0x71,
+	0x13, 0x22, 0x32, 0x81, 0x08, 0x14, 0x42, 0x91, 0xa1, 0xb1, 0xc1, 0x09, 0x23, 0x33, 0x52, 0xf0,
+	0x15, 0x62, 0x72, 0xd1, 0x0a, 0x16, 0x24, 0x34, 0xe1, 0x25, 0xf1, 0x17, 0x18, 0x19, 0x1a, 0x26,
+	0x27, 0x28, 0x29, 0x2a, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48,
+	0x49, 0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68,
+	0x69, 0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x82, 0x83, 0x84, 0x85, 0x86, 0x87,
+	0x88, 0x89, 0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a, 0xa2, 0xa3, 0xa4, 0xa5,
+	0xa6, 0xa7, 0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3,
+	0xc4, 0xc5, 0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda,
+	0xe2, 0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8,
+	0xf9, 0xfa,
+};
+
+uint32_t ReadU16(const uint8_t* data) {
+	return (static_cast<uint32_t>(data[0]) << 8) | data[1];
+}
+
+uint8_t Clamp255(int value) {
+	return static_cast<uint8_t>(value > 255 ? 255 : (value < 0 ? 0 : value));
+}
+
+// 8-bit streams keep coefficients within 11 bits, clamping stops corrupt ones
+// from overflowing the IDCT.
+int ClampCoefficient(int value) {
+	return value > 2047 ? 2047 : (value < -2048 ? -2048 : value);
+}
+
+// Fixed point (12 bit) constants of the LLM integer IDCT used by libjpeg's
+// islow method.
+constexpr int Fix(double value) {
+	return static_cast<int>(value * 4096 + 0.5);
+}
+
+struct Idct1D {
+	int t0, t1, t2, t3;
+	int x0, x1, x2, x3;
+
+	Idct1D(int s0, int s1, int s2, int s3, int s4, int s5, int s6, int s7) {
+		int p2 = s2;
+		int p3 = s6;
+		int p1 = (p2 + p3) * Fix(0.5411961);
+		t2 = p1 + p3 * Fix(-1.847759065);
+		t3 = p1 + p2 * Fix(0.765366865);
+		t0 = (s0 + s4) * 4096;
+		t1 = (s0 - s4) * 4096;
+		x0 = t0 + t3;
+		x3 = t0 - t3;
+		x1 = t1 + t2;
+		x2 = t1 - t2;
+		t0 = s7;
+		t1 = s5;
+		t2 = s3;
+		t3 = s1;
+		p3 = t0 + t2;
+		int p4 = t1 + t3;
+		p1 = t0 + t3;
+		p2 = t1 + t2;
+		int p5 = (p3 + p4) * Fix(1.175875602);
+		t0 = t0 * Fix(0.298631336);
+		t1 = t1 * Fix(2.053119869);
+		t2 = t2 * Fix(3.072711026);
+		t3 = t3 * Fix(1.501321110);
+		p1 = p5 + p1 * Fix(-0.899976223);
+		p2 = p5 + p2 * Fix(-2.562915447);
+		p3 = p3 * Fix(-1.961570560);
+		p4 = p4 * Fix(-0.390180644);
+		t3 += p1 + p4;
+		t2 += p2 + p3;
+		t1 += p2 + p4;
+		t0 += p1 + p3;
+	}
+};
+
+void InverseDct(const int* coefficients, uint8_t* out, int out_stride) {
+	int values[64];
+	for (int i = 0; i < 8; ++i) {
+		const int* d = coefficients + i;
+		int* v = values + i;
+		if (d[8] == 0 && d[16] == 0 && d[24] == 0 && d[32] == 0 && d[40] == 0 && d[48] == 0 && d[56] == 0) {
+			int dc = d[0] * 4;
+			v[0] = v[8] = v[16] = v[24] = v[32] = v[40] = v[48] = v[56] = dc;
+			continue;
+		}
+		Idct1D idct(d[0], d[8], d[16], d[24], d[32], d[40], d[48], d[56]);
+		// Keep two extra bits of precision for the row pass.
+		idct.x0 += 512;
+		idct.x1 += 512;
+		idct.x2 += 512;
+		idct.x3 += 512;
+		v[0] = (idct.x0 + idct.t3) >> 10;
+		v[56] = (idct.x0 - idct.t3) >> 10;
+		v[8] = (idct.x1 + idct.t2) >> 10;
+		v[48] = (idct.x1 - idct.t2) >> 10;
+		v[16] = (idct.x2 + idct.t1) >> 10;
+		v[40] = (idct.x2 - idct.t1) >> 10;
+		v[24] = (idct.x3 + idct.t0) >> 10;
+		v[32] = (idct.x3 - idct.t0) >> 10;
+	}
+	for (int i = 0; i < 8; ++i) {
+		const int* v = values + i * 8;
+		uint8_t* o = out + i * out_stride;
+		Idct1D idct(v[0], v[1], v[2], v[3], v[4], v[5], v[6], v[7]);
+		// Remove the 1 << 17 scale with rounding and level shift by 128.
+		const int bias = 65536 + (128 << 17);
+		idct.x0 += bias;
+		idct.x1 += bias;
+		idct.x2 += bias;
+		idct.x3 += bias;
+		o[0] = Clamp255((idct.x0 + idct.t3) >> 17);
+		o[7] = Clamp255((idct.x0 - idct.t3) >> 17);
+		o[1] = Clamp255((idct.x1 + idct.t2) >> 17);
+		o[6] = Clamp255((idct.x1 - idct.t2) >> 17);
+		o[2] = Clamp255((idct.x2 + idct.t1) >> 17);
+		o[5] = Clamp255((idct.x2 - idct.t1) >> 17);
+		o[3] = Clamp255((idct.x3 + idct.t0) >> 17);
+		o[4] = Clamp255((idct.x3 - idct.t0) >> 17);
+	}
+}
+
+}
+
+// Reads entropy coded bits of one restart segment. Stuffed zero bytes are
+// dropped and anything past the segment reads as zero bits; Overrun() tells
+// whether any of those were consumed, which only a cut short segment needs.
+class MjpegDecoder::BitReader {
+public:
+	BitReader(const uint8_t* begin, const uint8_t* end) : position_(begin), end_(end) {}
+
+	int DecodeSymbol(const HuffmanTable& table) {
+		Fill();
+		int k = table.fast[bits_ >> (32 - kFastBits)];
+		if (k < 255) {
+			int size = table.size[k];
+			if (size > count_) {
+				return -1;
+			}
+			Consume(size);
+			return table.values[k];
+		}
+		uint32_t top = bits_ >> 16;
+		int length = kFastBits + 1;
+		while (top >= table.max_code[length]) {
+			++length;
+		}
+		if (length > 16 || length > count_) {
+			return -1;
+		}
+		int index = static_cast<int>(bits_ >> (32 - length)) + table.delta[length];
+		if (index < 0 || index >= 256) {
+			return -1;
+		}
+		Consume(length);
+		return table.values[index];
+	}
+
+	// Reads |length| bits and sign extends them as in T.81 F.2.2.1.
+	int Receive(int length) {
+		if (length == 0) {
+			return 0;
+		}
+		Fill();
+		int value = static_cast<int>(bits_ >> (32 - length));
+		Consume(length);
+		if (value < (1 << (length - 1))) {
+			value += 1 - (1 << length);
+		}
+		return value;
+	}
+
+	bool Overrun() const {
+		return padding_ > count_;
+	}
+
+private:
+	void Fill() {
+		while (count_ <= 24) {
+			uint32_t byte = 0;
+			if (position_ < end_) {
+				byte = *position_++;
+				if (byte == 0xff) {
+					if (position_ < end_ && *position_ == 0x00) {
+						++position_;
+					}
+					else {
+						byte = 0;
+						position_ = end_;
+						padding_ += 8;
+					}
+				}
+			}
+			else {
+				padding_ += 8;
+			}
+			bits_ |= byte << (24 - count_);
+			count_ += 8;
+		}
+	}
+
+	void Consume(int length) {
+		bits_ <<= length;
+		count_ -= length;
+	}
+
+	const uint8_t* position_;
+	const uint8_t* end_;
+	uint32_t bits_{};
+	int count_{};
+	// Zero bits appended past the end of the segment.
+	int padding_{};
+};
+
+class MjpegDecoder::SegmentDecoder {
+public:
+	SegmentDecoder(const MjpegDecoder& decoder, VideoFrame& video_frame)
+		: decoder_(decoder), frame_(video_frame) {
+		pixel_step_ = (video_frame.video_type == kVideoTypeNV12) ? 2 : 1;
+	}
+
+	bool Decode(const Segment& segment) {
+		BitReader reader(segment.begin, segment.end);
+		int dc_predictors[3] = {};
+		for (uint32_t mcu = segment.first_mcu; mcu < segment.first_mcu + segment.mcu_count; ++mcu) {
+			uint32_t mcu_x = mcu % decoder_.mcus_x_;
+			uint32_t mcu_y = mcu / decoder_.mcus_x_;
+			for (int c = 0; c < decoder_.component_count_; ++c) {
+				const Component& component = decoder_.components_[c];
+				for (int v = 0; v < component.v; ++v) {
+					for (int h = 0; h < component.h; ++h) {
+						if (!DecodeBlock(reader, component, dc_predictors[c])) {
+							return false;
+						}
+						StoreBlock(c, mcu_x * component.h + h, mcu_y * component.v + v);
+					}
+				}
+			}
+		}
+		return !reader.Overrun();
+	}
+
+private:
+	bool DecodeBlock(BitReader& reader, const Component& component, int& dc_predictor) {
+		const uint16_t* quant = decoder_.quant_tables_[component.quant_table];
+		memset(coefficients_, 0, sizeof(coefficients_));
+		int t = reader.DecodeSymbol(decoder_.dc_tables_[component.dc_table]);
+		if (t < 0 || t > 11) {
+			return false;
+		}
+		dc_predictor = ClampCoefficient(dc_predictor + reader.Receive(t));
+		coefficients_[0] = ClampCoefficient(dc_predictor * quant[0]);
+		const HuffmanTable& ac = decoder_.ac_tables_[component.ac_table];
+		for (int k = 1; k < 64;) {
+			int rs = reader.DecodeSymbol(ac);
+			if (rs < 0) {
+				return false;
+			}
+			int s = rs & 15;
+			int r = rs >> 4;
+			if (s == 0) {
+				if (r != 15) {
+					break;
+				}
+				k += 16;
+				continue;
+			}
+			k += r;
+			if (k > 63) {
+				return false;
+			}
+			int index = kZigzag[k++];
+			coefficients_[index] = ClampCoefficient(reader.Receive(s) * quant[index]);
+		}
+		return true;
+	}
+
+	// Writes the block at block coordinates (|block_x|, |block_y|) of component
+	// |c|. Chroma is averaged down to the 4:2:0 grid of the destination.
+	void StoreBlock(int c, uint32_t block_x, uint32_t block_y) {
+		uint32_t x = block_x * 8;
+		uint32_t y = block_y * 8;
+		if (c == 0) {
+			if (x + 8 <= frame_.width && y + 8 <= frame_.height) {
+				InverseDct(coefficients_, frame_.y_data + static_cast<size_t>(y) * frame_.y_stride + x, frame_.y_stride);
+				return;
+			}
+			if (x >= frame_.width || y >= frame_.height) {
+				return;
+			}
+			InverseDct(coefficients_, pixels_, 8);
+			uint32_t columns = frame_.width - x < 8 ? frame_.width - x : 8;
+			uint32_t rows = frame_.height - y < 8 ? frame_.height - y : 8;
+			for (uint32_t row = 0; row < rows; ++row) {
+				memcpy(frame_.y_data + static_cast<size_t>(y + row) * frame_.y_stride + x, pixels_ + row * 8, columns);
+			}
+			return;
+		}
+		InverseDct(coefficients_, pixels_, 8);
+		const Component& component = decoder_.components_[c];
+		uint32_t step_x = 2 * component.h / decoder_.max_h_;
+		uint32_t step_y = 2 * component.v / decoder_.max_v_;
+		uint32_t chroma_width = (frame_.width + 1) / 2;
+		uint32_t chroma_height = (frame_.height + 1) / 2;
+		uint32_t dst_x = x / step_x;
+		uint32_t dst_y = y / step_y;
+		uint8_t* plane = (c == 1) ? frame_.u_data : frame_.v_data;
+		uint32_t stride = (c == 1) ? frame_.u_stride : frame_.v_stride;
+		for (uint32_t row = 0; row < 8 / step_y && dst_y + row < chroma_height; ++row) {
+			uint8_t* out = plane + static_cast<size_t>(dst_y + row) * stride;
+			// Samples past the image edge are padding, reuse the last real one.
+			const uint8_t* in0 = pixels_ + row * step_y * 8;
+			const uint8_t* in1 = (step_y == 2 && y + row * 2 + 1 < frame_.height) ? in0 + 8 : in0;
+			for (uint32_t column = 0; column < 8 / step_x && dst_x + column < chroma_width; ++column) {
+				uint32_t i = column * step_x;
+				uint32_t j = (step_x == 2 && x + i + 1 < frame_.width) ? i + 1 : i;
+				out[(dst_x + column) * pixel_step_] = static_cast<uint8_t>((in0[i] + in0[j] + in1[i] + in1[j] + 2) >> 2);
+			}
+		}
+	}
+
+	const MjpegDecoder& decoder_;
+	VideoFrame& frame_;
+	int pixel_step_;
+	int coefficients_[64];
+	uint8_t pixels_[64];
+};
+
+MjpegDecoder::MjpegDecoder(ThreadPool* thread_pool) : thread_pool_(thread_pool) {
+
+}
+
+MjpegDecoder::~MjpegDecoder() {
+
+}
+
+void MjpegDecoder::SetThreadPool(ThreadPool* thread_pool) {
+	thread_pool_ = thread_pool;
+}
+
+bool MjpegDecoder::GetImageSize(const uint8_t* data, size_t size, uint32_t& width, uint32_t& height) {
+	if (size < 4 || data[0] != 0xff || data[1] != 0xd8) {
+		return false;
+	}
+	size_t position = 2;
+	while (position + 4 <= size) {
+		if (data[position] != 0xff) {
+			return false;
+		}
+		uint8_t marker = data[position + 1];
+		if (marker == 0xff) {
+			++position;
+			continue;
+		}
+		size_t length = ReadU16(data + position + 2);
+		if (length < 2 || position + 2 + length > size) {
+			return false;
+		}
+		if (marker >= 0xc0 && marker <= 0xcf && marker != 0xc4 && marker != 0xc8 && marker != 0xcc) {
+			if (length < 7) {
+				return false;
+			}
+			height = ReadU16(data + position + 5);
+			width = ReadU16(data + position + 7);
+			return true;
+		}
+		position += 2 + length;
+	}
+	return false;
+}
+
+bool MjpegDecoder::Decode(const uint8_t* data, size_t size, VideoFrame& video_frame) {
+	if (!data || !video_frame.y_data || !video_frame.u_data || !video_frame.v_data) {
+		return false;
+	}
+	if (video_frame.video_type != kVideoTypeI420 && video_frame.video_type != kVideoTypeIYUV &&
+		video_frame.video_type != kVideoTypeNV12) {
+		return false;
+	}
+	const uint8_t* scan_begin = nullptr;
+	const uint8_t* scan_end = nullptr;
+	if (!ParseHeaders(data, size, &scan_begin, &scan_end)) {
+		return false;
+	}
+	if (width_ != video_frame.width || height_ != video_frame.height) {
+		return false;
+	}
+	if (!SplitSegments(scan_begin, scan_end)) {
+		return false;
+	}
+
+	std::atomic<bool> ok{ true };
+	if (thread_pool_ && segments_.size() > 1) {
+		// A restart interval can be a single MCU, so hand out runs of segments.
+		size_t chunks = thread_pool_->ThreadCount() * 4;
+		if (chunks > segments_.size()) {
+			chunks = segments_.size();
+		}
+		size_t per_chunk = (segments_.size() + chunks - 1) / chunks;
+		thread_pool_->ParallelFor(chunks, [this, &video_frame, &ok, per_chunk](size_t chunk) {
+			SegmentDecoder decoder(*this, video_frame);
+			size_t end = (chunk + 1) * per_chunk < segments_.size() ? (chunk + 1) * per_chunk : segments_.size();
+			for (size_t i = chunk * per_chunk; i < end; ++i) {
+				if (!decoder.Decode(segments_[i])) {
+					ok = false;
+				}
+			}
+		});
+	}
+	else {
+		SegmentDecoder decoder(*this, video_frame);
+		for (size_t i = 0; i < segments_.size(); ++i) {
+			if (!decoder.Decode(segments_[i])) {
+				ok = false;
+			}
+		}
+	}
+
+	if (component_count_ == 1) {
+		uint32_t chroma_width = (width_ + 1) / 2;
+		uint32_t chroma_height = (height_ + 1) / 2;
+		int pixel_step = video_frame.video_type == kVideoTypeNV12 ? 2 : 1;
+		for (uint32_t y = 0; y < chroma_height; ++y) {
+			uint8_t* u = video_frame.u_data + static_cast<size_t>(y) * video_frame.u_stride;
+			uint8_t* v = video_frame.v_data + static_cast<size_t>(y) * video_frame.v_stride;
+			for (uint32_t x = 0; x < chroma_width; ++x) {
+				u[x * pixel_step] = 128;
+				v[x * pixel_step] = 128;
+			}
+		}
+	}
+	return ok;
+}
+
+bool MjpegDecoder::ParseHeaders(const uint8_t* data, size_t size, const uint8_t** scan_begin, const uint8_t** scan_end) {
+	if (size < 4 || data[0] != 0xff || data[1] != 0xd8) {
+		return false;
+	}
+	restart_interval_ = 0;
+	component_count_ = 0;
+	bool has_huffman_tables = false;
+	const uint8_t* end = data + size;
+	const uint8_t* position = data + 2;
+	while (position + 4 <= end) {
+		if (position[0] != 0xff) {
+			return false;
+		}
+		uint8_t marker = position[1];
+		if (marker == 0xff) {
+			++position;
+			continue;
+		}
+		size_t length = ReadU16(position + 2);
+		if (length < 2 || position + 2 + length > end) {
+			return false;
+		}
+		const uint8_t* payload = position + 4;
+		size_t payload_length = length - 2;
+		switch (marker) {
+		case 0xdb:
+			if (!ParseQuantizationTables(payload, payload_length)) {
+				return false;
+			}
+			break;
+		case 0xc4:
+			if (!ParseHuffmanTables(payload, payload_length)) {
+				return false;
+			}
+			has_huffman_tables = true;
+			break;
+		case 0xc0:
+		case 0xc1:
+			if (!ParseFrameHeader(payload, payload_length)) {
+				return false;
+			}
+			break;
+		case 0xdd:
+			if (payload_length < 2) {
+				return false;
+			}
+			restart_interval_ = ReadU16(payload);
+			break;
+		case 0xda: {
+			if (component_count_ == 0 || !ParseScanHeader(payload, payload_length)) {
+				return false;
+			}
+			if (!has_huffman_tables) {
+				LoadDefaultHuffmanTables();
+			}
+			for (int c = 0; c < component_count_; ++c) {
+				if (!dc_table_valid_[components_[c].dc_table] || !ac_table_valid_[components_[c].ac_table]) {
+					return false;
+				}
+			}
+			*scan_begin = payload + payload_length;
+			// The scan runs to the first marker that is not a restart marker.
+			const uint8_t* scan = *scan_begin;
+			while (scan + 1 < end) {
+				scan = static_cast<const uint8_t*>(memchr(scan, 0xff, end - scan - 1));
+				if (!scan) {
+					scan = end;
+					break;
+				}
+				uint8_t next = scan[1];
+				if (next != 0x00 && next != 0xff && (next < 0xd0 || next > 0xd7)) {
+					break;
+				}
+				scan += (next == 0xff) ? 1 : 2;
+			}
+			*scan_end = scan < end ? scan : end;
+			return true;
+		}
+		default:
+			// SOF2 and friends: progressive, lossless and arithmetic coding.
+			if ((marker >= 0xc2 && marker <= 0xcf && marker != 0xc4 && marker != 0xc8 && marker != 0xcc) ||
+				marker == 0xd9) {
+				return false;
+			}
+			break;
+		}
+		position += 2 + length;
+	}
+	return false;
+}
+
+bool MjpegDecoder::ParseQuantizationTables(const uint8_t* data, size_t length) {
+	while (length > 0) {
+		int precision = data[0] >> 4;
+		int id = data[0] & 15;
+		size_t table_length = 1 + (precision ? 128 : 64);
+		if (id > 3 || table_length > length) {
+			return false;
+		}
+		std::vector<uint8_t>& source = quant_source_[id];
+		if (source.size() != table_length || memcmp(source.data(), data, table_length) != 0) {
+			source.assign(data, data + table_length);
+			for (int i = 0; i < 64; ++i) {
+				uint32_t value = precision ? ReadU16(data + 1 + 2 * i) : data[1 + i];
+				quant_tables_[id][kZigzag[i]] = static_cast<uint16_t>(value);
+			}
+		}
+		data += table_length;
+		length -= table_length;
+	}
+	return true;
+}
+
+bool MjpegDecoder::ParseHuffmanTables(const uint8_t* data, size_t length) {
+	while (length >= 17) {
+		int table_class = data[0] >> 4;
+		int id = data[0] & 15;
+		size_t count = 0;
+		for (int i = 0; i < 16; ++i) {
+			count += data[1 + i];
+		}
+		size_t table_length = 17 + count;
+		if (table_class > 1 || id > 3 || count > 255 || table_length > length) {
+			return false;
+		}
+		HuffmanTable& table = table_class ? ac_tables_[id] : dc_tables_[id];
+		bool& valid = table_class ? ac_table_valid_[id] : dc_table_valid_[id];
+		if (!valid || table.source.size() != table_length || memcmp(table.source.data(), data, table_length) != 0) {
+			valid = BuildHuffmanTable(table, data + 1, data + 17);
+			if (!valid) {
+				return false;
+			}
+			table.source.assign(data, data + table_length);
+			default_tables_loaded_ = false;
+		}
+		data += table_length;
+		length -= table_length;
+	}
+	return length == 0;
+}
+
+bool MjpegDecoder::ParseFrameHeader(const uint8_t* data, size_t length) {
+	if (length < 6 || data[0] != 8) {
+		return false;
+	}
+	height_ = ReadU16(data + 1);
+	width_ = ReadU16(data + 3);
+	component_count_ = data[5];
+	if (width_ == 0 || height_ == 0 || (component_count_ != 1 && component_count_ != 3) ||
+		length < 6 + 3 * static_cast<size_t>(component_count_)) {
+		component_count_ = 0;
+		return false;
+	}
+	max_h_ = 1;
+	max_v_ = 1;
+	for (int c = 0; c < component_count_; ++c) {
+		Component& component = components_[c];
+		component.id = data[6 + 3 * c];
+		component.h = data[7 + 3 * c] >> 4;
+		component.v = data[7 + 3 * c] & 15;
+		component.quant_table = data[8 + 3 * c];
+		if (component.h < 1 || component.h > 2 || component.v < 1 || component.v > 2 || component.quant_table > 3) {
+			component_count_ = 0;
+			return false;
+		}
+		max_h_ = component.h > max_h_ ? component.h : max_h_;
+		max_v_ = component.v > max_v_ ? component.v : max_v_;
+	}
+	if (component_count_ == 1) {
+		// A single component scan is not interleaved, its MCU is one block.
+		components_[0].h = components_[0].v = max_h_ = max_v_ = 1;
+	}
+	// Luma carries the highest sampling, chroma at most halves it.
+	if (components_[0].h != max_h_ || components_[0].v != max_v_) {
+		component_count_ = 0;
+		return false;
+	}
+	mcus_x_ = (width_ + 8 * max_h_ - 1) / (8 * max_h_);
+	mcus_y_ = (height_ + 8 * max_v_ - 1) / (8 * max_v_);
+	return true;
+}
+
+bool MjpegDecoder::ParseScanHeader(const uint8_t* data, size_t length) {
+	if (length < 1) {
+		return false;
+	}
+	int count = data[0];
+	if (count != component_count_ || length < 4 + 2 * static_cast<size_t>(count)) {
+		return false;
+	}
+	for (int i = 0; i < count; ++i) {
+		int id = data[1 + 2 * i];
+		int tables = data[2 + 2 * i];
+		int c = 0;
+		while (c < component_count_ && components_[c].id != id) {
+			++c;
+		}
+		if (c == component_count_ || (tables >> 4) > 3 || (tables & 15) > 3) {
+			return false;
+		}
+		components_[c].dc_table = tables >> 4;
+		components_[c].ac_table = tables & 15;
+	}
+	const uint8_t* spectral = data + 1 + 2 * count;
+	return spectral[0] == 0 && spectral[1] == 63 && spectral[2] == 0;
+}
+
+bool MjpegDecoder::BuildHuffmanTable(HuffmanTable& table, const uint8_t* bits, const uint8_t* values) {
+	int k = 0;
+	for (int i = 0; i < 16; ++i) {
+		for (int j = 0; j < bits[i]; ++j) {
+			table.size[k++] = static_cast<uint8_t>(i + 1);
+		}
+	}
+	table.size[k] = 0;
+	memcpy(table.values, values, k);
+	uint32_t code = 0;
+	k = 0;
+	for (int length = 1; length <= 16; ++length) {
+		table.delta[length] = k - static_cast<int>(code);
+		if (table.size[k] == length) {
+			while (table.size[k] == length) {
+				table.code[k++] = static_cast<uint16_t>(code++);
+			}
+			if (code - 1 >= (1u << length)) {
+				return false;
+			}
+		}
+		table.max_code[length] = code << (16 - length);
+		code <<= 1;
+	}
+	table.max_code[17] = 0xffffffff;
+	memset(table.fast, 255, sizeof(table.fast));
+	for (int i = 0; i < k; ++i) {
+		int size = table.size[i];
+		if (size <= kFastBits) {
+			int first = table.code[i] << (kFastBits - size);
+			int count = 1 << (kFastBits - size);
+			for (int j = 0; j < count; ++j) {
+				table.fast[first + j] = static_cast<uint8_t>(i);
+			}
+		}
+	}
+	return true;
+}
+
+void MjpegDecoder::LoadDefaultHuffmanTables() {
+	if (default_tables_loaded_) {
+		return;
+	}
+	dc_table_valid_[0] = BuildHuffmanTable(dc_tables_[0], kDcLuminanceBits, kDcValues);
+	dc_table_valid_[1] = BuildHuffmanTable(dc_tables_[1], kDcChrominanceBits, kDcValues);
+	ac_table_valid_[0] = BuildHuffmanTable(ac_tables_[0], kAcLuminanceBits, kAcLuminanceValues);
+	ac_table_valid_[1] = BuildHuffmanTable(ac_tables_[1], kAcChrominanceBits, kAcChrominanceValues);
+	dc_tables_[0].source.clear();
+	dc_tables_[1].source.clear();
+	ac_tables_[0].source.clear();
+	ac_tables_[1].source.clear();
+	default_tables_loaded_ = true;
+}
+
+bool MjpegDecoder::SplitSegments(const uint8_t* begin, const uint8_t* end) {
+	segments_.clear();
+	uint32_t total = mcus_x_ * mcus_y_;
+	uint32_t interval = restart_interval_ ? restart_interval_ : total;
+	Segment segment = { begin, end, 0, 0 };
+	const uint8_t* scan = begin;
+	while (restart_interval_ && scan + 1 < end) {
+		scan = static_cast<const uint8_t*>(memchr(scan, 0xff, end - scan - 1));
+		if (!scan) {
+			break;
+		}
+		if (scan[1] < 0xd0 || scan[1] > 0xd7) {
+			++scan;
+			continue;
+		}
+		segment.end = scan;
+		segment.mcu_count = interval;
+		segments_.push_back(segment);
+		segment.begin = scan + 2;
+		segment.first_mcu += interval;
+		if (segment.first_mcu >= total) {
+			break;
+		}
+		scan += 2;
+	}
+	if (segment.first_mcu < total) {
+		segment.end = end;
+		segments_.push_back(segment);
+	}
+	for (size_t i = 0; i < segments_.size(); ++i) {
+		uint32_t left = total - segments_[i].first_mcu;
+		segments_[i].mcu_count = interval < left ? interval : left;
+	}
+	// Fewer RST markers than intervals: the frame was cut short.
+	return !segments_.empty() && segments_.back().first_mcu + segments_.back().mcu_count == total;
+}
@@ -0,0 +1,93 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "video_frame.h"
+
+class ThreadPool;
+
+// Baseline JPEG decoder for camera MJPEG. Handles 8-bit sequential Huffman
+// frames with 1 or 3 components in 4:2:0, 4:2:2 or 4:4:4, including the
+// DHT-less frames UVC cameras send, and writes I420 or NV12 straight into the
+// planes of the destination frame. Frames with a restart interval are split at
+// their RST markers and the segments are decoded in parallel on |thread_pool|.
+// Huffman and quantization tables are kept across frames and only rebuilt
+// when their bytes change. Not thread safe; use one decoder per stream.
+class MjpegDecoder {
+public:
+	explicit MjpegDecoder(ThreadPool* thread_pool = nullptr);
+	~MjpegDecoder();
+
+	static bool GetImageSize(const uint8_t* data, size_t size, uint32_t& width, uint32_t& height);
+
+	// |video_frame| must be I420, IYUV or NV12 with the size of the image.
+	// Returns false for damaged or cut short frames, whose planes may then hold
+	// part of the image.
+	bool Decode(const uint8_t* data, size_t size, VideoFrame& video_frame);
+
+	void SetThreadPool(ThreadPool* thread_pool);
+
+private:
+	struct HuffmanTable {
+		uint8_t fast[1 << 9];
+		uint16_t code[256];
+		uint8_t values[256];
+		uint8_t size[257];
+		uint32_t max_code[18];
+		int delta[17];
+		std::vector<uint8_t> source{};
+	};
+
+	struct Component {
+		int id;
+		int h;
+		int v;
+		int quant_table;
+		int dc_table;
+		int ac_table;
+	};
+
+	struct Segment {
+		const uint8_t* begin;
+		const uint8_t* end;
+		uint32_t first_mcu;
+		uint32_t mcu_count;
+	};
+
+	class BitReader;
+	class SegmentDecoder;
+
+	MjpegDecoder(const MjpegDecoder&) = delete;
+	MjpegDecoder operator =(const MjpegDecoder&) = delete;
+
+	bool ParseHeaders(const uint8_t* data, size_t size, const uint8_t** scan_begin, const uint8_t** scan_end);
+	bool ParseQuantizationTables(const uint8_t* data, size_t length);
+	bool ParseHuffmanTables(const uint8_t* data, size_t length);
+	bool ParseFrameHeader(const uint8_t* data, size_t length);
+	bool ParseScanHeader(const uint8_t* data, size_t length);
+	bool BuildHuffmanTable(HuffmanTable& table, const uint8_t* bits, const uint8_t* values);
+	void LoadDefaultHuffmanTables();
+	bool SplitSegments(const uint8_t* begin, const uint8_t* end);
+
+	ThreadPool* thread_pool_{};
+	HuffmanTable dc_tables_[4]{};
+	HuffmanTable ac_tables_[4]{};
+	bool dc_table_valid_[4]{};
+	bool ac_table_valid_[4]{};
+	bool default_tables_loaded_{};
+	// Dequantization factors in natural (not zigzag) order.
+	uint16_t quant_tables_[4][64]{};
+	std::vector<uint8_t> quant_source_[4]{};
+
+	uint32_t width_{};
+	uint32_t height_{};
+	Component components_[3]{};
+	int component_count_{};
+	int max_h_{};
+	int max_v_{};
+	uint32_t mcus_x_{};
+	uint32_t mcus_y_{};
+	uint32_t restart_interval_{};
+	std::vector<Segment> segments_{};
+};
@@ -0,0 +1,286 @@
+// MjpegDecoder against the frames in testdata/mjpeg, each with its I420
+// reference decoded by libjpeg (chroma averaged down to 4:2:0 the way the
+// decoder does it): every sampling, odd sizes, restart intervals and a frame
+// without DHT. The thread pool must give the bytes of the serial decode, and
+// cut short or damaged frames must fail without reading past their end.
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "format_negotiation.h"
+#include "mjpeg_decoder.h"
+#include "test_check.h"
+#include "thread_pool.h"
+#include "video_frame_buffer.h"
+
+namespace {
+
+const char* const kImages[] = {
+	"420_35x19",
+	"420_35x19_dri4",
+	"420_96x64_dri1",
+	"422_33x17",
+	"422_33x17_dri3",
+	"444_17x9",
+	"444_17x9_dri2",
+	"gray_31x23",
+	"gray_31x23_dri5",
+	"422_48x32_nodht",
+};
+
+// Largest difference allowed between the two inverse DCTs.
+const int kTolerance = 2;
+
+struct TestFrame {
+	TestFrame(uint32_t width, uint32_t height, VideoType video_type) : pool(1) {
+		VideoDescription description;
+		description.width = width;
+		description.height = height;
+		description.video_type = video_type;
+		pool.Configure(description);
+		buffer = pool.CreateBuffer();
+		if (buffer) {
+			buffer->WrapVideoFrame(frame);
+			memset(buffer->Data(0), 0xa5, buffer->Size());
+		}
+	}
+
+	std::vector<uint8_t> Bytes() const {
+		return std::vector<uint8_t>(buffer->Data(0), buffer->Data(0) + buffer->Size());
+	}
+
+	VideoFrameBufferPool pool;
+	RefPtr<VideoFrameBuffer> buffer{};
+	VideoFrame frame{};
+};
+
+std::vector<uint8_t> ReadFile(const std::string& name) {
+	std::vector<uint8_t> data;
+	std::string path = std::string(MJPEG_TESTDATA_DIR) + "/" + name;
+	FILE* file = fopen(path.c_str(), "rb");
+	CHECK(file);
+	if (!file) {
+		fprintf(stderr, "cannot open %s\n", path.c_str());
+		return data;
+	}
+	uint8_t chunk[4096];
+	size_t read = 0;
+	while ((read = fread(chunk, 1, sizeof(chunk), file)) > 0) {
+		data.insert(data.end(), chunk, chunk + read);
+	}
+	fclose(file);
+	return data;
+}
+
+bool Near(const uint8_t* row, int step, const uint8_t* expected, uint32_t width) {
+	for (uint32_t x = 0; x < width; ++x) {
+		if (abs(row[x * step] - expected[x]) > kTolerance) {
+			return false;
+		}
+	}
+	return true;
+}
+
+// |reference| holds the Y, U and V planes without padding.
+bool MatchesReference(const VideoFrame& frame, const std::vector<uint8_t>& reference) {
+	uint32_t chroma_width = (frame.width + 1) / 2;
+	uint32_t chroma_height = (frame.height + 1) / 2;
+	size_t luma_size = static_cast<size_t>(frame.width) * frame.height;
+	size_t chroma_size = static_cast<size_t>(chroma_width) * chroma_height;
+	if (reference.size() != luma_size + 2 * chroma_size) {
+		return false;
+	}
+	int step = frame.video_type == kVideoTypeNV12 ? 2 : 1;
+	for (uint32_t y = 0; y < frame.height; ++y) {
+		if (!Near(frame.y_data + static_cast<size_t>(y) * frame.y_stride, 1, &reference[y * frame.width], frame.width)) {
+			return false;
+		}
+	}
+	for (uint32_t y = 0; y < chroma_height; ++y) {
+		const uint8_t* u = &reference[luma_size + y * chroma_width];
+		const uint8_t* v = u + chroma_size;
+		if (!Near(frame.u_data + static_cast<size_t>(y) * frame.u_stride, step, u, chroma_width) ||
+			!Near(frame.v_data + static_cast<size_t>(y) * frame.v_stride, step, v, chroma_width)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+void TestImage(const char* name, ThreadPool& pool) {
+	std::vector<uint8_t> data = ReadFile(std::string(name) + ".jpg");
+	std::vector<uint8_t> reference = ReadFile(std::string(name) + ".i420");
+	uint32_t width = 0;
+	uint32_t height = 0;
+	CHECK(MjpegDecoder::GetImageSize(data.data(), data.size(), width, height));
+	if (width == 0 || height == 0) {
+		return;
+	}
+	const VideoType types[] = { kVideoTypeI420, kVideoTypeNV12 };
+	for (VideoType video_type : types) {
+		MjpegDecoder decoder;
+		TestFrame serial(width, height, video_type);
+		CHECK(decoder.Decode(data.data(), data.size(), serial.frame));
+		bool matches = MatchesReference(serial.frame, reference);
+		if (!matches) {
+			fprintf(stderr, "%s as %s differs from the reference\n", name, VideoTypeName(video_type));
+		}
+		CHECK(matches);
+
+		// Tables kept from the first frame must decode the second the same.
+		TestFrame again(width, height, video_type);
+		CHECK(decoder.Decode(data.data(), data.size(), again.frame));
+		CHECK(again.Bytes() == serial.Bytes());
+
+		MjpegDecoder parallel(&pool);
+		TestFrame threaded(width, height, video_type);
+		CHECK(parallel.Decode(data.data(), data.size(), threaded.frame));
+		bool same = threaded.Bytes() == serial.Bytes();
+		if (!same) {
+			fprintf(stderr, "%s as %s on the thread pool differs from the serial decode\n", name,
+				VideoTypeName(video_type));
+		}
+		CHECK(same);
+	}
+}
+
+// Every prefix that loses scan data fails. Each is copied to a buffer of its
+// own size so a sanitizer build catches reads past the end.
+void TestTruncated(const char* name, ThreadPool& pool) {
+	std::vector<uint8_t> data = ReadFile(std::string(name) + ".jpg");
+	uint32_t width = 0;
+	uint32_t height = 0;
+	if (!MjpegDecoder::GetImageSize(data.data(), data.size(), width, height)) {
+		return;
+	}
+	TestFrame frame(width, height, kVideoTypeI420);
+	MjpegDecoder serial;
+	MjpegDecoder parallel(&pool);
+	// The last two bytes are EOI.
+	for (size_t size = 0; size + 2 < data.size(); ++size) {
+		std::vector<uint8_t> prefix(data.begin(), data.begin() + size);
+		bool decoded = serial.Decode(prefix.data(), prefix.size(), frame.frame) ||
+			parallel.Decode(prefix.data(), prefix.size(), frame.frame);
+		if (decoded) {
+			fprintf(stderr, "%s cut to %zu of %zu bytes decoded\n", name, size, data.size());
+		}
+		CHECK(!decoded);
+	}
+}
+
+// Offset of the first marker segment of type |marker|, 0 if there is none.
+size_t FindMarker(const std::vector<uint8_t>& data, uint8_t marker) {
+	size_t position = 2;
+	while (position + 4 <= data.size() && data[position] == 0xff) {
+		if (data[position + 1] == marker) {
+			return position;
+		}
+		position += 2 + (data[position + 2] << 8 | data[position + 3]);
+	}
+	return 0;
+}
+
+bool Decodes(const std::vector<uint8_t>& data, uint32_t width, uint32_t height) {
+	TestFrame frame(width, height, kVideoTypeI420);
+	MjpegDecoder decoder;
+	return decoder.Decode(data.data(), data.size(), frame.frame);
+}
+
+void TestCorrupt() {
+	std::vector<uint8_t> data = ReadFile("420_35x19.jpg");
+	size_t sof = FindMarker(data, 0xc0);
+	size_t sos = FindMarker(data, 0xda);
+	size_t dqt = FindMarker(data, 0xdb);
+	size_t dht = FindMarker(data, 0xc4);
+	CHECK(sof && sos && dqt && dht);
+	if (!sof || !sos || !dqt || !dht) {
+		return;
+	}
+	CHECK(Decodes(data, 35, 19));
+	CHECK(!Decodes(data, 34, 19));
+
+	std::vector<uint8_t> bad = data;
+	bad[1] = 0xd9;
+	CHECK(!Decodes(bad, 35, 19));
+	// Progressive.
+	bad = data;
+	bad[sof + 1] = 0xc2;
+	CHECK(!Decodes(bad, 35, 19));
+	// 12 bits per sample.
+	bad = data;
+	bad[sof + 4] = 12;
+	CHECK(!Decodes(bad, 35, 19));
+	// Two components, then a sampling factor of 3.
+	bad = data;
+	bad[sof + 9] = 2;
+	CHECK(!Decodes(bad, 35, 19));
+	bad = data;
+	bad[sof + 14] = 0x31;
+	CHECK(!Decodes(bad, 35, 19));
+	// A quantization table id past 3.
+	bad = data;
+	bad[dqt + 4] = 0x05;
+	CHECK(!Decodes(bad, 35, 19));
+	// Code length counts that add up to more than 255 codes.
+	bad = data;
+	bad[dht + 5] = 0xff;
+	bad[dht + 6] = 0xff;
+	CHECK(!Decodes(bad, 35, 19));
+	// A scan that names a Huffman table the frame never defined.
+	bad = data;
+	bad[sos + 6] = 0x22;
+	CHECK(!Decodes(bad, 35, 19));
+	// A segment length past the end of the data.
+	bad = data;
+	bad[dqt + 2] = 0xff;
+	CHECK(!Decodes(bad, 35, 19));
+
+	// All one bits are never a valid Huffman code.
+	size_t scan = sos + 2 + (data[sos + 2] << 8 | data[sos + 3]);
+	bad = data;
+	for (size_t i = scan; i + 4 < bad.size(); i += 2) {
+		bad[i] = 0xff;
+		bad[i + 1] = 0x00;
+	}
+	CHECK(!Decodes(bad, 35, 19));
+	// A marker in the middle of the scan ends it early.
+	bad = data;
+	bad[scan + 20] = 0xff;
+	bad[scan + 21] = 0xe0;
+	CHECK(!Decodes(bad, 35, 19));
+
+	// Random damage may decode or not, but must stay inside the data.
+	const char* const names[] = { "420_35x19_dri4", "422_33x17", "gray_31x23_dri5", "422_48x32_nodht" };
+	uint32_t seed = 1;
+	for (const char* name : names) {
+		std::vector<uint8_t> original = ReadFile(std::string(name) + ".jpg");
+		uint32_t width = 0;
+		uint32_t height = 0;
+		if (!MjpegDecoder::GetImageSize(original.data(), original.size(), width, height)) {
+			continue;
+		}
+		TestFrame frame(width, height, kVideoTypeI420);
+		MjpegDecoder decoder;
+		for (int i = 0; i < 2000; ++i) {
+			bad = original;
+			for (int j = 0; j < 4; ++j) {
+				seed = seed * 1664525 + 1013904223;
+				bad[(seed >> 8) % bad.size()] = static_cast<uint8_t>(seed >> 24);
+			}
+			decoder.Decode(bad.data(), bad.size(), frame.frame);
+		}
+	}
+}
+
+}
+
+int main() {
+	ThreadPool pool(3);
+	for (const char* name : kImages) {
+		TestImage(name, pool);
+		TestTruncated(name, pool);
+	}
+	TestCorrupt();
+	return test::Result();
+}
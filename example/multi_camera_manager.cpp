@@ -0,0 +1,165 @@
+#include "multi_camera_manager.h"
+
+namespace {
+
+// Frames a camera may hold while waiting for the others. They hold pool
+// buffers, so keep it well below the capture's pool size.
+const size_t kMaxPendingFrames = 3;
+
+}
+
+MultiCameraManager::MultiCameraManager(size_t thread_count, const std::vector<int>& cpus)
+	: pool_(thread_count, cpus) {
+
+}
+
+MultiCameraManager::~MultiCameraManager() {
+	StopAll();
+	// Destroying a capture waits for its queued frames to be delivered.
+	cameras_.clear();
+}
+
+size_t MultiCameraManager::AddCamera(std::unique_ptr<VideoCapture> capture, const VideoDevice& video_device,
+	const VideoDescription& video_description, size_t queue_capacity) {
+	size_t camera = cameras_.size();
+	std::unique_ptr<CameraSession> session(new CameraSession());
+	session->capture = std::move(capture);
+	session->video_device = video_device;
+	session->video_description = video_description;
+	session->capture->SetThreadPool(&pool_);
+	session->capture->SetAsyncDelivery(queue_capacity ? queue_capacity : 1, kFrameQueueDropOldest, &pool_);
+	session->capture->RegisterVideoFrameCallback([this, camera](VideoFrame& video_frame) {
+		OnFrame(camera, video_frame);
+	});
+	cameras_.push_back(std::move(session));
+	return camera;
+}
+
+size_t MultiCameraManager::CameraCount() const {
+	return cameras_.size();
+}
+
+VideoCapture* MultiCameraManager::Camera(size_t camera) const {
+	return camera < cameras_.size() ? cameras_[camera]->capture.get() : nullptr;
+}
+
+bool MultiCameraManager::StartAll(std::chrono::milliseconds timeout) {
+	std::vector<std::shared_ptr<CaptureOperation>> operations;
+	for (std::unique_ptr<CameraSession>& session : cameras_) {
+		operations.push_back(session->capture->StartCaptureAsync(session->video_device,
+			session->video_description, timeout));
+	}
+	bool started = true;
+	for (size_t camera = 0; camera < cameras_.size(); ++camera) {
+		// A camera that times out stops itself if it comes up later.
+		if (operations[camera]->Wait() == kCaptureStatusSucceeded) {
+			cameras_[camera]->started = true;
+		}
+		else {
+			started = false;
+		}
+	}
+	if (!started) {
+		StopAll();
+	}
+	return started;
+}
+
+void MultiCameraManager::StopAll() {
+	std::vector<std::shared_ptr<CaptureOperation>> operations;
+	for (std::unique_ptr<CameraSession>& session : cameras_) {
+		if (session->started) {
+			operations.push_back(session->capture->StopCaptureAsync(std::chrono::milliseconds(0)));
+			session->started = false;
+		}
+	}
+	for (const std::shared_ptr<CaptureOperation>& operation : operations) {
+		operation->Wait();
+	}
+	ClearPending();
+}
+
+void MultiCameraManager::SetFrameCallback(FrameCallback callback) {
+	frame_callback_ = callback;
+}
+
+void MultiCameraManager::SetFrameSetCallback(FrameSetCallback callback, int64_t max_skew_us) {
+	frame_set_callback_ = callback;
+	max_skew_us_ = max_skew_us;
+}
+
+MultiCameraStats MultiCameraManager::Stats() const {
+	std::lock_guard<std::mutex> lock(align_mutex_);
+	MultiCameraStats stats;
+	stats.frame_sets = frame_sets_;
+	stats.frames_unmatched = frames_unmatched_;
+	return stats;
+}
+
+ThreadPool& MultiCameraManager::Pool() {
+	return pool_;
+}
+
+void MultiCameraManager::OnFrame(size_t camera, VideoFrame& video_frame) {
+	if (frame_callback_) {
+		frame_callback_(camera, video_frame);
+	}
+	if (frame_set_callback_) {
+		AlignFrame(camera, video_frame);
+	}
+}
+
+void MultiCameraManager::AlignFrame(size_t camera, const VideoFrame& video_frame) {
+	std::unique_lock<std::mutex> lock(align_mutex_);
+	std::deque<VideoFrame>& pending = cameras_[camera]->pending;
+	pending.push_back(video_frame);
+	if (pending.size() > kMaxPendingFrames) {
+		// Another camera has stalled; do not hold this one's buffers for it.
+		pending.pop_front();
+		++frames_unmatched_;
+	}
+	for (;;) {
+		// Compare the oldest frame of every camera.
+		size_t earliest = 0;
+		int64_t min_us = INT64_MAX;
+		int64_t max_us = INT64_MIN;
+		for (size_t i = 0; i < cameras_.size(); ++i) {
+			if (cameras_[i]->pending.empty()) {
+				return;
+			}
+			int64_t timestamp_us = cameras_[i]->pending.front().timestamp_us;
+			if (timestamp_us < min_us) {
+				min_us = timestamp_us;
+				earliest = i;
+			}
+			if (timestamp_us > max_us) {
+				max_us = timestamp_us;
+			}
+		}
+		if (max_us - min_us > max_skew_us_) {
+			// The earliest frame is too old for the latest camera's oldest
+			// frame, and so for every later one: it can never be matched.
+			cameras_[earliest]->pending.pop_front();
+			++frames_unmatched_;
+			continue;
+		}
+		FrameSet frame_set;
+		frame_set.skew_us = max_us - min_us;
+		frame_set.sequence = frame_sets_++;
+		for (std::unique_ptr<CameraSession>& session : cameras_) {
+			frame_set.frames.push_back(session->pending.front());
+			session->pending.pop_front();
+		}
+		std::lock_guard<std::mutex> emit_lock(emit_mutex_);
+		lock.unlock();
+		frame_set_callback_(frame_set);
+		return;
+	}
+}
+
+void MultiCameraManager::ClearPending() {
+	std::lock_guard<std::mutex> lock(align_mutex_);
+	for (std::unique_ptr<CameraSession>& session : cameras_) {
+		session->pending.clear();
+	}
+}
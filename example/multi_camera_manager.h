@@ -0,0 +1,96 @@
+#pragma once
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "thread_pool.h"
+#include "video_capture.h"
+
+struct FrameSet {
+	// One frame per camera, in AddCamera() order.
+	std::vector<VideoFrame> frames{};
+	// Spread between the earliest and the latest capture timestamp.
+	int64_t skew_us{};
+	uint64_t sequence{};
+};
+
+struct MultiCameraStats {
+	uint64_t frame_sets;
+	// Frames that found no partners within the skew window.
+	uint64_t frames_unmatched;
+};
+
+// Runs several captures on one shared worker pool. Every camera delivers
+// through SetAsyncDelivery() on that pool and decodes MJPEG with it, so N
+// cameras cost a fixed set of (optionally pinned) threads instead of one
+// delivery thread each. Frames can be consumed per camera, as time-aligned
+// sets with one frame from every camera, or both.
+class MultiCameraManager {
+public:
+	using FrameCallback = std::function<void(size_t camera, VideoFrame& video_frame)>;
+	using FrameSetCallback = std::function<void(FrameSet& frame_set)>;
+
+	// See ThreadPool for |thread_count| and |cpus|.
+	explicit MultiCameraManager(size_t thread_count = 0, const std::vector<int>& cpus = std::vector<int>());
+	~MultiCameraManager();
+
+	// Takes over |capture| and returns its camera index. Call while stopped.
+	// |queue_capacity| frames may wait for the pool per camera.
+	size_t AddCamera(std::unique_ptr<VideoCapture> capture, const VideoDevice& video_device,
+		const VideoDescription& video_description, size_t queue_capacity = 4);
+	size_t CameraCount() const;
+	VideoCapture* Camera(size_t camera) const;
+
+	// Starts every camera, or none: a failure stops the ones that started.
+	// Cameras come up concurrently, each allowed |timeout|, so bring-up takes
+	// as long as the slowest camera instead of the sum.
+	bool StartAll(std::chrono::milliseconds timeout = std::chrono::milliseconds(10000));
+	void StopAll();
+
+	// Both run on pool workers. One camera's frames arrive in order and one at
+	// a time; different cameras run in parallel. Set them while stopped.
+	void SetFrameCallback(FrameCallback callback);
+	// Emits a set whenever every camera has a frame within |max_skew_us| of the
+	// others. Frames that can no longer be matched are dropped.
+	void SetFrameSetCallback(FrameSetCallback callback, int64_t max_skew_us);
+
+	MultiCameraStats Stats() const;
+	ThreadPool& Pool();
+
+private:
+	struct CameraSession {
+		std::unique_ptr<VideoCapture> capture{};
+		VideoDevice video_device{};
+		VideoDescription video_description{};
+		bool started{};
+		// Frames waiting for partners, oldest first.
+		std::deque<VideoFrame> pending{};
+	};
+
+	MultiCameraManager(const MultiCameraManager&) = delete;
+	MultiCameraManager operator =(const MultiCameraManager&) = delete;
+
+	void OnFrame(size_t camera, VideoFrame& video_frame);
+	void AlignFrame(size_t camera, const VideoFrame& video_frame);
+	void ClearPending();
+
+	ThreadPool pool_;
+	FrameCallback frame_callback_{};
+	FrameSetCallback frame_set_callback_{};
+	int64_t max_skew_us_{};
+
+	mutable std::mutex align_mutex_{};
+	// Taken before |align_mutex_| is released, so sets are emitted in order.
+	std::mutex emit_mutex_{};
+	uint64_t frame_sets_{};
+	uint64_t frames_unmatched_{};
+
+	// Declared last: the captures go first, while the pool and the alignment
+	// state their callbacks use are still alive.
+	std::vector<std::unique_ptr<CameraSession>> cameras_{};
+};
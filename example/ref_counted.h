@@ -0,0 +1,91 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <utility>
+
+class RefCountInterface {
+public:
+	virtual void AddRef() const = 0;
+	virtual void Release() const = 0;
+
+protected:
+	virtual ~RefCountInterface() {}
+};
+
+// Atomic reference count. Subclasses override OnZeroReferences() to recycle
+// themselves instead of being deleted.
+class RefCountedBase : public RefCountInterface {
+public:
+	void AddRef() const override {
+		ref_count_.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	void Release() const override {
+		if (ref_count_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+			OnZeroReferences();
+		}
+	}
+
+	bool HasOneRef() const {
+		return ref_count_.load(std::memory_order_acquire) == 1;
+	}
+
+protected:
+	virtual void OnZeroReferences() const {
+		delete this;
+	}
+
+private:
+	mutable std::atomic<int> ref_count_{ 0 };
+};
+
+template <class T>
+class RefPtr {
+public:
+	RefPtr() {}
+	RefPtr(std::nullptr_t) {}
+	RefPtr(T* ptr) : ptr_(ptr) {
+		if (ptr_) {
+			ptr_->AddRef();
+		}
+	}
+	RefPtr(const RefPtr& other) : RefPtr(other.ptr_) {}
+	template <class U>
+	RefPtr(const RefPtr<U>& other) : RefPtr(other.Get()) {}
+	RefPtr(RefPtr&& other) : ptr_(other.ptr_) {
+		other.ptr_ = nullptr;
+	}
+	~RefPtr() {
+		Reset();
+	}
+
+	RefPtr& operator=(const RefPtr& other) {
+		RefPtr(other).Swap(*this);
+		return *this;
+	}
+	RefPtr& operator=(RefPtr&& other) {
+		RefPtr(std::move(other)).Swap(*this);
+		return *this;
+	}
+
+	T* Get() const { return ptr_; }
+	T* operator->() const { return ptr_; }
+	T& operator*() const { return *ptr_; }
+	explicit operator bool() const { return ptr_ != nullptr; }
+
+	void Reset() {
+		if (ptr_) {
+			ptr_->Release();
+			ptr_ = nullptr;
+		}
+	}
+
+	void Swap(RefPtr& other) {
+		T* tmp = ptr_;
+		ptr_ = other.ptr_;
+		other.ptr_ = tmp;
+	}
+
+private:
+	T* ptr_{};
+};
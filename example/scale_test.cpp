@@ -0,0 +1,224 @@
+// Every SIMD level must produce exactly the bytes of the scalar scaler, for
+// each 4:2:0 type and filter, at odd sizes and ratios that leave tails for each
+// kernel, and on the thread pool. VideoScaler must scale every layer from the
+// smallest finished layer that covers it.
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#include "cpu_features.h"
+#include "format_negotiation.h"
+#include "test_check.h"
+#include "thread_pool.h"
+#include "video_frame_buffer.h"
+#include "video_scaler.h"
+
+namespace {
+
+struct TestFrame {
+	TestFrame(uint32_t width, uint32_t height, VideoType video_type) : pool(1) {
+		VideoDescription description;
+		description.width = width;
+		description.height = height;
+		description.video_type = video_type;
+		pool.Configure(description);
+		buffer = pool.CreateBuffer();
+		if (buffer) {
+			buffer->WrapVideoFrame(frame);
+		}
+	}
+
+	// The whole buffer, stride padding included.
+	uint8_t* Data() {
+		return buffer->Data(0);
+	}
+
+	size_t Size() const {
+		return buffer->Size();
+	}
+
+	VideoFrameBufferPool pool;
+	RefPtr<VideoFrameBuffer> buffer{};
+	VideoFrame frame{};
+};
+
+void FillRandom(TestFrame& frame, uint32_t seed) {
+	for (size_t i = 0; i < frame.Size(); ++i) {
+		seed = seed * 1664525 + 1013904223;
+		frame.Data()[i] = static_cast<uint8_t>(seed >> 24);
+	}
+}
+
+// Compares the visible samples of two frames of the same type and size.
+bool SamePixels(const VideoFrame& a, const VideoFrame& b) {
+	if (a.video_type != b.video_type || a.width != b.width || a.height != b.height) {
+		return false;
+	}
+	bool semi_planar = a.video_type == kVideoTypeNV12 || a.video_type == kVideoTypeNV21;
+	uint32_t chroma_width = (a.width + 1) / 2;
+	uint32_t chroma_height = (a.height + 1) / 2;
+	for (uint32_t y = 0; y < a.height; ++y) {
+		if (memcmp(a.y_data + static_cast<size_t>(y) * a.y_stride, b.y_data + static_cast<size_t>(y) * b.y_stride,
+			a.width) != 0) {
+			return false;
+		}
+	}
+	for (uint32_t y = 0; y < chroma_height; ++y) {
+		if (semi_planar) {
+			const uint8_t* a_row = std::min(a.u_data, a.v_data) + static_cast<size_t>(y) * a.u_stride;
+			const uint8_t* b_row = std::min(b.u_data, b.v_data) + static_cast<size_t>(y) * b.u_stride;
+			if (memcmp(a_row, b_row, chroma_width * 2) != 0) {
+				return false;
+			}
+			continue;
+		}
+		if (memcmp(a.u_data + static_cast<size_t>(y) * a.u_stride, b.u_data + static_cast<size_t>(y) * b.u_stride,
+			chroma_width) != 0 ||
+			memcmp(a.v_data + static_cast<size_t>(y) * a.v_stride, b.v_data + static_cast<size_t>(y) * b.v_stride,
+			chroma_width) != 0) {
+			return false;
+		}
+	}
+	return true;
+}
+
+// Scales with the kernels allowed by |mask| into a destination cleared to a
+// fixed pattern, so untouched padding compares equal too.
+std::vector<uint8_t> Scale(const VideoFrame& src, TestFrame& dst, int mask, ScaleFilter filter,
+	ThreadPool* thread_pool) {
+	SetCpuFlagsMask(mask);
+	memset(dst.Data(), 0xa5, dst.Size());
+	bool scaled = ScaleVideoFrame(src, dst.frame, filter, thread_pool);
+	SetCpuFlagsMask(-1);
+	CHECK(scaled);
+	return std::vector<uint8_t>(dst.Data(), dst.Data() + dst.Size());
+}
+
+struct Size {
+	uint32_t width;
+	uint32_t height;
+};
+
+struct Ratio {
+	Size src;
+	Size dst;
+};
+
+const Ratio kRatios[] = {
+	{ { 640, 480 }, { 320, 240 } },
+	{ { 641, 479 }, { 320, 240 } },
+	{ { 67, 35 }, { 133, 71 } },
+	{ { 67, 35 }, { 17, 9 } },
+	{ { 33, 17 }, { 33, 9 } },
+	{ { 33, 17 }, { 11, 17 } },
+	{ { 1, 1 }, { 3, 3 } },
+	{ { 1000, 3 }, { 7, 1 } },
+};
+
+void TestRatio(const Ratio& ratio, VideoType video_type, ThreadPool& pool) {
+	TestFrame src(ratio.src.width, ratio.src.height, video_type);
+	TestFrame dst(ratio.dst.width, ratio.dst.height, video_type);
+	CHECK(src.buffer && dst.buffer);
+	if (!src.buffer || !dst.buffer) {
+		return;
+	}
+	FillRandom(src, ratio.src.width * 31 + ratio.dst.width * 17 + video_type);
+	const ScaleFilter filters[] = { kScaleFilterBox, kScaleFilterBilinear, kScaleFilterBicubic };
+	const int masks[] = { kCpuHasSSE2, kCpuHasSSE2 | kCpuHasAVX2, kCpuHasNEON, -1 };
+	for (ScaleFilter filter : filters) {
+		std::vector<uint8_t> reference = Scale(src.frame, dst, 0, filter, nullptr);
+		for (int mask : masks) {
+			if (mask != -1 && (GetCpuFlags() & mask) != mask) {
+				continue;
+			}
+			bool same = Scale(src.frame, dst, mask, filter, nullptr) == reference;
+			if (!same) {
+				fprintf(stderr, "%s %ux%u->%ux%u filter %d cpu flags %d differ from scalar\n",
+					VideoTypeName(video_type), ratio.src.width, ratio.src.height, ratio.dst.width, ratio.dst.height,
+					filter, mask);
+			}
+			CHECK(same);
+		}
+		bool same = Scale(src.frame, dst, -1, filter, &pool) == reference;
+		if (!same) {
+			fprintf(stderr, "%s %ux%u->%ux%u filter %d on the thread pool differs from scalar\n",
+				VideoTypeName(video_type), ratio.src.width, ratio.src.height, ratio.dst.width, ratio.dst.height,
+				filter);
+		}
+		CHECK(same);
+	}
+}
+
+// Layers given out of order. By area the scaler makes 640x480, 320x240,
+// 240x130, 200x100 and 160x120; both of the last two are covered by 240x130
+// but not by each other.
+void TestPyramid(VideoType video_type) {
+	TestFrame src(640, 480, video_type);
+	CHECK(src.buffer);
+	if (!src.buffer) {
+		return;
+	}
+	FillRandom(src, 7 + video_type);
+	src.frame.timestamp_us = 1234;
+	src.frame.sequence = 56;
+	VideoScaler scaler;
+	const Size kLayers[] = { { 160, 120 }, { 640, 480 }, { 200, 100 }, { 320, 240 }, { 240, 130 } };
+	std::vector<ScaleSize> sizes;
+	for (const Size& layer : kLayers) {
+		ScaleSize size;
+		size.width = layer.width;
+		size.height = layer.height;
+		sizes.push_back(size);
+	}
+	scaler.SetLayers(sizes);
+	std::vector<VideoFrame> layers;
+	CHECK(scaler.Scale(src.frame, layers));
+	CHECK(layers.size() == sizes.size());
+	if (layers.size() != sizes.size()) {
+		return;
+	}
+	for (size_t i = 0; i < sizes.size(); ++i) {
+		CHECK(layers[i].width == sizes[i].width && layers[i].height == sizes[i].height);
+		CHECK(layers[i].timestamp_us == 1234 && layers[i].sequence == 56);
+	}
+	// The layer the size of the source shares its buffer.
+	CHECK(layers[1].y_data == src.frame.y_data && layers[1].buffer.Get() == src.frame.buffer.Get());
+
+	// Each layer: the index of the layer it must have been scaled from, -1 for
+	// the source.
+	const int from[] = { 4, -1, 4, 1, 3 };
+	for (size_t i = 0; i < sizes.size(); ++i) {
+		if (i == 1) {
+			continue;
+		}
+		const VideoFrame& source = from[i] < 0 ? src.frame : layers[from[i]];
+		TestFrame expected(sizes[i].width, sizes[i].height, video_type);
+		CHECK(ScaleVideoFrame(source, expected.frame));
+		bool same = SamePixels(layers[i], expected.frame);
+		if (!same) {
+			fprintf(stderr, "%s layer %ux%u was not scaled from the smallest covering layer\n",
+				VideoTypeName(video_type), sizes[i].width, sizes[i].height);
+		}
+		CHECK(same);
+	}
+	// Scaling straight from the source gives other bytes, so the check above
+	// tells the two apart.
+	TestFrame direct(160, 120, video_type);
+	CHECK(ScaleVideoFrame(src.frame, direct.frame));
+	CHECK(!SamePixels(layers[0], direct.frame));
+}
+
+}
+
+int main() {
+	printf("cpu flags %d\n", GetCpuFlags());
+	ThreadPool pool(3);
+	const VideoType types[] = { kVideoTypeI420, kVideoTypeYV12, kVideoTypeNV12, kVideoTypeNV21 };
+	for (VideoType video_type : types) {
+		for (const Ratio& ratio : kRatios) {
+			TestRatio(ratio, video_type, pool);
+		}
+		TestPyramid(video_type);
+	}
+	return test::Result();
+}
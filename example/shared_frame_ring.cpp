@@ -0,0 +1,380 @@
+#include "shared_frame_ring.h"
+
+#include <atomic>
+#include <limits>
+#include <new>
+#include <thread>
+
+#include "shared_memory.h"
+#include "video_convert.h"
+#include "video_frame_buffer.h"
+#include "video_frame_view.h"
+
+// Both sides of the ring see these through their own mapping, so they hold
+// only fixed-size fields and address-free atomics.
+struct SharedFrameRingHeader {
+	// Stored last by the writer, once everything else is in place.
+	std::atomic<uint32_t> magic;
+	uint32_t version;
+	uint32_t slot_count;
+	uint32_t reserved;
+	uint64_t slot_size;
+	uint64_t data_offset;
+	uint64_t total_size;
+	// Sequence of the newest published frame, 0 before the first.
+	std::atomic<uint64_t> write_sequence;
+};
+
+struct alignas(64) SharedFrameSlot {
+	// Frame sequence << kSequenceShift | writing flag | reader count.
+	std::atomic<uint64_t> state;
+	uint32_t width;
+	uint32_t height;
+	int32_t video_type;
+	uint32_t unchanged;
+	int64_t timestamp_us;
+	int64_t arrival_us;
+	uint64_t frame_sequence;
+};
+
+namespace {
+
+const uint32_t kRingMagic = 0x56465231;  // "VFR1"
+const uint32_t kRingVersion = 1;
+const uint64_t kReaderMask = 0xffff;
+const uint64_t kWritingFlag = 1ull << 16;
+const int kSequenceShift = 17;
+// Slot data starts on a page, so slots never share one with the header.
+const size_t kRingDataAlignment = 4096;
+const int kPinAttempts = 4;
+
+uint64_t GetStateSequence(uint64_t state) {
+	return state >> kSequenceShift;
+}
+
+uint64_t MakeState(uint64_t sequence, bool writing) {
+	return (sequence << kSequenceShift) | (writing ? kWritingFlag : 0);
+}
+
+size_t AlignSize(size_t size, size_t alignment) {
+	return (size + alignment - 1) / alignment * alignment;
+}
+
+bool IsRingSupported() {
+	// The state words are shared between processes, which needs atomics that
+	// do not fall back to a lock in the process's own memory.
+	std::atomic<uint64_t> state(0);
+	std::atomic<uint32_t> magic(0);
+	return state.is_lock_free() && magic.is_lock_free();
+}
+
+SharedFrameSlot* GetSlots(SharedFrameRingHeader* header) {
+	size_t offset = AlignSize(sizeof(SharedFrameRingHeader), alignof(SharedFrameSlot));
+	return reinterpret_cast<SharedFrameSlot*>(reinterpret_cast<uint8_t*>(header) + offset);
+}
+
+uint8_t* GetSlotData(SharedFrameRingHeader* header, const SharedFrameSlot* slot) {
+	size_t index = static_cast<size_t>(slot - GetSlots(header));
+	return reinterpret_cast<uint8_t*>(header) + header->data_offset + index * header->slot_size;
+}
+
+// Keeps a slot pinned for as long as a frame reading it is alive.
+class SlotPin : public RefCountedBase {
+public:
+	SlotPin(RefPtr<SharedMemory> memory, std::atomic<uint64_t>* state)
+		: memory_(std::move(memory)), state_(state) {}
+
+	~SlotPin() {
+		state_->fetch_sub(1, std::memory_order_release);
+	}
+
+private:
+	RefPtr<SharedMemory> memory_{};
+	std::atomic<uint64_t>* state_{};
+};
+
+}
+
+SharedFrameWriter::SharedFrameWriter() {
+
+}
+
+SharedFrameWriter::~SharedFrameWriter() {
+	Close();
+}
+
+bool SharedFrameWriter::Create(const std::string& name, const VideoDescription& largest, uint32_t slot_count) {
+	std::lock_guard<std::mutex> lock(mutex_);
+	VideoFrameLayout layout;
+	if (memory_ || slot_count == 0 || !IsRingSupported() ||
+		!GetVideoFrameLayout(largest, kFrameBufferAlignment, layout)) {
+		return false;
+	}
+	size_t slot_size = AlignSize(layout.size, kFrameBufferAlignment);
+	size_t data_offset = AlignSize(AlignSize(sizeof(SharedFrameRingHeader), alignof(SharedFrameSlot)) +
+		sizeof(SharedFrameSlot) * slot_count, kRingDataAlignment);
+	size_t total_size = data_offset + slot_size * slot_count;
+	RefPtr<SharedMemory> memory = SharedMemory::Create(name, total_size);
+	if (!memory) {
+		return false;
+	}
+	SharedFrameRingHeader* header = new (memory->Data()) SharedFrameRingHeader();
+	header->version = kRingVersion;
+	header->slot_count = slot_count;
+	header->slot_size = slot_size;
+	header->data_offset = data_offset;
+	header->total_size = total_size;
+	header->write_sequence.store(0, std::memory_order_relaxed);
+	SharedFrameSlot* slots = GetSlots(header);
+	for (uint32_t i = 0; i < slot_count; ++i) {
+		new (&slots[i]) SharedFrameSlot();
+		slots[i].state.store(0, std::memory_order_relaxed);
+	}
+	header->magic.store(kRingMagic, std::memory_order_release);
+	memory_ = memory;
+	header_ = header;
+	sequence_ = 0;
+	stats_ = SharedFrameWriterStats();
+	return true;
+}
+
+void SharedFrameWriter::Close() {
+	std::lock_guard<std::mutex> lock(mutex_);
+	CancelWriteLocked();
+	header_ = nullptr;
+	memory_.Reset();
+}
+
+bool SharedFrameWriter::IsOpen() const {
+	std::lock_guard<std::mutex> lock(mutex_);
+	return header_ != nullptr;
+}
+
+bool SharedFrameWriter::Write(const VideoFrame& video_frame) {
+	std::lock_guard<std::mutex> lock(mutex_);
+	VideoDescription description;
+	description.width = video_frame.width;
+	description.height = video_frame.height;
+	description.video_type = video_frame.video_type;
+	VideoFrame slot_frame;
+	if (!BeginWriteLocked(description, slot_frame)) {
+		return false;
+	}
+	if (!ConvertVideoFrame(video_frame, slot_frame)) {
+		CancelWriteLocked();
+		++stats_.dropped;
+		return false;
+	}
+	slot_frame.timestamp_us = video_frame.timestamp_us;
+	slot_frame.arrival_us = video_frame.arrival_us;
+	slot_frame.sequence = video_frame.sequence;
+	slot_frame.unchanged = video_frame.unchanged;
+	EndWriteLocked(slot_frame);
+	return true;
+}
+
+bool SharedFrameWriter::BeginWrite(const VideoDescription& description, VideoFrame& video_frame) {
+	std::lock_guard<std::mutex> lock(mutex_);
+	return BeginWriteLocked(description, video_frame);
+}
+
+bool SharedFrameWriter::EndWrite(const VideoFrame& video_frame) {
+	std::lock_guard<std::mutex> lock(mutex_);
+	if (!writing_slot_) {
+		return false;
+	}
+	EndWriteLocked(video_frame);
+	return true;
+}
+
+void SharedFrameWriter::CancelWrite() {
+	std::lock_guard<std::mutex> lock(mutex_);
+	CancelWriteLocked();
+}
+
+SharedFrameWriterStats SharedFrameWriter::Stats() const {
+	std::lock_guard<std::mutex> lock(mutex_);
+	return stats_;
+}
+
+bool SharedFrameWriter::BeginWriteLocked(const VideoDescription& description, VideoFrame& video_frame) {
+	if (!header_ || writing_slot_) {
+		return false;
+	}
+	VideoFrameLayout layout;
+	if (GetPixelLayout(description.video_type) == kPixelLayoutCompressed ||
+		!GetVideoFrameLayout(description, kFrameBufferAlignment, layout) || layout.size > header_->slot_size) {
+		++stats_.dropped;
+		return false;
+	}
+	// Takes the free slot holding the oldest frame. A reader can pin a slot
+	// between the scan and the exchange, then the scan starts over.
+	SharedFrameSlot* slots = GetSlots(header_);
+	SharedFrameSlot* slot = nullptr;
+	for (uint32_t attempt = 0; !slot && attempt <= header_->slot_count; ++attempt) {
+		SharedFrameSlot* oldest = nullptr;
+		uint64_t oldest_state = 0;
+		for (uint32_t i = 0; i < header_->slot_count; ++i) {
+			uint64_t state = slots[i].state.load(std::memory_order_acquire);
+			if ((state & (kReaderMask | kWritingFlag)) == 0 &&
+				(!oldest || GetStateSequence(state) < GetStateSequence(oldest_state))) {
+				oldest = &slots[i];
+				oldest_state = state;
+			}
+		}
+		if (!oldest) {
+			break;
+		}
+		if (oldest->state.compare_exchange_strong(oldest_state, MakeState(0, true), std::memory_order_acquire)) {
+			slot = oldest;
+		}
+	}
+	if (!slot) {
+		++stats_.dropped;
+		return false;
+	}
+	writing_slot_ = slot;
+	video_frame = VideoFrame();
+	SetVideoFramePlanes(description, layout, GetSlotData(header_, slot), video_frame);
+	video_frame.buffer = memory_;
+	return true;
+}
+
+void SharedFrameWriter::EndWriteLocked(const VideoFrame& video_frame) {
+	SharedFrameSlot* slot = writing_slot_;
+	writing_slot_ = nullptr;
+	slot->width = video_frame.width;
+	slot->height = video_frame.height;
+	slot->video_type = video_frame.video_type;
+	slot->unchanged = video_frame.unchanged ? 1 : 0;
+	slot->timestamp_us = video_frame.timestamp_us;
+	slot->arrival_us = video_frame.arrival_us;
+	slot->frame_sequence = video_frame.sequence;
+	++sequence_;
+	// Releases the pixels and the fields above to readers that pin the slot.
+	slot->state.store(MakeState(sequence_, false), std::memory_order_release);
+	header_->write_sequence.store(sequence_, std::memory_order_release);
+	++stats_.written;
+}
+
+void SharedFrameWriter::CancelWriteLocked() {
+	if (writing_slot_) {
+		// The old frame is partly overwritten, the slot goes back empty.
+		writing_slot_->state.store(MakeState(0, false), std::memory_order_release);
+		writing_slot_ = nullptr;
+	}
+}
+
+SharedFrameReader::SharedFrameReader() {
+
+}
+
+SharedFrameReader::~SharedFrameReader() {
+	Close();
+}
+
+bool SharedFrameReader::Open(const std::string& name) {
+	Close();
+	if (!IsRingSupported()) {
+		return false;
+	}
+	RefPtr<SharedMemory> memory = SharedMemory::Open(name);
+	if (!memory || memory->Size() < sizeof(SharedFrameRingHeader)) {
+		return false;
+	}
+	SharedFrameRingHeader* header = reinterpret_cast<SharedFrameRingHeader*>(memory->Data());
+	if (header->magic.load(std::memory_order_acquire) != kRingMagic || header->version != kRingVersion ||
+		header->slot_count == 0 || header->total_size > memory->Size() ||
+		header->data_offset + header->slot_size * header->slot_count > header->total_size) {
+		return false;
+	}
+	memory_ = memory;
+	header_ = header;
+	uint64_t newest = header->write_sequence.load(std::memory_order_acquire);
+	last_sequence_ = newest > 0 ? newest - 1 : 0;
+	stats_ = SharedFrameReaderStats();
+	return true;
+}
+
+void SharedFrameReader::Close() {
+	header_ = nullptr;
+	memory_.Reset();
+}
+
+bool SharedFrameReader::IsOpen() const {
+	return header_ != nullptr;
+}
+
+bool SharedFrameReader::TryRead(VideoFrame& video_frame) {
+	if (!header_) {
+		return false;
+	}
+	SharedFrameSlot* slots = GetSlots(header_);
+	for (int attempt = 0; attempt < kPinAttempts; ++attempt) {
+		SharedFrameSlot* next = nullptr;
+		uint64_t next_sequence = std::numeric_limits<uint64_t>::max();
+		for (uint32_t i = 0; i < header_->slot_count; ++i) {
+			uint64_t state = slots[i].state.load(std::memory_order_acquire);
+			uint64_t sequence = GetStateSequence(state);
+			if (!(state & kWritingFlag) && sequence > last_sequence_ && sequence < next_sequence) {
+				next = &slots[i];
+				next_sequence = sequence;
+			}
+		}
+		if (!next) {
+			return false;
+		}
+		// Loses only to the writer taking the slot over; the next scan finds
+		// whatever is oldest then.
+		if (PinSlot(next, next_sequence, video_frame)) {
+			stats_.missed += next_sequence - last_sequence_ - 1;
+			++stats_.read;
+			last_sequence_ = next_sequence;
+			return true;
+		}
+	}
+	return false;
+}
+
+bool SharedFrameReader::Read(VideoFrame& video_frame, std::chrono::milliseconds timeout) {
+	std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + timeout;
+	for (;;) {
+		if (TryRead(video_frame)) {
+			return true;
+		}
+		if (!header_ || std::chrono::steady_clock::now() >= deadline) {
+			return false;
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+}
+
+SharedFrameReaderStats SharedFrameReader::Stats() const {
+	return stats_;
+}
+
+bool SharedFrameReader::PinSlot(SharedFrameSlot* slot, uint64_t sequence, VideoFrame& video_frame) {
+	uint64_t state = slot->state.load(std::memory_order_acquire);
+	do {
+		if (GetStateSequence(state) != sequence || (state & kWritingFlag) || (state & kReaderMask) == kReaderMask) {
+			return false;
+		}
+	} while (!slot->state.compare_exchange_weak(state, state + 1, std::memory_order_acquire));
+	RefPtr<SlotPin> pin(new SlotPin(memory_, &slot->state));
+	VideoDescription description;
+	description.width = slot->width;
+	description.height = slot->height;
+	description.video_type = static_cast<VideoType>(slot->video_type);
+	VideoFrameLayout layout;
+	if (!GetVideoFrameLayout(description, kFrameBufferAlignment, layout) || layout.size > header_->slot_size) {
+		return false;
+	}
+	video_frame = VideoFrame();
+	SetVideoFramePlanes(description, layout, GetSlotData(header_, slot), video_frame);
+	video_frame.timestamp_us = slot->timestamp_us;
+	video_frame.arrival_us = slot->arrival_us;
+	video_frame.sequence = slot->frame_sequence;
+	video_frame.unchanged = slot->unchanged != 0;
+	video_frame.buffer = pin;
+	return true;
+}
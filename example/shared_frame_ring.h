@@ -0,0 +1,120 @@
+#pragma once
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+#include "ref_counted.h"
+#include "video_frame.h"
+
+class SharedMemory;
+struct SharedFrameRingHeader;
+struct SharedFrameSlot;
+
+struct SharedFrameWriterStats {
+	uint64_t written;
+	// Frames not written because every slot was pinned by readers, or the
+	// frame did not fit a slot.
+	uint64_t dropped;
+};
+
+struct SharedFrameReaderStats {
+	uint64_t read;
+	// Frames the writer published but that were overwritten before this
+	// reader got to them.
+	uint64_t missed;
+};
+
+// Ring of frame slots in named shared memory, written by one process and read
+// in place by any number of others. Each slot carries an atomic state word
+// with the sequence number of the frame in it, a writing flag and a count of
+// readers pinning it; the writer only reuses slots no reader pins, readers
+// only pin slots that are not being written, and neither side ever waits for
+// the other or takes a lock.
+//
+// The writer never blocks: when readers pin every slot the frame is dropped
+// and counted. A reader that falls behind skips to the oldest frame still in
+// the ring and counts what it missed. A reader process that dies while
+// pinning a slot keeps that slot out of use until the ring is created again.
+//
+// Slots are laid out like VideoFrameBufferPool buffers, so raw frames of any
+// type fit as long as they are no bigger than the description given to
+// Create(). MJPEG frames are not carried yet.
+class SharedFrameWriter {
+public:
+	SharedFrameWriter();
+	~SharedFrameWriter();
+
+	// Creates the ring |name| with |slot_count| slots, each big enough for a
+	// frame of |largest|. Pass at least one slot more than frames readers keep
+	// pinned at once.
+	bool Create(const std::string& name, const VideoDescription& largest, uint32_t slot_count);
+	// Readers that have the ring open keep reading what is left in it.
+	void Close();
+	bool IsOpen() const;
+
+	// Copies |video_frame| into the oldest free slot and publishes it.
+	bool Write(const VideoFrame& video_frame);
+
+	// Write() without the copy: points |video_frame| at a free slot for a
+	// frame of |description| for the caller to fill in, e.g. as the
+	// destination of a conversion. EndWrite() publishes it, with the
+	// timestamps and sequence set on |video_frame| by then. One frame at a
+	// time.
+	bool BeginWrite(const VideoDescription& description, VideoFrame& video_frame);
+	bool EndWrite(const VideoFrame& video_frame);
+	// Gives the slot of BeginWrite() back unpublished.
+	void CancelWrite();
+
+	SharedFrameWriterStats Stats() const;
+
+private:
+	SharedFrameWriter(const SharedFrameWriter&) = delete;
+	SharedFrameWriter operator =(const SharedFrameWriter&) = delete;
+
+	bool BeginWriteLocked(const VideoDescription& description, VideoFrame& video_frame);
+	void EndWriteLocked(const VideoFrame& video_frame);
+	void CancelWriteLocked();
+
+	mutable std::mutex mutex_{};
+	RefPtr<SharedMemory> memory_{};
+	SharedFrameRingHeader* header_{};
+	uint64_t sequence_{};
+	SharedFrameSlot* writing_slot_{};
+	SharedFrameWriterStats stats_{};
+};
+
+// Reads frames from a SharedFrameWriter in another process, oldest first.
+// Returned frames point into the shared memory and pin their slot until the
+// last copy of the frame is gone, so hold on to them no longer than needed.
+// Each reader keeps its own position; use one per thread.
+class SharedFrameReader {
+public:
+	SharedFrameReader();
+	~SharedFrameReader();
+
+	// Starts at the newest frame in the ring.
+	bool Open(const std::string& name);
+	void Close();
+	bool IsOpen() const;
+
+	// Takes the next frame without waiting; false when there is none yet.
+	bool TryRead(VideoFrame& video_frame);
+	// Polls for the next frame for up to |timeout|. Shared memory has no
+	// portable wake-up, so this sleeps a millisecond between polls.
+	bool Read(VideoFrame& video_frame, std::chrono::milliseconds timeout);
+
+	SharedFrameReaderStats Stats() const;
+
+private:
+	SharedFrameReader(const SharedFrameReader&) = delete;
+	SharedFrameReader operator =(const SharedFrameReader&) = delete;
+
+	bool PinSlot(SharedFrameSlot* slot, uint64_t sequence, VideoFrame& video_frame);
+
+	RefPtr<SharedMemory> memory_{};
+	SharedFrameRingHeader* header_{};
+	uint64_t last_sequence_{};
+	SharedFrameReaderStats stats_{};
+};
@@ -0,0 +1,212 @@
+// SharedFrameWriter and SharedFrameReader in one process on a ring of their
+// own: delivery order, readers that are lapped, slots pinned by readers and
+// released with the last copy of a frame, and the in-place write calls.
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "shared_frame_ring.h"
+#include "test_check.h"
+#include "time_utils.h"
+#include "video_frame_buffer.h"
+
+namespace {
+
+const uint32_t kWidth = 64;
+const uint32_t kHeight = 48;
+
+std::string UniqueName(const char* test) {
+	return std::string("shared_frame_ring_test_") + test + "_" + std::to_string(utils::TimeMicros());
+}
+
+VideoDescription Describe(uint32_t width, uint32_t height, VideoType video_type) {
+	VideoDescription description;
+	description.width = width;
+	description.height = height;
+	description.video_type = video_type;
+	return description;
+}
+
+// Writes an I420 frame whose samples all hold |value| and whose sequence is
+// |value| too.
+bool WriteFrame(SharedFrameWriter& writer, uint8_t value, uint32_t width = kWidth, uint32_t height = kHeight) {
+	VideoFrameBufferPool pool(1);
+	pool.Configure(Describe(width, height, kVideoTypeI420));
+	RefPtr<VideoFrameBuffer> buffer = pool.CreateBuffer();
+	if (!buffer) {
+		return false;
+	}
+	memset(buffer->Data(0), value, buffer->Size());
+	VideoFrame frame;
+	buffer->WrapVideoFrame(frame);
+	frame.sequence = value;
+	frame.timestamp_us = value * 1000;
+	return writer.Write(frame);
+}
+
+// Every visible sample of |frame| is |value|.
+bool HasValue(const VideoFrame& frame, uint8_t value) {
+	if (frame.width != kWidth || frame.height != kHeight || frame.video_type != kVideoTypeI420) {
+		return false;
+	}
+	for (uint32_t y = 0; y < frame.height; ++y) {
+		for (uint32_t x = 0; x < frame.width; ++x) {
+			if (frame.y_data[static_cast<size_t>(y) * frame.y_stride + x] != value) {
+				return false;
+			}
+		}
+	}
+	for (uint32_t y = 0; y < (frame.height + 1) / 2; ++y) {
+		for (uint32_t x = 0; x < (frame.width + 1) / 2; ++x) {
+			if (frame.u_data[static_cast<size_t>(y) * frame.u_stride + x] != value ||
+				frame.v_data[static_cast<size_t>(y) * frame.v_stride + x] != value) {
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+void TestInOrder() {
+	std::string name = UniqueName("order");
+	SharedFrameWriter writer;
+	CHECK(writer.Create(name, Describe(kWidth, kHeight, kVideoTypeI420), 4));
+	SharedFrameReader reader;
+	CHECK(reader.Open(name));
+	VideoFrame frame;
+	CHECK(!reader.TryRead(frame));
+	for (uint8_t value = 1; value <= 3; ++value) {
+		CHECK(WriteFrame(writer, value));
+	}
+	for (uint8_t value = 1; value <= 3; ++value) {
+		CHECK(reader.TryRead(frame));
+		CHECK(frame.sequence == value && frame.timestamp_us == value * 1000);
+		CHECK(HasValue(frame, value));
+		frame = VideoFrame();
+	}
+	CHECK(!reader.TryRead(frame));
+	CHECK(reader.Stats().read == 3 && reader.Stats().missed == 0);
+	CHECK(writer.Stats().written == 3 && writer.Stats().dropped == 0);
+
+	SharedFrameReader missing;
+	CHECK(!missing.Open(name + "_missing"));
+}
+
+void TestLapped() {
+	std::string name = UniqueName("lapped");
+	SharedFrameWriter writer;
+	CHECK(writer.Create(name, Describe(kWidth, kHeight, kVideoTypeI420), 4));
+	SharedFrameReader reader;
+	CHECK(reader.Open(name));
+	for (uint8_t value = 1; value <= 10; ++value) {
+		CHECK(WriteFrame(writer, value));
+	}
+	// Only 7 to 10 are left in the ring.
+	VideoFrame frame;
+	for (uint8_t value = 7; value <= 10; ++value) {
+		CHECK(reader.TryRead(frame));
+		CHECK(frame.sequence == value && HasValue(frame, value));
+		frame = VideoFrame();
+	}
+	CHECK(!reader.TryRead(frame));
+	CHECK(reader.Stats().read == 4 && reader.Stats().missed == 6);
+}
+
+void TestPinnedSlots() {
+	std::string name = UniqueName("pinned");
+	SharedFrameWriter writer;
+	CHECK(writer.Create(name, Describe(kWidth, kHeight, kVideoTypeI420), 3));
+	SharedFrameReader reader;
+	CHECK(reader.Open(name));
+	std::vector<VideoFrame> held(3);
+	for (uint8_t value = 1; value <= 3; ++value) {
+		CHECK(WriteFrame(writer, value));
+		CHECK(reader.TryRead(held[value - 1]));
+	}
+	// Every slot is pinned: the writer drops instead of waiting.
+	CHECK(!WriteFrame(writer, 4));
+	CHECK(writer.Stats().dropped == 1);
+
+	// A copy keeps the slot pinned after the frame it came from is gone.
+	VideoFrame copy = held[0];
+	held[0] = VideoFrame();
+	CHECK(!WriteFrame(writer, 4));
+	CHECK(writer.Stats().dropped == 2);
+	CHECK(HasValue(copy, 1));
+	copy = VideoFrame();
+	CHECK(WriteFrame(writer, 4));
+	CHECK(writer.Stats().written == 4 && writer.Stats().dropped == 2);
+
+	// The frames still held were not touched by the write.
+	CHECK(HasValue(held[1], 2) && HasValue(held[2], 3));
+	VideoFrame frame;
+	CHECK(reader.TryRead(frame) && frame.sequence == 4 && HasValue(frame, 4));
+}
+
+void TestWriteInPlace() {
+	std::string name = UniqueName("in_place");
+	SharedFrameWriter writer;
+	VideoDescription description = Describe(kWidth, kHeight, kVideoTypeI420);
+	CHECK(writer.Create(name, description, 2));
+	SharedFrameReader reader;
+	CHECK(reader.Open(name));
+
+	VideoFrame slot;
+	CHECK(writer.BeginWrite(description, slot));
+	VideoFrame second;
+	CHECK(!writer.BeginWrite(description, second));
+	memset(slot.y_data, 9, static_cast<size_t>(slot.y_stride) * kHeight);
+	memset(slot.u_data, 9, static_cast<size_t>(slot.u_stride) * (kHeight / 2));
+	memset(slot.v_data, 9, static_cast<size_t>(slot.v_stride) * (kHeight / 2));
+	slot.sequence = 9;
+	// Not visible before EndWrite().
+	VideoFrame frame;
+	CHECK(!reader.TryRead(frame));
+	CHECK(writer.EndWrite(slot));
+	CHECK(!writer.EndWrite(slot));
+	CHECK(reader.TryRead(frame) && frame.sequence == 9 && HasValue(frame, 9));
+	frame = VideoFrame();
+
+	// A cancelled write publishes nothing and gives the slot back.
+	CHECK(writer.BeginWrite(description, slot));
+	memset(slot.y_data, 0, static_cast<size_t>(slot.y_stride) * kHeight);
+	writer.CancelWrite();
+	CHECK(!writer.EndWrite(slot));
+	CHECK(!reader.TryRead(frame));
+	CHECK(WriteFrame(writer, 10));
+	CHECK(WriteFrame(writer, 11));
+	CHECK(reader.TryRead(frame) && frame.sequence == 10 && HasValue(frame, 10));
+	CHECK(reader.TryRead(frame) && frame.sequence == 11 && HasValue(frame, 11));
+	CHECK(reader.Stats().missed == 0);
+	CHECK(writer.Stats().written == 3 && writer.Stats().dropped == 0);
+}
+
+void TestTooLarge() {
+	std::string name = UniqueName("too_large");
+	SharedFrameWriter writer;
+	CHECK(writer.Create(name, Describe(kWidth, kHeight, kVideoTypeI420), 2));
+	SharedFrameReader reader;
+	CHECK(reader.Open(name));
+	CHECK(!WriteFrame(writer, 1, kWidth * 2, kHeight * 2));
+	VideoFrame slot;
+	CHECK(!writer.BeginWrite(Describe(kWidth * 2, kHeight, kVideoTypeI420), slot));
+	CHECK(!writer.BeginWrite(Describe(kWidth, kHeight, kVideoTypeMJPEG), slot));
+	CHECK(writer.Stats().dropped == 3 && writer.Stats().written == 0);
+	VideoFrame frame;
+	CHECK(!reader.TryRead(frame));
+	// Smaller frames still fit.
+	CHECK(writer.BeginWrite(Describe(kWidth / 2, kHeight / 2, kVideoTypeNV12), slot));
+	CHECK(writer.EndWrite(slot));
+	CHECK(reader.TryRead(frame) && frame.width == kWidth / 2 && frame.video_type == kVideoTypeNV12);
+}
+
+}
+
+int main() {
+	TestInOrder();
+	TestLapped();
+	TestPinnedSlots();
+	TestWriteInPlace();
+	TestTooLarge();
+	return test::Result();
+}
@@ -0,0 +1,136 @@
+#include "shared_memory.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+#ifdef _WIN32
+std::wstring GetMappingName(const std::string& name) {
+	std::wstring wide_name;
+	int length = MultiByteToWideChar(CP_UTF8, 0, name.c_str(), -1, nullptr, 0);
+	if (length > 0) {
+		wide_name.resize(length);
+		MultiByteToWideChar(CP_UTF8, 0, name.c_str(), -1, &wide_name[0], length);
+		wide_name.resize(length - 1);
+	}
+	// Session local, so it does not need SeCreateGlobalPrivilege.
+	return L"Local\\" + wide_name;
+}
+#else
+std::string GetObjectName(const std::string& name) {
+	return name.empty() || name[0] != '/' ? "/" + name : name;
+}
+#endif
+
+}
+
+RefPtr<SharedMemory> SharedMemory::Create(const std::string& name, size_t size) {
+	if (name.empty() || size == 0) {
+		return nullptr;
+	}
+	RefPtr<SharedMemory> memory(new SharedMemory());
+#ifdef _WIN32
+	uint64_t mapping_size = size;
+	memory->mapping_ = CreateFileMappingW(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE,
+		static_cast<DWORD>(mapping_size >> 32), static_cast<DWORD>(mapping_size), GetMappingName(name).c_str());
+	if (!memory->mapping_) {
+		return nullptr;
+	}
+	if (GetLastError() == ERROR_ALREADY_EXISTS) {
+		return nullptr;
+	}
+	memory->data_ = static_cast<uint8_t*>(MapViewOfFile(memory->mapping_, FILE_MAP_ALL_ACCESS, 0, 0, size));
+	if (!memory->data_) {
+		return nullptr;
+	}
+#else
+	std::string object_name = GetObjectName(name);
+	shm_unlink(object_name.c_str());
+	memory->fd_ = shm_open(object_name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+	if (memory->fd_ < 0) {
+		return nullptr;
+	}
+	memory->unlink_name_ = object_name;
+	if (ftruncate(memory->fd_, static_cast<off_t>(size)) != 0) {
+		return nullptr;
+	}
+	void* data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, memory->fd_, 0);
+	if (data == MAP_FAILED) {
+		return nullptr;
+	}
+	memory->data_ = static_cast<uint8_t*>(data);
+#endif
+	memory->size_ = size;
+	return memory;
+}
+
+RefPtr<SharedMemory> SharedMemory::Open(const std::string& name) {
+	if (name.empty()) {
+		return nullptr;
+	}
+	RefPtr<SharedMemory> memory(new SharedMemory());
+#ifdef _WIN32
+	memory->mapping_ = OpenFileMappingW(FILE_MAP_ALL_ACCESS, FALSE, GetMappingName(name).c_str());
+	if (!memory->mapping_) {
+		return nullptr;
+	}
+	memory->data_ = static_cast<uint8_t*>(MapViewOfFile(memory->mapping_, FILE_MAP_ALL_ACCESS, 0, 0, 0));
+	if (!memory->data_) {
+		return nullptr;
+	}
+	MEMORY_BASIC_INFORMATION info;
+	if (!VirtualQuery(memory->data_, &info, sizeof(info))) {
+		return nullptr;
+	}
+	memory->size_ = info.RegionSize;
+#else
+	memory->fd_ = shm_open(GetObjectName(name).c_str(), O_RDWR, 0);
+	if (memory->fd_ < 0) {
+		return nullptr;
+	}
+	struct stat status;
+	if (fstat(memory->fd_, &status) != 0 || status.st_size <= 0) {
+		return nullptr;
+	}
+	void* data = mmap(nullptr, static_cast<size_t>(status.st_size), PROT_READ | PROT_WRITE, MAP_SHARED,
+		memory->fd_, 0);
+	if (data == MAP_FAILED) {
+		return nullptr;
+	}
+	memory->data_ = static_cast<uint8_t*>(data);
+	memory->size_ = static_cast<size_t>(status.st_size);
+#endif
+	return memory;
+}
+
+SharedMemory::SharedMemory() {
+
+}
+
+SharedMemory::~SharedMemory() {
+#ifdef _WIN32
+	if (data_) {
+		UnmapViewOfFile(data_);
+	}
+	if (mapping_) {
+		CloseHandle(mapping_);
+	}
+#else
+	if (data_) {
+		munmap(data_, size_);
+	}
+	if (fd_ >= 0) {
+		close(fd_);
+	}
+	if (!unlink_name_.empty()) {
+		shm_unlink(unlink_name_.c_str());
+	}
+#endif
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "ref_counted.h"
+
+// Named memory shared between processes: POSIX shared memory, or a paging
+// file backed mapping on Windows. Frames that point into the memory hold a
+// reference to it, like MappedFile.
+class SharedMemory : public RefCountedBase {
+public:
+	// Creates |name| with |size| zeroed bytes. On POSIX a name left behind by
+	// a process that died is replaced; the creator removes the name again when
+	// the memory is released, processes that still have it open keep their
+	// mapping. On Windows Create() fails while the name is in use.
+	static RefPtr<SharedMemory> Create(const std::string& name, size_t size);
+	// Opens memory made by Create() in any process.
+	static RefPtr<SharedMemory> Open(const std::string& name);
+
+	uint8_t* Data() const { return data_; }
+	size_t Size() const { return size_; }
+
+private:
+	SharedMemory();
+	~SharedMemory();
+
+	SharedMemory(const SharedMemory&) = delete;
+	SharedMemory operator =(const SharedMemory&) = delete;
+
+	uint8_t* data_{};
+	size_t size_{};
+#ifdef _WIN32
+	void* mapping_{};
+#else
+	int fd_{ -1 };
+	std::string unlink_name_{};
+#endif
+};
@@ -0,0 +1,30 @@
+#pragma once
+#include <cstdio>
+
+// Minimal checks for the test executables. Failures are printed and counted,
+// and main() returns test::Result() so ctest sees the outcome.
+namespace test {
+
+inline int& FailureCount() {
+	static int failures = 0;
+	return failures;
+}
+
+inline int Result() {
+	if (FailureCount() == 0) {
+		printf("all checks passed\n");
+		return 0;
+	}
+	printf("%d checks failed\n", FailureCount());
+	return 1;
+}
+
+}
+
+#define CHECK(condition) \
+	do { \
+		if (!(condition)) { \
+			++test::FailureCount(); \
+			fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+		} \
+	} while (0)
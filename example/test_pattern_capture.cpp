@@ -0,0 +1,329 @@
+#include "test_pattern_capture.h"
+
+#include <chrono>
+#include <cstring>
+
+#include "time_utils.h"
+#include "video_convert.h"
+
+namespace {
+
+struct YuvColor {
+	uint8_t y;
+	uint8_t u;
+	uint8_t v;
+};
+
+// 75% white, yellow, cyan, green, magenta, red, blue and black in BT.601
+// limited range.
+const YuvColor kColorBars[8] = {
+	{ 180, 128, 128 }, { 162, 44, 142 }, { 131, 156, 44 }, { 112, 72, 58 },
+	{ 84, 184, 198 }, { 65, 100, 212 }, { 35, 212, 114 }, { 16, 128, 128 },
+};
+
+// 3x5 glyphs for 0-9, one row per 3 bits, most significant bit leftmost.
+const uint8_t kDigitGlyphs[10][5] = {
+	{ 7, 5, 5, 5, 7 }, { 2, 6, 2, 2, 7 }, { 7, 1, 7, 4, 7 }, { 7, 1, 7, 1, 7 }, { 5, 5, 7, 1, 1 },
+	{ 7, 4, 7, 1, 7 }, { 7, 4, 7, 5, 7 }, { 7, 1, 1, 1, 1 }, { 7, 5, 7, 5, 7 }, { 7, 5, 7, 1, 7 },
+};
+
+bool IsDirectlyRendered(VideoType video_type) {
+	return video_type == kVideoTypeI420 || video_type == kVideoTypeIYUV || video_type == kVideoTypeYV12 ||
+		video_type == kVideoTypeNV12 || video_type == kVideoTypeNV21;
+}
+
+// Distance between two chroma samples of one plane, 2 for interleaved UV.
+uint32_t ChromaStep(const VideoFrame& video_frame) {
+	return (video_frame.video_type == kVideoTypeNV12 || video_frame.video_type == kVideoTypeNV21) ? 2 : 1;
+}
+
+uint64_t NextRandom(uint64_t& state) {
+	state ^= state << 13;
+	state ^= state >> 7;
+	state ^= state << 17;
+	return state;
+}
+
+}
+
+TestPatternCapture::TestPatternCapture() {
+
+}
+
+TestPatternCapture::~TestPatternCapture() {
+	FinishOperations();
+	StopCapture();
+}
+
+bool TestPatternCapture::StartCapture(const VideoDevice&, const VideoDescription& video_description) {
+	StopCapture();
+	if (!Configure(video_description)) {
+		return false;
+	}
+	frame_index_ = 0;
+	frames_delivered_ = 0;
+	frames_dropped_ = 0;
+	clock_.Start(fps_ >= 0.0 ? fps_ : video_description.fps);
+	thread_ = std::thread(&TestPatternCapture::Run, this);
+	return true;
+}
+
+bool TestPatternCapture::StopCapture() {
+	StopRendering();
+	return true;
+}
+
+bool TestPatternCapture::SwitchFormat(const VideoDescription& video_description) {
+	if (!thread_.joinable()) {
+		return false;
+	}
+	// Subclasses model the device open and close in StartCapture() and
+	// StopCapture(); a switch only restarts the render thread.
+	VideoDescription old_description = video_description_;
+	StopRendering();
+	BeginFormatSwitch();
+	bool configured = Configure(video_description);
+	if (!configured) {
+		Configure(old_description);
+	}
+	// The pattern and frame counter carry on where the old mode stopped.
+	clock_.Start(fps_ >= 0.0 ? fps_ : video_description_.fps);
+	thread_ = std::thread(&TestPatternCapture::Run, this);
+	return configured;
+}
+
+void TestPatternCapture::StopRendering() {
+	clock_.Stop();
+	if (thread_.joinable()) {
+		thread_.join();
+	}
+}
+
+bool TestPatternCapture::Configure(const VideoDescription& video_description) {
+	if (video_description.width == 0 || video_description.height == 0) {
+		return false;
+	}
+	if (!IsDirectlyRendered(video_description.video_type) &&
+		!CanConvertVideoFrame(kVideoTypeI420, video_description.video_type)) {
+		return false;
+	}
+	if (!frame_pool_.Configure(video_description)) {
+		return false;
+	}
+	VideoDescription render_description = video_description;
+	render_description.video_type = kVideoTypeI420;
+	if (!render_pool_.Configure(render_description)) {
+		return false;
+	}
+	video_description_ = video_description;
+	return true;
+}
+
+void TestPatternCapture::SetPattern(TestPattern pattern) {
+	pattern_ = pattern;
+}
+
+void TestPatternCapture::SetFrameRate(double fps) {
+	fps_ = fps;
+}
+
+void TestPatternCapture::SetFrameCounter(bool enabled) {
+	frame_counter_ = enabled;
+}
+
+uint64_t TestPatternCapture::FramesDelivered() const {
+	return frames_delivered_;
+}
+
+uint64_t TestPatternCapture::FramesDropped() const {
+	return frames_dropped_;
+}
+
+void TestPatternCapture::Run() {
+	while (clock_.Wait()) {
+		int64_t timestamp_us = utils::TimeMicros();
+		if (!AcceptFrame(timestamp_us)) {
+			++frame_index_;
+			continue;
+		}
+		VideoFrame video_frame;
+		video_frame.sequence = NextSequence();
+		if (!frame_pool_.CreateFrame(video_frame)) {
+			++frames_dropped_;
+			++frame_index_;
+			if (clock_.Fps() == 0.0) {
+				std::this_thread::yield();
+			}
+			continue;
+		}
+		video_frame.timestamp_us = timestamp_us;
+		video_frame.arrival_us = timestamp_us;
+		if (!RenderFrame(frame_index_, video_frame)) {
+			++frames_dropped_;
+			++frame_index_;
+			continue;
+		}
+		++frame_index_;
+		++frames_delivered_;
+		DeliverFrame(video_frame);
+	}
+}
+
+bool TestPatternCapture::RenderFrame(uint64_t frame_index, VideoFrame& video_frame) {
+	VideoFrame render_frame;
+	if (IsDirectlyRendered(video_frame.video_type)) {
+		render_frame = video_frame;
+	}
+	else if (!render_pool_.CreateFrame(render_frame)) {
+		return false;
+	}
+	switch (pattern_) {
+	case kTestPatternColorBars:
+		RenderColorBars(frame_index, render_frame);
+		break;
+	case kTestPatternGradient:
+		RenderGradient(frame_index, render_frame);
+		break;
+	case kTestPatternNoise:
+		RenderNoise(render_frame);
+		break;
+	}
+	if (frame_counter_) {
+		RenderFrameCounter(frame_index, render_frame);
+	}
+	if (render_frame.y_data != video_frame.y_data) {
+		render_frame.timestamp_us = video_frame.timestamp_us;
+		return ConvertVideoFrame(render_frame, video_frame);
+	}
+	return true;
+}
+
+void TestPatternCapture::RenderColorBars(uint64_t frame_index, VideoFrame& video_frame) {
+	uint32_t width = video_frame.width;
+	uint32_t chroma_width = (width + 1) / 2;
+	uint32_t chroma_height = (video_frame.height + 1) / 2;
+	uint32_t step = ChromaStep(video_frame);
+	uint32_t offset = static_cast<uint32_t>((frame_index * 4) % width);
+	// Bars are vertical, so render the first row of each plane and copy it down.
+	uint8_t* y_row = video_frame.y_data;
+	for (uint32_t x = 0; x < width; ++x) {
+		y_row[x] = kColorBars[((x + offset) % width) * 8 / width].y;
+	}
+	uint8_t* u_row = video_frame.u_data;
+	uint8_t* v_row = video_frame.v_data;
+	for (uint32_t x = 0; x < chroma_width; ++x) {
+		const YuvColor& color = kColorBars[((x * 2 + offset) % width) * 8 / width];
+		u_row[x * step] = color.u;
+		v_row[x * step] = color.v;
+	}
+	for (uint32_t y = 1; y < video_frame.height; ++y) {
+		memcpy(video_frame.y_data + static_cast<size_t>(y) * video_frame.y_stride, y_row, width);
+	}
+	for (uint32_t y = 1; y < chroma_height; ++y) {
+		if (step == 2) {
+			// One interleaved row carries both planes.
+			uint8_t* uv_row = u_row < v_row ? u_row : v_row;
+			memcpy(uv_row + static_cast<size_t>(y) * video_frame.u_stride, uv_row, chroma_width * 2);
+		}
+		else {
+			memcpy(u_row + static_cast<size_t>(y) * video_frame.u_stride, u_row, chroma_width);
+			memcpy(v_row + static_cast<size_t>(y) * video_frame.v_stride, v_row, chroma_width);
+		}
+	}
+}
+
+void TestPatternCapture::RenderGradient(uint64_t frame_index, VideoFrame& video_frame) {
+	uint32_t chroma_width = (video_frame.width + 1) / 2;
+	uint32_t chroma_height = (video_frame.height + 1) / 2;
+	uint32_t step = ChromaStep(video_frame);
+	uint32_t phase = static_cast<uint32_t>(frame_index);
+	for (uint32_t y = 0; y < video_frame.height; ++y) {
+		uint8_t* row = video_frame.y_data + static_cast<size_t>(y) * video_frame.y_stride;
+		for (uint32_t x = 0; x < video_frame.width; ++x) {
+			row[x] = static_cast<uint8_t>(x + y + phase);
+		}
+	}
+	for (uint32_t y = 0; y < chroma_height; ++y) {
+		uint8_t* u_row = video_frame.u_data + static_cast<size_t>(y) * video_frame.u_stride;
+		uint8_t* v_row = video_frame.v_data + static_cast<size_t>(y) * video_frame.v_stride;
+		for (uint32_t x = 0; x < chroma_width; ++x) {
+			u_row[x * step] = static_cast<uint8_t>(x * 2 + phase);
+			v_row[x * step] = static_cast<uint8_t>(y * 2 - phase);
+		}
+	}
+}
+
+void TestPatternCapture::RenderNoise(VideoFrame& video_frame) {
+	uint32_t chroma_width = (video_frame.width + 1) / 2;
+	uint32_t chroma_height = (video_frame.height + 1) / 2;
+	uint32_t step = ChromaStep(video_frame);
+	uint8_t* planes[3] = { video_frame.y_data, video_frame.u_data, video_frame.v_data };
+	uint32_t strides[3] = { video_frame.y_stride, video_frame.u_stride, video_frame.v_stride };
+	uint32_t row_bytes[3] = { video_frame.width, chroma_width, chroma_width };
+	uint32_t rows[3] = { video_frame.height, chroma_height, chroma_height };
+	// Interleaved chroma is one plane of twice the width.
+	int plane_count = 3;
+	if (step == 2) {
+		planes[1] = video_frame.u_data < video_frame.v_data ? video_frame.u_data : video_frame.v_data;
+		row_bytes[1] = chroma_width * 2;
+		plane_count = 2;
+	}
+	for (int plane = 0; plane < plane_count; ++plane) {
+		for (uint32_t y = 0; y < rows[plane]; ++y) {
+			uint8_t* row = planes[plane] + static_cast<size_t>(y) * strides[plane];
+			uint32_t x = 0;
+			for (; x + 8 <= row_bytes[plane]; x += 8) {
+				uint64_t value = NextRandom(noise_state_);
+				memcpy(row + x, &value, 8);
+			}
+			if (x < row_bytes[plane]) {
+				uint64_t value = NextRandom(noise_state_);
+				memcpy(row + x, &value, row_bytes[plane] - x);
+			}
+		}
+	}
+}
+
+void TestPatternCapture::RenderFrameCounter(uint64_t frame_index, VideoFrame& video_frame) {
+	char digits[24];
+	int count = 0;
+	do {
+		digits[count++] = static_cast<char>(frame_index % 10);
+		frame_index /= 10;
+	} while (frame_index);
+	// Glyphs are 3x5 cells plus a cell of spacing, scaled to stay readable.
+	uint32_t scale = video_frame.height >= 60 ? video_frame.height / 60 : 1;
+	uint32_t box_width = (count * 4 + 1) * scale;
+	uint32_t box_height = 7 * scale;
+	if (box_width > video_frame.width) {
+		box_width = video_frame.width;
+	}
+	if (box_height > video_frame.height) {
+		box_height = video_frame.height;
+	}
+	for (uint32_t y = 0; y < box_height; ++y) {
+		uint8_t* row = video_frame.y_data + static_cast<size_t>(y) * video_frame.y_stride;
+		uint32_t cell_y = y / scale;
+		for (uint32_t x = 0; x < box_width; ++x) {
+			uint32_t cell_x = x / scale;
+			uint8_t value = 16;
+			if (cell_y >= 1 && cell_y <= 5 && cell_x >= 1 && (cell_x - 1) % 4 < 3) {
+				int digit = digits[count - 1 - static_cast<int>((cell_x - 1) / 4)];
+				uint32_t bit = 2 - (cell_x - 1) % 4;
+				if ((kDigitGlyphs[digit][cell_y - 1] >> bit) & 1) {
+					value = 235;
+				}
+			}
+			row[x] = value;
+		}
+	}
+	uint32_t step = ChromaStep(video_frame);
+	for (uint32_t y = 0; y < (box_height + 1) / 2; ++y) {
+		uint8_t* u_row = video_frame.u_data + static_cast<size_t>(y) * video_frame.u_stride;
+		uint8_t* v_row = video_frame.v_data + static_cast<size_t>(y) * video_frame.v_stride;
+		for (uint32_t x = 0; x < (box_width + 1) / 2; ++x) {
+			u_row[x * step] = 128;
+			v_row[x * step] = 128;
+		}
+	}
+}
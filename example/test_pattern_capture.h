@@ -0,0 +1,70 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <thread>
+
+#include "frame_clock.h"
+#include "video_capture.h"
+
+enum TestPattern {
+	// Eight 75% bars scrolling left by four pixels per frame.
+	kTestPatternColorBars,
+	// Diagonal luma ramp with chroma ramps, all moving with the frame count.
+	kTestPatternGradient,
+	// Uniform random bytes in every plane, the worst case for compression and
+	// frame differencing.
+	kTestPatternNoise,
+};
+
+// Camera-less VideoCapture that renders test patterns on its own thread at
+// the requested rate, so the whole callback pipeline can run on machines
+// without a camera. Any size and any format ConvertVideoFrame() can produce
+// from I420 are supported. The device passed to StartCapture() is ignored.
+class TestPatternCapture : public VideoCapture {
+public:
+	TestPatternCapture();
+	~TestPatternCapture();
+
+	// A description fps of 0, like SetFrameRate(0), renders frames as fast as
+	// the callback takes them.
+	bool StartCapture(const VideoDevice& video_device, const VideoDescription& video_description) override;
+	bool StopCapture() override;
+
+	void SetPattern(TestPattern pattern);
+	// Overrides the integer description rate, e.g. 29.97, also across
+	// Reconfigure(). Call while stopped.
+	void SetFrameRate(double fps);
+	// Burns the frame number into the top left corner of every frame.
+	void SetFrameCounter(bool enabled);
+
+	uint64_t FramesDelivered() const;
+	// Frames skipped because every pooled buffer was still held downstream.
+	uint64_t FramesDropped() const;
+
+protected:
+	bool SwitchFormat(const VideoDescription& video_description) override;
+
+private:
+	bool Configure(const VideoDescription& video_description);
+	void StopRendering();
+	void Run();
+	bool RenderFrame(uint64_t frame_index, VideoFrame& video_frame);
+	void RenderColorBars(uint64_t frame_index, VideoFrame& video_frame);
+	void RenderGradient(uint64_t frame_index, VideoFrame& video_frame);
+	void RenderNoise(VideoFrame& video_frame);
+	void RenderFrameCounter(uint64_t frame_index, VideoFrame& video_frame);
+
+	std::atomic<TestPattern> pattern_{ kTestPatternColorBars };
+	double fps_{ -1.0 };
+	std::atomic<bool> frame_counter_{ true };
+	uint64_t noise_state_{ 0x9e3779b97f4a7c15ull };
+	// Planar I420 frame rendered into before converting to packed formats.
+	VideoFrameBufferPool render_pool_{ 1 };
+
+	std::thread thread_{};
+	FrameClock clock_{};
+	// Only touched by the render thread.
+	uint64_t frame_index_{};
+	std::atomic<uint64_t> frames_delivered_{ 0 };
+	std::atomic<uint64_t> frames_dropped_{ 0 };
+};
@@ -0,0 +1,117 @@
+#include "thread_pool.h"
+
+#include <atomic>
+#include <memory>
+
+#include "thread_utils.h"
+
+ThreadPool::ThreadPool(size_t thread_count) {
+	Start(thread_count, std::vector<int>());
+}
+
+ThreadPool::ThreadPool(size_t thread_count, const std::vector<int>& cpus) {
+	Start(thread_count, cpus);
+}
+
+ThreadPool::~ThreadPool() {
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		stopped_ = true;
+	}
+	condition_.notify_all();
+	for (size_t i = 0; i < threads_.size(); ++i) {
+		threads_[i].join();
+	}
+}
+
+void ThreadPool::PostTask(Task task) {
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		tasks_.push_back(std::move(task));
+	}
+	condition_.notify_one();
+}
+
+void ThreadPool::ParallelFor(size_t count, const std::function<void(size_t)>& function) {
+	if (count == 0) {
+		return;
+	}
+	struct State {
+		std::atomic<size_t> next{ 0 };
+		size_t active{};
+		bool finished{};
+		std::mutex mutex;
+		std::condition_variable done;
+		const std::function<void(size_t)>* function{};
+		size_t count{};
+
+		void Work() {
+			size_t index;
+			while ((index = next.fetch_add(1)) < count) {
+				(*function)(index);
+			}
+		}
+	};
+	std::shared_ptr<State> state = std::make_shared<State>();
+	state->function = &function;
+	state->count = count;
+	size_t helpers = threads_.size() < count - 1 ? threads_.size() : count - 1;
+	for (size_t i = 0; i < helpers; ++i) {
+		// Helpers that only get scheduled after the caller finished (e.g. every
+		// worker is itself inside ParallelFor) see |finished| and return.
+		PostTask([state]() {
+			{
+				std::lock_guard<std::mutex> lock(state->mutex);
+				if (state->finished) {
+					return;
+				}
+				++state->active;
+			}
+			state->Work();
+			std::lock_guard<std::mutex> lock(state->mutex);
+			if (--state->active == 0) {
+				state->done.notify_one();
+			}
+		});
+	}
+	state->Work();
+	std::unique_lock<std::mutex> lock(state->mutex);
+	state->finished = true;
+	state->done.wait(lock, [&state]() { return state->active == 0; });
+}
+
+size_t ThreadPool::ThreadCount() const {
+	return threads_.size();
+}
+
+void ThreadPool::Start(size_t thread_count, const std::vector<int>& cpus) {
+	if (thread_count == 0) {
+		thread_count = cpus.empty() ? std::thread::hardware_concurrency() : cpus.size();
+	}
+	if (thread_count == 0) {
+		thread_count = 1;
+	}
+	for (size_t i = 0; i < thread_count; ++i) {
+		int cpu = cpus.empty() ? -1 : cpus[i % cpus.size()];
+		threads_.push_back(std::thread(&ThreadPool::Run, this, cpu));
+	}
+}
+
+void ThreadPool::Run(int cpu) {
+	if (cpu >= 0) {
+		utils::SetCurrentThreadAffinity(cpu);
+	}
+	for (;;) {
+		Task task;
+		{
+			std::unique_lock<std::mutex> lock(mutex_);
+			condition_.wait(lock, [this]() { return stopped_ || !tasks_.empty(); });
+			if (tasks_.empty()) {
+				return;
+			}
+			task = std::move(tasks_.front());
+			tasks_.pop_front();
+		}
+		task();
+	}
+}
@@ -0,0 +1,42 @@
+#pragma once
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class ThreadPool {
+public:
+	using Task = std::function<void()>;
+
+	// 0 picks one thread per hardware core.
+	explicit ThreadPool(size_t thread_count = 0);
+	// Pins worker i to logical CPU cpus[i % cpus.size()]; 0 threads starts one
+	// per listed CPU. Lets several cameras share a fixed set of cores instead
+	// of oversubscribing all of them.
+	ThreadPool(size_t thread_count, const std::vector<int>& cpus);
+	~ThreadPool();
+
+	void PostTask(Task task);
+
+	// Calls |function| for every index in [0, count) on the workers and the
+	// calling thread, and returns once all calls are done.
+	void ParallelFor(size_t count, const std::function<void(size_t)>& function);
+
+	size_t ThreadCount() const;
+
+private:
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool operator =(const ThreadPool&) = delete;
+
+	void Start(size_t thread_count, const std::vector<int>& cpus);
+	void Run(int cpu);
+
+	std::vector<std::thread> threads_{};
+	std::deque<Task> tasks_{};
+	std::mutex mutex_{};
+	std::condition_variable condition_{};
+	bool stopped_{};
+};
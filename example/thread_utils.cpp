@@ -0,0 +1,164 @@
+#include "thread_utils.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#include <objbase.h>
+#include <avrt.h>
+#pragma comment(lib, "avrt.lib")
+#else
+#include <pthread.h>
+#include <sched.h>
+#ifdef __linux__
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+#endif
+
+namespace
+{
+#ifdef _WIN32
+	// MMCSS registration of the calling thread, undone when it leaves the
+	// realtime class.
+	thread_local HANDLE mmcss_task = nullptr;
+
+	void LeaveMmcssTask()
+	{
+		if (mmcss_task) {
+			AvRevertMmThreadCharacteristics(mmcss_task);
+			mmcss_task = nullptr;
+		}
+	}
+#endif
+}
+
+namespace utils
+{
+	bool SetCurrentThreadAffinity(int cpu)
+	{
+		if (cpu < 0) {
+			return false;
+		}
+#ifdef _WIN32
+		if (cpu >= static_cast<int>(sizeof(DWORD_PTR) * 8)) {
+			return false;
+		}
+		return SetThreadAffinityMask(GetCurrentThread(), static_cast<DWORD_PTR>(1) << cpu) != 0;
+#elif defined(__linux__)
+		if (cpu >= CPU_SETSIZE) {
+			return false;
+		}
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		CPU_SET(cpu, &set);
+		return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+		// macOS only offers affinity hints, not pinning.
+		return false;
+#endif
+	}
+
+	bool SetCurrentThreadAffinityMask(uint64_t mask)
+	{
+		if (mask == 0) {
+			return false;
+		}
+#ifdef _WIN32
+		DWORD_PTR thread_mask = static_cast<DWORD_PTR>(mask);
+		if (thread_mask != mask) {
+			return false;
+		}
+		return SetThreadAffinityMask(GetCurrentThread(), thread_mask) != 0;
+#elif defined(__linux__)
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		for (int cpu = 0; cpu < 64 && cpu < CPU_SETSIZE; ++cpu) {
+			if (mask & (static_cast<uint64_t>(1) << cpu)) {
+				CPU_SET(cpu, &set);
+			}
+		}
+		return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+		return false;
+#endif
+	}
+
+	bool SetCurrentThreadPriority(ThreadPriority priority, int realtime_priority)
+	{
+		if (priority == kThreadPriorityDefault) {
+			return true;
+		}
+#ifdef _WIN32
+		if (priority == kThreadPriorityRealtime) {
+			if (!mmcss_task) {
+				DWORD task_index = 0;
+				mmcss_task = AvSetMmThreadCharacteristicsW(L"Capture", &task_index);
+			}
+			return mmcss_task && AvSetMmThreadPriority(mmcss_task, AVRT_PRIORITY_HIGH);
+		}
+		LeaveMmcssTask();
+		int thread_priority = priority == kThreadPriorityHigh ? THREAD_PRIORITY_HIGHEST : THREAD_PRIORITY_NORMAL;
+		return SetThreadPriority(GetCurrentThread(), thread_priority) != 0;
+#else
+		sched_param param = {};
+		if (priority == kThreadPriorityRealtime) {
+			int min_priority = sched_get_priority_min(SCHED_FIFO);
+			int max_priority = sched_get_priority_max(SCHED_FIFO);
+			param.sched_priority = realtime_priority < min_priority ? min_priority :
+				realtime_priority > max_priority ? max_priority : realtime_priority;
+			return pthread_setschedparam(pthread_self(), SCHED_FIFO, &param) == 0;
+		}
+		if (pthread_setschedparam(pthread_self(), SCHED_OTHER, &param) != 0) {
+			return false;
+		}
+#ifdef __linux__
+		// Linux keeps a nice value per thread, addressed by its tid.
+		id_t tid = static_cast<id_t>(syscall(SYS_gettid));
+		return setpriority(PRIO_PROCESS, tid, priority == kThreadPriorityHigh ? -10 : 0) == 0;
+#else
+		return priority == kThreadPriorityNormal;
+#endif
+#endif
+	}
+
+	bool ApplyThreadConfig(const ThreadConfig& config)
+	{
+		bool applied = true;
+		if (config.affinity_mask) {
+			applied = SetCurrentThreadAffinityMask(config.affinity_mask);
+		}
+		if (!SetCurrentThreadPriority(config.priority, config.realtime_priority)) {
+			applied = false;
+		}
+		return applied;
+	}
+
+	int GetCurrentCpu()
+	{
+#ifdef _WIN32
+		return static_cast<int>(GetCurrentProcessorNumber());
+#elif defined(__linux__)
+		return sched_getcpu();
+#else
+		return -1;
+#endif
+	}
+
+	ScopedComApartment::ScopedComApartment()
+	{
+#ifdef _WIN32
+		// S_FALSE (already in the MTA) still needs its CoUninitialize();
+		// RPC_E_CHANGED_MODE (an STA thread) does not.
+		initialized_ = SUCCEEDED(CoInitializeEx(NULL, COINIT_MULTITHREADED));
+#endif
+	}
+
+	ScopedComApartment::~ScopedComApartment()
+	{
+#ifdef _WIN32
+		if (initialized_) {
+			CoUninitialize();
+		}
+#endif
+	}
+}
@@ -0,0 +1,58 @@
+#pragma once
+#include <cstdint>
+
+namespace utils
+{
+	enum ThreadPriority {
+		// Leaves the thread's scheduling as it is.
+		kThreadPriorityDefault,
+		kThreadPriorityNormal,
+		// Still time-shared, but ahead of normal threads: nice -10 on Linux,
+		// THREAD_PRIORITY_HIGHEST on Windows.
+		kThreadPriorityHigh,
+		// SCHED_FIFO on POSIX, the MMCSS "Capture" task on Windows. Linux needs
+		// CAP_SYS_NICE or an RLIMIT_RTPRIO for it.
+		kThreadPriorityRealtime,
+	};
+
+	struct ThreadConfig {
+		// Bit i allows logical CPU i; 0 leaves the affinity as it is.
+		uint64_t affinity_mask{};
+		ThreadPriority priority{ kThreadPriorityDefault };
+		// SCHED_FIFO priority for kThreadPriorityRealtime, 1 to 99. Kept low by
+		// default so kernel threads and audio still preempt capture.
+		int realtime_priority{ 10 };
+	};
+
+	// Keeps the calling thread on logical CPU |cpu|. Returns false when the
+	// OS refuses or cannot pin threads.
+	bool SetCurrentThreadAffinity(int cpu);
+	// Same for the set of CPUs in |mask|.
+	bool SetCurrentThreadAffinityMask(uint64_t mask);
+
+	// Moves the calling thread into |priority|'s scheduling class. Returns
+	// false when the OS refuses, typically for lack of privileges.
+	bool SetCurrentThreadPriority(ThreadPriority priority, int realtime_priority = 10);
+
+	// Applies both halves of |config|; false when either was refused.
+	bool ApplyThreadConfig(const ThreadConfig& config);
+
+	// Logical CPU the calling thread runs on right now, -1 when unknown.
+	int GetCurrentCpu();
+
+	// Keeps the calling thread in the COM multithreaded apartment while it
+	// lives, for threads that create or use Media Foundation objects. A thread
+	// already in an apartment is left as it is. Does nothing off Windows.
+	class ScopedComApartment
+	{
+	public:
+		ScopedComApartment();
+		~ScopedComApartment();
+
+	private:
+		ScopedComApartment(const ScopedComApartment&) = delete;
+		ScopedComApartment operator =(const ScopedComApartment&) = delete;
+
+		bool initialized_{};
+	};
+}
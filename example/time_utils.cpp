@@ -0,0 +1,27 @@
+#include "time_utils.h"
+
+#include <chrono>
+
+namespace utils
+{
+	int64_t TimeMicros()
+	{
+		return std::chrono::duration_cast<std::chrono::microseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	int64_t TimestampAligner::Translate(int64_t device_us, int64_t arrival_us)
+	{
+		int64_t offset_us = arrival_us - device_us;
+		if (!has_offset_ || offset_us < offset_us_) {
+			offset_us_ = offset_us;
+			has_offset_ = true;
+		}
+		return device_us + offset_us_;
+	}
+
+	void TimestampAligner::Reset()
+	{
+		has_offset_ = false;
+	}
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstdint>
+
+namespace utils
+{
+	// Microseconds on a monotonic clock with an arbitrary epoch. Every frame
+	// timestamp uses this clock so they can be compared across backends.
+	int64_t TimeMicros();
+
+	// Maps timestamps from a device clock with an unknown epoch onto
+	// TimeMicros(). The offset is the smallest arrival minus device time seen
+	// so far, so mapped times never lie after arrival and the least delayed
+	// frame defines zero transport latency. Not thread safe.
+	class TimestampAligner
+	{
+	public:
+		int64_t Translate(int64_t device_us, int64_t arrival_us);
+		// Forget the offset, e.g. when the device restarts its clock.
+		void Reset();
+
+	private:
+		bool has_offset_{};
+		int64_t offset_us_{};
+	};
+}
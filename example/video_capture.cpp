@@ -1,21 +1,657 @@
-#include "video_capture.h"
-
-VideoCapture::VideoCapture() {
-
-}
-
-VideoCapture::~VideoCapture() {
-
-}
-
-bool VideoCapture::StartCapture(const VideoDevice& video_device, const VideoDescription& video_description) {
-	return true;
-}
-
-bool VideoCapture::StopCapture() {
-	return true;
-}
-
-void VideoCapture::RegisterVideoFrameCallback(VideoFrameCallback callback) {
-	callback_ = callback;
-}
\ No newline at end of file
+#include "video_capture.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "frame_statistics.h"
+#include "mjpeg_decoder.h"
+#include "thread_pool.h"
+#include "time_utils.h"
+#include "video_convert.h"
+#include "video_scaler.h"
+
+namespace {
+
+std::atomic<uint32_t> g_next_thread_config_id{ 1 };
+// Capture thread config the calling thread last applied, see
+// VideoCapture::ApplyThreadConfig().
+thread_local uint32_t t_thread_config_id = 0;
+
+// Statistics objects kept for reuse. Frames in flight are bounded by the
+// frame pools, so this only overflows with callbacks holding many frames.
+const size_t kMaxPooledStatistics = 16;
+
+bool ConfigurePool(VideoFrameBufferPool& pool, const VideoDescription& video_description) {
+	const VideoDescription& current = pool.Description();
+	if (current.width == video_description.width && current.height == video_description.height &&
+		current.video_type == video_description.video_type) {
+		return true;
+	}
+	return pool.Configure(video_description);
+}
+
+}
+
+VideoCapture::VideoCapture() {
+
+}
+
+VideoCapture::~VideoCapture() {
+	FinishOperations();
+	StopAsyncDelivery();
+}
+
+bool VideoCapture::StartCapture(const VideoDevice& video_device, const VideoDescription& video_description) {
+	return true;
+}
+
+bool VideoCapture::StopCapture() {
+	return true;
+}
+
+std::shared_ptr<CaptureOperation> VideoCapture::StartCaptureAsync(const VideoDevice& video_device,
+	const VideoDescription& video_description, std::chrono::milliseconds timeout,
+	CaptureOperation::Callback callback) {
+	return RunAsync(true, video_device, video_description, timeout, std::move(callback));
+}
+
+std::shared_ptr<CaptureOperation> VideoCapture::StopCaptureAsync(std::chrono::milliseconds timeout,
+	CaptureOperation::Callback callback) {
+	return RunAsync(false, VideoDevice(), VideoDescription(), timeout, std::move(callback));
+}
+
+std::shared_ptr<CaptureOperation> VideoCapture::CurrentOperation() const {
+	std::lock_guard<std::mutex> lock(operation_mutex_);
+	return current_operation_;
+}
+
+void VideoCapture::FinishOperations() {
+	std::thread operation_thread;
+	std::vector<std::shared_ptr<CaptureOperation>> pending;
+	{
+		std::lock_guard<std::mutex> lock(operation_mutex_);
+		operation_thread.swap(operation_thread_);
+		pending = pending_operations_;
+	}
+	for (const std::shared_ptr<CaptureOperation>& operation : pending) {
+		operation->Cancel();
+	}
+	// Joins every earlier operation thread through the chain.
+	if (operation_thread.joinable()) {
+		operation_thread.join();
+	}
+}
+
+std::shared_ptr<CaptureOperation> VideoCapture::RunAsync(bool start, const VideoDevice& video_device,
+	const VideoDescription& video_description, std::chrono::milliseconds timeout,
+	CaptureOperation::Callback callback) {
+	std::shared_ptr<CaptureOperation> operation = std::make_shared<CaptureOperation>(timeout, std::move(callback));
+	// The deadline runs from now, also while the operation waits its turn.
+	std::thread watchdog;
+	if (timeout.count() > 0) {
+		watchdog = std::thread([operation, timeout]() {
+			if (!operation->Wait(timeout)) {
+				operation->Complete(kCaptureStatusTimedOut);
+			}
+		});
+	}
+	std::lock_guard<std::mutex> lock(operation_mutex_);
+	pending_operations_.push_back(operation);
+	operation_thread_ = std::thread(&VideoCapture::RunOperation, this, std::move(operation_thread_),
+		std::move(watchdog), operation, start, video_device, video_description);
+	return operation;
+}
+
+void VideoCapture::RunOperation(std::thread previous, std::thread watchdog,
+	std::shared_ptr<CaptureOperation> operation, bool start, VideoDevice video_device,
+	VideoDescription video_description) {
+	// Media Foundation backends create and use COM objects on this thread,
+	// including the StopCapture() below for a start nobody waits for.
+	utils::ScopedComApartment com_apartment;
+	if (previous.joinable()) {
+		previous.join();
+	}
+	if (!operation->Done()) {
+		{
+			std::lock_guard<std::mutex> lock(operation_mutex_);
+			current_operation_ = operation;
+		}
+		bool succeeded = start ? StartCapture(video_device, video_description) : StopCapture();
+		{
+			std::lock_guard<std::mutex> lock(operation_mutex_);
+			current_operation_.reset();
+		}
+		// A backend that gave up at the deadline reports the timeout, not a
+		// failure of its own.
+		CaptureStatus status = succeeded ? kCaptureStatusSucceeded :
+			operation->Abandoned() ? kCaptureStatusTimedOut : kCaptureStatusFailed;
+		if (!operation->Complete(status) && start && succeeded) {
+			// Nobody is waiting for this capture any more.
+			StopCapture();
+		}
+	}
+	if (watchdog.joinable()) {
+		watchdog.join();
+	}
+	std::lock_guard<std::mutex> lock(operation_mutex_);
+	pending_operations_.erase(std::find(pending_operations_.begin(), pending_operations_.end(), operation));
+}
+
+bool VideoCapture::Reconfigure(const VideoDescription& video_description) {
+	{
+		std::lock_guard<std::mutex> lock(reconfigure_mutex_);
+		reconfigure_start_us_ = utils::TimeMicros();
+		switch_arrival_us_ = 0;
+	}
+	if (!SwitchFormat(video_description)) {
+		std::lock_guard<std::mutex> lock(reconfigure_mutex_);
+		++reconfigure_stats_.failures;
+		switch_pending_.store(false, std::memory_order_relaxed);
+		reconfigure_stats_.pending = false;
+		return false;
+	}
+	// Backends that never said when the old stream ended switched by now.
+	std::lock_guard<std::mutex> lock(reconfigure_mutex_);
+	if (!switch_arrival_us_) {
+		switch_arrival_us_ = reconfigure_start_us_;
+		last_old_arrival_us_ = last_arrival_us_.load(std::memory_order_relaxed);
+		reconfigure_stats_.pending = true;
+		switch_pending_.store(true, std::memory_order_release);
+	}
+	++reconfigure_stats_.switches;
+	return true;
+}
+
+ReconfigureStats VideoCapture::GetReconfigureStats() const {
+	std::lock_guard<std::mutex> lock(reconfigure_mutex_);
+	return reconfigure_stats_;
+}
+
+FormatChoice VideoCapture::GetFormatChoice() const {
+	std::lock_guard<std::mutex> lock(format_choice_mutex_);
+	return format_choice_;
+}
+
+void VideoCapture::SetFormatChoice(const FormatChoice& choice) {
+	std::lock_guard<std::mutex> lock(format_choice_mutex_);
+	format_choice_ = choice;
+	adapt_frames_.store(choice.convert || choice.scale, std::memory_order_release);
+}
+
+bool VideoCapture::SwitchFormat(const VideoDescription&) {
+	return false;
+}
+
+void VideoCapture::BeginFormatSwitch() {
+	std::lock_guard<std::mutex> lock(reconfigure_mutex_);
+	switch_arrival_us_ = utils::TimeMicros();
+	last_old_arrival_us_ = last_arrival_us_.load(std::memory_order_relaxed);
+	reconfigure_stats_.pending = true;
+	switch_pending_.store(true, std::memory_order_release);
+}
+
+void VideoCapture::FinishFormatSwitch(const VideoFrame& video_frame, int64_t now_us) {
+	std::lock_guard<std::mutex> lock(reconfigure_mutex_);
+	int64_t arrival_us = video_frame.arrival_us ? video_frame.arrival_us : now_us;
+	if (!reconfigure_stats_.pending || arrival_us < switch_arrival_us_) {
+		return;
+	}
+	reconfigure_stats_.pending = false;
+	switch_pending_.store(false, std::memory_order_relaxed);
+	reconfigure_stats_.last_switch_us = now_us - reconfigure_start_us_;
+	reconfigure_stats_.last_gap_us = last_old_arrival_us_ ? arrival_us - last_old_arrival_us_ : 0;
+	reconfigure_stats_.max_switch_us = std::max(reconfigure_stats_.max_switch_us, reconfigure_stats_.last_switch_us);
+}
+
+void VideoCapture::RegisterVideoFrameCallback(VideoFrameCallback callback) {
+	callback_ = callback;
+}
+
+void VideoCapture::SetMjpegDecodeType(VideoType video_type) {
+	mjpeg_decode_type_ = video_type;
+}
+
+void VideoCapture::SetZeroCopy(bool enabled) {
+	zero_copy_ = enabled;
+}
+
+void VideoCapture::SetThreadPool(ThreadPool* thread_pool) {
+	thread_pool_ = thread_pool;
+	if (mjpeg_decoder_) {
+		mjpeg_decoder_->SetThreadPool(thread_pool);
+	}
+}
+
+void VideoCapture::SetAsyncDelivery(size_t capacity, FrameQueuePolicy policy, ThreadPool* thread_pool) {
+	StopAsyncDelivery();
+	// Queued frames hold pool buffers, leave some for the capture side.
+	size_t max_buffers = capacity + 4 > 8 ? capacity + 4 : 8;
+	frame_pool_.SetMaxBuffers(max_buffers);
+	decoded_frame_pool_.SetMaxBuffers(max_buffers);
+	adapted_frame_pool_.SetMaxBuffers(max_buffers);
+	if (capacity == 0) {
+		return;
+	}
+	delivery_queue_.reset(new FrameQueue<QueuedFrame>(capacity, policy));
+	delivery_pool_ = thread_pool;
+	if (!delivery_pool_) {
+		delivery_thread_ = std::thread(&VideoCapture::RunDelivery, this);
+	}
+}
+
+void VideoCapture::SetMaxPooledFrames(size_t count) {
+	frame_pool_.SetMaxBuffers(count);
+	decoded_frame_pool_.SetMaxBuffers(count);
+	adapted_frame_pool_.SetMaxBuffers(count);
+}
+
+FrameQueueStats VideoCapture::GetDeliveryStats() const {
+	if (!delivery_queue_) {
+		FrameQueueStats stats = {};
+		return stats;
+	}
+	return delivery_queue_->Stats();
+}
+
+void VideoCapture::SetThreadConfig(const CaptureThreadConfig& config) {
+	std::lock_guard<std::mutex> lock(thread_config_mutex_);
+	thread_config_ = config;
+	delivery_config_applied_ = true;
+	capture_config_applied_ = true;
+	thread_config_id_.store(g_next_thread_config_id.fetch_add(1, std::memory_order_relaxed), std::memory_order_release);
+}
+
+CaptureThreadStats VideoCapture::GetThreadStats() const {
+	CaptureThreadStats stats;
+	stats.callback_jitter = callback_jitter_.Summary();
+	stats.cpu_migrations = cpu_migrations_.load(std::memory_order_relaxed);
+	stats.delivery_applied = delivery_config_applied_;
+	stats.capture_applied = capture_config_applied_;
+	return stats;
+}
+
+LatencySummary VideoCapture::GetLatencyStats(LatencyStage stage) const {
+	return latency_[stage].Summary();
+}
+
+void VideoCapture::ResetLatencyStats() {
+	for (int stage = 0; stage < kLatencyStageCount; ++stage) {
+		latency_[stage].Reset();
+	}
+	callback_jitter_.Reset();
+	cpu_migrations_ = 0;
+}
+
+void VideoCapture::DeliverFrame(VideoFrame& video_frame) {
+	if (adapt_frames_.load(std::memory_order_acquire) && !AdaptFrame(video_frame)) {
+		return;
+	}
+	int static_frame_mode = static_frame_mode_.load(std::memory_order_relaxed);
+	if (static_frame_mode != kStaticFrameOff) {
+		FrameChange change = change_detector_.Process(video_frame);
+		if (!change.changed && !change.keep_alive && static_frame_mode == kStaticFrameDrop) {
+			return;
+		}
+		video_frame.unchanged = !change.changed;
+	}
+	if (frame_statistics_.load(std::memory_order_relaxed)) {
+		std::shared_ptr<FrameStatistics> statistics = AcquireFrameStatistics();
+		if (ComputeFrameStatistics(video_frame, *statistics)) {
+			video_frame.statistics = std::move(statistics);
+		}
+	}
+	int64_t now_us = utils::TimeMicros();
+	if (switch_pending_.load(std::memory_order_acquire)) {
+		FinishFormatSwitch(video_frame, now_us);
+	}
+	last_arrival_us_.store(video_frame.arrival_us ? video_frame.arrival_us : now_us, std::memory_order_relaxed);
+	if (video_frame.arrival_us) {
+		if (video_frame.timestamp_us) {
+			latency_[kLatencyStageDevice].Record(video_frame.arrival_us - video_frame.timestamp_us);
+		}
+		latency_[kLatencyStageProcessing].Record(now_us - video_frame.arrival_us);
+	}
+	if (delivery_queue_) {
+		QueuedFrame queued_frame;
+		queued_frame.video_frame = video_frame;
+		queued_frame.queued_us = now_us;
+		if (delivery_queue_->Push(std::move(queued_frame)) && delivery_pool_) {
+			ScheduleDrain();
+		}
+		return;
+	}
+	InvokeCallback(video_frame, 0);
+}
+
+uint64_t VideoCapture::NextSequence() {
+	return next_sequence_.fetch_add(1, std::memory_order_relaxed);
+}
+
+void VideoCapture::StopAsyncDelivery() {
+	if (!delivery_queue_) {
+		return;
+	}
+	delivery_queue_->Close();
+	if (delivery_thread_.joinable()) {
+		delivery_thread_.join();
+	}
+	{
+		std::unique_lock<std::mutex> lock(drain_mutex_);
+		drain_done_.wait(lock, [this]() { return !drain_scheduled_; });
+	}
+	delivery_queue_.reset();
+	delivery_pool_ = nullptr;
+}
+
+void VideoCapture::RunDelivery() {
+	uint32_t thread_config_id = 0;
+	for (;;) {
+		ApplyThreadConfig(true, thread_config_id);
+		QueuedFrame queued_frame;
+		if (delivery_queue_->Pop(queued_frame, std::chrono::milliseconds(100))) {
+			InvokeCallback(queued_frame.video_frame, queued_frame.queued_us);
+		}
+		else if (delivery_queue_->Closed()) {
+			return;
+		}
+	}
+}
+
+void VideoCapture::ScheduleDrain() {
+	{
+		std::lock_guard<std::mutex> lock(drain_mutex_);
+		if (drain_scheduled_) {
+			return;
+		}
+		drain_scheduled_ = true;
+	}
+	delivery_pool_->PostTask([this]() {
+		DrainDelivery();
+	});
+}
+
+void VideoCapture::DrainDelivery() {
+	for (;;) {
+		QueuedFrame queued_frame;
+		while (delivery_queue_->TryPop(queued_frame)) {
+			InvokeCallback(queued_frame.video_frame, queued_frame.queued_us);
+		}
+		// A frame pushed after the last pop saw |drain_scheduled_| still set
+		// and counts on this task, so only give up when the queue is empty
+		// under the lock.
+		std::lock_guard<std::mutex> lock(drain_mutex_);
+		if (delivery_queue_->Size() == 0) {
+			drain_scheduled_ = false;
+			drain_done_.notify_all();
+			return;
+		}
+	}
+}
+
+void VideoCapture::InvokeCallback(VideoFrame& video_frame, int64_t queued_us) {
+	if (!callback_) {
+		return;
+	}
+	int64_t start_us = utils::TimeMicros();
+	if (queued_us) {
+		latency_[kLatencyStageQueue].Record(start_us - queued_us);
+	}
+	if (video_frame.timestamp_us) {
+		latency_[kLatencyStageEndToEnd].Record(start_us - video_frame.timestamp_us);
+		if (last_callback_us_ && video_frame.timestamp_us > last_callback_timestamp_us_) {
+			int64_t jitter_us = (start_us - last_callback_us_) - (video_frame.timestamp_us - last_callback_timestamp_us_);
+			callback_jitter_.Record(jitter_us < 0 ? -jitter_us : jitter_us);
+		}
+		last_callback_us_ = start_us;
+		last_callback_timestamp_us_ = video_frame.timestamp_us;
+	}
+	int cpu = utils::GetCurrentCpu();
+	if (cpu >= 0 && last_callback_cpu_ >= 0 && cpu != last_callback_cpu_) {
+		cpu_migrations_.fetch_add(1, std::memory_order_relaxed);
+	}
+	last_callback_cpu_ = cpu;
+	callback_(video_frame);
+	latency_[kLatencyStageConsumer].Record(utils::TimeMicros() - start_us);
+}
+
+void VideoCapture::SetMaxFrameRate(double fps) {
+	decimator_.SetTargetFps(fps);
+}
+
+FrameRateStats VideoCapture::GetFrameRateStats() const {
+	return decimator_.Stats();
+}
+
+void VideoCapture::SetStaticFrameDetection(StaticFrameMode mode, double mean_threshold, int block_threshold,
+	int64_t keep_alive_us) {
+	change_detector_.SetThresholds(mean_threshold, block_threshold);
+	change_detector_.SetKeepAlive(keep_alive_us);
+	if (mode != static_frame_mode_.exchange(mode)) {
+		change_detector_.Reset();
+	}
+}
+
+FrameChangeStats VideoCapture::GetStaticFrameStats() const {
+	return change_detector_.Stats();
+}
+
+std::shared_ptr<FrameStatistics> VideoCapture::AcquireFrameStatistics() {
+	for (const std::shared_ptr<FrameStatistics>& statistics : statistics_pool_) {
+		if (statistics.use_count() == 1) {
+			// Orders the reuse after the reads of the frame that released it.
+			std::atomic_thread_fence(std::memory_order_acquire);
+			return statistics;
+		}
+	}
+	std::shared_ptr<FrameStatistics> statistics = std::make_shared<FrameStatistics>();
+	if (statistics_pool_.size() < kMaxPooledStatistics) {
+		statistics_pool_.push_back(statistics);
+	}
+	return statistics;
+}
+
+void VideoCapture::SetFrameStatistics(bool enabled) {
+	frame_statistics_ = enabled;
+}
+
+bool VideoCapture::AcceptFrame(int64_t timestamp_us) {
+	ApplyThreadConfig(false, t_thread_config_id);
+	if (decimator_.ShouldKeep(timestamp_us)) {
+		return true;
+	}
+	NextSequence();
+	return false;
+}
+
+void VideoCapture::ApplyThreadConfig(bool delivery, uint32_t& applied_id) {
+	uint32_t id = thread_config_id_.load(std::memory_order_acquire);
+	if (id == applied_id) {
+		return;
+	}
+	applied_id = id;
+	utils::ThreadConfig config;
+	{
+		std::lock_guard<std::mutex> lock(thread_config_mutex_);
+		config = delivery ? thread_config_.delivery : thread_config_.capture;
+	}
+	if (!utils::ApplyThreadConfig(config)) {
+		(delivery ? delivery_config_applied_ : capture_config_applied_) = false;
+	}
+}
+
+bool VideoCapture::DeliverContiguousFrame(const uint8_t* data, size_t size, uint32_t stride, int64_t timestamp_us,
+	int64_t arrival_us) {
+	VideoFrameView view;
+	GetContiguousFrameView(video_description_, data, size, static_cast<int32_t>(stride), view);
+	// |data| is only valid during the call, so it is always copied.
+	return DeliverView(view, false, timestamp_us, arrival_us);
+}
+
+bool VideoCapture::DeliverFrameView(VideoFrameView& view, int64_t timestamp_us, int64_t arrival_us) {
+	return DeliverView(view, zero_copy_, timestamp_us, arrival_us);
+}
+
+bool VideoCapture::DeliverView(VideoFrameView& view, bool wrap, int64_t timestamp_us, int64_t arrival_us) {
+	VideoFrame video_frame;
+	video_frame.sequence = NextSequence();
+	video_frame.arrival_us = arrival_us ? arrival_us : utils::TimeMicros();
+	video_frame.timestamp_us = timestamp_us ? timestamp_us : video_frame.arrival_us;
+	bool delivered = false;
+	if (callback_ && view.plane_count > 0) {
+		if (view.layout == kPixelLayoutCompressed) {
+			// Passed through JPEG data can stay in the device buffer like raw
+			// planes; decoding always reads it in place.
+			if (wrap && mjpeg_decode_type_ == kVideoTypeMJPEG && WrapVideoFrameView(view, video_frame)) {
+				DeliverFrame(video_frame);
+				delivered = true;
+			}
+			else {
+				delivered = DeliverCompressedFrame(view.planes[0].data, view.planes[0].row_bytes, video_frame);
+			}
+		}
+		else if (wrap && WrapVideoFrameView(view, video_frame)) {
+			DeliverFrame(video_frame);
+			delivered = true;
+		}
+		else {
+			delivered = DeliverCopiedFrame(view, video_frame);
+		}
+	}
+	// Whatever the frame did not take over is done with now.
+	if (view.release) {
+		view.release();
+		view.release = nullptr;
+	}
+	view.owner = nullptr;
+	return delivered;
+}
+
+bool VideoCapture::DeliverCompressedFrame(const uint8_t* data, size_t size, VideoFrame& video_frame) {
+	if (mjpeg_decode_type_ != kVideoTypeMJPEG) {
+		return DeliverMjpegFrame(data, size, video_frame);
+	}
+	if (!ConfigureFramePool(video_description_.width, video_description_.height, kVideoTypeMJPEG)) {
+		return false;
+	}
+	RefPtr<VideoFrameBuffer> buffer = frame_pool_.CreateBuffer();
+	if (!buffer || size > buffer->Layout().size) {
+		return false;
+	}
+	memcpy(buffer->Data(0), data, size);
+	buffer->WrapVideoFrame(video_frame);
+	video_frame.compressed_size = static_cast<uint32_t>(size);
+	DeliverFrame(video_frame);
+	return true;
+}
+
+bool VideoCapture::DeliverCopiedFrame(const VideoFrameView& view, VideoFrame& video_frame) {
+	if (!ConfigureFramePool(view.width, view.height, view.video_type)) {
+		return false;
+	}
+	RefPtr<VideoFrameBuffer> buffer = frame_pool_.CreateBuffer();
+	if (!buffer) {
+		return false;
+	}
+	buffer->WrapVideoFrame(video_frame);
+	if (!CopyVideoFrameView(view, video_frame)) {
+		return false;
+	}
+	DeliverFrame(video_frame);
+	return true;
+}
+
+bool VideoCapture::ConfigureFramePool(uint32_t width, uint32_t height, VideoType video_type) {
+	const VideoDescription& current = frame_pool_.Description();
+	if (current.width == width && current.height == height && current.video_type == video_type) {
+		return true;
+	}
+	VideoDescription video_description = video_description_;
+	video_description.width = width;
+	video_description.height = height;
+	video_description.video_type = video_type;
+	return frame_pool_.Configure(video_description);
+}
+
+bool VideoCapture::DeliverMjpegFrame(const uint8_t* data, size_t size, VideoFrame& video_frame) {
+	VideoDescription video_description = video_description_;
+	video_description.video_type = mjpeg_decode_type_;
+	// Cameras may send a different size than negotiated, trust the bitstream.
+	if (!MjpegDecoder::GetImageSize(data, size, video_description.width, video_description.height)) {
+		return false;
+	}
+	const VideoDescription& current = decoded_frame_pool_.Description();
+	if (current.width != video_description.width || current.height != video_description.height ||
+		current.video_type != video_description.video_type) {
+		if (!decoded_frame_pool_.Configure(video_description)) {
+			return false;
+		}
+	}
+	if (!mjpeg_decoder_) {
+		if (!thread_pool_) {
+			owned_thread_pool_.reset(new ThreadPool());
+			thread_pool_ = owned_thread_pool_.get();
+		}
+		mjpeg_decoder_.reset(new MjpegDecoder(thread_pool_));
+	}
+	if (!decoded_frame_pool_.CreateFrame(video_frame)) {
+		return false;
+	}
+	if (!mjpeg_decoder_->Decode(data, size, video_frame)) {
+		return false;
+	}
+	DeliverFrame(video_frame);
+	return true;
+}
+
+bool VideoCapture::AdaptFrame(VideoFrame& video_frame) {
+	VideoDescription output;
+	{
+		std::lock_guard<std::mutex> lock(format_choice_mutex_);
+		output = format_choice_.output;
+	}
+	bool scale = video_frame.width != output.width || video_frame.height != output.height;
+	bool convert = video_frame.video_type != output.video_type;
+	// Passed through JPEG data was negotiated at the requested size already.
+	if (video_frame.video_type == kVideoTypeMJPEG || (!scale && !convert)) {
+		return true;
+	}
+	VideoFrame source = video_frame;
+	if (scale && convert) {
+		// Convert at the smaller of the two sizes where the scaler takes both
+		// types, as GetFormatCost() priced it.
+		VideoDescription step = output;
+		bool scale_source = CanScaleVideoFrame(source.video_type);
+		if (scale_source && (!CanScaleVideoFrame(output.video_type) ||
+			static_cast<uint64_t>(output.width) * output.height < static_cast<uint64_t>(source.width) * source.height)) {
+			step.video_type = source.video_type;
+		}
+		else {
+			step.width = source.width;
+			step.height = source.height;
+		}
+		VideoFrame step_frame;
+		if (!ConfigurePool(adapt_step_pool_, step) || !adapt_step_pool_.CreateFrame(step_frame)) {
+			return false;
+		}
+		bool done = step.video_type == source.video_type ? ScaleVideoFrame(source, step_frame, kScaleFilterBilinear,
+			thread_pool_) : ConvertVideoFrame(source, step_frame, kYuvI601Constants, thread_pool_);
+		if (!done) {
+			return false;
+		}
+		source = step_frame;
+	}
+	VideoFrame adapted;
+	if (!ConfigurePool(adapted_frame_pool_, output) || !adapted_frame_pool_.CreateFrame(adapted)) {
+		return false;
+	}
+	bool done = source.video_type == output.video_type ? ScaleVideoFrame(source, adapted, kScaleFilterBilinear,
+		thread_pool_) : ConvertVideoFrame(source, adapted, kYuvI601Constants, thread_pool_);
+	if (!done) {
+		return false;
+	}
+	adapted.timestamp_us = video_frame.timestamp_us;
+	adapted.arrival_us = video_frame.arrival_us;
+	adapted.sequence = video_frame.sequence;
+	video_frame = adapted;
+	return true;
+}
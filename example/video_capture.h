@@ -1,21 +1,337 @@
-#pragma once
-#include <functional>
-
-#include "video_frame.h"
-
-class VideoCapture {
-public:
-	using VideoFrameCallback = std::function<void(VideoFrame& video_frame)>;
-
-public:
-	VideoCapture();
-	virtual ~VideoCapture();
-
-	virtual bool StartCapture(const VideoDevice& video_device, const VideoDescription& video_description);
-	virtual bool StopCapture();
-
-	void RegisterVideoFrameCallback(VideoFrameCallback callback);
-
-protected:
-	VideoFrameCallback callback_{};
-};
\ No newline at end of file
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "capture_operation.h"
+#include "format_negotiation.h"
+#include "frame_change_detector.h"
+#include "frame_decimator.h"
+#include "frame_queue.h"
+#include "latency_histogram.h"
+#include "thread_utils.h"
+#include "video_frame.h"
+#include "video_frame_buffer.h"
+#include "video_frame_view.h"
+
+class MjpegDecoder;
+class ThreadPool;
+
+// Where a frame's time goes between the sensor and the end of the callback.
+enum LatencyStage {
+	// Capture timestamp to arrival on the host.
+	kLatencyStageDevice,
+	// Arrival to hand-off for delivery: copy, decode or rendering.
+	kLatencyStageProcessing,
+	// Waiting in the async delivery queue; only recorded with SetAsyncDelivery().
+	kLatencyStageQueue,
+	// Time spent inside the frame callback.
+	kLatencyStageConsumer,
+	// Capture timestamp to the start of the callback.
+	kLatencyStageEndToEnd,
+	kLatencyStageCount,
+};
+
+enum StaticFrameMode {
+	kStaticFrameOff,
+	// Unchanged frames are delivered with VideoFrame::unchanged set.
+	kStaticFrameFlag,
+	// Unchanged frames are dropped, except one per keep-alive interval.
+	kStaticFrameDrop,
+};
+
+struct CaptureThreadConfig {
+	// The dedicated thread of SetAsyncDelivery(). Pool delivery keeps the
+	// pool's placement, inline delivery runs on the capture threads.
+	utils::ThreadConfig delivery;
+	// Threads the backend receives device frames on: Media Foundation
+	// work-queue threads, the file and test pattern threads. Media Foundation
+	// shares its work-queue threads within the process, so the last capture
+	// to apply wins.
+	utils::ThreadConfig capture;
+};
+
+struct CaptureThreadStats {
+	// How far the spacing of callback starts strays from the spacing of the
+	// frames' capture timestamps; preemption and migration show up here.
+	LatencySummary callback_jitter;
+	// Callbacks that ran on another CPU than the one before.
+	uint64_t cpu_migrations;
+	// False once the OS refused part of the configuration, e.g. SCHED_FIFO
+	// without CAP_SYS_NICE.
+	bool delivery_applied;
+	bool capture_applied;
+};
+
+struct ReconfigureStats {
+	uint64_t switches;
+	// Reconfigure() calls the backend refused or failed; the old mode keeps
+	// running where it could.
+	uint64_t failures;
+	// Reconfigure() call to the first frame of the new mode reaching delivery,
+	// and the gap in the stream between the last frame of the old mode and it.
+	int64_t last_switch_us;
+	int64_t last_gap_us;
+	int64_t max_switch_us;
+	// The last switch has not produced a frame yet.
+	bool pending;
+};
+
+class VideoCapture {
+public:
+	using VideoFrameCallback = std::function<void(VideoFrame& video_frame)>;
+
+public:
+	VideoCapture();
+	virtual ~VideoCapture();
+
+	// Device backends open the native mode NegotiateVideoFormat() finds
+	// cheapest for |video_description|, which may differ from it in size, rate
+	// or type. Frames are decoded, converted and scaled to the requested size
+	// and type before they reach the callback; only the rate can fall short.
+	virtual bool StartCapture(const VideoDevice& video_device, const VideoDescription& video_description);
+	virtual bool StopCapture();
+
+	// Run StartCapture() and StopCapture() on a thread of their own and return
+	// at once, so several captures can come up concurrently. Operations on one
+	// capture run one at a time, in the order they were made. A start that
+	// succeeds after it timed out or was cancelled is stopped again. |timeout|
+	// of 0 waits as long as the backend takes. Do not mix with the blocking
+	// calls while an operation is pending.
+	std::shared_ptr<CaptureOperation> StartCaptureAsync(const VideoDevice& video_device,
+		const VideoDescription& video_description, std::chrono::milliseconds timeout,
+		CaptureOperation::Callback callback = nullptr);
+	std::shared_ptr<CaptureOperation> StopCaptureAsync(std::chrono::milliseconds timeout,
+		CaptureOperation::Callback callback = nullptr);
+
+	// Switches a running capture to another size, rate or type without
+	// closing the device: the session, callbacks, delivery queue and pools
+	// stay in place, and only the stream restarts. |video_description| is
+	// negotiated like in StartCapture(). Frames of the old mode already on
+	// their way are still delivered, frames after them have the new mode.
+	// Returns false when the backend cannot switch while capturing or no mode
+	// fits; the capture then keeps its old mode where it can. Do not call
+	// while an asynchronous operation is pending.
+	bool Reconfigure(const VideoDescription& video_description);
+	ReconfigureStats GetReconfigureStats() const;
+
+	// The device mode the backend opened on the last start or format switch,
+	// with FormatChoice::reason saying why, for logs. Empty for backends that
+	// open the requested description as is.
+	FormatChoice GetFormatChoice() const;
+
+	void RegisterVideoFrameCallback(VideoFrameCallback callback);
+
+	// MJPEG frames are decoded to |video_type| (I420, IYUV or NV12) before they
+	// reach the callback. kVideoTypeMJPEG passes the compressed data through,
+	// sized by VideoFrame::compressed_size, for FrameRecorder to store as is.
+	void SetMjpegDecodeType(VideoType video_type);
+
+	// Frames from backends that can lend their buffers (Media Foundation
+	// samples, file mappings) point into them instead of a pooled copy; their
+	// planes are read-only. A held frame keeps its device buffer locked, and
+	// devices with few buffers stall when the callback holds on to too many;
+	// disable to always copy. On by default.
+	void SetZeroCopy(bool enabled);
+
+	// Pool used for parallel decoding, conversion and scaling. Without one a
+	// pool is created on the first MJPEG frame. |thread_pool| must outlive the
+	// capture.
+	void SetThreadPool(ThreadPool* thread_pool);
+
+	// Hands frames to the callback on a dedicated thread through a queue of
+	// |capacity| frames, so a slow callback no longer stalls the capture
+	// thread. |policy| picks what happens when the callback falls behind.
+	// 0 delivers inline on the capture thread again. Call while stopped.
+	// With |thread_pool| the callback runs on its workers instead of a thread
+	// of its own, still one frame at a time and in order; |thread_pool| must
+	// outlive the capture.
+	void SetAsyncDelivery(size_t capacity, FrameQueuePolicy policy = kFrameQueueDropOldest,
+		ThreadPool* thread_pool = nullptr);
+	FrameQueueStats GetDeliveryStats() const;
+
+	// Buffers kept for frames from the device, the MJPEG decoder and the
+	// conversion to the requested format. Frames held downstream, e.g. in
+	// FrameBus queues, keep theirs; when all are out, new device frames are
+	// dropped. SetAsyncDelivery() sets it as well, the later call wins.
+	void SetMaxPooledFrames(size_t count);
+
+	// Thins the device stream to |fps| by capture timestamp before frames are
+	// locked, copied or decoded, see FrameDecimator. 0 delivers every frame.
+	// Can be changed while capturing.
+	void SetMaxFrameRate(double fps);
+	// Device and delivered frame rates and the output cadence.
+	FrameRateStats GetFrameRateStats() const;
+
+	// Compares every frame with the last changed one before it is handed on,
+	// see FrameChangeDetector for the thresholds. Can be changed while
+	// capturing.
+	void SetStaticFrameDetection(StaticFrameMode mode, double mean_threshold = 1.5, int block_threshold = 24,
+		int64_t keep_alive_us = 1000000);
+	FrameChangeStats GetStaticFrameStats() const;
+
+	// Attaches FrameStatistics to every delivered planar and semi-planar
+	// frame, computed on the capture thread in one pass over the planes, so
+	// exposure and quality checks downstream need no passes of their own.
+	// The objects are reused once no frame refers to them any more. Can be
+	// changed while capturing.
+	void SetFrameStatistics(bool enabled);
+
+	// Affinity and scheduling class of the threads frames pass through. Takes
+	// effect with the next frame on each thread.
+	void SetThreadConfig(const CaptureThreadConfig& config);
+	// Reset along with the latency stats.
+	CaptureThreadStats GetThreadStats() const;
+
+	// Latency of every delivered frame, recorded lock-free per stage.
+	LatencySummary GetLatencyStats(LatencyStage stage) const;
+	void ResetLatencyStats();
+
+protected:
+	// Copies an image stored the way Media Foundation lays out its buffers
+	// (planes back to back, |stride| bytes per luma or packed row, 0 for the
+	// minimum) into a pooled frame and hands it to the callback.
+	// |timestamp_us| and |arrival_us| are on the utils::TimeMicros() clock,
+	// 0 stands for the time of the call.
+	bool DeliverContiguousFrame(const uint8_t* data, size_t size, uint32_t stride, int64_t timestamp_us = 0,
+		int64_t arrival_us = 0);
+
+	// Backends ask first, with the capture time of every device frame, and
+	// leave the sample untouched when this returns false. Dropped frames still
+	// take a sequence number. Also applies CaptureThreadConfig::capture to the
+	// calling thread.
+	bool AcceptFrame(int64_t timestamp_us);
+
+	// Hands the frame in |view| to the callback, pointing into its memory when
+	// zero copy is on and copying otherwise. Takes over |view.owner| and
+	// |view.release|: the hook runs once the last frame is gone, or before
+	// returning when the frame was copied or dropped.
+	bool DeliverFrameView(VideoFrameView& view, int64_t timestamp_us = 0, int64_t arrival_us = 0);
+
+	// Passes a finished frame to the callback, inline or through the queue.
+	// Backends fill in timestamp_us, arrival_us and sequence first.
+	void DeliverFrame(VideoFrame& video_frame);
+
+	// Backend half of Reconfigure(): stops the stream, calls
+	// BeginFormatSwitch() once no frame of the old mode can arrive any more,
+	// sets video_description_ and restarts the stream. The default cannot
+	// switch.
+	virtual bool SwitchFormat(const VideoDescription& video_description);
+	// Frames arriving from now on count as the new mode for the switch time.
+	void BeginFormatSwitch();
+	// Records the negotiated mode for GetFormatChoice().
+	void SetFormatChoice(const FormatChoice& choice);
+
+	// Next frame sequence number; take one per frame from the device, including
+	// frames that are then dropped.
+	uint64_t NextSequence();
+
+	// The asynchronous operation StartCapture() or StopCapture() is running
+	// for, null for blocking calls. Backends bound their waits by it.
+	std::shared_ptr<CaptureOperation> CurrentOperation() const;
+	// Cancels pending operations and waits for the one running. Subclasses
+	// call it first thing in their destructor, while their state is intact.
+	void FinishOperations();
+
+private:
+	struct QueuedFrame {
+		VideoFrame video_frame{};
+		int64_t queued_us{};
+	};
+
+	bool DeliverView(VideoFrameView& view, bool wrap, int64_t timestamp_us, int64_t arrival_us);
+	bool DeliverCompressedFrame(const uint8_t* data, size_t size, VideoFrame& video_frame);
+	bool DeliverCopiedFrame(const VideoFrameView& view, VideoFrame& video_frame);
+	bool ConfigureFramePool(uint32_t width, uint32_t height, VideoType video_type);
+	bool DeliverMjpegFrame(const uint8_t* data, size_t size, VideoFrame& video_frame);
+	// Converts and scales |video_frame| to FormatChoice::output of the
+	// negotiated mode. False when a step fails or no buffer is free.
+	bool AdaptFrame(VideoFrame& video_frame);
+	void StopAsyncDelivery();
+	void RunDelivery();
+	void ScheduleDrain();
+	void DrainDelivery();
+	void InvokeCallback(VideoFrame& video_frame, int64_t queued_us);
+	// Applies the delivery or capture half of the thread config to the
+	// calling thread unless |applied_id| shows it already has.
+	void ApplyThreadConfig(bool delivery, uint32_t& applied_id);
+	void FinishFormatSwitch(const VideoFrame& video_frame, int64_t now_us);
+	// A statistics object no delivered frame holds any more, or a new one.
+	std::shared_ptr<FrameStatistics> AcquireFrameStatistics();
+	std::shared_ptr<CaptureOperation> RunAsync(bool start, const VideoDevice& video_device,
+		const VideoDescription& video_description, std::chrono::milliseconds timeout,
+		CaptureOperation::Callback callback);
+	void RunOperation(std::thread previous, std::thread watchdog, std::shared_ptr<CaptureOperation> operation,
+		bool start, VideoDevice video_device, VideoDescription video_description);
+
+protected:
+	VideoFrameCallback callback_{};
+	VideoDescription video_description_{};
+	VideoFrameBufferPool frame_pool_{};
+
+private:
+	VideoType mjpeg_decode_type_{ kVideoTypeI420 };
+	bool zero_copy_{ true };
+	ThreadPool* thread_pool_{};
+	std::unique_ptr<ThreadPool> owned_thread_pool_{};
+	std::unique_ptr<MjpegDecoder> mjpeg_decoder_{};
+	VideoFrameBufferPool decoded_frame_pool_{};
+	// Output of AdaptFrame(), and the frame between its two steps when it
+	// both converts and scales.
+	VideoFrameBufferPool adapted_frame_pool_{};
+	VideoFrameBufferPool adapt_step_pool_{ 2 };
+	std::unique_ptr<FrameQueue<QueuedFrame>> delivery_queue_{};
+	std::thread delivery_thread_{};
+	ThreadPool* delivery_pool_{};
+	// At most one pool task drains the queue at a time, which keeps frames in
+	// order without a thread per capture.
+	bool drain_scheduled_{};
+	std::mutex drain_mutex_{};
+	std::condition_variable drain_done_{};
+	std::atomic<uint64_t> next_sequence_{ 0 };
+	FrameDecimator decimator_{};
+	std::atomic<int> static_frame_mode_{ kStaticFrameOff };
+	FrameChangeDetector change_detector_{};
+	std::atomic<bool> frame_statistics_{ false };
+	// Only touched by DeliverFrame(); an entry is free when this list holds
+	// the only reference.
+	std::vector<std::shared_ptr<FrameStatistics>> statistics_pool_{};
+	LatencyHistogram latency_[kLatencyStageCount];
+	std::mutex thread_config_mutex_{};
+	CaptureThreadConfig thread_config_{};
+	// Changes with every SetThreadConfig(), unique across captures, so each
+	// thread applies a configuration once.
+	std::atomic<uint32_t> thread_config_id_{ 0 };
+	std::atomic<bool> delivery_config_applied_{ true };
+	std::atomic<bool> capture_config_applied_{ true };
+	// Only touched by the callback, which never runs twice at once.
+	int64_t last_callback_us_{};
+	int64_t last_callback_timestamp_us_{};
+	int last_callback_cpu_{ -1 };
+	LatencyHistogram callback_jitter_{};
+	std::atomic<uint64_t> cpu_migrations_{ 0 };
+	mutable std::mutex reconfigure_mutex_{};
+	ReconfigureStats reconfigure_stats_{};
+	int64_t reconfigure_start_us_{};
+	// Frames arriving from here on belong to the new mode.
+	int64_t switch_arrival_us_{};
+	int64_t last_old_arrival_us_{};
+	// Set while a switch waits for its first frame, so DeliverFrame() only
+	// takes the lock then.
+	std::atomic<bool> switch_pending_{ false };
+	std::atomic<int64_t> last_arrival_us_{ 0 };
+	mutable std::mutex format_choice_mutex_{};
+	FormatChoice format_choice_{};
+	// The negotiated mode needs AdaptFrame(), so DeliverFrame() only takes
+	// the lock then.
+	std::atomic<bool> adapt_frames_{ false };
+	mutable std::mutex operation_mutex_{};
+	// Newest operation thread; each one joins its predecessor first.
+	std::thread operation_thread_{};
+	std::vector<std::shared_ptr<CaptureOperation>> pending_operations_{};
+	std::shared_ptr<CaptureOperation> current_operation_{};
+};
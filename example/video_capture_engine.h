@@ -1,41 +1,56 @@
-#pragma once
-#include <mfcaptureengine.h>
-#include <strsafe.h>
-#include <commctrl.h>
-#include <d3d11.h>
-#include <wrl/client.h>
-
-#include "video_capture.h"
-
-class MFVideoCallback;
-
-class VideoCaptureEngine : public VideoCapture {
-public:
-	VideoCaptureEngine();
-	~VideoCaptureEngine();
-
-	bool StartCapture(const VideoDevice& video_device, const VideoDescription& video_description) override;
-	bool StopCapture() override;
-
-	void OnEvent(IMFMediaEvent* media_event);
-private:
-	bool InitCaptureEngine(const VideoDevice& video_device);
-	bool CreateD3DManager();
-	bool GetAvailableIndex(IMFCaptureSource* source, int& stream_index, int& media_type_index, const VideoDescription& video_description);
-	HRESULT WaitOnCaptureEvent(GUID capture_event_guid);
-
-private:
-	Microsoft::WRL::ComPtr<IMFCaptureEngine> capture_engine_{};
-	MFVideoCallback* video_callback_{};
-
-	bool is_initialized_{};
-	bool is_started_{};
-
-	HANDLE error_handle_{};
-	HANDLE initial_handle_{};
-
-	Microsoft::WRL::ComPtr<IMFMediaSource> source_{};
-	Microsoft::WRL::ComPtr<IMFDXGIDeviceManager> dxgi_device_manager_{};
-	Microsoft::WRL::ComPtr<ID3D11Device> dx11_device_{};
-	UINT reset_token_{};
-};
+#pragma once
+#include <mfcaptureengine.h>
+#include <strsafe.h>
+#include <commctrl.h>
+#include <d3d11.h>
+#include <wrl/client.h>
+
+#include "format_negotiation.h"
+#include "time_utils.h"
+#include "video_capture.h"
+
+class MFVideoCallback;
+
+class VideoCaptureEngine : public VideoCapture {
+public:
+	VideoCaptureEngine();
+	~VideoCaptureEngine();
+
+	bool StartCapture(const VideoDevice& video_device, const VideoDescription& video_description) override;
+	bool StopCapture() override;
+
+	void OnEvent(IMFMediaEvent* media_event);
+	void OnSample(IMFSample* sample);
+
+protected:
+	// Restarts the preview stream in the new mode on the running engine.
+	bool SwitchFormat(const VideoDescription& video_description) override;
+
+private:
+	bool InitCaptureEngine(const VideoDevice& video_device);
+	// Negotiates the device mode and starts the preview sink on it.
+	bool StartPreviewStream(const VideoDescription& video_description);
+	bool CreateD3DManager();
+	// Picks the cheapest native mode for |video_description| across the video
+	// streams, see NegotiateVideoFormat().
+	bool SelectDeviceMediaType(IMFCaptureSource* source, const VideoDescription& video_description,
+		DWORD& stream_index, DWORD& media_type_index, FormatChoice& choice);
+	HRESULT WaitOnCaptureEvent(GUID capture_event_guid);
+
+private:
+	Microsoft::WRL::ComPtr<IMFCaptureEngine> capture_engine_{};
+	MFVideoCallback* video_callback_{};
+
+	bool is_initialized_{};
+	bool is_started_{};
+
+	HANDLE error_handle_{};
+	HANDLE initial_handle_{};
+	HANDLE preview_stopped_handle_{};
+
+	Microsoft::WRL::ComPtr<IMFMediaSource> source_{};
+	Microsoft::WRL::ComPtr<IMFDXGIDeviceManager> dxgi_device_manager_{};
+	Microsoft::WRL::ComPtr<ID3D11Device> dx11_device_{};
+	UINT reset_token_{};
+	utils::TimestampAligner timestamp_aligner_{};
+};
@@ -1,32 +1,47 @@
-#pragma once
-#include <wrl/client.h>
-
-#include <mfapi.h>
-#include <mfidl.h>
-#include <mfreadwrite.h>
-#include <mferror.h>
-
-#include "video_capture.h"
-
-class VideoCaptureReader : public VideoCapture, public IMFSourceReaderCallback {
-public:
-	VideoCaptureReader();
-	~VideoCaptureReader();
-
-	bool StartCapture(const VideoDevice& video_device, const VideoDescription& video_description) override;
-	bool StopCapture() override;
-
-private:
-	HRESULT STDMETHODCALLTYPE OnReadSample(HRESULT hrStatus, DWORD dwStreamIndex, DWORD dwStreamFlags,
-		LONGLONG llTimestamp, IMFSample *pSample) override;
-	STDMETHODIMP QueryInterface(REFIID iid, void** ppv) override;
-	STDMETHODIMP_(ULONG) AddRef() override;
-	STDMETHODIMP_(ULONG) Release() override;
-	STDMETHODIMP OnFlush(_In_  DWORD dwStreamIndex) override;
-	STDMETHODIMP OnEvent(_In_  DWORD dwStreamIndex, _In_  IMFMediaEvent *pEvent) override;
-
-private:
-	IMFActivate* active_{};
-	long ref_count_{};
-	IMFSourceReader* source_reader_{};
-};
+#pragma once
+#include <wrl/client.h>
+
+#include <mfapi.h>
+#include <mfidl.h>
+#include <mfreadwrite.h>
+#include <mferror.h>
+
+#include "format_negotiation.h"
+#include "time_utils.h"
+#include "video_capture.h"
+
+class VideoCaptureReader : public VideoCapture, public IMFSourceReaderCallback {
+public:
+	VideoCaptureReader();
+	~VideoCaptureReader();
+
+	bool StartCapture(const VideoDevice& video_device, const VideoDescription& video_description) override;
+	bool StopCapture() override;
+
+protected:
+	// Keeps the reader and the device open and only changes the stream's
+	// media type.
+	bool SwitchFormat(const VideoDescription& video_description) override;
+
+private:
+	bool SelectMediaType(const VideoDescription& video_description, FormatChoice& choice,
+		Microsoft::WRL::ComPtr<IMFMediaType>& media_type);
+	void ApplyFormat(const FormatChoice& choice);
+	HRESULT STDMETHODCALLTYPE OnReadSample(HRESULT hrStatus, DWORD dwStreamIndex, DWORD dwStreamFlags,
+		LONGLONG llTimestamp, IMFSample *pSample) override;
+	STDMETHODIMP QueryInterface(REFIID iid, void** ppv) override;
+	STDMETHODIMP_(ULONG) AddRef() override;
+	STDMETHODIMP_(ULONG) Release() override;
+	STDMETHODIMP OnFlush(_In_  DWORD dwStreamIndex) override;
+	STDMETHODIMP OnEvent(_In_  DWORD dwStreamIndex, _In_  IMFMediaEvent *pEvent) override;
+
+private:
+	Microsoft::WRL::ComPtr<IMFActivate> active_{};
+	long ref_count_{};
+	IMFSourceReader* source_reader_{};
+	utils::TimestampAligner timestamp_aligner_{};
+	// Signalled by OnFlush().
+	HANDLE flush_event_{};
+	// Holds back the next ReadSample() while SwitchFormat() changes the type.
+	std::atomic<bool> switching_{ false };
+};
@@ -0,0 +1,449 @@
+#include "video_convert.h"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#include "thread_pool.h"
+#include "video_convert_row.h"
+#include "video_frame_buffer.h"
+
+namespace {
+
+constexpr int16_t ToFixed6(double value) {
+	return static_cast<int16_t>(value * 64 + 0.5);
+}
+
+constexpr YuvConstants MakeYuvConstants(double kr, double kb, double kg, double y_scale, double uv_scale,
+	int16_t y_offset) {
+	return YuvConstants{ ToFixed6(y_scale), y_offset, ToFixed6(2 * (1 - kb) * uv_scale),
+		ToFixed6(2 * (1 - kb) * kb / kg * uv_scale), ToFixed6(2 * (1 - kr) * kr / kg * uv_scale),
+		ToFixed6(2 * (1 - kr) * uv_scale) };
+}
+
+// |kr| and |kb| are the red and blue luma weights of the matrix. Limited range
+// stretches luma 16..235 and chroma 16..240 to the full 0..255.
+constexpr YuvConstants MakeYuvConstants(double kr, double kb, YuvColorRange range) {
+	return range == kYuvColorRangeFull ? MakeYuvConstants(kr, kb, 1 - kr - kb, 1.0, 1.0, 0) :
+		MakeYuvConstants(kr, kb, 1 - kr - kb, 255.0 / 219, 255.0 / 224, 16);
+}
+
+}
+
+constexpr YuvConstants kYuvI601Constants = MakeYuvConstants(0.299, 0.114, kYuvColorRangeLimited);
+constexpr YuvConstants kYuvJ601Constants = MakeYuvConstants(0.299, 0.114, kYuvColorRangeFull);
+constexpr YuvConstants kYuvH709Constants = MakeYuvConstants(0.2126, 0.0722, kYuvColorRangeLimited);
+constexpr YuvConstants kYuvF709Constants = MakeYuvConstants(0.2126, 0.0722, kYuvColorRangeFull);
+
+static_assert(kYuvI601Constants.y_gain == 75 && kYuvI601Constants.ub == 129 && kYuvI601Constants.ug == 25 &&
+	kYuvI601Constants.vg == 52 && kYuvI601Constants.vr == 102, "BT.601 coefficients changed");
+
+const YuvConstants& GetYuvConstants(YuvColorMatrix matrix, YuvColorRange range) {
+	if (matrix == kYuvColorMatrixBT709) {
+		return range == kYuvColorRangeFull ? kYuvF709Constants : kYuvH709Constants;
+	}
+	return range == kYuvColorRangeFull ? kYuvJ601Constants : kYuvI601Constants;
+}
+
+ConvertRowFunctions GetConvertRowFunctions(int cpu_flags) {
+	ConvertRowFunctions functions = {
+		SplitUVRow_C, MergeUVRow_C, YUY2ToYRow_C, UYVYToYRow_C, YUY2ToUVRow_C, UYVYToUVRow_C,
+		I422ToRGBRow_C<kVideoTypeBGRA>, I422ToRGBRow_C<kVideoTypeARGB>, I422ToRGBRow_C<kVideoTypeABGR>,
+	};
+#if defined(HAS_X86_SIMD)
+	if (cpu_flags & kCpuHasSSE2) {
+		ConvertRowFunctions sse2 = {
+			SplitUVRow_SSE2, MergeUVRow_SSE2, YUY2ToYRow_SSE2, UYVYToYRow_SSE2, YUY2ToUVRow_SSE2, UYVYToUVRow_SSE2,
+			I422ToRGBRow_SSE2<kVideoTypeBGRA>, I422ToRGBRow_SSE2<kVideoTypeARGB>, I422ToRGBRow_SSE2<kVideoTypeABGR>,
+		};
+		functions = sse2;
+	}
+	if ((cpu_flags & kCpuHasSSE2) && (cpu_flags & kCpuHasAVX2)) {
+		ConvertRowFunctions avx2 = {
+			SplitUVRow_AVX2, MergeUVRow_AVX2, YUY2ToYRow_AVX2, UYVYToYRow_AVX2, YUY2ToUVRow_AVX2, UYVYToUVRow_AVX2,
+			I422ToRGBRow_AVX2<kVideoTypeBGRA>, I422ToRGBRow_AVX2<kVideoTypeARGB>, I422ToRGBRow_AVX2<kVideoTypeABGR>,
+		};
+		functions = avx2;
+	}
+#endif
+#if defined(HAS_NEON_SIMD)
+	if (cpu_flags & kCpuHasNEON) {
+		ConvertRowFunctions neon = {
+			SplitUVRow_NEON, MergeUVRow_NEON, YUY2ToYRow_NEON, UYVYToYRow_NEON, YUY2ToUVRow_NEON, UYVYToUVRow_NEON,
+			I422ToRGBRow_NEON<kVideoTypeBGRA>, I422ToRGBRow_NEON<kVideoTypeARGB>, I422ToRGBRow_NEON<kVideoTypeABGR>,
+		};
+		functions = neon;
+	}
+#endif
+	return functions;
+}
+
+namespace {
+
+enum FormatFamily {
+	kFamilyNone,
+	kFamilyPlanar420,
+	kFamilySemiPlanar420,
+	kFamilyPacked422,
+	kFamilyRGB,
+};
+
+FormatFamily GetFormatFamily(VideoType video_type) {
+	switch (video_type) {
+	case kVideoTypeI420:
+	case kVideoTypeIYUV:
+	case kVideoTypeYV12:
+		return kFamilyPlanar420;
+	case kVideoTypeNV12:
+	case kVideoTypeNV21:
+		return kFamilySemiPlanar420;
+	case kVideoTypeYUY2:
+	case kVideoTypeUYVY:
+		return kFamilyPacked422;
+	case kVideoTypeBGRA:
+	case kVideoTypeARGB:
+	case kVideoTypeABGR:
+	case kVideoTypeRGB24:
+	case kVideoTypeRGB565:
+	case kVideoTypeARGB1555:
+	case kVideoTypeARGB4444:
+		return kFamilyRGB;
+	default:
+		break;
+	}
+	return kFamilyNone;
+}
+
+// Bands smaller than this cost more to hand out than to convert.
+const int kMinRowsPerTask = 16;
+
+// Start of the interleaved chroma plane of an NV12 or NV21 frame.
+const uint8_t* ChromaPlane(const VideoFrame& frame) {
+	return frame.video_type == kVideoTypeNV21 ? frame.v_data : frame.u_data;
+}
+
+struct Scratch {
+	uint8_t* y;
+	uint8_t* u;
+	uint8_t* v;
+	uint8_t* bgra;
+};
+
+Scratch GetScratch(int width) {
+	static thread_local std::vector<uint8_t> memory;
+	size_t row = (static_cast<size_t>(width) + 63) & ~static_cast<size_t>(63);
+	if (memory.size() < row * 11) {
+		memory.resize(row * 11);
+	}
+	Scratch scratch;
+	scratch.y = memory.data();
+	scratch.u = scratch.y + row;
+	scratch.v = scratch.u + row;
+	scratch.bgra = scratch.v + row;
+	return scratch;
+}
+
+class FrameConverter {
+public:
+	FrameConverter(const VideoFrame& src, VideoFrame& dst, const YuvConstants& yuv_constants,
+		ThreadPool* thread_pool)
+		: src_(src), dst_(dst), yuv_constants_(yuv_constants), thread_pool_(thread_pool),
+		rows_(GetConvertRowFunctions(GetCpuFlags())),
+		width_(static_cast<int>(src.width)), height_(static_cast<int>(src.height)),
+		chroma_width_((width_ + 1) / 2), scratch_(GetScratch(width_)) {}
+
+	bool Convert() {
+		FormatFamily src_family = GetFormatFamily(src_.video_type);
+		FormatFamily dst_family = GetFormatFamily(dst_.video_type);
+		if (src_.video_type == dst_.video_type && src_family != kFamilyNone) {
+			CopySameType();
+			return true;
+		}
+		switch (dst_family) {
+		case kFamilyPlanar420:
+		case kFamilySemiPlanar420:
+			if (src_family == kFamilyRGB) {
+				RGBTo420();
+			}
+			else {
+				YuvTo420();
+			}
+			return true;
+		case kFamilyPacked422:
+		case kFamilyRGB:
+			ConvertRowsInBands();
+			return true;
+		default:
+			break;
+		}
+		return false;
+	}
+
+private:
+	// Destination rows are independent, so with a thread pool the frame is cut
+	// into bands of whole chroma rows and each band gets its own converter and
+	// scratch rows on the thread that runs it.
+	void ConvertRowsInBands() {
+		size_t threads = thread_pool_ ? thread_pool_->ThreadCount() : 0;
+		int band_rows = threads ? static_cast<int>((height_ + threads * 4 - 1) / (threads * 4)) : height_;
+		band_rows = (std::max(band_rows, kMinRowsPerTask) + 1) & ~1;
+		size_t bands = static_cast<size_t>((height_ + band_rows - 1) / band_rows);
+		if (bands <= 1) {
+			ConvertRows(0, height_);
+			return;
+		}
+		thread_pool_->ParallelFor(bands, [this, band_rows](size_t index) {
+			int row_begin = static_cast<int>(index) * band_rows;
+			FrameConverter band(src_, dst_, yuv_constants_, nullptr);
+			band.ConvertRows(row_begin, std::min(row_begin + band_rows, height_));
+		});
+	}
+
+	// Rows [row_begin, row_end) of a packed 4:2:2 or RGB destination. |row_begin|
+	// is even so semi-planar chroma rows are never split between bands.
+	void ConvertRows(int row_begin, int row_end) {
+		FormatFamily src_family = GetFormatFamily(src_.video_type);
+		FormatFamily dst_family = GetFormatFamily(dst_.video_type);
+		for (int y = row_begin; y < row_end; ++y) {
+			const uint8_t* row_y;
+			const uint8_t* row_u;
+			const uint8_t* row_v;
+			if (src_family == kFamilyRGB) {
+				const uint8_t* bgra = SourceRowAsBGRA(y);
+				if (dst_family == kFamilyRGB) {
+					BGRAToRGBRow_C(bgra, DestinationRow(y), dst_.video_type, width_);
+					continue;
+				}
+				BGRAToYRow_C(bgra, scratch_.y, width_);
+				BGRAToUVRow_C(bgra, 0, scratch_.u, scratch_.v, width_);
+				row_y = scratch_.y;
+				row_u = scratch_.u;
+				row_v = scratch_.v;
+			}
+			else {
+				GetYuvRow(y, &row_y, &row_u, &row_v);
+			}
+			if (dst_family == kFamilyPacked422) {
+				I422ToPackedRow_C(row_y, row_u, row_v, DestinationRow(y), dst_.video_type, width_);
+			}
+			else {
+				YuvRowToRGB(row_y, row_u, row_v, DestinationRow(y));
+			}
+		}
+	}
+
+	uint8_t* DestinationRow(int y) {
+		return dst_.y_data + static_cast<size_t>(y) * dst_.y_stride;
+	}
+
+	const uint8_t* SourceRow(int y) {
+		return src_.y_data + static_cast<size_t>(y) * src_.y_stride;
+	}
+
+	void CopySameType() {
+		VideoDescription description;
+		description.width = src_.width;
+		description.height = src_.height;
+		description.video_type = src_.video_type;
+		VideoFrameLayout layout;
+		GetVideoFrameLayout(description, 1, layout);
+		const uint8_t* src_planes[] = { src_.y_data, src_.u_data, src_.v_data };
+		uint8_t* dst_planes[] = { dst_.y_data, dst_.u_data, dst_.v_data };
+		uint32_t src_strides[] = { src_.y_stride, src_.u_stride, src_.v_stride };
+		uint32_t dst_strides[] = { dst_.y_stride, dst_.u_stride, dst_.v_stride };
+		if (src_.video_type == kVideoTypeNV21) {
+			src_planes[1] = src_.v_data;
+			dst_planes[1] = dst_.v_data;
+		}
+		for (int plane = 0; plane < layout.plane_count; ++plane) {
+			for (uint32_t row = 0; row < layout.planes[plane].height; ++row) {
+				memcpy(dst_planes[plane] + static_cast<size_t>(row) * dst_strides[plane],
+					src_planes[plane] + static_cast<size_t>(row) * src_strides[plane], layout.planes[plane].stride);
+			}
+		}
+	}
+
+	// U and V rows of a 4:2:0 source as planar rows.
+	void GetChromaRow(int chroma_y, const uint8_t** row_u, const uint8_t** row_v) {
+		if (GetFormatFamily(src_.video_type) == kFamilyPlanar420) {
+			*row_u = src_.u_data + static_cast<size_t>(chroma_y) * src_.u_stride;
+			*row_v = src_.v_data + static_cast<size_t>(chroma_y) * src_.v_stride;
+			return;
+		}
+		const uint8_t* uv = ChromaPlane(src_) + static_cast<size_t>(chroma_y) * src_.u_stride;
+		if (src_.video_type == kVideoTypeNV21) {
+			rows_.split_uv(uv, scratch_.v, scratch_.u, chroma_width_);
+		}
+		else {
+			rows_.split_uv(uv, scratch_.u, scratch_.v, chroma_width_);
+		}
+		*row_u = scratch_.u;
+		*row_v = scratch_.v;
+	}
+
+	// One luma row with its 4:2:2 chroma from a YUV source.
+	void GetYuvRow(int y, const uint8_t** row_y, const uint8_t** row_u, const uint8_t** row_v) {
+		if (GetFormatFamily(src_.video_type) == kFamilyPacked422) {
+			bool uyvy = src_.video_type == kVideoTypeUYVY;
+			(uyvy ? rows_.uyvy_to_y : rows_.yuy2_to_y)(SourceRow(y), scratch_.y, width_);
+			(uyvy ? rows_.uyvy_to_uv : rows_.yuy2_to_uv)(SourceRow(y), 0, scratch_.u, scratch_.v, width_);
+			*row_y = scratch_.y;
+			*row_u = scratch_.u;
+			*row_v = scratch_.v;
+			return;
+		}
+		*row_y = SourceRow(y);
+		// Semi-planar chroma is split once and reused for the second luma row.
+		if (y % 2 == 0 || GetFormatFamily(src_.video_type) == kFamilyPlanar420) {
+			GetChromaRow(y / 2, &chroma_u_, &chroma_v_);
+		}
+		*row_u = chroma_u_;
+		*row_v = chroma_v_;
+	}
+
+	void YuvRowToRGB(const uint8_t* row_y, const uint8_t* row_u, const uint8_t* row_v, uint8_t* dst) {
+		switch (dst_.video_type) {
+		case kVideoTypeBGRA:
+			rows_.i422_to_bgra(row_y, row_u, row_v, dst, width_, yuv_constants_);
+			break;
+		case kVideoTypeARGB:
+			rows_.i422_to_argb(row_y, row_u, row_v, dst, width_, yuv_constants_);
+			break;
+		case kVideoTypeABGR:
+			rows_.i422_to_abgr(row_y, row_u, row_v, dst, width_, yuv_constants_);
+			break;
+		default:
+			rows_.i422_to_bgra(row_y, row_u, row_v, scratch_.bgra, width_, yuv_constants_);
+			BGRAToRGBRow_C(scratch_.bgra, dst, dst_.video_type, width_);
+			break;
+		}
+	}
+
+	const uint8_t* SourceRowAsBGRA(int y, uint8_t* scratch) {
+		if (src_.video_type == kVideoTypeBGRA) {
+			return SourceRow(y);
+		}
+		RGBToBGRARow_C(SourceRow(y), src_.video_type, scratch, width_);
+		return scratch;
+	}
+
+	const uint8_t* SourceRowAsBGRA(int y) {
+		return SourceRowAsBGRA(y, scratch_.bgra);
+	}
+
+	// Writes planar U and V rows to the chroma of a 4:2:0 destination.
+	void WriteChromaRow(int chroma_y, const uint8_t* row_u, const uint8_t* row_v) {
+		if (GetFormatFamily(dst_.video_type) == kFamilyPlanar420) {
+			uint8_t* u = dst_.u_data + static_cast<size_t>(chroma_y) * dst_.u_stride;
+			uint8_t* v = dst_.v_data + static_cast<size_t>(chroma_y) * dst_.v_stride;
+			if (u != row_u) {
+				memcpy(u, row_u, chroma_width_);
+			}
+			if (v != row_v) {
+				memcpy(v, row_v, chroma_width_);
+			}
+			return;
+		}
+		uint8_t* uv = const_cast<uint8_t*>(ChromaPlane(dst_)) + static_cast<size_t>(chroma_y) * dst_.u_stride;
+		if (dst_.video_type == kVideoTypeNV21) {
+			rows_.merge_uv(row_v, row_u, uv, chroma_width_);
+		}
+		else {
+			rows_.merge_uv(row_u, row_v, uv, chroma_width_);
+		}
+	}
+
+	// Planar destination rows can be written directly, semi-planar ones go
+	// through the scratch rows.
+	void ChromaOutputRows(int chroma_y, uint8_t** row_u, uint8_t** row_v) {
+		if (GetFormatFamily(dst_.video_type) == kFamilyPlanar420) {
+			*row_u = dst_.u_data + static_cast<size_t>(chroma_y) * dst_.u_stride;
+			*row_v = dst_.v_data + static_cast<size_t>(chroma_y) * dst_.v_stride;
+			return;
+		}
+		*row_u = scratch_.u;
+		*row_v = scratch_.v;
+	}
+
+	void YuvTo420() {
+		FormatFamily src_family = GetFormatFamily(src_.video_type);
+		if (src_family == kFamilyPacked422) {
+			bool uyvy = src_.video_type == kVideoTypeUYVY;
+			for (int y = 0; y < height_; ++y) {
+				(uyvy ? rows_.uyvy_to_y : rows_.yuy2_to_y)(SourceRow(y), DestinationRow(y), width_);
+			}
+			for (int chroma_y = 0; chroma_y < (height_ + 1) / 2; ++chroma_y) {
+				int src_stride = (2 * chroma_y + 1 < height_) ? static_cast<int>(src_.y_stride) : 0;
+				uint8_t* row_u;
+				uint8_t* row_v;
+				ChromaOutputRows(chroma_y, &row_u, &row_v);
+				(uyvy ? rows_.uyvy_to_uv : rows_.yuy2_to_uv)(SourceRow(2 * chroma_y), src_stride, row_u, row_v, width_);
+				WriteChromaRow(chroma_y, row_u, row_v);
+			}
+			return;
+		}
+		for (int y = 0; y < height_; ++y) {
+			memcpy(DestinationRow(y), SourceRow(y), width_);
+		}
+		bool same_semi_planar = src_family == kFamilySemiPlanar420 &&
+			GetFormatFamily(dst_.video_type) == kFamilySemiPlanar420 && src_.video_type == dst_.video_type;
+		for (int chroma_y = 0; chroma_y < (height_ + 1) / 2; ++chroma_y) {
+			if (same_semi_planar) {
+				memcpy(const_cast<uint8_t*>(ChromaPlane(dst_)) + static_cast<size_t>(chroma_y) * dst_.u_stride,
+					ChromaPlane(src_) + static_cast<size_t>(chroma_y) * src_.u_stride, chroma_width_ * 2);
+				continue;
+			}
+			const uint8_t* row_u;
+			const uint8_t* row_v;
+			GetChromaRow(chroma_y, &row_u, &row_v);
+			WriteChromaRow(chroma_y, row_u, row_v);
+		}
+	}
+
+	void RGBTo420() {
+		uint8_t* second_row = scratch_.bgra + static_cast<size_t>(width_) * 4;
+		for (int y = 0; y < height_; y += 2) {
+			const uint8_t* bgra0 = SourceRowAsBGRA(y, scratch_.bgra);
+			const uint8_t* bgra1 = (y + 1 < height_) ? SourceRowAsBGRA(y + 1, second_row) : bgra0;
+			BGRAToYRow_C(bgra0, DestinationRow(y), width_);
+			if (y + 1 < height_) {
+				BGRAToYRow_C(bgra1, DestinationRow(y + 1), width_);
+			}
+			uint8_t* row_u;
+			uint8_t* row_v;
+			ChromaOutputRows(y / 2, &row_u, &row_v);
+			BGRAToUVRow_C(bgra0, static_cast<int>(bgra1 - bgra0), row_u, row_v, width_);
+			WriteChromaRow(y / 2, row_u, row_v);
+		}
+	}
+
+	const VideoFrame& src_;
+	VideoFrame& dst_;
+	const YuvConstants& yuv_constants_;
+	ThreadPool* thread_pool_;
+	ConvertRowFunctions rows_;
+	int width_;
+	int height_;
+	int chroma_width_;
+	Scratch scratch_;
+	const uint8_t* chroma_u_{};
+	const uint8_t* chroma_v_{};
+};
+
+}
+
+bool CanConvertVideoFrame(VideoType src_type, VideoType dst_type) {
+	return GetFormatFamily(src_type) != kFamilyNone && GetFormatFamily(dst_type) != kFamilyNone;
+}
+
+bool ConvertVideoFrame(const VideoFrame& src, VideoFrame& dst, const YuvConstants& yuv_constants,
+	ThreadPool* thread_pool) {
+	if (!CanConvertVideoFrame(src.video_type, dst.video_type)) {
+		return false;
+	}
+	if (src.width != dst.width || src.height != dst.height || !src.y_data || !dst.y_data) {
+		return false;
+	}
+	FrameConverter converter(src, dst, yuv_constants, thread_pool);
+	return converter.Convert();
+}
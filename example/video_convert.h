@@ -0,0 +1,57 @@
+#pragma once
+#include <cstdint>
+
+#include "video_frame.h"
+
+class ThreadPool;
+
+// Fixed point YUV->RGB coefficients with 6 fractional bits. All kernels use
+// saturating 16-bit arithmetic so the SIMD paths match the scalar reference
+// bit for bit:
+//   y' = (y - y_offset) * y_gain + 32
+//   b = (y' + ub * (u - 128)) >> 6
+//   g = (y' - (ug * (u - 128) + vg * (v - 128))) >> 6
+//   r = (y' + vr * (v - 128)) >> 6
+struct YuvConstants {
+	int16_t y_gain;
+	int16_t y_offset;
+	int16_t ub;
+	int16_t ug;
+	int16_t vg;
+	int16_t vr;
+};
+
+enum YuvColorMatrix {
+	kYuvColorMatrixBT601,
+	kYuvColorMatrixBT709,
+};
+
+enum YuvColorRange {
+	kYuvColorRangeLimited,
+	kYuvColorRangeFull,
+};
+
+// Coefficients for each matrix and range, generated at compile time from the
+// luma weights of the matrix.
+
+// BT.601, limited range. SD cameras and most webcams.
+extern const YuvConstants kYuvI601Constants;
+// BT.601, full range. JPEG and so MJPEG cameras.
+extern const YuvConstants kYuvJ601Constants;
+// BT.709, limited range. HD video.
+extern const YuvConstants kYuvH709Constants;
+// BT.709, full range.
+extern const YuvConstants kYuvF709Constants;
+
+const YuvConstants& GetYuvConstants(YuvColorMatrix matrix, YuvColorRange range);
+
+// RGB formats are named by byte order in memory, e.g. kVideoTypeBGRA stores
+// B, G, R, A and kVideoTypeRGB24 stores B, G, R like Windows RGB24.
+bool CanConvertVideoFrame(VideoType src_type, VideoType dst_type);
+
+// Converts |src| into the planes already allocated in |dst|, which must have
+// the same size. Pixel data goes through the fastest kernels allowed by
+// GetCpuFlags(). Conversions to packed 4:2:2 and RGB types split their rows
+// across |thread_pool| when one is given.
+bool ConvertVideoFrame(const VideoFrame& src, VideoFrame& dst,
+	const YuvConstants& yuv_constants = kYuvI601Constants, ThreadPool* thread_pool = nullptr);
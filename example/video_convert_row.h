@@ -0,0 +1,86 @@
+#pragma once
+#include <cstdint>
+
+#include "cpu_features.h"
+#include "video_convert.h"
+
+// Row kernels behind ConvertVideoFrame(). Widths are in pixels of the
+// destination plane: chroma samples for the UV rows, luma samples otherwise.
+// SIMD versions handle whole blocks and finish the tail with the _C version,
+// so every variant produces exactly the same bytes.
+
+typedef void (*SplitUVRowFunction)(const uint8_t* src_uv, uint8_t* dst_u, uint8_t* dst_v, int width);
+typedef void (*MergeUVRowFunction)(const uint8_t* src_u, const uint8_t* src_v, uint8_t* dst_uv, int width);
+typedef void (*PackedToYRowFunction)(const uint8_t* src, uint8_t* dst_y, int width);
+// Averages the chroma of two packed 4:2:2 rows |src_stride| apart, pass 0 to
+// read a single row. |width| is the luma width of the row.
+typedef void (*PackedToUVRowFunction)(const uint8_t* src, int src_stride, uint8_t* dst_u, uint8_t* dst_v, int width);
+typedef void (*I422ToRGBRowFunction)(const uint8_t* src_y, const uint8_t* src_u, const uint8_t* src_v,
+	uint8_t* dst, int width, const YuvConstants& yuv_constants);
+
+struct ConvertRowFunctions {
+	SplitUVRowFunction split_uv;
+	MergeUVRowFunction merge_uv;
+	PackedToYRowFunction yuy2_to_y;
+	PackedToYRowFunction uyvy_to_y;
+	PackedToUVRowFunction yuy2_to_uv;
+	PackedToUVRowFunction uyvy_to_uv;
+	I422ToRGBRowFunction i422_to_bgra;
+	I422ToRGBRowFunction i422_to_argb;
+	I422ToRGBRowFunction i422_to_abgr;
+};
+
+ConvertRowFunctions GetConvertRowFunctions(int cpu_flags);
+
+void SplitUVRow_C(const uint8_t* src_uv, uint8_t* dst_u, uint8_t* dst_v, int width);
+void MergeUVRow_C(const uint8_t* src_u, const uint8_t* src_v, uint8_t* dst_uv, int width);
+void YUY2ToYRow_C(const uint8_t* src, uint8_t* dst_y, int width);
+void UYVYToYRow_C(const uint8_t* src, uint8_t* dst_y, int width);
+void YUY2ToUVRow_C(const uint8_t* src, int src_stride, uint8_t* dst_u, uint8_t* dst_v, int width);
+void UYVYToUVRow_C(const uint8_t* src, int src_stride, uint8_t* dst_u, uint8_t* dst_v, int width);
+template <VideoType kType>
+void I422ToRGBRow_C(const uint8_t* src_y, const uint8_t* src_u, const uint8_t* src_v,
+	uint8_t* dst, int width, const YuvConstants& yuv_constants);
+
+// Scalar only: packing and unpacking of the less common RGB layouts goes
+// through a BGRA row.
+void BGRAToRGBRow_C(const uint8_t* src_bgra, uint8_t* dst, VideoType dst_type, int width);
+void RGBToBGRARow_C(const uint8_t* src, VideoType src_type, uint8_t* dst_bgra, int width);
+void BGRAToYRow_C(const uint8_t* src_bgra, uint8_t* dst_y, int width);
+void BGRAToUVRow_C(const uint8_t* src_bgra, int src_stride, uint8_t* dst_u, uint8_t* dst_v, int width);
+void I422ToPackedRow_C(const uint8_t* src_y, const uint8_t* src_u, const uint8_t* src_v,
+	uint8_t* dst, VideoType dst_type, int width);
+
+#if defined(HAS_X86_SIMD)
+void SplitUVRow_SSE2(const uint8_t* src_uv, uint8_t* dst_u, uint8_t* dst_v, int width);
+void MergeUVRow_SSE2(const uint8_t* src_u, const uint8_t* src_v, uint8_t* dst_uv, int width);
+void YUY2ToYRow_SSE2(const uint8_t* src, uint8_t* dst_y, int width);
+void UYVYToYRow_SSE2(const uint8_t* src, uint8_t* dst_y, int width);
+void YUY2ToUVRow_SSE2(const uint8_t* src, int src_stride, uint8_t* dst_u, uint8_t* dst_v, int width);
+void UYVYToUVRow_SSE2(const uint8_t* src, int src_stride, uint8_t* dst_u, uint8_t* dst_v, int width);
+template <VideoType kType>
+void I422ToRGBRow_SSE2(const uint8_t* src_y, const uint8_t* src_u, const uint8_t* src_v,
+	uint8_t* dst, int width, const YuvConstants& yuv_constants);
+
+void SplitUVRow_AVX2(const uint8_t* src_uv, uint8_t* dst_u, uint8_t* dst_v, int width);
+void MergeUVRow_AVX2(const uint8_t* src_u, const uint8_t* src_v, uint8_t* dst_uv, int width);
+void YUY2ToYRow_AVX2(const uint8_t* src, uint8_t* dst_y, int width);
+void UYVYToYRow_AVX2(const uint8_t* src, uint8_t* dst_y, int width);
+void YUY2ToUVRow_AVX2(const uint8_t* src, int src_stride, uint8_t* dst_u, uint8_t* dst_v, int width);
+void UYVYToUVRow_AVX2(const uint8_t* src, int src_stride, uint8_t* dst_u, uint8_t* dst_v, int width);
+template <VideoType kType>
+void I422ToRGBRow_AVX2(const uint8_t* src_y, const uint8_t* src_u, const uint8_t* src_v,
+	uint8_t* dst, int width, const YuvConstants& yuv_constants);
+#endif
+
+#if defined(HAS_NEON_SIMD)
+void SplitUVRow_NEON(const uint8_t* src_uv, uint8_t* dst_u, uint8_t* dst_v, int width);
+void MergeUVRow_NEON(const uint8_t* src_u, const uint8_t* src_v, uint8_t* dst_uv, int width);
+void YUY2ToYRow_NEON(const uint8_t* src, uint8_t* dst_y, int width);
+void UYVYToYRow_NEON(const uint8_t* src, uint8_t* dst_y, int width);
+void YUY2ToUVRow_NEON(const uint8_t* src, int src_stride, uint8_t* dst_u, uint8_t* dst_v, int width);
+void UYVYToUVRow_NEON(const uint8_t* src, int src_stride, uint8_t* dst_u, uint8_t* dst_v, int width);
+template <VideoType kType>
+void I422ToRGBRow_NEON(const uint8_t* src_y, const uint8_t* src_u, const uint8_t* src_v,
+	uint8_t* dst, int width, const YuvConstants& yuv_constants);
+#endif
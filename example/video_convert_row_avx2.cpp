@@ -0,0 +1,171 @@
+#include "video_convert_row.h"
+
+// Built with AVX2 code generation enabled, only called when the CPU has it.
+#if defined(HAS_X86_SIMD)
+#include <immintrin.h>
+
+namespace {
+
+__m256i LoadU(const uint8_t* src) {
+	return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src));
+}
+
+void StoreU(uint8_t* dst, __m256i value) {
+	_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst), value);
+}
+
+// Even (|odd| false) or odd bytes of 64 bytes into 32, in order.
+__m256i PackBytes(__m256i lo, __m256i hi, bool odd) {
+	__m256i packed;
+	if (odd) {
+		packed = _mm256_packus_epi16(_mm256_srli_epi16(lo, 8), _mm256_srli_epi16(hi, 8));
+	}
+	else {
+		const __m256i mask = _mm256_set1_epi16(0x00ff);
+		packed = _mm256_packus_epi16(_mm256_and_si256(lo, mask), _mm256_and_si256(hi, mask));
+	}
+	// packus works per 128-bit lane, restore the order of the 64-bit halves.
+	return _mm256_permute4x64_epi64(packed, 0xd8);
+}
+
+// 16 pixels of 4:2:2 to 16-bit B, G, R.
+void YuvToRGB16(const uint8_t* src_y, const uint8_t* src_u, const uint8_t* src_v, const YuvConstants& c,
+	__m256i* b, __m256i* g, __m256i* r) {
+	__m256i y = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src_y)));
+	__m128i u8 = _mm_cvtepu8_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(src_u)));
+	__m128i v8 = _mm_cvtepu8_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(src_v)));
+	__m256i u = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_unpacklo_epi16(u8, u8)), _mm_unpackhi_epi16(u8, u8), 1);
+	__m256i v = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_unpacklo_epi16(v8, v8)), _mm_unpackhi_epi16(v8, v8), 1);
+	u = _mm256_sub_epi16(u, _mm256_set1_epi16(128));
+	v = _mm256_sub_epi16(v, _mm256_set1_epi16(128));
+	y = _mm256_mullo_epi16(_mm256_sub_epi16(y, _mm256_set1_epi16(c.y_offset)), _mm256_set1_epi16(c.y_gain));
+	y = _mm256_adds_epi16(y, _mm256_set1_epi16(32));
+	__m256i uv_g = _mm256_adds_epi16(_mm256_mullo_epi16(u, _mm256_set1_epi16(c.ug)),
+		_mm256_mullo_epi16(v, _mm256_set1_epi16(c.vg)));
+	*b = _mm256_srai_epi16(_mm256_adds_epi16(y, _mm256_mullo_epi16(u, _mm256_set1_epi16(c.ub))), 6);
+	*g = _mm256_srai_epi16(_mm256_subs_epi16(y, uv_g), 6);
+	*r = _mm256_srai_epi16(_mm256_adds_epi16(y, _mm256_mullo_epi16(v, _mm256_set1_epi16(c.vr))), 6);
+}
+
+// Interleaves four 8-bit channels of 16 pixels in memory order c0 c1 c2 c3.
+void StoreChannels16(uint8_t* dst, __m256i c0, __m256i c1, __m256i c2, __m256i c3) {
+	__m256i c01 = _mm256_packus_epi16(c0, c1);
+	__m256i c23 = _mm256_packus_epi16(c2, c3);
+	c01 = _mm256_unpacklo_epi8(c01, _mm256_srli_si256(c01, 8));
+	c23 = _mm256_unpacklo_epi8(c23, _mm256_srli_si256(c23, 8));
+	__m256i lo = _mm256_unpacklo_epi16(c01, c23);
+	__m256i hi = _mm256_unpackhi_epi16(c01, c23);
+	StoreU(dst, _mm256_permute2x128_si256(lo, hi, 0x20));
+	StoreU(dst + 32, _mm256_permute2x128_si256(lo, hi, 0x31));
+}
+
+template <VideoType kType>
+void StorePixels16(uint8_t* dst, __m256i b, __m256i g, __m256i r);
+
+template <>
+void StorePixels16<kVideoTypeBGRA>(uint8_t* dst, __m256i b, __m256i g, __m256i r) {
+	StoreChannels16(dst, b, g, r, _mm256_set1_epi16(255));
+}
+
+template <>
+void StorePixels16<kVideoTypeARGB>(uint8_t* dst, __m256i b, __m256i g, __m256i r) {
+	StoreChannels16(dst, _mm256_set1_epi16(255), r, g, b);
+}
+
+template <>
+void StorePixels16<kVideoTypeABGR>(uint8_t* dst, __m256i b, __m256i g, __m256i r) {
+	StoreChannels16(dst, _mm256_set1_epi16(255), b, g, r);
+}
+
+void PackedToYRow(const uint8_t* src, uint8_t* dst_y, int width, bool odd) {
+	int x = 0;
+	for (; x + 32 <= width; x += 32) {
+		StoreU(dst_y + x, PackBytes(LoadU(src + 2 * x), LoadU(src + 2 * x + 32), odd));
+	}
+	if (x < width) {
+		(odd ? UYVYToYRow_SSE2 : YUY2ToYRow_SSE2)(src + 2 * x, dst_y + x, width - x);
+	}
+}
+
+void PackedToUVRow(const uint8_t* src, int src_stride, uint8_t* dst_u, uint8_t* dst_v, int width, bool yuy2) {
+	const uint8_t* next = src + src_stride;
+	int x = 0;
+	for (; x + 32 <= width; x += 32) {
+		__m256i lo = _mm256_avg_epu8(LoadU(src + 2 * x), LoadU(next + 2 * x));
+		__m256i hi = _mm256_avg_epu8(LoadU(src + 2 * x + 32), LoadU(next + 2 * x + 32));
+		__m256i uv = PackBytes(lo, hi, yuy2);
+		__m256i u = PackBytes(uv, uv, false);
+		__m256i v = PackBytes(uv, uv, true);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst_u + x / 2), _mm256_castsi256_si128(u));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst_v + x / 2), _mm256_castsi256_si128(v));
+	}
+	if (x < width) {
+		(yuy2 ? YUY2ToUVRow_SSE2 : UYVYToUVRow_SSE2)(src + 2 * x, src_stride, dst_u + x / 2, dst_v + x / 2, width - x);
+	}
+}
+
+}
+
+void SplitUVRow_AVX2(const uint8_t* src_uv, uint8_t* dst_u, uint8_t* dst_v, int width) {
+	int x = 0;
+	for (; x + 32 <= width; x += 32) {
+		__m256i lo = LoadU(src_uv + 2 * x);
+		__m256i hi = LoadU(src_uv + 2 * x + 32);
+		StoreU(dst_u + x, PackBytes(lo, hi, false));
+		StoreU(dst_v + x, PackBytes(lo, hi, true));
+	}
+	if (x < width) {
+		SplitUVRow_SSE2(src_uv + 2 * x, dst_u + x, dst_v + x, width - x);
+	}
+}
+
+void MergeUVRow_AVX2(const uint8_t* src_u, const uint8_t* src_v, uint8_t* dst_uv, int width) {
+	int x = 0;
+	for (; x + 32 <= width; x += 32) {
+		__m256i u = LoadU(src_u + x);
+		__m256i v = LoadU(src_v + x);
+		__m256i lo = _mm256_unpacklo_epi8(u, v);
+		__m256i hi = _mm256_unpackhi_epi8(u, v);
+		StoreU(dst_uv + 2 * x, _mm256_permute2x128_si256(lo, hi, 0x20));
+		StoreU(dst_uv + 2 * x + 32, _mm256_permute2x128_si256(lo, hi, 0x31));
+	}
+	if (x < width) {
+		MergeUVRow_SSE2(src_u + x, src_v + x, dst_uv + 2 * x, width - x);
+	}
+}
+
+void YUY2ToYRow_AVX2(const uint8_t* src, uint8_t* dst_y, int width) {
+	PackedToYRow(src, dst_y, width, false);
+}
+
+void UYVYToYRow_AVX2(const uint8_t* src, uint8_t* dst_y, int width) {
+	PackedToYRow(src, dst_y, width, true);
+}
+
+void YUY2ToUVRow_AVX2(const uint8_t* src, int src_stride, uint8_t* dst_u, uint8_t* dst_v, int width) {
+	PackedToUVRow(src, src_stride, dst_u, dst_v, width, true);
+}
+
+void UYVYToUVRow_AVX2(const uint8_t* src, int src_stride, uint8_t* dst_u, uint8_t* dst_v, int width) {
+	PackedToUVRow(src, src_stride, dst_u, dst_v, width, false);
+}
+
+template <VideoType kType>
+void I422ToRGBRow_AVX2(const uint8_t* src_y, const uint8_t* src_u, const uint8_t* src_v,
+	uint8_t* dst, int width, const YuvConstants& yuv_constants) {
+	int x = 0;
+	for (; x + 16 <= width; x += 16) {
+		__m256i b, g, r;
+		YuvToRGB16(src_y + x, src_u + x / 2, src_v + x / 2, yuv_constants, &b, &g, &r);
+		StorePixels16<kType>(dst + 4 * x, b, g, r);
+	}
+	if (x < width) {
+		I422ToRGBRow_SSE2<kType>(src_y + x, src_u + x / 2, src_v + x / 2, dst + 4 * x, width - x, yuv_constants);
+	}
+}
+
+template void I422ToRGBRow_AVX2<kVideoTypeBGRA>(const uint8_t*, const uint8_t*, const uint8_t*, uint8_t*, int, const YuvConstants&);
+template void I422ToRGBRow_AVX2<kVideoTypeARGB>(const uint8_t*, const uint8_t*, const uint8_t*, uint8_t*, int, const YuvConstants&);
+template void I422ToRGBRow_AVX2<kVideoTypeABGR>(const uint8_t*, const uint8_t*, const uint8_t*, uint8_t*, int, const YuvConstants&);
+
+#endif
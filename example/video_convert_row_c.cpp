@@ -0,0 +1,234 @@
+#include "video_convert_row.h"
+
+namespace {
+
+int16_t Saturate16(int value) {
+	return static_cast<int16_t>(value > 32767 ? 32767 : (value < -32768 ? -32768 : value));
+}
+
+uint8_t Clamp255(int value) {
+	return static_cast<uint8_t>(value > 255 ? 255 : (value < 0 ? 0 : value));
+}
+
+void YuvPixel(uint8_t y, uint8_t u, uint8_t v, const YuvConstants& c, uint8_t* b, uint8_t* g, uint8_t* r) {
+	int16_t y1 = Saturate16(static_cast<int16_t>((y - c.y_offset) * c.y_gain) + 32);
+	int16_t u1 = static_cast<int16_t>(u - 128);
+	int16_t v1 = static_cast<int16_t>(v - 128);
+	int16_t uv_g = Saturate16(static_cast<int16_t>(u1 * c.ug) + static_cast<int16_t>(v1 * c.vg));
+	*b = Clamp255(Saturate16(y1 + static_cast<int16_t>(u1 * c.ub)) >> 6);
+	*g = Clamp255(Saturate16(y1 - uv_g) >> 6);
+	*r = Clamp255(Saturate16(y1 + static_cast<int16_t>(v1 * c.vr)) >> 6);
+}
+
+template <VideoType kType>
+void StorePixel(uint8_t* dst, uint8_t b, uint8_t g, uint8_t r, uint8_t a);
+
+template <>
+void StorePixel<kVideoTypeBGRA>(uint8_t* dst, uint8_t b, uint8_t g, uint8_t r, uint8_t a) {
+	dst[0] = b;
+	dst[1] = g;
+	dst[2] = r;
+	dst[3] = a;
+}
+
+template <>
+void StorePixel<kVideoTypeARGB>(uint8_t* dst, uint8_t b, uint8_t g, uint8_t r, uint8_t a) {
+	dst[0] = a;
+	dst[1] = r;
+	dst[2] = g;
+	dst[3] = b;
+}
+
+template <>
+void StorePixel<kVideoTypeABGR>(uint8_t* dst, uint8_t b, uint8_t g, uint8_t r, uint8_t a) {
+	dst[0] = a;
+	dst[1] = b;
+	dst[2] = g;
+	dst[3] = r;
+}
+
+void PackedToUVRow(const uint8_t* src, int src_stride, uint8_t* dst_u, uint8_t* dst_v, int width, int u_offset) {
+	const uint8_t* next = src + src_stride;
+	for (int x = 0; x < (width + 1) / 2; ++x) {
+		int u = u_offset + x * 4;
+		int v = u + 2;
+		dst_u[x] = static_cast<uint8_t>((src[u] + next[u] + 1) >> 1);
+		dst_v[x] = static_cast<uint8_t>((src[v] + next[v] + 1) >> 1);
+	}
+}
+
+}
+
+void SplitUVRow_C(const uint8_t* src_uv, uint8_t* dst_u, uint8_t* dst_v, int width) {
+	for (int x = 0; x < width; ++x) {
+		dst_u[x] = src_uv[2 * x];
+		dst_v[x] = src_uv[2 * x + 1];
+	}
+}
+
+void MergeUVRow_C(const uint8_t* src_u, const uint8_t* src_v, uint8_t* dst_uv, int width) {
+	for (int x = 0; x < width; ++x) {
+		dst_uv[2 * x] = src_u[x];
+		dst_uv[2 * x + 1] = src_v[x];
+	}
+}
+
+void YUY2ToYRow_C(const uint8_t* src, uint8_t* dst_y, int width) {
+	for (int x = 0; x < width; ++x) {
+		dst_y[x] = src[2 * x];
+	}
+}
+
+void UYVYToYRow_C(const uint8_t* src, uint8_t* dst_y, int width) {
+	for (int x = 0; x < width; ++x) {
+		dst_y[x] = src[2 * x + 1];
+	}
+}
+
+void YUY2ToUVRow_C(const uint8_t* src, int src_stride, uint8_t* dst_u, uint8_t* dst_v, int width) {
+	PackedToUVRow(src, src_stride, dst_u, dst_v, width, 1);
+}
+
+void UYVYToUVRow_C(const uint8_t* src, int src_stride, uint8_t* dst_u, uint8_t* dst_v, int width) {
+	PackedToUVRow(src, src_stride, dst_u, dst_v, width, 0);
+}
+
+template <VideoType kType>
+void I422ToRGBRow_C(const uint8_t* src_y, const uint8_t* src_u, const uint8_t* src_v,
+	uint8_t* dst, int width, const YuvConstants& yuv_constants) {
+	for (int x = 0; x < width; ++x) {
+		uint8_t b, g, r;
+		YuvPixel(src_y[x], src_u[x / 2], src_v[x / 2], yuv_constants, &b, &g, &r);
+		StorePixel<kType>(dst + 4 * x, b, g, r, 255);
+	}
+}
+
+template void I422ToRGBRow_C<kVideoTypeBGRA>(const uint8_t*, const uint8_t*, const uint8_t*, uint8_t*, int, const YuvConstants&);
+template void I422ToRGBRow_C<kVideoTypeARGB>(const uint8_t*, const uint8_t*, const uint8_t*, uint8_t*, int, const YuvConstants&);
+template void I422ToRGBRow_C<kVideoTypeABGR>(const uint8_t*, const uint8_t*, const uint8_t*, uint8_t*, int, const YuvConstants&);
+
+void BGRAToRGBRow_C(const uint8_t* src_bgra, uint8_t* dst, VideoType dst_type, int width) {
+	for (int x = 0; x < width; ++x) {
+		const uint8_t* p = src_bgra + 4 * x;
+		uint8_t b = p[0];
+		uint8_t g = p[1];
+		uint8_t r = p[2];
+		uint8_t a = p[3];
+		switch (dst_type) {
+		case kVideoTypeBGRA:
+			StorePixel<kVideoTypeBGRA>(dst + 4 * x, b, g, r, a);
+			break;
+		case kVideoTypeARGB:
+			StorePixel<kVideoTypeARGB>(dst + 4 * x, b, g, r, a);
+			break;
+		case kVideoTypeABGR:
+			StorePixel<kVideoTypeABGR>(dst + 4 * x, b, g, r, a);
+			break;
+		case kVideoTypeRGB24:
+			dst[3 * x] = b;
+			dst[3 * x + 1] = g;
+			dst[3 * x + 2] = r;
+			break;
+		case kVideoTypeRGB565: {
+			uint16_t pixel = static_cast<uint16_t>((b >> 3) | ((g >> 2) << 5) | ((r >> 3) << 11));
+			dst[2 * x] = static_cast<uint8_t>(pixel);
+			dst[2 * x + 1] = static_cast<uint8_t>(pixel >> 8);
+			break;
+		}
+		case kVideoTypeARGB1555: {
+			uint16_t pixel = static_cast<uint16_t>((b >> 3) | ((g >> 3) << 5) | ((r >> 3) << 10) | ((a >> 7) << 15));
+			dst[2 * x] = static_cast<uint8_t>(pixel);
+			dst[2 * x + 1] = static_cast<uint8_t>(pixel >> 8);
+			break;
+		}
+		case kVideoTypeARGB4444: {
+			uint16_t pixel = static_cast<uint16_t>((b >> 4) | ((g >> 4) << 4) | ((r >> 4) << 8) | ((a >> 4) << 12));
+			dst[2 * x] = static_cast<uint8_t>(pixel);
+			dst[2 * x + 1] = static_cast<uint8_t>(pixel >> 8);
+			break;
+		}
+		default:
+			return;
+		}
+	}
+}
+
+void RGBToBGRARow_C(const uint8_t* src, VideoType src_type, uint8_t* dst_bgra, int width) {
+	for (int x = 0; x < width; ++x) {
+		uint8_t b = 0, g = 0, r = 0, a = 255;
+		const uint8_t* p = src + 4 * x;
+		uint16_t pixel = static_cast<uint16_t>(src[2 * x] | (src[2 * x + 1] << 8));
+		switch (src_type) {
+		case kVideoTypeBGRA:
+			b = p[0]; g = p[1]; r = p[2]; a = p[3];
+			break;
+		case kVideoTypeARGB:
+			a = p[0]; r = p[1]; g = p[2]; b = p[3];
+			break;
+		case kVideoTypeABGR:
+			a = p[0]; b = p[1]; g = p[2]; r = p[3];
+			break;
+		case kVideoTypeRGB24:
+			b = src[3 * x]; g = src[3 * x + 1]; r = src[3 * x + 2];
+			break;
+		case kVideoTypeRGB565:
+			b = static_cast<uint8_t>((pixel & 0x1f) << 3 | (pixel & 0x1f) >> 2);
+			g = static_cast<uint8_t>(((pixel >> 5) & 0x3f) << 2 | ((pixel >> 5) & 0x3f) >> 4);
+			r = static_cast<uint8_t>((pixel >> 11) << 3 | (pixel >> 11) >> 2);
+			break;
+		case kVideoTypeARGB1555:
+			b = static_cast<uint8_t>((pixel & 0x1f) << 3 | (pixel & 0x1f) >> 2);
+			g = static_cast<uint8_t>(((pixel >> 5) & 0x1f) << 3 | ((pixel >> 5) & 0x1f) >> 2);
+			r = static_cast<uint8_t>(((pixel >> 10) & 0x1f) << 3 | ((pixel >> 10) & 0x1f) >> 2);
+			a = (pixel & 0x8000) ? 255 : 0;
+			break;
+		case kVideoTypeARGB4444:
+			b = static_cast<uint8_t>((pixel & 0xf) * 17);
+			g = static_cast<uint8_t>(((pixel >> 4) & 0xf) * 17);
+			r = static_cast<uint8_t>(((pixel >> 8) & 0xf) * 17);
+			a = static_cast<uint8_t>((pixel >> 12) * 17);
+			break;
+		default:
+			return;
+		}
+		StorePixel<kVideoTypeBGRA>(dst_bgra + 4 * x, b, g, r, a);
+	}
+}
+
+// BT.601 limited range, the inverse of kYuvI601Constants.
+void BGRAToYRow_C(const uint8_t* src_bgra, uint8_t* dst_y, int width) {
+	for (int x = 0; x < width; ++x) {
+		const uint8_t* p = src_bgra + 4 * x;
+		dst_y[x] = static_cast<uint8_t>(((66 * p[2] + 129 * p[1] + 25 * p[0] + 128) >> 8) + 16);
+	}
+}
+
+void BGRAToUVRow_C(const uint8_t* src_bgra, int src_stride, uint8_t* dst_u, uint8_t* dst_v, int width) {
+	const uint8_t* next = src_bgra + src_stride;
+	for (int x = 0; x < (width + 1) / 2; ++x) {
+		int x1 = (2 * x + 1 < width) ? 2 * x + 1 : 2 * x;
+		const uint8_t* p0 = src_bgra + 8 * x;
+		const uint8_t* p1 = src_bgra + 4 * x1;
+		const uint8_t* p2 = next + 8 * x;
+		const uint8_t* p3 = next + 4 * x1;
+		int b = (p0[0] + p1[0] + p2[0] + p3[0] + 2) >> 2;
+		int g = (p0[1] + p1[1] + p2[1] + p3[1] + 2) >> 2;
+		int r = (p0[2] + p1[2] + p2[2] + p3[2] + 2) >> 2;
+		dst_u[x] = static_cast<uint8_t>(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+		dst_v[x] = static_cast<uint8_t>(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+	}
+}
+
+void I422ToPackedRow_C(const uint8_t* src_y, const uint8_t* src_u, const uint8_t* src_v,
+	uint8_t* dst, VideoType dst_type, int width) {
+	bool uyvy = dst_type == kVideoTypeUYVY;
+	for (int x = 0; x < (width + 1) / 2; ++x) {
+		uint8_t y0 = src_y[2 * x];
+		uint8_t y1 = (2 * x + 1 < width) ? src_y[2 * x + 1] : y0;
+		uint8_t* p = dst + 4 * x;
+		p[uyvy ? 1 : 0] = y0;
+		p[uyvy ? 0 : 1] = src_u[x];
+		p[uyvy ? 3 : 2] = y1;
+		p[uyvy ? 2 : 3] = src_v[x];
+	}
+}
@@ -0,0 +1,142 @@
+#include "video_convert_row.h"
+
+#if defined(HAS_NEON_SIMD)
+#include <arm_neon.h>
+#include <cstring>
+
+namespace {
+
+// 8 pixels of 4:2:2 to 8-bit B, G, R.
+void YuvToRGB8(const uint8_t* src_y, const uint8_t* src_u, const uint8_t* src_v, const YuvConstants& c,
+	uint8x8_t* b, uint8x8_t* g, uint8x8_t* r) {
+	uint32_t u32 = 0;
+	uint32_t v32 = 0;
+	memcpy(&u32, src_u, 4);
+	memcpy(&v32, src_v, 4);
+	uint8x8_t u4 = vreinterpret_u8_u32(vdup_n_u32(u32));
+	uint8x8_t v4 = vreinterpret_u8_u32(vdup_n_u32(v32));
+	int16x8_t y = vreinterpretq_s16_u16(vmovl_u8(vld1_u8(src_y)));
+	int16x8_t u = vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(vzip_u8(u4, u4).val[0])), vdupq_n_s16(128));
+	int16x8_t v = vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(vzip_u8(v4, v4).val[0])), vdupq_n_s16(128));
+	y = vmulq_s16(vsubq_s16(y, vdupq_n_s16(c.y_offset)), vdupq_n_s16(c.y_gain));
+	y = vqaddq_s16(y, vdupq_n_s16(32));
+	int16x8_t uv_g = vqaddq_s16(vmulq_s16(u, vdupq_n_s16(c.ug)), vmulq_s16(v, vdupq_n_s16(c.vg)));
+	*b = vqmovun_s16(vshrq_n_s16(vqaddq_s16(y, vmulq_s16(u, vdupq_n_s16(c.ub))), 6));
+	*g = vqmovun_s16(vshrq_n_s16(vqsubq_s16(y, uv_g), 6));
+	*r = vqmovun_s16(vshrq_n_s16(vqaddq_s16(y, vmulq_s16(v, vdupq_n_s16(c.vr))), 6));
+}
+
+template <VideoType kType>
+void StorePixels8(uint8_t* dst, uint8x8_t b, uint8x8_t g, uint8x8_t r);
+
+template <>
+void StorePixels8<kVideoTypeBGRA>(uint8_t* dst, uint8x8_t b, uint8x8_t g, uint8x8_t r) {
+	uint8x8x4_t pixels = { { b, g, r, vdup_n_u8(255) } };
+	vst4_u8(dst, pixels);
+}
+
+template <>
+void StorePixels8<kVideoTypeARGB>(uint8_t* dst, uint8x8_t b, uint8x8_t g, uint8x8_t r) {
+	uint8x8x4_t pixels = { { vdup_n_u8(255), r, g, b } };
+	vst4_u8(dst, pixels);
+}
+
+template <>
+void StorePixels8<kVideoTypeABGR>(uint8_t* dst, uint8x8_t b, uint8x8_t g, uint8x8_t r) {
+	uint8x8x4_t pixels = { { vdup_n_u8(255), b, g, r } };
+	vst4_u8(dst, pixels);
+}
+
+// YUY2 loads as {y0, u, y1, v}, UYVY as {u, y0, v, y1}.
+void PackedToYRow(const uint8_t* src, uint8_t* dst_y, int width, bool uyvy) {
+	int x = 0;
+	for (; x + 32 <= width; x += 32) {
+		uint8x16x4_t packed = vld4q_u8(src + 2 * x);
+		uint8x16x2_t y;
+		y.val[0] = uyvy ? packed.val[1] : packed.val[0];
+		y.val[1] = uyvy ? packed.val[3] : packed.val[2];
+		vst2q_u8(dst_y + x, y);
+	}
+	if (x < width) {
+		(uyvy ? UYVYToYRow_C : YUY2ToYRow_C)(src + 2 * x, dst_y + x, width - x);
+	}
+}
+
+void PackedToUVRow(const uint8_t* src, int src_stride, uint8_t* dst_u, uint8_t* dst_v, int width, bool uyvy) {
+	const uint8_t* next = src + src_stride;
+	int x = 0;
+	for (; x + 32 <= width; x += 32) {
+		uint8x16x4_t row0 = vld4q_u8(src + 2 * x);
+		uint8x16x4_t row1 = vld4q_u8(next + 2 * x);
+		int u = uyvy ? 0 : 1;
+		int v = uyvy ? 2 : 3;
+		vst1q_u8(dst_u + x / 2, vrhaddq_u8(row0.val[u], row1.val[u]));
+		vst1q_u8(dst_v + x / 2, vrhaddq_u8(row0.val[v], row1.val[v]));
+	}
+	if (x < width) {
+		(uyvy ? UYVYToUVRow_C : YUY2ToUVRow_C)(src + 2 * x, src_stride, dst_u + x / 2, dst_v + x / 2, width - x);
+	}
+}
+
+}
+
+void SplitUVRow_NEON(const uint8_t* src_uv, uint8_t* dst_u, uint8_t* dst_v, int width) {
+	int x = 0;
+	for (; x + 16 <= width; x += 16) {
+		uint8x16x2_t uv = vld2q_u8(src_uv + 2 * x);
+		vst1q_u8(dst_u + x, uv.val[0]);
+		vst1q_u8(dst_v + x, uv.val[1]);
+	}
+	if (x < width) {
+		SplitUVRow_C(src_uv + 2 * x, dst_u + x, dst_v + x, width - x);
+	}
+}
+
+void MergeUVRow_NEON(const uint8_t* src_u, const uint8_t* src_v, uint8_t* dst_uv, int width) {
+	int x = 0;
+	for (; x + 16 <= width; x += 16) {
+		uint8x16x2_t uv;
+		uv.val[0] = vld1q_u8(src_u + x);
+		uv.val[1] = vld1q_u8(src_v + x);
+		vst2q_u8(dst_uv + 2 * x, uv);
+	}
+	if (x < width) {
+		MergeUVRow_C(src_u + x, src_v + x, dst_uv + 2 * x, width - x);
+	}
+}
+
+void YUY2ToYRow_NEON(const uint8_t* src, uint8_t* dst_y, int width) {
+	PackedToYRow(src, dst_y, width, false);
+}
+
+void UYVYToYRow_NEON(const uint8_t* src, uint8_t* dst_y, int width) {
+	PackedToYRow(src, dst_y, width, true);
+}
+
+void YUY2ToUVRow_NEON(const uint8_t* src, int src_stride, uint8_t* dst_u, uint8_t* dst_v, int width) {
+	PackedToUVRow(src, src_stride, dst_u, dst_v, width, false);
+}
+
+void UYVYToUVRow_NEON(const uint8_t* src, int src_stride, uint8_t* dst_u, uint8_t* dst_v, int width) {
+	PackedToUVRow(src, src_stride, dst_u, dst_v, width, true);
+}
+
+template <VideoType kType>
+void I422ToRGBRow_NEON(const uint8_t* src_y, const uint8_t* src_u, const uint8_t* src_v,
+	uint8_t* dst, int width, const YuvConstants& yuv_constants) {
+	int x = 0;
+	for (; x + 8 <= width; x += 8) {
+		uint8x8_t b, g, r;
+		YuvToRGB8(src_y + x, src_u + x / 2, src_v + x / 2, yuv_constants, &b, &g, &r);
+		StorePixels8<kType>(dst + 4 * x, b, g, r);
+	}
+	if (x < width) {
+		I422ToRGBRow_C<kType>(src_y + x, src_u + x / 2, src_v + x / 2, dst + 4 * x, width - x, yuv_constants);
+	}
+}
+
+template void I422ToRGBRow_NEON<kVideoTypeBGRA>(const uint8_t*, const uint8_t*, const uint8_t*, uint8_t*, int, const YuvConstants&);
+template void I422ToRGBRow_NEON<kVideoTypeARGB>(const uint8_t*, const uint8_t*, const uint8_t*, uint8_t*, int, const YuvConstants&);
+template void I422ToRGBRow_NEON<kVideoTypeABGR>(const uint8_t*, const uint8_t*, const uint8_t*, uint8_t*, int, const YuvConstants&);
+
+#endif
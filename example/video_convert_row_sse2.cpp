@@ -0,0 +1,161 @@
+#include "video_convert_row.h"
+
+#if defined(HAS_X86_SIMD)
+#include <emmintrin.h>
+#include <cstring>
+
+namespace {
+
+// 8 pixels of 4:2:2 to 16-bit B, G, R.
+void YuvToRGB8(const uint8_t* src_y, const uint8_t* src_u, const uint8_t* src_v, const YuvConstants& c,
+	__m128i* b, __m128i* g, __m128i* r) {
+	const __m128i zero = _mm_setzero_si128();
+	__m128i y = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(src_y)), zero);
+	int u32 = 0;
+	int v32 = 0;
+	memcpy(&u32, src_u, 4);
+	memcpy(&v32, src_v, 4);
+	__m128i u = _mm_unpacklo_epi8(_mm_cvtsi32_si128(u32), zero);
+	__m128i v = _mm_unpacklo_epi8(_mm_cvtsi32_si128(v32), zero);
+	u = _mm_sub_epi16(_mm_unpacklo_epi16(u, u), _mm_set1_epi16(128));
+	v = _mm_sub_epi16(_mm_unpacklo_epi16(v, v), _mm_set1_epi16(128));
+	y = _mm_mullo_epi16(_mm_sub_epi16(y, _mm_set1_epi16(c.y_offset)), _mm_set1_epi16(c.y_gain));
+	y = _mm_adds_epi16(y, _mm_set1_epi16(32));
+	__m128i uv_g = _mm_adds_epi16(_mm_mullo_epi16(u, _mm_set1_epi16(c.ug)), _mm_mullo_epi16(v, _mm_set1_epi16(c.vg)));
+	*b = _mm_srai_epi16(_mm_adds_epi16(y, _mm_mullo_epi16(u, _mm_set1_epi16(c.ub))), 6);
+	*g = _mm_srai_epi16(_mm_subs_epi16(y, uv_g), 6);
+	*r = _mm_srai_epi16(_mm_adds_epi16(y, _mm_mullo_epi16(v, _mm_set1_epi16(c.vr))), 6);
+}
+
+// Interleaves four 8-bit channels of 8 pixels in memory order c0 c1 c2 c3.
+void StoreChannels8(uint8_t* dst, __m128i c0, __m128i c1, __m128i c2, __m128i c3) {
+	__m128i c01 = _mm_packus_epi16(c0, c1);
+	__m128i c23 = _mm_packus_epi16(c2, c3);
+	c01 = _mm_unpacklo_epi8(c01, _mm_srli_si128(c01, 8));
+	c23 = _mm_unpacklo_epi8(c23, _mm_srli_si128(c23, 8));
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(dst), _mm_unpacklo_epi16(c01, c23));
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 16), _mm_unpackhi_epi16(c01, c23));
+}
+
+template <VideoType kType>
+void StorePixels8(uint8_t* dst, __m128i b, __m128i g, __m128i r);
+
+template <>
+void StorePixels8<kVideoTypeBGRA>(uint8_t* dst, __m128i b, __m128i g, __m128i r) {
+	StoreChannels8(dst, b, g, r, _mm_set1_epi16(255));
+}
+
+template <>
+void StorePixels8<kVideoTypeARGB>(uint8_t* dst, __m128i b, __m128i g, __m128i r) {
+	StoreChannels8(dst, _mm_set1_epi16(255), r, g, b);
+}
+
+template <>
+void StorePixels8<kVideoTypeABGR>(uint8_t* dst, __m128i b, __m128i g, __m128i r) {
+	StoreChannels8(dst, _mm_set1_epi16(255), b, g, r);
+}
+
+// Picks the even (|odd| false) or odd bytes of 32 bytes into 16.
+__m128i PackBytes(__m128i lo, __m128i hi, bool odd) {
+	if (odd) {
+		return _mm_packus_epi16(_mm_srli_epi16(lo, 8), _mm_srli_epi16(hi, 8));
+	}
+	const __m128i mask = _mm_set1_epi16(0x00ff);
+	return _mm_packus_epi16(_mm_and_si128(lo, mask), _mm_and_si128(hi, mask));
+}
+
+void PackedToYRow(const uint8_t* src, uint8_t* dst_y, int width, bool odd) {
+	int x = 0;
+	for (; x + 16 <= width; x += 16) {
+		__m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 2 * x));
+		__m128i hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 2 * x + 16));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst_y + x), PackBytes(lo, hi, odd));
+	}
+	if (x < width) {
+		(odd ? UYVYToYRow_C : YUY2ToYRow_C)(src + 2 * x, dst_y + x, width - x);
+	}
+}
+
+void PackedToUVRow(const uint8_t* src, int src_stride, uint8_t* dst_u, uint8_t* dst_v, int width, bool yuy2) {
+	const uint8_t* next = src + src_stride;
+	int x = 0;
+	for (; x + 16 <= width; x += 16) {
+		__m128i lo = _mm_avg_epu8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 2 * x)),
+			_mm_loadu_si128(reinterpret_cast<const __m128i*>(next + 2 * x)));
+		__m128i hi = _mm_avg_epu8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 2 * x + 16)),
+			_mm_loadu_si128(reinterpret_cast<const __m128i*>(next + 2 * x + 16)));
+		// YUY2 keeps chroma in the odd bytes, UYVY in the even ones.
+		__m128i uv = PackBytes(lo, hi, yuy2);
+		__m128i u = PackBytes(uv, uv, false);
+		__m128i v = PackBytes(uv, uv, true);
+		_mm_storel_epi64(reinterpret_cast<__m128i*>(dst_u + x / 2), u);
+		_mm_storel_epi64(reinterpret_cast<__m128i*>(dst_v + x / 2), v);
+	}
+	if (x < width) {
+		(yuy2 ? YUY2ToUVRow_C : UYVYToUVRow_C)(src + 2 * x, src_stride, dst_u + x / 2, dst_v + x / 2, width - x);
+	}
+}
+
+}
+
+void SplitUVRow_SSE2(const uint8_t* src_uv, uint8_t* dst_u, uint8_t* dst_v, int width) {
+	int x = 0;
+	for (; x + 16 <= width; x += 16) {
+		__m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src_uv + 2 * x));
+		__m128i hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src_uv + 2 * x + 16));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst_u + x), PackBytes(lo, hi, false));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst_v + x), PackBytes(lo, hi, true));
+	}
+	if (x < width) {
+		SplitUVRow_C(src_uv + 2 * x, dst_u + x, dst_v + x, width - x);
+	}
+}
+
+void MergeUVRow_SSE2(const uint8_t* src_u, const uint8_t* src_v, uint8_t* dst_uv, int width) {
+	int x = 0;
+	for (; x + 16 <= width; x += 16) {
+		__m128i u = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src_u + x));
+		__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src_v + x));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst_uv + 2 * x), _mm_unpacklo_epi8(u, v));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst_uv + 2 * x + 16), _mm_unpackhi_epi8(u, v));
+	}
+	if (x < width) {
+		MergeUVRow_C(src_u + x, src_v + x, dst_uv + 2 * x, width - x);
+	}
+}
+
+void YUY2ToYRow_SSE2(const uint8_t* src, uint8_t* dst_y, int width) {
+	PackedToYRow(src, dst_y, width, false);
+}
+
+void UYVYToYRow_SSE2(const uint8_t* src, uint8_t* dst_y, int width) {
+	PackedToYRow(src, dst_y, width, true);
+}
+
+void YUY2ToUVRow_SSE2(const uint8_t* src, int src_stride, uint8_t* dst_u, uint8_t* dst_v, int width) {
+	PackedToUVRow(src, src_stride, dst_u, dst_v, width, true);
+}
+
+void UYVYToUVRow_SSE2(const uint8_t* src, int src_stride, uint8_t* dst_u, uint8_t* dst_v, int width) {
+	PackedToUVRow(src, src_stride, dst_u, dst_v, width, false);
+}
+
+template <VideoType kType>
+void I422ToRGBRow_SSE2(const uint8_t* src_y, const uint8_t* src_u, const uint8_t* src_v,
+	uint8_t* dst, int width, const YuvConstants& yuv_constants) {
+	int x = 0;
+	for (; x + 8 <= width; x += 8) {
+		__m128i b, g, r;
+		YuvToRGB8(src_y + x, src_u + x / 2, src_v + x / 2, yuv_constants, &b, &g, &r);
+		StorePixels8<kType>(dst + 4 * x, b, g, r);
+	}
+	if (x < width) {
+		I422ToRGBRow_C<kType>(src_y + x, src_u + x / 2, src_v + x / 2, dst + 4 * x, width - x, yuv_constants);
+	}
+}
+
+template void I422ToRGBRow_SSE2<kVideoTypeBGRA>(const uint8_t*, const uint8_t*, const uint8_t*, uint8_t*, int, const YuvConstants&);
+template void I422ToRGBRow_SSE2<kVideoTypeARGB>(const uint8_t*, const uint8_t*, const uint8_t*, uint8_t*, int, const YuvConstants&);
+template void I422ToRGBRow_SSE2<kVideoTypeABGR>(const uint8_t*, const uint8_t*, const uint8_t*, uint8_t*, int, const YuvConstants&);
+
+#endif
@@ -0,0 +1,26 @@
+#pragma once
+#include <string>
+#include <vector>
+
+#include "video_frame.h"
+
+// Lists capture devices and their formats. VideoDeviceManager implements it
+// with Media Foundation; FakeVideoDeviceEnumerator stands in for it where no
+// camera, or no Windows, is available. Implementations must accept calls from
+// any one thread at a time.
+class VideoDeviceEnumerator {
+public:
+	virtual ~VideoDeviceEnumerator() {}
+
+	virtual std::vector<VideoDevice> EnumerateDevices() = 0;
+
+	// Opens the device to read its formats, which can take hundreds of
+	// milliseconds. Returns false when the device could not be queried.
+	virtual bool QueryVideoFormats(const VideoDevice& video_device, std::vector<VideoDescription>& formats) = 0;
+
+	// Cheap value that changes when a device's formats may have changed
+	// without its device_id changing, e.g. a driver swap.
+	virtual std::string DeviceFingerprint(const VideoDevice& video_device) {
+		return video_device.device_name;
+	}
+};
@@ -1,203 +1,362 @@
-#include "video_device_manager.h"
-
-#include <iostream>
-#include <string>
-#include <atlbase.h>
-
-#include "video_frame.h"
-#include "string_utils.h"
-
-#pragma comment(lib,"mfplat.lib")
-#pragma comment(lib,"mf.lib")
-#pragma comment(lib,"mfreadwrite.lib")
-#pragma comment(lib,"mfuuid.lib")
-#pragma comment(lib,"d3d9.lib")
-#pragma comment(lib,"shlwapi.lib")
-
-VideoDeviceManager& VideoDeviceManager::Instance() {
-	static VideoDeviceManager instance;
-	return instance;
-}
-
-VideoDeviceManager::VideoDeviceManager() {
-	Init();
-}
-
-VideoDeviceManager::~VideoDeviceManager() {
-	Clear();
-	RELEASE_AND_CLEAR(attributes_);
-}
-
-void VideoDeviceManager::Clear() {
-	for (UINT32 i = 0; i < count_; i++)
-	{
-		RELEASE_AND_CLEAR(imf_active_[i]);
-	}
-	CoTaskMemFree(imf_active_);
-	imf_active_ = NULL;
-	count_ = 0;
-}
-
-bool VideoDeviceManager::Init() {
-	if (init_) {
-		return true;
-	}
-	HRESULT hr = S_OK;
-	hr = CoInitializeEx(NULL, COINIT_APARTMENTTHREADED | COINIT_DISABLE_OLE1DDE);
-
-	if (SUCCEEDED(hr)) {
-		hr = MFStartup(MF_VERSION);
-	}
-	if (FAILED(hr)) {
-		return false;
-	}
-	init_ = true;
-	return true;
-}
-
-IMFActivate* VideoDeviceManager::GetMFActive(const VideoDevice& video_device) {
-	return imf_active_[video_device.index];
-}
-
-IMFAttributes* VideoDeviceManager::GetMFAttrutes() {
-	return attributes_;
-}
-
-std::vector<VideoDevice> VideoDeviceManager::GetAllVideoDevcies() {
-	Clear();
-	std::vector<VideoDevice> result;
-	HRESULT hr = S_OK;
-	if (!attributes_) {
-		hr = MFCreateAttributes(&attributes_, 1);
-		if (FAILED(hr)) {
-			return result;
-		}
-	}
-	hr = attributes_->SetGUID(
-		MF_DEVSOURCE_ATTRIBUTE_SOURCE_TYPE,
-		MF_DEVSOURCE_ATTRIBUTE_SOURCE_TYPE_VIDCAP_GUID
-	);
-	if (FAILED(hr)) {
-		return result;
-	}
-	
-	hr = MFEnumDeviceSources(attributes_, &imf_active_, &count_);
-	if (FAILED(hr)) {
-		return result;
-	}
-	
-	for (UINT32 i = 0; i < count_; ++i) {
-		WCHAR* device_name = NULL;
-		WCHAR* device_id = NULL;
-		VideoDevice video_device;
-		hr = imf_active_[i]->GetAllocatedString(
-			MF_DEVSOURCE_ATTRIBUTE_FRIENDLY_NAME,
-			&device_name,
-			NULL
-		);
-
-		hr = imf_active_[i]->GetAllocatedString(
-			MF_DEVSOURCE_ATTRIBUTE_SOURCE_TYPE_VIDCAP_SYMBOLIC_LINK,
-			&device_id,
-			NULL
-		);
-		
-		video_device.device_id = utils::UnicodeToUtf8(device_id);
-		video_device.device_name = utils::UnicodeToUtf8(device_name);
-		video_device.index = i;
-		result.push_back(std::move(video_device));
-		CoTaskMemFree(device_name);
-		CoTaskMemFree(device_id);
-	}
-	return result;
-}
-
-std::vector<VideoDescription> VideoDeviceManager::GetVideoFormats(const VideoDevice& video_device) {
-	std::vector<VideoDescription> video_descriptions_{};
-	if (!init_) {
-		return video_descriptions_;
-	}
-	IMFMediaSource* source = NULL;
-	HRESULT hr = imf_active_[video_device.index]->ActivateObject(__uuidof(IMFMediaSource), (void**)&source);
-	if (FAILED(hr)) {
-		return video_descriptions_;
-	}
-
-	CComPtr<IMFPresentationDescriptor> pd = nullptr;
-	CComPtr<IMFStreamDescriptor> sd = nullptr;
-	CComPtr<IMFMediaTypeHandler> handle = nullptr;
-
-	BOOL bSelected = false;
-	unsigned long types = 0;
-	hr = source->CreatePresentationDescriptor(&pd);
-	if (FAILED(hr)) {
-		return video_descriptions_;
-	}
-	hr = pd->GetStreamDescriptorByIndex(0, &bSelected, &sd);
-	if (FAILED(hr)) {
-		return video_descriptions_;
-	}
-	hr = sd->GetMediaTypeHandler(&handle);
-	if (FAILED(hr)) {
-		return video_descriptions_;
-	}
-	hr = handle->GetMediaTypeCount(&types);
-	if (FAILED(hr)) {
-		return video_descriptions_;
-	}
-	
-	for (int i = 0; i < types; i++) {
-		CComPtr<IMFMediaType> type = nullptr;
-		hr = handle->GetMediaTypeByIndex(i, &type);
-		if (FAILED(hr)) {
-			continue;
-		}
-		VideoDescription video_desc;
-
-		UINT32 frameRate = 0u;
-		UINT32 denominator = 0u;
-		MFGetAttributeRatio(type, MF_MT_FRAME_RATE, &frameRate, &denominator);
-		
-		if (frameRate > 30 || frameRate < 10 || (frameRate % 5 != 0)) {
-			continue;
-		}
-		video_desc.fps = frameRate;
-
-		UINT32 width, height;
-		MFGetAttributeSize(type, MF_MT_FRAME_SIZE, &width, &height);
-		if (width % 10 != 0 || height % 10 != 0 || width < 320 || height < 240 || 
-			width > 1280 || height > 720) {
-			continue;
-		}
-		video_desc.width = width;
-		video_desc.height = height;
-
-		GUID subtype = { 0 };
-		hr = type->GetGUID(MF_MT_SUBTYPE, &subtype);
-		if (MFVideoFormat_NV12 != subtype && MFVideoFormat_MJPG != subtype) {
-			continue;
-		}
-		if (MFVideoFormat_NV12 == subtype) {
-			video_desc.video_type = kVideoTypeNV12;
-		}
-		else if (MFVideoFormat_MJPG == subtype) {
-			video_desc.video_type = kVideoTypeMJPEG;
-		}
-
-		video_descriptions_.push_back(std::move(video_desc));
-	}
-	
-	return video_descriptions_;
-}
-
-GUID VideoDeviceManager::GetGuidByFormat(VideoType video_type) {
-	switch (video_type) {
-	case kVideoTypeNV12:
-		return MFVideoFormat_NV12;
-	case kVideoTypeMJPEG:
-		return MFVideoFormat_MJPG;
-	default:
-		break;
-	}
-	return MFVideoFormat_Base;
-}
\ No newline at end of file
+#include "video_device_manager.h"
+
+#include <iostream>
+#include <string>
+#include <atlbase.h>
+
+#include "video_frame.h"
+#include "string_utils.h"
+#include "thread_utils.h"
+
+#pragma comment(lib,"mfplat.lib")
+#pragma comment(lib,"mf.lib")
+#pragma comment(lib,"mfreadwrite.lib")
+#pragma comment(lib,"mfuuid.lib")
+#pragma comment(lib,"d3d9.lib")
+#pragma comment(lib,"shlwapi.lib")
+
+using Microsoft::WRL::ComPtr;
+
+namespace {
+
+// Callers on threads of their own (cache refreshes, the device registry
+// monitor, capture operations) need COM too, and the IMFActivate objects
+// made or handed out here are used after the call returns. So the thread
+// enters the MTA on its first call and stays until it exits.
+void EnterComApartment() {
+	static thread_local utils::ScopedComApartment com_apartment;
+	(void)com_apartment;
+}
+
+}
+
+VideoDeviceManager& VideoDeviceManager::Instance() {
+	static VideoDeviceManager instance;
+	return instance;
+}
+
+VideoDeviceManager::VideoDeviceManager() {
+	Init();
+}
+
+VideoDeviceManager::~VideoDeviceManager() {
+	Clear();
+	RELEASE_AND_CLEAR(attributes_);
+}
+
+void VideoDeviceManager::Clear() {
+	activates_.clear();
+	devices_.clear();
+}
+
+bool VideoDeviceManager::Init() {
+	if (init_) {
+		return true;
+	}
+	HRESULT hr = S_OK;
+	hr = CoInitializeEx(NULL, COINIT_APARTMENTTHREADED | COINIT_DISABLE_OLE1DDE);
+
+	if (SUCCEEDED(hr)) {
+		hr = MFStartup(MF_VERSION);
+	}
+	if (FAILED(hr)) {
+		return false;
+	}
+	init_ = true;
+	return true;
+}
+
+ComPtr<IMFActivate> VideoDeviceManager::GetMFActive(const VideoDevice& video_device) {
+	EnterComApartment();
+	std::lock_guard<std::mutex> lock(mutex_);
+	IMFActivate* activate = FindActivateLocked(video_device);
+	if (!activate) {
+		// Devices served from the capability cache have not been enumerated yet.
+		EnumerateLocked();
+		activate = FindActivateLocked(video_device);
+	}
+	return ComPtr<IMFActivate>(activate);
+}
+
+IMFActivate* VideoDeviceManager::FindActivateLocked(const VideoDevice& video_device) {
+	for (size_t i = 0; i < devices_.size(); ++i) {
+		if (devices_[i].device_id == video_device.device_id) {
+			return activates_[i].Get();
+		}
+	}
+	if (video_device.device_id.empty() && video_device.index < activates_.size()) {
+		return activates_[video_device.index].Get();
+	}
+	return nullptr;
+}
+
+IMFAttributes* VideoDeviceManager::GetMFAttrutes() {
+	return attributes_;
+}
+
+std::vector<VideoDevice> VideoDeviceManager::GetAllVideoDevcies() {
+	EnterComApartment();
+	std::lock_guard<std::mutex> lock(mutex_);
+	return EnumerateLocked();
+}
+
+std::vector<VideoDevice> VideoDeviceManager::EnumerateDevices() {
+	return GetAllVideoDevcies();
+}
+
+std::vector<VideoDevice> VideoDeviceManager::EnumerateLocked() {
+	HRESULT hr = S_OK;
+	if (!attributes_) {
+		hr = MFCreateAttributes(&attributes_, 1);
+		if (FAILED(hr)) {
+			return devices_;
+		}
+	}
+	hr = attributes_->SetGUID(
+		MF_DEVSOURCE_ATTRIBUTE_SOURCE_TYPE,
+		MF_DEVSOURCE_ATTRIBUTE_SOURCE_TYPE_VIDCAP_GUID
+	);
+	if (FAILED(hr)) {
+		return devices_;
+	}
+
+	IMFActivate** imf_active = NULL;
+	UINT32 count = 0;
+	hr = MFEnumDeviceSources(attributes_, &imf_active, &count);
+	if (FAILED(hr)) {
+		// A failed enumeration is no reason to drop the devices we know.
+		return devices_;
+	}
+
+	std::vector<VideoDevice> devices;
+	std::vector<ComPtr<IMFActivate>> activates;
+	for (UINT32 i = 0; i < count; ++i) {
+		WCHAR* device_name = NULL;
+		WCHAR* device_id = NULL;
+		VideoDevice video_device;
+		hr = imf_active[i]->GetAllocatedString(
+			MF_DEVSOURCE_ATTRIBUTE_FRIENDLY_NAME,
+			&device_name,
+			NULL
+		);
+
+		hr = imf_active[i]->GetAllocatedString(
+			MF_DEVSOURCE_ATTRIBUTE_SOURCE_TYPE_VIDCAP_SYMBOLIC_LINK,
+			&device_id,
+			NULL
+		);
+
+		video_device.device_id = utils::UnicodeToUtf8(device_id);
+		video_device.device_name = utils::UnicodeToUtf8(device_name);
+		video_device.index = i;
+		CoTaskMemFree(device_name);
+		CoTaskMemFree(device_id);
+		// Devices seen before keep the activate captures were opened from;
+		// only the index is refreshed.
+		IMFActivate* activate = FindActivateLocked(video_device);
+		activates.push_back(activate && !video_device.device_id.empty() ? activate : imf_active[i]);
+		devices.push_back(std::move(video_device));
+		RELEASE_AND_CLEAR(imf_active[i]);
+	}
+	CoTaskMemFree(imf_active);
+	devices_ = devices;
+	activates_.swap(activates);
+	return devices;
+}
+
+std::vector<VideoDescription> VideoDeviceManager::GetVideoFormats(const VideoDevice& video_device) {
+	std::vector<VideoDescription> video_descriptions;
+	QueryVideoFormats(video_device, video_descriptions);
+	return video_descriptions;
+}
+
+bool VideoDeviceManager::QueryVideoFormats(const VideoDevice& video_device,
+	std::vector<VideoDescription>& video_descriptions) {
+	video_descriptions.clear();
+	if (!init_) {
+		return false;
+	}
+	EnterComApartment();
+	// Only the lookup takes the lock; activating the source is the slow part.
+	ComPtr<IMFActivate> activate = GetMFActive(video_device);
+	if (!activate) {
+		return false;
+	}
+	CComPtr<IMFMediaSource> source = nullptr;
+	HRESULT hr = activate->ActivateObject(__uuidof(IMFMediaSource), (void**)&source);
+	if (FAILED(hr)) {
+		return false;
+	}
+
+	CComPtr<IMFPresentationDescriptor> pd = nullptr;
+	CComPtr<IMFStreamDescriptor> sd = nullptr;
+	CComPtr<IMFMediaTypeHandler> handle = nullptr;
+
+	BOOL bSelected = false;
+	unsigned long types = 0;
+	hr = source->CreatePresentationDescriptor(&pd);
+	if (FAILED(hr)) {
+		return false;
+	}
+	hr = pd->GetStreamDescriptorByIndex(0, &bSelected, &sd);
+	if (FAILED(hr)) {
+		return false;
+	}
+	hr = sd->GetMediaTypeHandler(&handle);
+	if (FAILED(hr)) {
+		return false;
+	}
+	hr = handle->GetMediaTypeCount(&types);
+	if (FAILED(hr)) {
+		return false;
+	}
+	
+	// Every mode is reported; picking one is up to NegotiateVideoFormat().
+	for (DWORD i = 0; i < types; i++) {
+		CComPtr<IMFMediaType> type = nullptr;
+		hr = handle->GetMediaTypeByIndex(i, &type);
+		if (FAILED(hr)) {
+			continue;
+		}
+		VideoDescription video_desc;
+		if (GetMediaTypeDescription(type, video_desc)) {
+			video_descriptions.push_back(std::move(video_desc));
+		}
+	}
+	
+	return true;
+}
+
+GUID VideoDeviceManager::GetGuidByFormat(VideoType video_type) {
+	switch (video_type) {
+	case kVideoTypeNV12:
+		return MFVideoFormat_NV12;
+	case kVideoTypeI420:
+		return MFVideoFormat_I420;
+	case kVideoTypeIYUV:
+		return MFVideoFormat_IYUV;
+	case kVideoTypeYV12:
+		return MFVideoFormat_YV12;
+	case kVideoTypeYUY2:
+		return MFVideoFormat_YUY2;
+	case kVideoTypeUYVY:
+		return MFVideoFormat_UYVY;
+	case kVideoTypeRGB24:
+		return MFVideoFormat_RGB24;
+	case kVideoTypeBGRA:
+		return MFVideoFormat_ARGB32;
+	case kVideoTypeRGB565:
+		return MFVideoFormat_RGB565;
+	case kVideoTypeMJPEG:
+		return MFVideoFormat_MJPG;
+	default:
+		break;
+	}
+	return MFVideoFormat_Base;
+}
+
+VideoType VideoDeviceManager::GetFormatByGuid(const GUID& guid) {
+	static const struct {
+		GUID guid;
+		VideoType video_type;
+	} kFormats[] = {
+		{ MFVideoFormat_NV12, kVideoTypeNV12 },
+		{ MFVideoFormat_I420, kVideoTypeI420 },
+		{ MFVideoFormat_IYUV, kVideoTypeIYUV },
+		{ MFVideoFormat_YV12, kVideoTypeYV12 },
+		{ MFVideoFormat_YUY2, kVideoTypeYUY2 },
+		{ MFVideoFormat_UYVY, kVideoTypeUYVY },
+		{ MFVideoFormat_RGB24, kVideoTypeRGB24 },
+		{ MFVideoFormat_ARGB32, kVideoTypeBGRA },
+		{ MFVideoFormat_RGB32, kVideoTypeBGRA },
+		{ MFVideoFormat_RGB565, kVideoTypeRGB565 },
+		{ MFVideoFormat_MJPG, kVideoTypeMJPEG },
+	};
+	for (const auto& format : kFormats) {
+		if (format.guid == guid) {
+			return format.video_type;
+		}
+	}
+	return kVideoTypeUnknown;
+}
+
+bool GetMediaTypeDescription(IMFMediaType* type, VideoDescription& video_description) {
+	GUID subtype = GUID_NULL;
+	UINT32 width = 0;
+	UINT32 height = 0;
+	if (FAILED(type->GetGUID(MF_MT_SUBTYPE, &subtype)) ||
+		FAILED(MFGetAttributeSize(type, MF_MT_FRAME_SIZE, &width, &height))) {
+		return false;
+	}
+	UINT32 numerator = 0;
+	UINT32 denominator = 0;
+	MFGetAttributeRatio(type, MF_MT_FRAME_RATE, &numerator, &denominator);
+	video_description.width = width;
+	video_description.height = height;
+	// 30000/1001 reports as 30.
+	video_description.fps = denominator ? (numerator + denominator / 2) / denominator : 0;
+	video_description.video_type = VideoDeviceManager::Instance().GetFormatByGuid(subtype);
+	return video_description.video_type != kVideoTypeUnknown && width && height;
+}
+
+int64_t SampleTimeMicros(IMFSample* sample, LONGLONG sample_time, int64_t arrival_us,
+	utils::TimestampAligner& aligner) {
+	UINT64 device_time = 0;
+	if (SUCCEEDED(sample->GetUINT64(MFSampleExtension_DeviceTimestamp, &device_time)) && device_time) {
+		// MFGetSystemTime() reads the same clock, so the age of the sample
+		// carries over to TimeMicros().
+		int64_t age_us = (MFGetSystemTime() - static_cast<LONGLONG>(device_time)) / 10;
+		return utils::TimeMicros() - age_us;
+	}
+	return aligner.Translate(sample_time / 10, arrival_us);
+}
+
+bool LockSampleFrameView(IMFSample* sample, const VideoDescription& video_description, VideoFrameView& view) {
+	ComPtr<IMFSample> held_sample(sample);
+	ComPtr<IMFMediaBuffer> buffer;
+	if (FAILED(sample->GetBufferByIndex(0, &buffer))) {
+		return false;
+	}
+	if (video_description.video_type != kVideoTypeMJPEG) {
+		ComPtr<IMF2DBuffer2> buffer_2d2;
+		ComPtr<IMF2DBuffer> buffer_2d;
+		BYTE* scanline0 = nullptr;
+		LONG pitch = 0;
+		if (SUCCEEDED(buffer.As(&buffer_2d2))) {
+			BYTE* start = nullptr;
+			DWORD length = 0;
+			if (SUCCEEDED(buffer_2d2->Lock2DSize(MF2DBuffer_LockFlags_Read, &scanline0, &pitch, &start, &length))) {
+				if (GetContiguousFrameView(video_description, start, length, pitch, view)) {
+					view.release = [held_sample, buffer_2d2]() { buffer_2d2->Unlock2D(); };
+					return true;
+				}
+				buffer_2d2->Unlock2D();
+			}
+		}
+		else if (SUCCEEDED(buffer.As(&buffer_2d))) {
+			DWORD length = 0;
+			buffer->GetMaxLength(&length);
+			if (SUCCEEDED(buffer_2d->Lock2D(&scanline0, &pitch))) {
+				// |scanline0| is the top row; bottom-up images start below it.
+				BYTE* start = pitch < 0 ? scanline0 + static_cast<LONG>(video_description.height - 1) * pitch : scanline0;
+				if (GetContiguousFrameView(video_description, start, length, pitch, view)) {
+					view.release = [held_sample, buffer_2d]() { buffer_2d->Unlock2D(); };
+					return true;
+				}
+				buffer_2d->Unlock2D();
+			}
+		}
+	}
+	// Plain buffers, and compressed samples, are read as they are stored.
+	BYTE* data = nullptr;
+	DWORD length = 0;
+	if (FAILED(buffer->Lock(&data, nullptr, &length))) {
+		return false;
+	}
+	if (!GetContiguousFrameView(video_description, data, length, 0, view)) {
+		buffer->Unlock();
+		return false;
+	}
+	view.release = [held_sample, buffer]() { buffer->Unlock(); };
+	return true;
+}
@@ -1,38 +1,74 @@
-#pragma once
-
-#include <mfapi.h>
-#include <mfidl.h>
-#include <mfreadwrite.h>
-#include <mferror.h>
-
-#include <vector>
-
-#include "video_frame.h"
-
-class VideoDeviceManager {
-public:
-	static VideoDeviceManager& Instance();
-
-	std::vector<VideoDevice> GetAllVideoDevcies();
-	std::vector<VideoDescription> GetVideoFormats(const VideoDevice& video_device);
-	bool Init();
-
-	IMFActivate* GetMFActive(const VideoDevice& video_device);
-	IMFAttributes* GetMFAttrutes();
-	GUID GetGuidByFormat(VideoType video_type);
-
-private:
-	VideoDeviceManager();
-	~VideoDeviceManager();
-
-	VideoDeviceManager(const VideoDeviceManager&) = delete;
-	VideoDeviceManager operator =(const VideoDeviceManager&) = delete;
-
-	void Clear();
-
-private:
-	IMFAttributes* attributes_{};
-	IMFActivate** imf_active_{};
-	UINT32 count_{};
-	bool init_;
-};
\ No newline at end of file
+#pragma once
+
+#include <mfapi.h>
+#include <mfidl.h>
+#include <mfreadwrite.h>
+#include <mferror.h>
+
+#include <wrl/client.h>
+
+#include <mutex>
+#include <vector>
+
+#include "time_utils.h"
+#include "video_device_enumerator.h"
+#include "video_frame.h"
+#include "video_frame_view.h"
+
+// Media Foundation device enumeration. Safe to call from any thread, e.g. a
+// DeviceCapabilityCache refresh.
+class VideoDeviceManager : public VideoDeviceEnumerator {
+public:
+	static VideoDeviceManager& Instance();
+
+	std::vector<VideoDevice> GetAllVideoDevcies();
+	std::vector<VideoDescription> GetVideoFormats(const VideoDevice& video_device);
+	bool Init();
+
+	std::vector<VideoDevice> EnumerateDevices() override;
+	bool QueryVideoFormats(const VideoDevice& video_device, std::vector<VideoDescription>& formats) override;
+
+	// Looks the device up by device_id, so devices from an earlier enumeration
+	// or from the capability cache still resolve. Null when it is gone.
+	Microsoft::WRL::ComPtr<IMFActivate> GetMFActive(const VideoDevice& video_device);
+	IMFAttributes* GetMFAttrutes();
+	GUID GetGuidByFormat(VideoType video_type);
+	// kVideoTypeUnknown for subtypes the pipeline does not handle.
+	VideoType GetFormatByGuid(const GUID& guid);
+
+private:
+	VideoDeviceManager();
+	~VideoDeviceManager();
+
+	VideoDeviceManager(const VideoDeviceManager&) = delete;
+	VideoDeviceManager operator =(const VideoDeviceManager&) = delete;
+
+	void Clear();
+	std::vector<VideoDevice> EnumerateLocked();
+	IMFActivate* FindActivateLocked(const VideoDevice& video_device);
+
+private:
+	std::mutex mutex_{};
+	std::vector<VideoDevice> devices_{};
+	IMFAttributes* attributes_{};
+	// Parallel to |devices_|. A device that stays across enumerations keeps
+	// its activate, so captures opened from it are not disturbed.
+	std::vector<Microsoft::WRL::ComPtr<IMFActivate>> activates_{};
+	bool init_{};
+};
+
+// Size, rate and type of a native media type. False for subtypes without a
+// VideoType.
+bool GetMediaTypeDescription(IMFMediaType* type, VideoDescription& video_description);
+
+// Capture time of |sample| on the utils::TimeMicros() clock. Uses the QPC based
+// MFSampleExtension_DeviceTimestamp when the driver sets one, otherwise maps
+// |sample_time| (100 ns units, arbitrary epoch) through |aligner|.
+int64_t SampleTimeMicros(IMFSample* sample, LONGLONG sample_time, int64_t arrival_us,
+	utils::TimestampAligner& aligner);
+
+// Locks the first buffer of |sample| for reading and describes it as |view|,
+// through IMF2DBuffer where the buffer has one so that Media Foundation does
+// not make a contiguous copy. The view holds the sample and its release hook
+// unlocks the buffer.
+bool LockSampleFrameView(IMFSample* sample, const VideoDescription& video_description, VideoFrameView& view);
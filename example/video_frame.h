@@ -1,52 +1,79 @@
-#pragma once
-#include <string>
-
-#define RELEASE_AND_CLEAR(p) \
-    if (p) {                 \
-        (p)->Release();      \
-        (p) = NULL;          \
-    }
-
-enum VideoType {
-	kVideoTypeUnknown,
-	kVideoTypeI420,
-	kVideoTypeIYUV,
-	kVideoTypeRGB24,
-	kVideoTypeABGR,
-	kVideoTypeARGB,
-	kVideoTypeARGB4444,
-	kVideoTypeRGB565,
-	kVideoTypeARGB1555,
-	kVideoTypeYUY2,
-	kVideoTypeYV12,
-	kVideoTypeUYVY,
-	kVideoTypeMJPEG,
-	kVideoTypeNV21,
-	kVideoTypeNV12,
-	kVideoTypeBGRA,
-};
-
-struct VideoDevice {
-	uint32_t index{};
-	std::string device_name{};
-	std::string device_id{};
-};
-
-struct VideoDescription {
-	uint32_t width{};
-	uint32_t height{};
-	uint32_t fps{};
-	VideoType video_type{};
-};
-
-struct VideoFrame {
-	uint8_t* y_data;
-	uint32_t y_stride;
-	uint8_t* u_data;
-	uint32_t u_stride;
-	uint8_t* v_data;
-	uint32_t v_stride;
-	uint32_t width;
-	uint32_t height;
-	VideoType video_type{};
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "ref_counted.h"
+
+#define RELEASE_AND_CLEAR(p) \
+    if (p) {                 \
+        (p)->Release();      \
+        (p) = NULL;          \
+    }
+
+enum VideoType {
+	kVideoTypeUnknown,
+	kVideoTypeI420,
+	kVideoTypeIYUV,
+	kVideoTypeRGB24,
+	kVideoTypeABGR,
+	kVideoTypeARGB,
+	kVideoTypeARGB4444,
+	kVideoTypeRGB565,
+	kVideoTypeARGB1555,
+	kVideoTypeYUY2,
+	kVideoTypeYV12,
+	kVideoTypeUYVY,
+	kVideoTypeMJPEG,
+	kVideoTypeNV21,
+	kVideoTypeNV12,
+	kVideoTypeBGRA,
+};
+
+struct FrameStatistics;
+
+struct VideoDevice {
+	uint32_t index{};
+	std::string device_name{};
+	std::string device_id{};
+};
+
+struct VideoDescription {
+	uint32_t width{};
+	uint32_t height{};
+	uint32_t fps{};
+	VideoType video_type{};
+};
+
+struct VideoFrame {
+	uint8_t* y_data{};
+	uint32_t y_stride{};
+	uint8_t* u_data{};
+	uint32_t u_stride{};
+	uint8_t* v_data{};
+	uint32_t v_stride{};
+	uint32_t width{};
+	uint32_t height{};
+	VideoType video_type{};
+	// Bytes of JPEG data at |y_data| for MJPEG frames passed through
+	// undecoded, 0 for every other type.
+	uint32_t compressed_size{};
+	// Capture time in microseconds on the utils::TimeMicros() clock. Backends
+	// with device timestamps map them onto that clock.
+	int64_t timestamp_us{};
+	// Time the frame reached the host, before any copy or decode.
+	int64_t arrival_us{};
+	// Counts frames as they arrive from the device; a gap at the consumer
+	// means frames were dropped on the way.
+	uint64_t sequence{};
+	// Set by static frame detection when the picture barely differs from the
+	// last frame that was not, see VideoCapture::SetStaticFrameDetection().
+	bool unchanged{};
+	// Luma and chroma statistics from the capture path, see
+	// VideoCapture::SetFrameStatistics(); null when off or for formats
+	// without a separate luma plane.
+	std::shared_ptr<const FrameStatistics> statistics{};
+	// Owner of the plane memory. Copies of the frame share it, so a consumer
+	// can keep a frame past the callback without copying the pixels.
+	RefPtr<RefCountInterface> buffer{};
 };
\ No newline at end of file
@@ -0,0 +1,286 @@
+#include "video_frame_buffer.h"
+
+#include <cstdlib>
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+struct VideoFrameBufferPoolState {
+	std::mutex mutex;
+	std::vector<VideoFrameBuffer*> free_buffers;
+	size_t max_buffers{};
+	size_t allocated{};
+	uint32_t generation{};
+	bool closed{};
+};
+
+namespace {
+
+uint32_t AlignUp(uint32_t value, uint32_t alignment) {
+	return (value + alignment - 1) / alignment * alignment;
+}
+
+void SetPlanes(VideoFrameLayout& layout, int plane_count, const uint32_t* strides, const uint32_t* heights, uint32_t alignment) {
+	size_t offset = 0;
+	layout.plane_count = plane_count;
+	for (int i = 0; i < plane_count; ++i) {
+		layout.planes[i].stride = AlignUp(strides[i], alignment);
+		layout.planes[i].height = heights[i];
+		layout.planes[i].offset = offset;
+		offset += static_cast<size_t>(layout.planes[i].stride) * heights[i];
+	}
+	layout.size = offset;
+}
+
+}
+
+bool GetVideoFrameLayout(const VideoDescription& description, uint32_t alignment, VideoFrameLayout& layout) {
+	layout = VideoFrameLayout();
+	if (description.width == 0 || description.height == 0 || alignment == 0) {
+		return false;
+	}
+	uint32_t width = description.width;
+	uint32_t height = description.height;
+	uint32_t chroma_width = (width + 1) / 2;
+	uint32_t chroma_height = (height + 1) / 2;
+	switch (description.video_type) {
+	case kVideoTypeI420:
+	case kVideoTypeIYUV:
+	case kVideoTypeYV12: {
+		uint32_t strides[] = { width, chroma_width, chroma_width };
+		uint32_t heights[] = { height, chroma_height, chroma_height };
+		SetPlanes(layout, 3, strides, heights, alignment);
+		return true;
+	}
+	case kVideoTypeNV12:
+	case kVideoTypeNV21: {
+		uint32_t strides[] = { width, chroma_width * 2 };
+		uint32_t heights[] = { height, chroma_height };
+		SetPlanes(layout, 2, strides, heights, alignment);
+		return true;
+	}
+	case kVideoTypeYUY2:
+	case kVideoTypeUYVY:
+	case kVideoTypeRGB565:
+	case kVideoTypeARGB1555:
+	case kVideoTypeARGB4444: {
+		uint32_t strides[] = { chroma_width * 4 };
+		if (description.video_type != kVideoTypeYUY2 && description.video_type != kVideoTypeUYVY) {
+			strides[0] = width * 2;
+		}
+		SetPlanes(layout, 1, strides, &height, alignment);
+		return true;
+	}
+	case kVideoTypeRGB24: {
+		uint32_t stride = width * 3;
+		SetPlanes(layout, 1, &stride, &height, alignment);
+		return true;
+	}
+	case kVideoTypeARGB:
+	case kVideoTypeABGR:
+	case kVideoTypeBGRA: {
+		uint32_t stride = width * 4;
+		SetPlanes(layout, 1, &stride, &height, alignment);
+		return true;
+	}
+	case kVideoTypeMJPEG: {
+		// Worst case for a compressed frame, same budget as 4:2:2.
+		uint32_t stride = width * 2;
+		SetPlanes(layout, 1, &stride, &height, alignment);
+		return true;
+	}
+	default:
+		break;
+	}
+	return false;
+}
+
+void SetVideoFramePlanes(const VideoDescription& description, const VideoFrameLayout& layout, uint8_t* data,
+	VideoFrame& video_frame) {
+	video_frame.width = description.width;
+	video_frame.height = description.height;
+	video_frame.video_type = description.video_type;
+	video_frame.y_data = data + layout.planes[0].offset;
+	video_frame.y_stride = layout.planes[0].stride;
+	video_frame.u_data = nullptr;
+	video_frame.u_stride = 0;
+	video_frame.v_data = nullptr;
+	video_frame.v_stride = 0;
+	if (layout.plane_count == 3) {
+		// YV12 stores V before U, the frame always exposes U and V by name.
+		int u_plane = description.video_type == kVideoTypeYV12 ? 2 : 1;
+		int v_plane = description.video_type == kVideoTypeYV12 ? 1 : 2;
+		video_frame.u_data = data + layout.planes[u_plane].offset;
+		video_frame.u_stride = layout.planes[u_plane].stride;
+		video_frame.v_data = data + layout.planes[v_plane].offset;
+		video_frame.v_stride = layout.planes[v_plane].stride;
+	}
+	else if (layout.plane_count == 2) {
+		// Semi-planar: U and V point into the interleaved chroma plane.
+		bool nv21 = description.video_type == kVideoTypeNV21;
+		video_frame.u_data = data + layout.planes[1].offset + (nv21 ? 1 : 0);
+		video_frame.v_data = data + layout.planes[1].offset + (nv21 ? 0 : 1);
+		video_frame.u_stride = layout.planes[1].stride;
+		video_frame.v_stride = layout.planes[1].stride;
+	}
+}
+
+void* AlignedMalloc(size_t size, size_t alignment) {
+#ifdef _WIN32
+	return _aligned_malloc(size, alignment);
+#else
+	void* ptr = nullptr;
+	if (posix_memalign(&ptr, alignment, size) != 0) {
+		return nullptr;
+	}
+	return ptr;
+#endif
+}
+
+void AlignedFree(void* ptr) {
+#ifdef _WIN32
+	_aligned_free(ptr);
+#else
+	free(ptr);
+#endif
+}
+
+VideoFrameBuffer::VideoFrameBuffer(const std::shared_ptr<VideoFrameBufferPoolState>& pool,
+	const VideoDescription& description, const VideoFrameLayout& layout, uint32_t generation)
+	: pool_(pool), description_(description), layout_(layout), generation_(generation) {
+	data_ = static_cast<uint8_t*>(AlignedMalloc(layout_.size, kFrameBufferAlignment));
+}
+
+VideoFrameBuffer::~VideoFrameBuffer() {
+	AlignedFree(data_);
+}
+
+void VideoFrameBuffer::WrapVideoFrame(VideoFrame& video_frame) {
+	SetVideoFramePlanes(description_, layout_, data_, video_frame);
+	video_frame.buffer = RefPtr<RefCountInterface>(this);
+}
+
+void VideoFrameBuffer::OnZeroReferences() const {
+	VideoFrameBuffer* self = const_cast<VideoFrameBuffer*>(this);
+	std::shared_ptr<VideoFrameBufferPoolState> pool = pool_;
+	{
+		std::lock_guard<std::mutex> lock(pool->mutex);
+		if (!pool->closed && generation_ == pool->generation && pool->allocated <= pool->max_buffers) {
+			pool->free_buffers.push_back(self);
+			return;
+		}
+		--pool->allocated;
+	}
+	delete self;
+}
+
+VideoFrameBufferPool::VideoFrameBufferPool(size_t max_buffers) : state_(std::make_shared<VideoFrameBufferPoolState>()) {
+	state_->max_buffers = max_buffers;
+	state_->free_buffers.reserve(max_buffers);
+}
+
+VideoFrameBufferPool::~VideoFrameBufferPool() {
+	std::vector<VideoFrameBuffer*> buffers;
+	{
+		std::lock_guard<std::mutex> lock(state_->mutex);
+		state_->closed = true;
+		buffers.swap(state_->free_buffers);
+		state_->allocated -= buffers.size();
+	}
+	for (size_t i = 0; i < buffers.size(); ++i) {
+		delete buffers[i];
+	}
+}
+
+bool VideoFrameBufferPool::Configure(const VideoDescription& description) {
+	VideoFrameLayout layout;
+	if (!GetVideoFrameLayout(description, kFrameBufferAlignment, layout)) {
+		return false;
+	}
+	if (description.width == description_.width && description.height == description_.height &&
+		description.video_type == description_.video_type) {
+		description_ = description;
+		return true;
+	}
+	std::vector<VideoFrameBuffer*> buffers;
+	{
+		std::lock_guard<std::mutex> lock(state_->mutex);
+		++state_->generation;
+		buffers.swap(state_->free_buffers);
+		state_->free_buffers.reserve(state_->max_buffers);
+		state_->allocated -= buffers.size();
+	}
+	for (size_t i = 0; i < buffers.size(); ++i) {
+		delete buffers[i];
+	}
+	description_ = description;
+	layout_ = layout;
+	return true;
+}
+
+const VideoDescription& VideoFrameBufferPool::Description() const {
+	return description_;
+}
+
+RefPtr<VideoFrameBuffer> VideoFrameBufferPool::CreateBuffer() {
+	uint32_t generation = 0;
+	{
+		std::lock_guard<std::mutex> lock(state_->mutex);
+		if (!state_->free_buffers.empty()) {
+			VideoFrameBuffer* buffer = state_->free_buffers.back();
+			state_->free_buffers.pop_back();
+			return RefPtr<VideoFrameBuffer>(buffer);
+		}
+		if (layout_.size == 0 || state_->allocated >= state_->max_buffers) {
+			return nullptr;
+		}
+		++state_->allocated;
+		generation = state_->generation;
+	}
+	VideoFrameBuffer* buffer = new VideoFrameBuffer(state_, description_, layout_, generation);
+	if (!buffer->data_) {
+		{
+			std::lock_guard<std::mutex> lock(state_->mutex);
+			--state_->allocated;
+		}
+		delete buffer;
+		return nullptr;
+	}
+	return RefPtr<VideoFrameBuffer>(buffer);
+}
+
+bool VideoFrameBufferPool::CreateFrame(VideoFrame& video_frame) {
+	RefPtr<VideoFrameBuffer> buffer = CreateBuffer();
+	if (!buffer) {
+		return false;
+	}
+	buffer->WrapVideoFrame(video_frame);
+	return true;
+}
+
+void VideoFrameBufferPool::SetMaxBuffers(size_t max_buffers) {
+	std::vector<VideoFrameBuffer*> buffers;
+	{
+		std::lock_guard<std::mutex> lock(state_->mutex);
+		state_->max_buffers = max_buffers;
+		state_->free_buffers.reserve(max_buffers);
+		while (state_->allocated > max_buffers && !state_->free_buffers.empty()) {
+			buffers.push_back(state_->free_buffers.back());
+			state_->free_buffers.pop_back();
+			--state_->allocated;
+		}
+	}
+	for (size_t i = 0; i < buffers.size(); ++i) {
+		delete buffers[i];
+	}
+}
+
+size_t VideoFrameBufferPool::AllocatedCount() const {
+	std::lock_guard<std::mutex> lock(state_->mutex);
+	return state_->allocated;
+}
+
+size_t VideoFrameBufferPool::FreeCount() const {
+	std::lock_guard<std::mutex> lock(state_->mutex);
+	return state_->free_buffers.size();
+}
@@ -0,0 +1,101 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "ref_counted.h"
+#include "video_frame.h"
+
+static const uint32_t kFrameBufferAlignment = 64;
+
+struct VideoPlaneLayout {
+	uint32_t stride{};
+	uint32_t height{};
+	size_t offset{};
+};
+
+struct VideoFrameLayout {
+	int plane_count{};
+	VideoPlaneLayout planes[3]{};
+	size_t size{};
+};
+
+// Plane layout of a frame in |description| with every stride and plane offset
+// rounded up to |alignment|. Semi-planar formats use two planes, packed and
+// compressed formats use one.
+bool GetVideoFrameLayout(const VideoDescription& description, uint32_t alignment, VideoFrameLayout& layout);
+
+// Points the planes of |video_frame| into |data| laid out as |layout|. The
+// frame's buffer reference is left to the caller.
+void SetVideoFramePlanes(const VideoDescription& description, const VideoFrameLayout& layout, uint8_t* data,
+	VideoFrame& video_frame);
+
+void* AlignedMalloc(size_t size, size_t alignment);
+void AlignedFree(void* ptr);
+
+struct VideoFrameBufferPoolState;
+
+class VideoFrameBuffer : public RefCountedBase {
+public:
+	const VideoDescription& Description() const { return description_; }
+	const VideoFrameLayout& Layout() const { return layout_; }
+	int PlaneCount() const { return layout_.plane_count; }
+	uint8_t* Data(int plane) const { return data_ + layout_.planes[plane].offset; }
+	uint32_t Stride(int plane) const { return layout_.planes[plane].stride; }
+	size_t Size() const { return layout_.size; }
+
+	// Points the planes of |video_frame| at this buffer and makes the frame
+	// hold a reference to it.
+	void WrapVideoFrame(VideoFrame& video_frame);
+
+protected:
+	void OnZeroReferences() const override;
+
+private:
+	friend class VideoFrameBufferPool;
+
+	VideoFrameBuffer(const std::shared_ptr<VideoFrameBufferPoolState>& pool,
+		const VideoDescription& description, const VideoFrameLayout& layout, uint32_t generation);
+	~VideoFrameBuffer();
+
+	std::shared_ptr<VideoFrameBufferPoolState> pool_{};
+	VideoDescription description_{};
+	VideoFrameLayout layout_{};
+	uint32_t generation_{};
+	uint8_t* data_{};
+};
+
+// Hands out ref-counted, 64-byte aligned frame buffers and takes them back when
+// the last reference is dropped. At most |max_buffers| are ever allocated, so
+// after warm-up CreateBuffer() does not touch the heap; it returns null when
+// every buffer is in flight.
+class VideoFrameBufferPool {
+public:
+	explicit VideoFrameBufferPool(size_t max_buffers = 8);
+	~VideoFrameBufferPool();
+
+	// Changing the description frees the idle buffers; buffers still in flight
+	// are freed instead of recycled when they come back.
+	bool Configure(const VideoDescription& description);
+	const VideoDescription& Description() const;
+
+	RefPtr<VideoFrameBuffer> CreateBuffer();
+	bool CreateFrame(VideoFrame& video_frame);
+
+	// Raises or lowers the cap, e.g. to cover frames parked in a queue. Buffers
+	// over a lowered cap are freed as they come back.
+	void SetMaxBuffers(size_t max_buffers);
+
+	size_t AllocatedCount() const;
+	size_t FreeCount() const;
+
+private:
+	VideoFrameBufferPool(const VideoFrameBufferPool&) = delete;
+	VideoFrameBufferPool operator =(const VideoFrameBufferPool&) = delete;
+
+	std::shared_ptr<VideoFrameBufferPoolState> state_{};
+	VideoDescription description_{};
+	VideoFrameLayout layout_{};
+};
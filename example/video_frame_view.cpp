@@ -0,0 +1,250 @@
+#include "video_frame_view.h"
+
+#include <cstring>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "video_frame_buffer.h"
+
+namespace {
+
+// Idle holders are kept up to this count so that wrapping a frame does not
+// allocate once capture is running.
+const size_t kMaxFreeViewBuffers = 16;
+
+class ViewBuffer;
+
+struct ViewBufferPool {
+	std::mutex mutex;
+	std::vector<ViewBuffer*> free_buffers;
+};
+
+// Never destroyed: frames may still drop their holders during static
+// destruction.
+ViewBufferPool& GetViewBufferPool() {
+	static ViewBufferPool* pool = new ViewBufferPool();
+	return *pool;
+}
+
+// Frame buffer that gives wrapped memory back to its owner. Once the last frame
+// is gone the holder goes back to the pool instead of being deleted.
+class ViewBuffer : public RefCountedBase {
+public:
+	static RefPtr<RefCountInterface> Create(RefPtr<RefCountInterface> owner, std::function<void()> release) {
+		ViewBuffer* buffer = nullptr;
+		ViewBufferPool& pool = GetViewBufferPool();
+		{
+			std::lock_guard<std::mutex> lock(pool.mutex);
+			if (!pool.free_buffers.empty()) {
+				buffer = pool.free_buffers.back();
+				pool.free_buffers.pop_back();
+			}
+		}
+		if (!buffer) {
+			buffer = new ViewBuffer();
+		}
+		buffer->owner_ = std::move(owner);
+		buffer->release_ = std::move(release);
+		return RefPtr<RefCountInterface>(buffer);
+	}
+
+protected:
+	void OnZeroReferences() const override {
+		ViewBuffer* self = const_cast<ViewBuffer*>(this);
+		self->release_();
+		self->release_ = nullptr;
+		self->owner_ = nullptr;
+		ViewBufferPool& pool = GetViewBufferPool();
+		{
+			std::lock_guard<std::mutex> lock(pool.mutex);
+			if (pool.free_buffers.size() < kMaxFreeViewBuffers) {
+				pool.free_buffers.push_back(self);
+				return;
+			}
+		}
+		delete self;
+	}
+
+private:
+	ViewBuffer() {}
+
+	RefPtr<RefCountInterface> owner_{};
+	std::function<void()> release_{};
+};
+
+// Planes of |video_frame| in the order of VideoFrameView.
+int GetFramePlanes(const VideoFrame& video_frame, uint8_t* data[3], uint32_t stride[3]) {
+	data[0] = video_frame.y_data;
+	stride[0] = video_frame.y_stride;
+	switch (GetPixelLayout(video_frame.video_type)) {
+	case kPixelLayoutPlanar:
+		data[1] = video_frame.u_data;
+		stride[1] = video_frame.u_stride;
+		data[2] = video_frame.v_data;
+		stride[2] = video_frame.v_stride;
+		return 3;
+	case kPixelLayoutSemiPlanar:
+		data[1] = video_frame.video_type == kVideoTypeNV21 ? video_frame.v_data : video_frame.u_data;
+		stride[1] = video_frame.u_stride;
+		return 2;
+	default:
+		break;
+	}
+	return 1;
+}
+
+}
+
+VideoPixelLayout GetPixelLayout(VideoType video_type) {
+	switch (video_type) {
+	case kVideoTypeI420:
+	case kVideoTypeIYUV:
+	case kVideoTypeYV12:
+		return kPixelLayoutPlanar;
+	case kVideoTypeNV12:
+	case kVideoTypeNV21:
+		return kPixelLayoutSemiPlanar;
+	case kVideoTypeYUY2:
+	case kVideoTypeUYVY:
+	case kVideoTypeRGB24:
+	case kVideoTypeABGR:
+	case kVideoTypeARGB:
+	case kVideoTypeARGB4444:
+	case kVideoTypeRGB565:
+	case kVideoTypeARGB1555:
+	case kVideoTypeBGRA:
+		return kPixelLayoutPacked;
+	case kVideoTypeMJPEG:
+		return kPixelLayoutCompressed;
+	default:
+		break;
+	}
+	return kPixelLayoutUnknown;
+}
+
+bool GetContiguousFrameView(const VideoDescription& description, const uint8_t* data, size_t size, int32_t stride,
+	VideoFrameView& view) {
+	view = VideoFrameView();
+	view.video_type = description.video_type;
+	view.layout = GetPixelLayout(description.video_type);
+	view.width = description.width;
+	view.height = description.height;
+	if (!data || view.layout == kPixelLayoutUnknown) {
+		return false;
+	}
+	if (view.layout == kPixelLayoutCompressed) {
+		if (size == 0 || size > UINT32_MAX) {
+			return false;
+		}
+		view.plane_count = 1;
+		view.planes[0].data = data;
+		view.planes[0].stride = static_cast<int32_t>(size);
+		view.planes[0].row_bytes = static_cast<uint32_t>(size);
+		view.planes[0].rows = 1;
+		return true;
+	}
+	VideoFrameLayout packed;
+	if (!GetVideoFrameLayout(description, 1, packed)) {
+		return false;
+	}
+	bool bottom_up = stride < 0;
+	uint32_t luma_stride = stride ? static_cast<uint32_t>(bottom_up ? -static_cast<int64_t>(stride) : stride) :
+		packed.planes[0].stride;
+	if (luma_stride < packed.planes[0].stride || (bottom_up && view.layout != kPixelLayoutPacked)) {
+		return false;
+	}
+	size_t offset = 0;
+	view.plane_count = packed.plane_count;
+	for (int plane = 0; plane < packed.plane_count; ++plane) {
+		// Chroma planes follow the luma plane with a stride scaled like their width.
+		uint32_t plane_stride = static_cast<uint32_t>(
+			static_cast<uint64_t>(luma_stride) * packed.planes[plane].stride / packed.planes[0].stride);
+		uint32_t rows = packed.planes[plane].height;
+		size_t last_row = offset + static_cast<size_t>(plane_stride) * (rows - 1);
+		if (last_row + packed.planes[plane].stride > size) {
+			return false;
+		}
+		// YV12 stores V before U.
+		int index = plane;
+		if (description.video_type == kVideoTypeYV12 && plane > 0) {
+			index = 3 - plane;
+		}
+		VideoPlaneView& plane_view = view.planes[index];
+		plane_view.data = data + (bottom_up ? last_row : offset);
+		plane_view.stride = bottom_up ? -static_cast<int32_t>(plane_stride) : static_cast<int32_t>(plane_stride);
+		plane_view.row_bytes = packed.planes[plane].stride;
+		plane_view.rows = rows;
+		offset += static_cast<size_t>(plane_stride) * rows;
+	}
+	return true;
+}
+
+bool WrapVideoFrameView(VideoFrameView& view, VideoFrame& video_frame) {
+	if (view.layout == kPixelLayoutUnknown || view.plane_count < 1) {
+		return false;
+	}
+	for (int plane = 0; plane < view.plane_count; ++plane) {
+		if (!view.planes[plane].data || view.planes[plane].stride < 0) {
+			return false;
+		}
+	}
+	video_frame.width = view.width;
+	video_frame.height = view.height;
+	video_frame.video_type = view.video_type;
+	video_frame.y_data = const_cast<uint8_t*>(view.planes[0].data);
+	video_frame.y_stride = static_cast<uint32_t>(view.planes[0].stride);
+	video_frame.compressed_size = view.layout == kPixelLayoutCompressed ? view.planes[0].row_bytes : 0;
+	video_frame.u_data = nullptr;
+	video_frame.u_stride = 0;
+	video_frame.v_data = nullptr;
+	video_frame.v_stride = 0;
+	if (view.layout == kPixelLayoutPlanar && view.plane_count == 3) {
+		video_frame.u_data = const_cast<uint8_t*>(view.planes[1].data);
+		video_frame.u_stride = static_cast<uint32_t>(view.planes[1].stride);
+		video_frame.v_data = const_cast<uint8_t*>(view.planes[2].data);
+		video_frame.v_stride = static_cast<uint32_t>(view.planes[2].stride);
+	}
+	else if (view.layout == kPixelLayoutSemiPlanar && view.plane_count == 2) {
+		// U and V point into the interleaved plane, as in pooled frames.
+		uint8_t* chroma = const_cast<uint8_t*>(view.planes[1].data);
+		bool nv21 = view.video_type == kVideoTypeNV21;
+		video_frame.u_data = chroma + (nv21 ? 1 : 0);
+		video_frame.v_data = chroma + (nv21 ? 0 : 1);
+		video_frame.u_stride = static_cast<uint32_t>(view.planes[1].stride);
+		video_frame.v_stride = video_frame.u_stride;
+	}
+	if (view.release) {
+		video_frame.buffer = ViewBuffer::Create(std::move(view.owner), std::move(view.release));
+		view.release = nullptr;
+	}
+	else {
+		video_frame.buffer = std::move(view.owner);
+	}
+	view.owner = nullptr;
+	return true;
+}
+
+bool CopyVideoFrameView(const VideoFrameView& view, VideoFrame& video_frame) {
+	if (view.video_type != video_frame.video_type || view.width != video_frame.width ||
+		view.height != video_frame.height || view.layout == kPixelLayoutCompressed) {
+		return false;
+	}
+	uint8_t* data[3];
+	uint32_t stride[3];
+	int plane_count = GetFramePlanes(video_frame, data, stride);
+	if (plane_count != view.plane_count) {
+		return false;
+	}
+	for (int plane = 0; plane < plane_count; ++plane) {
+		const VideoPlaneView& source = view.planes[plane];
+		if (!source.data || !data[plane]) {
+			return false;
+		}
+		for (uint32_t row = 0; row < source.rows; ++row) {
+			memcpy(data[plane] + static_cast<size_t>(row) * stride[plane],
+				source.data + static_cast<ptrdiff_t>(row) * source.stride, source.row_bytes);
+		}
+	}
+	return true;
+}
@@ -0,0 +1,71 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
+#include "ref_counted.h"
+#include "video_frame.h"
+
+// How the samples of a frame are arranged in memory.
+enum VideoPixelLayout {
+	kPixelLayoutUnknown,
+	// Y, U and V planes: I420, IYUV and YV12.
+	kPixelLayoutPlanar,
+	// A Y plane and one plane of interleaved chroma: NV12 (UV) and NV21 (VU).
+	kPixelLayoutSemiPlanar,
+	// One plane of interleaved pixels: YUY2, UYVY and the RGB formats.
+	kPixelLayoutPacked,
+	// One plane of bytes without rows: MJPEG.
+	kPixelLayoutCompressed,
+};
+
+VideoPixelLayout GetPixelLayout(VideoType video_type);
+
+struct VideoPlaneView {
+	const uint8_t* data{};
+	// Bytes from the start of one row to the next, negative for bottom-up
+	// images where |data| is the top row.
+	int32_t stride{};
+	// Bytes of samples per row and the number of rows. A compressed frame is
+	// one row of |row_bytes| bytes.
+	uint32_t row_bytes{};
+	uint32_t rows{};
+};
+
+// A frame in memory owned by someone else: a locked Media Foundation buffer,
+// a file mapping or a pool buffer. Planes are in Y, U, V order whatever their
+// order in memory; semi-planar frames have Y and the interleaved chroma.
+struct VideoFrameView {
+	VideoType video_type{};
+	VideoPixelLayout layout{};
+	uint32_t width{};
+	uint32_t height{};
+	int plane_count{};
+	VideoPlaneView planes[3]{};
+	// Keeps the memory alive while frames point into it.
+	RefPtr<RefCountInterface> owner{};
+	// Runs once when the last frame made from the view is gone, e.g. to
+	// unlock the buffer.
+	std::function<void()> release{};
+};
+
+// Describes a frame of |description| whose planes are stored back to back from
+// |data| on, the way Media Foundation and raw files lay them out. |stride| is
+// the luma or packed row pitch, scaled down for chroma; 0 means the minimum.
+// A negative |stride| marks a bottom-up packed image whose top row is stored
+// last. Fails when the planes do not fit into |size| bytes.
+bool GetContiguousFrameView(const VideoDescription& description, const uint8_t* data, size_t size, int32_t stride,
+	VideoFrameView& view);
+
+// Points |video_frame| at the planes of |view| without copying; the frame
+// takes over |view.owner| and |view.release|, and its planes are read-only.
+// The holder for |view.release| comes from a pool, so wrapping does not
+// allocate once capture is running.
+// A compressed view becomes a frame of VideoFrame::compressed_size bytes.
+// Fails, leaving |view| as it was, for negative strides, which VideoFrame
+// cannot describe.
+bool WrapVideoFrameView(VideoFrameView& view, VideoFrame& video_frame);
+
+// Copies the planes of |view| into |video_frame|, which must have the same type
+// and size; bottom-up images are flipped on the way.
+bool CopyVideoFrameView(const VideoFrameView& view, VideoFrame& video_frame);
@@ -0,0 +1,65 @@
+// Zero-copy frames wrapped from a VideoFrameView and their release hooks.
+#include <cstdint>
+#include <vector>
+
+#include "test_check.h"
+#include "video_frame_view.h"
+
+namespace {
+
+bool WrapNV12(const std::vector<uint8_t>& data, int& released, VideoFrame& video_frame) {
+	VideoDescription description;
+	description.video_type = kVideoTypeNV12;
+	description.width = 64;
+	description.height = 48;
+	VideoFrameView view;
+	if (!GetContiguousFrameView(description, data.data(), data.size(), 0, view)) {
+		return false;
+	}
+	view.release = [&released]() { ++released; };
+	return WrapVideoFrameView(view, video_frame) && !view.release;
+}
+
+void TestReleaseOnce() {
+	std::vector<uint8_t> data(64 * 48 * 3 / 2);
+	int released = 0;
+	VideoFrame video_frame;
+	CHECK(WrapNV12(data, released, video_frame));
+	CHECK(video_frame.y_data == data.data());
+	CHECK(video_frame.u_data == data.data() + 64 * 48);
+	VideoFrame copy = video_frame;
+	video_frame.buffer = nullptr;
+	CHECK(released == 0);
+	copy.buffer = nullptr;
+	CHECK(released == 1);
+}
+
+// Every wrapped frame used to allocate its own holder for the release hook.
+void TestHolderReuse() {
+	std::vector<uint8_t> data(64 * 48 * 3 / 2);
+	int released = 0;
+	VideoFrame video_frame;
+	CHECK(WrapNV12(data, released, video_frame));
+	RefCountInterface* first = video_frame.buffer.Get();
+	video_frame.buffer = nullptr;
+	// Hold blocks of every small size so a freed holder cannot simply come back
+	// from malloc at the same address.
+	std::vector<std::vector<char>> blocks;
+	for (size_t size = 8; size <= 512; size += 8) {
+		blocks.push_back(std::vector<char>(size));
+	}
+	for (int i = 0; i < 100; ++i) {
+		CHECK(WrapNV12(data, released, video_frame));
+		CHECK(video_frame.buffer.Get() == first);
+		video_frame.buffer = nullptr;
+	}
+	CHECK(released == 101);
+}
+
+}
+
+int main() {
+	TestReleaseOnce();
+	TestHolderReuse();
+	return test::Result();
+}
@@ -0,0 +1,63 @@
+#pragma once
+#include <cstdint>
+
+#include "cpu_features.h"
+
+// Row kernels behind VideoScaler. Filter weights are 14-bit fixed point and
+// sum to kScaleWeightOne; results are rounded and clamped to 0..255. SIMD
+// versions handle whole blocks and finish the tail with the _C version, so
+// every variant produces exactly the same bytes.
+
+static const int kScaleWeightBits = 14;
+static const int kScaleWeightOne = 1 << kScaleWeightBits;
+// Most source pixels one output pixel is filtered from.
+static const int kScaleMaxTaps = 64;
+
+// Averages 2x2 blocks of two rows |src_stride| apart with rounding. |width|
+// is the destination width: pixels, or UV pairs for the interleaved variant.
+typedef void (*ScaleRowDown2BoxFunction)(const uint8_t* src, int src_stride, uint8_t* dst, int width);
+// Weighted sum of |taps| rows, |width| bytes each.
+typedef void (*ScaleRowVerticalFunction)(const uint8_t* const* src_rows, const int16_t* weights, int taps,
+	uint8_t* dst, int width);
+// Filters a row of |channels| (1 or 2) interleaved channels. Tap k of output
+// pixel x reads source pixel indices[k * width + x] with the weight at the
+// same position. |src| must be readable for 3 bytes past the last pixel.
+typedef void (*ScaleRowHorizontalFunction)(const uint8_t* src, const int32_t* indices, const int16_t* weights,
+	int taps, uint8_t* dst, int width, int channels);
+
+struct ScaleRowFunctions {
+	ScaleRowDown2BoxFunction down2_box;
+	ScaleRowDown2BoxFunction uv_down2_box;
+	ScaleRowVerticalFunction vertical;
+	ScaleRowHorizontalFunction horizontal;
+};
+
+ScaleRowFunctions GetScaleRowFunctions(int cpu_flags);
+
+void ScaleRowDown2Box_C(const uint8_t* src, int src_stride, uint8_t* dst, int width);
+void ScaleUVRowDown2Box_C(const uint8_t* src, int src_stride, uint8_t* dst, int width);
+void ScaleRowVertical_C(const uint8_t* const* src_rows, const int16_t* weights, int taps, uint8_t* dst, int width);
+void ScaleRowHorizontal_C(const uint8_t* src, const int32_t* indices, const int16_t* weights, int taps,
+	uint8_t* dst, int width, int channels);
+// Outputs [offset, width) only: tap-major tables cannot be offset like rows.
+void ScaleRowHorizontalTail_C(const uint8_t* src, const int32_t* indices, const int16_t* weights, int taps,
+	uint8_t* dst, int width, int channels, int offset);
+
+#if defined(HAS_X86_SIMD)
+void ScaleRowDown2Box_SSE2(const uint8_t* src, int src_stride, uint8_t* dst, int width);
+void ScaleUVRowDown2Box_SSE2(const uint8_t* src, int src_stride, uint8_t* dst, int width);
+void ScaleRowVertical_SSE2(const uint8_t* const* src_rows, const int16_t* weights, int taps, uint8_t* dst, int width);
+
+void ScaleRowDown2Box_AVX2(const uint8_t* src, int src_stride, uint8_t* dst, int width);
+void ScaleUVRowDown2Box_AVX2(const uint8_t* src, int src_stride, uint8_t* dst, int width);
+void ScaleRowVertical_AVX2(const uint8_t* const* src_rows, const int16_t* weights, int taps, uint8_t* dst, int width);
+// AVX2 gathers; SSE2 and NEON use the C version.
+void ScaleRowHorizontal_AVX2(const uint8_t* src, const int32_t* indices, const int16_t* weights, int taps,
+	uint8_t* dst, int width, int channels);
+#endif
+
+#if defined(HAS_NEON_SIMD)
+void ScaleRowDown2Box_NEON(const uint8_t* src, int src_stride, uint8_t* dst, int width);
+void ScaleUVRowDown2Box_NEON(const uint8_t* src, int src_stride, uint8_t* dst, int width);
+void ScaleRowVertical_NEON(const uint8_t* const* src_rows, const int16_t* weights, int taps, uint8_t* dst, int width);
+#endif
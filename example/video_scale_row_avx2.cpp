@@ -0,0 +1,166 @@
+#include "video_scale_row.h"
+
+// Built with AVX2 code generation enabled, only called when the CPU has it.
+#if defined(HAS_X86_SIMD)
+#include <immintrin.h>
+
+namespace {
+
+__m256i LoadU(const uint8_t* src) {
+	return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src));
+}
+
+void StoreU(uint8_t* dst, __m256i value) {
+	_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst), value);
+}
+
+// 16 bytes widened to 16-bit lanes.
+__m256i Load16(const uint8_t* src) {
+	return _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src)));
+}
+
+// Sums of horizontally adjacent bytes as 16-bit lanes.
+__m256i AddPairs(__m256i value) {
+	return _mm256_add_epi16(_mm256_and_si256(value, _mm256_set1_epi16(0x00ff)), _mm256_srli_epi16(value, 8));
+}
+
+// Sums the even and odd 32-bit elements of |a| followed by |b|, in order.
+__m256i AddPairs32(__m256i a, __m256i b) {
+	__m256 even = _mm256_shuffle_ps(_mm256_castsi256_ps(a), _mm256_castsi256_ps(b), _MM_SHUFFLE(2, 0, 2, 0));
+	__m256 odd = _mm256_shuffle_ps(_mm256_castsi256_ps(a), _mm256_castsi256_ps(b), _MM_SHUFFLE(3, 1, 3, 1));
+	// The shuffles work per 128-bit lane, restore the order of the 64-bit halves.
+	return _mm256_permute4x64_epi64(_mm256_add_epi16(_mm256_castps_si256(even), _mm256_castps_si256(odd)), 0xd8);
+}
+
+__m256i RoundQuarter(__m256i sum) {
+	return _mm256_srli_epi16(_mm256_add_epi16(sum, _mm256_set1_epi16(2)), 2);
+}
+
+// Packs 16-bit lanes of |lo| followed by |hi| to bytes, in order.
+__m256i PackBytes(__m256i lo, __m256i hi) {
+	return _mm256_permute4x64_epi64(_mm256_packus_epi16(lo, hi), 0xd8);
+}
+
+int WeightPair(int16_t first, int16_t second) {
+	return static_cast<int>(static_cast<uint32_t>(static_cast<uint16_t>(second)) << 16 |
+		static_cast<uint16_t>(first));
+}
+
+__m256i RoundWeighted(__m256i sum) {
+	return _mm256_srai_epi32(_mm256_add_epi32(sum, _mm256_set1_epi32(kScaleWeightOne / 2)), kScaleWeightBits);
+}
+
+}
+
+void ScaleRowDown2Box_AVX2(const uint8_t* src, int src_stride, uint8_t* dst, int width) {
+	const uint8_t* src1 = src + src_stride;
+	int x = 0;
+	for (; x + 32 <= width; x += 32) {
+		__m256i lo = _mm256_add_epi16(AddPairs(LoadU(src + 2 * x)), AddPairs(LoadU(src1 + 2 * x)));
+		__m256i hi = _mm256_add_epi16(AddPairs(LoadU(src + 2 * x + 32)), AddPairs(LoadU(src1 + 2 * x + 32)));
+		StoreU(dst + x, PackBytes(RoundQuarter(lo), RoundQuarter(hi)));
+	}
+	if (x < width) {
+		ScaleRowDown2Box_SSE2(src + 2 * x, src_stride, dst + x, width - x);
+	}
+}
+
+void ScaleUVRowDown2Box_AVX2(const uint8_t* src, int src_stride, uint8_t* dst, int width) {
+	const uint8_t* src1 = src + src_stride;
+	int x = 0;
+	for (; x + 16 <= width; x += 16) {
+		// Both rows summed, one UV pair per 32-bit element.
+		__m256i s0 = _mm256_add_epi16(Load16(src + 4 * x), Load16(src1 + 4 * x));
+		__m256i s1 = _mm256_add_epi16(Load16(src + 4 * x + 16), Load16(src1 + 4 * x + 16));
+		__m256i s2 = _mm256_add_epi16(Load16(src + 4 * x + 32), Load16(src1 + 4 * x + 32));
+		__m256i s3 = _mm256_add_epi16(Load16(src + 4 * x + 48), Load16(src1 + 4 * x + 48));
+		__m256i lo = RoundQuarter(AddPairs32(s0, s1));
+		__m256i hi = RoundQuarter(AddPairs32(s2, s3));
+		StoreU(dst + 2 * x, PackBytes(lo, hi));
+	}
+	if (x < width) {
+		ScaleUVRowDown2Box_SSE2(src + 4 * x, src_stride, dst + 2 * x, width - x);
+	}
+}
+
+void ScaleRowVertical_AVX2(const uint8_t* const* src_rows, const int16_t* weights, int taps, uint8_t* dst, int width) {
+	const __m256i zero = _mm256_setzero_si256();
+	int x = 0;
+	for (; x + 32 <= width; x += 32) {
+		__m256i sum0 = zero;
+		__m256i sum1 = zero;
+		__m256i sum2 = zero;
+		__m256i sum3 = zero;
+		// Rows go in pairs, an odd last row pairs with itself at weight 0.
+		for (int k = 0; k < taps; k += 2) {
+			bool pair = k + 1 < taps;
+			__m256i weight = _mm256_set1_epi32(WeightPair(weights[k], pair ? weights[k + 1] : 0));
+			const uint8_t* a = src_rows[k] + x;
+			const uint8_t* b = pair ? src_rows[k + 1] + x : a;
+			__m256i a_lo = Load16(a);
+			__m256i a_hi = Load16(a + 16);
+			__m256i b_lo = Load16(b);
+			__m256i b_hi = Load16(b + 16);
+			sum0 = _mm256_add_epi32(sum0, _mm256_madd_epi16(_mm256_unpacklo_epi16(a_lo, b_lo), weight));
+			sum1 = _mm256_add_epi32(sum1, _mm256_madd_epi16(_mm256_unpackhi_epi16(a_lo, b_lo), weight));
+			sum2 = _mm256_add_epi32(sum2, _mm256_madd_epi16(_mm256_unpacklo_epi16(a_hi, b_hi), weight));
+			sum3 = _mm256_add_epi32(sum3, _mm256_madd_epi16(_mm256_unpackhi_epi16(a_hi, b_hi), weight));
+		}
+		// unpack and packs both work per 128-bit lane, so they cancel out.
+		__m256i lo = _mm256_packs_epi32(RoundWeighted(sum0), RoundWeighted(sum1));
+		__m256i hi = _mm256_packs_epi32(RoundWeighted(sum2), RoundWeighted(sum3));
+		StoreU(dst + x, PackBytes(lo, hi));
+	}
+	if (x < width) {
+		const uint8_t* rows[kScaleMaxTaps];
+		for (int k = 0; k < taps; ++k) {
+			rows[k] = src_rows[k] + x;
+		}
+		ScaleRowVertical_SSE2(rows, weights, taps, dst + x, width - x);
+	}
+}
+
+void ScaleRowHorizontal_AVX2(const uint8_t* src, const int32_t* indices, const int16_t* weights, int taps,
+	uint8_t* dst, int width, int channels) {
+	const int* base = reinterpret_cast<const int*>(src);
+	const __m256i byte_mask = _mm256_set1_epi32(0xff);
+	const __m256i max_value = _mm256_set1_epi32(255);
+	const __m256i zero = _mm256_setzero_si256();
+	int x = 0;
+	for (; x + 8 <= width; x += 8) {
+		__m256i sum0 = zero;
+		__m256i sum1 = zero;
+		for (int k = 0; k < taps; ++k) {
+			__m256i index = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(indices + k * width + x));
+			// Weights in the low half of each 32-bit lane; madd multiplies them by
+			// the pixel and adds the zero upper half times anything.
+			__m256i weight = _mm256_cvtepi16_epi32(
+				_mm_loadu_si128(reinterpret_cast<const __m128i*>(weights + k * width + x)));
+			// Four bytes from each source pixel, the first one or two are used.
+			__m256i pixels = channels == 2 ?
+				_mm256_i32gather_epi32(base, index, 2) : _mm256_i32gather_epi32(base, index, 1);
+			sum0 = _mm256_add_epi32(sum0, _mm256_madd_epi16(_mm256_and_si256(pixels, byte_mask), weight));
+			if (channels == 2) {
+				__m256i second = _mm256_and_si256(_mm256_srli_epi32(pixels, 8), byte_mask);
+				sum1 = _mm256_add_epi32(sum1, _mm256_madd_epi16(second, weight));
+			}
+		}
+		sum0 = _mm256_min_epi32(_mm256_max_epi32(RoundWeighted(sum0), zero), max_value);
+		if (channels == 2) {
+			sum1 = _mm256_min_epi32(_mm256_max_epi32(RoundWeighted(sum1), zero), max_value);
+			__m256i pairs = _mm256_or_si256(sum0, _mm256_slli_epi32(sum1, 8));
+			pairs = _mm256_permute4x64_epi64(_mm256_packus_epi32(pairs, pairs), 0x08);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 2 * x), _mm256_castsi256_si128(pairs));
+		}
+		else {
+			__m256i bytes = _mm256_packus_epi16(_mm256_packus_epi32(sum0, sum0), zero);
+			bytes = _mm256_permutevar8x32_epi32(bytes, _mm256_setr_epi32(0, 4, 1, 1, 1, 1, 1, 1));
+			_mm_storel_epi64(reinterpret_cast<__m128i*>(dst + x), _mm256_castsi256_si128(bytes));
+		}
+	}
+	if (x < width) {
+		ScaleRowHorizontalTail_C(src, indices, weights, taps, dst, width, channels, x);
+	}
+}
+
+#endif
@@ -0,0 +1,69 @@
+#include "video_scale_row.h"
+
+namespace {
+
+uint8_t RoundWeighted(int sum) {
+	int value = (sum + kScaleWeightOne / 2) >> kScaleWeightBits;
+	return static_cast<uint8_t>(value > 255 ? 255 : (value < 0 ? 0 : value));
+}
+
+template <int kChannels>
+void ScaleRowHorizontal(const uint8_t* src, const int32_t* indices, const int16_t* weights, int taps,
+	uint8_t* dst, int width, int offset) {
+	for (int x = offset; x < width; ++x) {
+		int sum[kChannels] = {};
+		for (int k = 0; k < taps; ++k) {
+			const uint8_t* pixel = src + indices[k * width + x] * kChannels;
+			for (int c = 0; c < kChannels; ++c) {
+				sum[c] += pixel[c] * weights[k * width + x];
+			}
+		}
+		for (int c = 0; c < kChannels; ++c) {
+			dst[x * kChannels + c] = RoundWeighted(sum[c]);
+		}
+	}
+}
+
+}
+
+void ScaleRowDown2Box_C(const uint8_t* src, int src_stride, uint8_t* dst, int width) {
+	const uint8_t* src1 = src + src_stride;
+	for (int x = 0; x < width; ++x) {
+		dst[x] = static_cast<uint8_t>((src[2 * x] + src[2 * x + 1] + src1[2 * x] + src1[2 * x + 1] + 2) >> 2);
+	}
+}
+
+void ScaleUVRowDown2Box_C(const uint8_t* src, int src_stride, uint8_t* dst, int width) {
+	const uint8_t* src1 = src + src_stride;
+	for (int x = 0; x < width; ++x) {
+		for (int c = 0; c < 2; ++c) {
+			dst[2 * x + c] = static_cast<uint8_t>((src[4 * x + c] + src[4 * x + 2 + c] +
+				src1[4 * x + c] + src1[4 * x + 2 + c] + 2) >> 2);
+		}
+	}
+}
+
+void ScaleRowVertical_C(const uint8_t* const* src_rows, const int16_t* weights, int taps, uint8_t* dst, int width) {
+	for (int x = 0; x < width; ++x) {
+		int sum = 0;
+		for (int k = 0; k < taps; ++k) {
+			sum += src_rows[k][x] * weights[k];
+		}
+		dst[x] = RoundWeighted(sum);
+	}
+}
+
+void ScaleRowHorizontal_C(const uint8_t* src, const int32_t* indices, const int16_t* weights, int taps,
+	uint8_t* dst, int width, int channels) {
+	ScaleRowHorizontalTail_C(src, indices, weights, taps, dst, width, channels, 0);
+}
+
+void ScaleRowHorizontalTail_C(const uint8_t* src, const int32_t* indices, const int16_t* weights, int taps,
+	uint8_t* dst, int width, int channels, int offset) {
+	if (channels == 2) {
+		ScaleRowHorizontal<2>(src, indices, weights, taps, dst, width, offset);
+	}
+	else {
+		ScaleRowHorizontal<1>(src, indices, weights, taps, dst, width, offset);
+	}
+}
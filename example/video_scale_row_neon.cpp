@@ -0,0 +1,79 @@
+#include "video_scale_row.h"
+
+#if defined(HAS_NEON_SIMD)
+#include <arm_neon.h>
+
+namespace {
+
+// Rounds and narrows 32-bit weighted sums to 16 bits.
+int16x4_t RoundWeighted(int32x4_t sum) {
+	return vqmovn_s32(vrshrq_n_s32(sum, kScaleWeightBits));
+}
+
+}
+
+void ScaleRowDown2Box_NEON(const uint8_t* src, int src_stride, uint8_t* dst, int width) {
+	const uint8_t* src1 = src + src_stride;
+	int x = 0;
+	for (; x + 16 <= width; x += 16) {
+		uint16x8_t lo = vpadalq_u8(vpaddlq_u8(vld1q_u8(src + 2 * x)), vld1q_u8(src1 + 2 * x));
+		uint16x8_t hi = vpadalq_u8(vpaddlq_u8(vld1q_u8(src + 2 * x + 16)), vld1q_u8(src1 + 2 * x + 16));
+		vst1q_u8(dst + x, vcombine_u8(vrshrn_n_u16(lo, 2), vrshrn_n_u16(hi, 2)));
+	}
+	if (x < width) {
+		ScaleRowDown2Box_C(src + 2 * x, src_stride, dst + x, width - x);
+	}
+}
+
+void ScaleUVRowDown2Box_NEON(const uint8_t* src, int src_stride, uint8_t* dst, int width) {
+	const uint8_t* src1 = src + src_stride;
+	int x = 0;
+	for (; x + 8 <= width; x += 8) {
+		// Even and odd UV pairs of 16.
+		uint16x8x2_t a = vld2q_u16(reinterpret_cast<const uint16_t*>(src + 4 * x));
+		uint16x8x2_t b = vld2q_u16(reinterpret_cast<const uint16_t*>(src1 + 4 * x));
+		uint8x16_t a_even = vreinterpretq_u8_u16(a.val[0]);
+		uint8x16_t a_odd = vreinterpretq_u8_u16(a.val[1]);
+		uint8x16_t b_even = vreinterpretq_u8_u16(b.val[0]);
+		uint8x16_t b_odd = vreinterpretq_u8_u16(b.val[1]);
+		uint16x8_t lo = vaddq_u16(vaddl_u8(vget_low_u8(a_even), vget_low_u8(a_odd)),
+			vaddl_u8(vget_low_u8(b_even), vget_low_u8(b_odd)));
+		uint16x8_t hi = vaddq_u16(vaddl_u8(vget_high_u8(a_even), vget_high_u8(a_odd)),
+			vaddl_u8(vget_high_u8(b_even), vget_high_u8(b_odd)));
+		vst1q_u8(dst + 2 * x, vcombine_u8(vrshrn_n_u16(lo, 2), vrshrn_n_u16(hi, 2)));
+	}
+	if (x < width) {
+		ScaleUVRowDown2Box_C(src + 4 * x, src_stride, dst + 2 * x, width - x);
+	}
+}
+
+void ScaleRowVertical_NEON(const uint8_t* const* src_rows, const int16_t* weights, int taps, uint8_t* dst, int width) {
+	int x = 0;
+	for (; x + 16 <= width; x += 16) {
+		int32x4_t sum0 = vdupq_n_s32(0);
+		int32x4_t sum1 = vdupq_n_s32(0);
+		int32x4_t sum2 = vdupq_n_s32(0);
+		int32x4_t sum3 = vdupq_n_s32(0);
+		for (int k = 0; k < taps; ++k) {
+			uint8x16_t row = vld1q_u8(src_rows[k] + x);
+			int16x8_t lo = vreinterpretq_s16_u16(vmovl_u8(vget_low_u8(row)));
+			int16x8_t hi = vreinterpretq_s16_u16(vmovl_u8(vget_high_u8(row)));
+			sum0 = vmlal_n_s16(sum0, vget_low_s16(lo), weights[k]);
+			sum1 = vmlal_n_s16(sum1, vget_high_s16(lo), weights[k]);
+			sum2 = vmlal_n_s16(sum2, vget_low_s16(hi), weights[k]);
+			sum3 = vmlal_n_s16(sum3, vget_high_s16(hi), weights[k]);
+		}
+		int16x8_t lo = vcombine_s16(RoundWeighted(sum0), RoundWeighted(sum1));
+		int16x8_t hi = vcombine_s16(RoundWeighted(sum2), RoundWeighted(sum3));
+		vst1q_u8(dst + x, vcombine_u8(vqmovun_s16(lo), vqmovun_s16(hi)));
+	}
+	if (x < width) {
+		const uint8_t* rows[kScaleMaxTaps];
+		for (int k = 0; k < taps; ++k) {
+			rows[k] = src_rows[k] + x;
+		}
+		ScaleRowVertical_C(rows, weights, taps, dst + x, width - x);
+	}
+}
+
+#endif
@@ -0,0 +1,112 @@
+#include "video_scale_row.h"
+
+#if defined(HAS_X86_SIMD)
+#include <emmintrin.h>
+
+namespace {
+
+__m128i LoadU(const uint8_t* src) {
+	return _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+}
+
+// Sums of horizontally adjacent bytes as 16-bit lanes.
+__m128i AddPairs(__m128i value) {
+	return _mm_add_epi16(_mm_and_si128(value, _mm_set1_epi16(0x00ff)), _mm_srli_epi16(value, 8));
+}
+
+// Sums the even and odd 32-bit elements of |a| followed by |b|.
+__m128i AddPairs32(__m128i a, __m128i b) {
+	__m128 even = _mm_shuffle_ps(_mm_castsi128_ps(a), _mm_castsi128_ps(b), _MM_SHUFFLE(2, 0, 2, 0));
+	__m128 odd = _mm_shuffle_ps(_mm_castsi128_ps(a), _mm_castsi128_ps(b), _MM_SHUFFLE(3, 1, 3, 1));
+	return _mm_add_epi16(_mm_castps_si128(even), _mm_castps_si128(odd));
+}
+
+__m128i RoundQuarter(__m128i sum) {
+	return _mm_srli_epi16(_mm_add_epi16(sum, _mm_set1_epi16(2)), 2);
+}
+
+// Two 16-bit weights in the layout _mm_madd_epi16 pairs with interleaved rows.
+int WeightPair(int16_t first, int16_t second) {
+	return static_cast<int>(static_cast<uint32_t>(static_cast<uint16_t>(second)) << 16 |
+		static_cast<uint16_t>(first));
+}
+
+__m128i RoundWeighted(__m128i sum) {
+	return _mm_srai_epi32(_mm_add_epi32(sum, _mm_set1_epi32(kScaleWeightOne / 2)), kScaleWeightBits);
+}
+
+}
+
+void ScaleRowDown2Box_SSE2(const uint8_t* src, int src_stride, uint8_t* dst, int width) {
+	const uint8_t* src1 = src + src_stride;
+	int x = 0;
+	for (; x + 16 <= width; x += 16) {
+		__m128i lo = _mm_add_epi16(AddPairs(LoadU(src + 2 * x)), AddPairs(LoadU(src1 + 2 * x)));
+		__m128i hi = _mm_add_epi16(AddPairs(LoadU(src + 2 * x + 16)), AddPairs(LoadU(src1 + 2 * x + 16)));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x), _mm_packus_epi16(RoundQuarter(lo), RoundQuarter(hi)));
+	}
+	if (x < width) {
+		ScaleRowDown2Box_C(src + 2 * x, src_stride, dst + x, width - x);
+	}
+}
+
+void ScaleUVRowDown2Box_SSE2(const uint8_t* src, int src_stride, uint8_t* dst, int width) {
+	const uint8_t* src1 = src + src_stride;
+	const __m128i zero = _mm_setzero_si128();
+	int x = 0;
+	for (; x + 8 <= width; x += 8) {
+		__m128i a0 = LoadU(src + 4 * x);
+		__m128i a1 = LoadU(src + 4 * x + 16);
+		__m128i b0 = LoadU(src1 + 4 * x);
+		__m128i b1 = LoadU(src1 + 4 * x + 16);
+		// Both rows summed, one UV pair per 32-bit element.
+		__m128i s0 = _mm_add_epi16(_mm_unpacklo_epi8(a0, zero), _mm_unpacklo_epi8(b0, zero));
+		__m128i s1 = _mm_add_epi16(_mm_unpackhi_epi8(a0, zero), _mm_unpackhi_epi8(b0, zero));
+		__m128i s2 = _mm_add_epi16(_mm_unpacklo_epi8(a1, zero), _mm_unpacklo_epi8(b1, zero));
+		__m128i s3 = _mm_add_epi16(_mm_unpackhi_epi8(a1, zero), _mm_unpackhi_epi8(b1, zero));
+		__m128i lo = RoundQuarter(AddPairs32(s0, s1));
+		__m128i hi = RoundQuarter(AddPairs32(s2, s3));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 2 * x), _mm_packus_epi16(lo, hi));
+	}
+	if (x < width) {
+		ScaleUVRowDown2Box_C(src + 4 * x, src_stride, dst + 2 * x, width - x);
+	}
+}
+
+void ScaleRowVertical_SSE2(const uint8_t* const* src_rows, const int16_t* weights, int taps, uint8_t* dst, int width) {
+	const __m128i zero = _mm_setzero_si128();
+	int x = 0;
+	for (; x + 16 <= width; x += 16) {
+		__m128i sum0 = zero;
+		__m128i sum1 = zero;
+		__m128i sum2 = zero;
+		__m128i sum3 = zero;
+		// Rows go in pairs, an odd last row pairs with itself at weight 0.
+		for (int k = 0; k < taps; k += 2) {
+			bool pair = k + 1 < taps;
+			__m128i weight = _mm_set1_epi32(WeightPair(weights[k], pair ? weights[k + 1] : 0));
+			__m128i a = LoadU(src_rows[k] + x);
+			__m128i b = pair ? LoadU(src_rows[k + 1] + x) : a;
+			__m128i a_lo = _mm_unpacklo_epi8(a, zero);
+			__m128i a_hi = _mm_unpackhi_epi8(a, zero);
+			__m128i b_lo = _mm_unpacklo_epi8(b, zero);
+			__m128i b_hi = _mm_unpackhi_epi8(b, zero);
+			sum0 = _mm_add_epi32(sum0, _mm_madd_epi16(_mm_unpacklo_epi16(a_lo, b_lo), weight));
+			sum1 = _mm_add_epi32(sum1, _mm_madd_epi16(_mm_unpackhi_epi16(a_lo, b_lo), weight));
+			sum2 = _mm_add_epi32(sum2, _mm_madd_epi16(_mm_unpacklo_epi16(a_hi, b_hi), weight));
+			sum3 = _mm_add_epi32(sum3, _mm_madd_epi16(_mm_unpackhi_epi16(a_hi, b_hi), weight));
+		}
+		__m128i lo = _mm_packs_epi32(RoundWeighted(sum0), RoundWeighted(sum1));
+		__m128i hi = _mm_packs_epi32(RoundWeighted(sum2), RoundWeighted(sum3));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x), _mm_packus_epi16(lo, hi));
+	}
+	if (x < width) {
+		const uint8_t* rows[kScaleMaxTaps];
+		for (int k = 0; k < taps; ++k) {
+			rows[k] = src_rows[k] + x;
+		}
+		ScaleRowVertical_C(rows, weights, taps, dst + x, width - x);
+	}
+}
+
+#endif
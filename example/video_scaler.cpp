@@ -0,0 +1,452 @@
+#include "video_scaler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "thread_pool.h"
+#include "video_frame_buffer.h"
+#include "video_scale_row.h"
+
+ScaleRowFunctions GetScaleRowFunctions(int cpu_flags) {
+	ScaleRowFunctions functions = {
+		ScaleRowDown2Box_C, ScaleUVRowDown2Box_C, ScaleRowVertical_C, ScaleRowHorizontal_C,
+	};
+#if defined(HAS_X86_SIMD)
+	if (cpu_flags & kCpuHasSSE2) {
+		ScaleRowFunctions sse2 = {
+			ScaleRowDown2Box_SSE2, ScaleUVRowDown2Box_SSE2, ScaleRowVertical_SSE2, ScaleRowHorizontal_C,
+		};
+		functions = sse2;
+	}
+	if ((cpu_flags & kCpuHasSSE2) && (cpu_flags & kCpuHasAVX2)) {
+		ScaleRowFunctions avx2 = {
+			ScaleRowDown2Box_AVX2, ScaleUVRowDown2Box_AVX2, ScaleRowVertical_AVX2, ScaleRowHorizontal_AVX2,
+		};
+		functions = avx2;
+	}
+#endif
+#if defined(HAS_NEON_SIMD)
+	if (cpu_flags & kCpuHasNEON) {
+		ScaleRowFunctions neon = {
+			ScaleRowDown2Box_NEON, ScaleUVRowDown2Box_NEON, ScaleRowVertical_NEON, ScaleRowHorizontal_C,
+		};
+		functions = neon;
+	}
+#endif
+	return functions;
+}
+
+namespace {
+
+// Output rows per parallel task; fewer are not worth the hand-off.
+const int kMinRowsPerTask = 16;
+
+double FilterRadius(ScaleFilter filter) {
+	switch (filter) {
+	case kScaleFilterBilinear:
+		return 1.0;
+	case kScaleFilterBicubic:
+		return 2.0;
+	default:
+		break;
+	}
+	return 0.5;
+}
+
+double FilterWeight(ScaleFilter filter, double x) {
+	x = std::fabs(x);
+	if (filter == kScaleFilterBilinear) {
+		return x < 1.0 ? 1.0 - x : 0.0;
+	}
+	// Catmull-Rom, a = -0.5.
+	if (x < 1.0) {
+		return (1.5 * x - 2.5) * x * x + 1.0;
+	}
+	if (x < 2.0) {
+		return ((-0.5 * x + 2.5) * x - 4.0) * x + 2.0;
+	}
+	return 0.0;
+}
+
+// Source pixels and weights for every output pixel along one axis, |taps| per
+// output, zero padded. Output-major, or tap-major for the horizontal kernels.
+struct FilterTable {
+	int taps{};
+	std::vector<int32_t> indices{};
+	std::vector<int16_t> weights{};
+};
+
+void BuildFilterTable(int src_size, int dst_size, ScaleFilter filter, bool tap_major, FilterTable& table) {
+	double scale = static_cast<double>(src_size) / dst_size;
+	// Downscaling stretches the filter over the source so every source pixel
+	// contributes.
+	double stretch = scale > 1.0 ? scale : 1.0;
+	double support = FilterRadius(filter) * stretch;
+	const double max_support = (kScaleMaxTaps - 1) / 2.0;
+	if (support > max_support) {
+		support = max_support;
+		stretch = support / FilterRadius(filter);
+	}
+	std::vector<int32_t> indices(static_cast<size_t>(dst_size) * kScaleMaxTaps);
+	std::vector<int16_t> weights(indices.size());
+	std::vector<int> counts(dst_size);
+	int taps = 1;
+	for (int i = 0; i < dst_size; ++i) {
+		// Output pixel centers in source coordinates, pixel edges at integers.
+		double center = (i + 0.5) * scale;
+		int first = static_cast<int>(std::floor(center - support));
+		int last = static_cast<int>(std::ceil(center + support)) - 1;
+		double values[kScaleMaxTaps];
+		double sum = 0.0;
+		int count = 0;
+		for (int j = first; j <= last && count < kScaleMaxTaps; ++j) {
+			double value;
+			if (filter == kScaleFilterBox) {
+				double begin = std::max<double>(j, center - support);
+				double end = std::min<double>(j + 1, center + support);
+				value = end > begin ? end - begin : 0.0;
+			}
+			else {
+				value = FilterWeight(filter, (j + 0.5 - center) / stretch);
+			}
+			values[count++] = value;
+			sum += value;
+		}
+		int32_t* out_indices = &indices[static_cast<size_t>(i) * kScaleMaxTaps];
+		int16_t* out_weights = &weights[static_cast<size_t>(i) * kScaleMaxTaps];
+		if (sum == 0.0) {
+			out_indices[0] = std::min(std::max(static_cast<int>(center), 0), src_size - 1);
+			out_weights[0] = kScaleWeightOne;
+			counts[i] = 1;
+			continue;
+		}
+		// Quantize, drop the zero weights at both ends and give the rounding
+		// error to the largest weight so every output sums to one exactly.
+		int begin = 0;
+		int end = count;
+		int16_t quantized[kScaleMaxTaps];
+		for (int k = 0; k < count; ++k) {
+			quantized[k] = static_cast<int16_t>(std::lround(values[k] / sum * kScaleWeightOne));
+		}
+		while (begin < end - 1 && quantized[begin] == 0) {
+			++begin;
+		}
+		while (end - 1 > begin && quantized[end - 1] == 0) {
+			--end;
+		}
+		int total = 0;
+		int largest = begin;
+		for (int k = begin; k < end; ++k) {
+			total += quantized[k];
+			if (quantized[k] > quantized[largest]) {
+				largest = k;
+			}
+		}
+		quantized[largest] = static_cast<int16_t>(quantized[largest] + kScaleWeightOne - total);
+		for (int k = begin; k < end; ++k) {
+			// Edges repeat the outermost source pixel.
+			out_indices[k - begin] = std::min(std::max(first + k, 0), src_size - 1);
+			out_weights[k - begin] = quantized[k];
+		}
+		counts[i] = end - begin;
+		taps = std::max(taps, end - begin);
+	}
+	table.taps = taps;
+	table.indices.assign(static_cast<size_t>(dst_size) * taps, 0);
+	table.weights.assign(table.indices.size(), 0);
+	for (int i = 0; i < dst_size; ++i) {
+		for (int k = 0; k < taps; ++k) {
+			size_t position = tap_major ? static_cast<size_t>(k) * dst_size + i : static_cast<size_t>(i) * taps + k;
+			// Padding taps read the last real source pixel at weight 0.
+			int source = k < counts[i] ? k : counts[i] - 1;
+			table.indices[position] = indices[static_cast<size_t>(i) * kScaleMaxTaps + source];
+			table.weights[position] = k < counts[i] ? weights[static_cast<size_t>(i) * kScaleMaxTaps + k] : 0;
+		}
+	}
+}
+
+uint8_t* GetScratchRow(size_t size) {
+	static thread_local std::vector<uint8_t> memory;
+	if (memory.size() < size) {
+		memory.resize(size);
+	}
+	return memory.data();
+}
+
+// Scales one plane. Rows are filtered vertically into a row of source width
+// first and then horizontally, so the costlier gather pass only runs once per
+// output row.
+class PlaneScaler {
+public:
+	void Configure(int src_width, int src_height, int dst_width, int dst_height, int channels, ScaleFilter filter) {
+		if (src_width == src_width_ && src_height == src_height_ && dst_width == dst_width_ &&
+			dst_height == dst_height_ && channels == channels_ && filter == filter_) {
+			return;
+		}
+		src_width_ = src_width;
+		src_height_ = src_height;
+		dst_width_ = dst_width;
+		dst_height_ = dst_height;
+		channels_ = channels;
+		filter_ = filter;
+		down2_box_ = filter == kScaleFilterBox && src_width == 2 * dst_width && src_height == 2 * dst_height;
+		if (!down2_box_ && src_width != dst_width) {
+			BuildFilterTable(src_width, dst_width, filter, true, horizontal_);
+		}
+		if (!down2_box_ && src_height != dst_height) {
+			BuildFilterTable(src_height, dst_height, filter, false, vertical_);
+		}
+	}
+
+	int Height() const {
+		return dst_height_;
+	}
+
+	void ScaleRows(const ScaleRowFunctions& rows, const uint8_t* src, int src_stride, uint8_t* dst, int dst_stride,
+		int row_begin, int row_end) const {
+		if (down2_box_) {
+			ScaleRowDown2BoxFunction down2 = channels_ == 2 ? rows.uv_down2_box : rows.down2_box;
+			for (int y = row_begin; y < row_end; ++y) {
+				down2(src + static_cast<size_t>(2 * y) * src_stride, src_stride,
+					dst + static_cast<size_t>(y) * dst_stride, dst_width_);
+			}
+			return;
+		}
+		int src_bytes = src_width_ * channels_;
+		// The horizontal kernels read a few bytes past the row, so they always
+		// work from the padded scratch row.
+		uint8_t* scratch = src_width_ != dst_width_ ? GetScratchRow(src_bytes + 4) : nullptr;
+		const uint8_t* src_rows[kScaleMaxTaps];
+		for (int y = row_begin; y < row_end; ++y) {
+			uint8_t* dst_row = dst + static_cast<size_t>(y) * dst_stride;
+			const uint8_t* row;
+			if (src_height_ == dst_height_) {
+				row = src + static_cast<size_t>(y) * src_stride;
+				if (scratch) {
+					memcpy(scratch, row, src_bytes);
+					row = scratch;
+				}
+			}
+			else {
+				const int32_t* indices = &vertical_.indices[static_cast<size_t>(y) * vertical_.taps];
+				for (int k = 0; k < vertical_.taps; ++k) {
+					src_rows[k] = src + static_cast<size_t>(indices[k]) * src_stride;
+				}
+				uint8_t* out = scratch ? scratch : dst_row;
+				rows.vertical(src_rows, &vertical_.weights[static_cast<size_t>(y) * vertical_.taps], vertical_.taps,
+					out, src_bytes);
+				row = out;
+			}
+			if (src_width_ == dst_width_) {
+				if (row != dst_row) {
+					memcpy(dst_row, row, src_bytes);
+				}
+				continue;
+			}
+			rows.horizontal(row, horizontal_.indices.data(), horizontal_.weights.data(), horizontal_.taps,
+				dst_row, dst_width_, channels_);
+		}
+	}
+
+private:
+	int src_width_{ -1 };
+	int src_height_{ -1 };
+	int dst_width_{ -1 };
+	int dst_height_{ -1 };
+	int channels_{};
+	ScaleFilter filter_{};
+	bool down2_box_{};
+	FilterTable horizontal_{};
+	FilterTable vertical_{};
+};
+
+bool IsSemiPlanar(VideoType video_type) {
+	return video_type == kVideoTypeNV12 || video_type == kVideoTypeNV21;
+}
+
+// Planes as (data, stride): Y, then U and V or the interleaved chroma.
+int GetPlanes(const VideoFrame& frame, uint8_t* data[3], int stride[3]) {
+	data[0] = frame.y_data;
+	stride[0] = static_cast<int>(frame.y_stride);
+	if (IsSemiPlanar(frame.video_type)) {
+		data[1] = frame.video_type == kVideoTypeNV21 ? frame.v_data : frame.u_data;
+		stride[1] = static_cast<int>(frame.u_stride);
+		return 2;
+	}
+	data[1] = frame.u_data;
+	stride[1] = static_cast<int>(frame.u_stride);
+	data[2] = frame.v_data;
+	stride[2] = static_cast<int>(frame.v_stride);
+	return 3;
+}
+
+void ConfigurePlanes(const VideoFrame& src, const VideoFrame& dst, ScaleFilter filter, PlaneScaler planes[3]) {
+	int src_width = static_cast<int>(src.width);
+	int src_height = static_cast<int>(src.height);
+	int dst_width = static_cast<int>(dst.width);
+	int dst_height = static_cast<int>(dst.height);
+	planes[0].Configure(src_width, src_height, dst_width, dst_height, 1, filter);
+	int channels = IsSemiPlanar(src.video_type) ? 2 : 1;
+	for (int plane = 1; plane < 3; ++plane) {
+		planes[plane].Configure((src_width + 1) / 2, (src_height + 1) / 2, (dst_width + 1) / 2, (dst_height + 1) / 2,
+			channels, filter);
+	}
+}
+
+void ScalePlanes(const VideoFrame& src, VideoFrame& dst, const PlaneScaler planes[3], ThreadPool* thread_pool) {
+	uint8_t* src_data[3];
+	int src_stride[3];
+	uint8_t* dst_data[3];
+	int dst_stride[3];
+	int plane_count = GetPlanes(src, src_data, src_stride);
+	GetPlanes(dst, dst_data, dst_stride);
+	ScaleRowFunctions rows = GetScaleRowFunctions(GetCpuFlags());
+
+	struct Band {
+		int plane;
+		int row_begin;
+		int row_end;
+	};
+	std::vector<Band> bands;
+	size_t threads = thread_pool ? thread_pool->ThreadCount() : 1;
+	for (int plane = 0; plane < plane_count; ++plane) {
+		int height = planes[plane].Height();
+		// Luma gets four bands per thread, chroma as many of proportional height.
+		int band_rows = static_cast<int>((height + threads * 4 - 1) / (threads * 4));
+		band_rows = std::max(band_rows, kMinRowsPerTask);
+		for (int row = 0; row < height; row += band_rows) {
+			Band band = { plane, row, std::min(row + band_rows, height) };
+			bands.push_back(band);
+		}
+	}
+	auto scale_band = [&](size_t index) {
+		const Band& band = bands[index];
+		planes[band.plane].ScaleRows(rows, src_data[band.plane], src_stride[band.plane],
+			dst_data[band.plane], dst_stride[band.plane], band.row_begin, band.row_end);
+	};
+	if (thread_pool && bands.size() > 1) {
+		thread_pool->ParallelFor(bands.size(), scale_band);
+	}
+	else {
+		for (size_t i = 0; i < bands.size(); ++i) {
+			scale_band(i);
+		}
+	}
+}
+
+}
+
+bool CanScaleVideoFrame(VideoType video_type) {
+	switch (video_type) {
+	case kVideoTypeI420:
+	case kVideoTypeIYUV:
+	case kVideoTypeYV12:
+	case kVideoTypeNV12:
+	case kVideoTypeNV21:
+		return true;
+	default:
+		break;
+	}
+	return false;
+}
+
+bool ScaleVideoFrame(const VideoFrame& src, VideoFrame& dst, ScaleFilter filter, ThreadPool* thread_pool) {
+	if (!CanScaleVideoFrame(src.video_type) || src.video_type != dst.video_type) {
+		return false;
+	}
+	if (!src.y_data || !dst.y_data || src.width == 0 || src.height == 0 || dst.width == 0 || dst.height == 0) {
+		return false;
+	}
+	PlaneScaler planes[3];
+	ConfigurePlanes(src, dst, filter, planes);
+	ScalePlanes(src, dst, planes, thread_pool);
+	return true;
+}
+
+struct VideoScaler::Layer {
+	ScaleSize size{};
+	VideoFrameBufferPool pool;
+	PlaneScaler planes[3]{};
+
+	explicit Layer(size_t max_buffers) : pool(max_buffers) {}
+};
+
+VideoScaler::VideoScaler(ThreadPool* thread_pool)
+	: thread_pool_(thread_pool) {
+
+}
+
+VideoScaler::~VideoScaler() {
+
+}
+
+void VideoScaler::SetLayers(const std::vector<ScaleSize>& sizes, size_t max_buffers) {
+	layers_.clear();
+	order_.clear();
+	for (size_t i = 0; i < sizes.size(); ++i) {
+		std::unique_ptr<Layer> layer(new Layer(max_buffers));
+		layer->size = sizes[i];
+		layers_.push_back(std::move(layer));
+		order_.push_back(i);
+	}
+	std::stable_sort(order_.begin(), order_.end(), [this](size_t a, size_t b) {
+		const ScaleSize& size_a = layers_[a]->size;
+		const ScaleSize& size_b = layers_[b]->size;
+		return static_cast<uint64_t>(size_a.width) * size_a.height > static_cast<uint64_t>(size_b.width) * size_b.height;
+	});
+}
+
+void VideoScaler::SetFilter(ScaleFilter filter) {
+	filter_ = filter;
+}
+
+void VideoScaler::SetThreadPool(ThreadPool* thread_pool) {
+	thread_pool_ = thread_pool;
+}
+
+bool VideoScaler::Scale(const VideoFrame& src, std::vector<VideoFrame>& layers) {
+	if (!CanScaleVideoFrame(src.video_type) || !src.y_data || src.width == 0 || src.height == 0) {
+		return false;
+	}
+	layers.assign(layers_.size(), VideoFrame());
+	std::vector<size_t> done;
+	for (size_t i : order_) {
+		Layer& layer = *layers_[i];
+		if (layer.size.width == 0 || layer.size.height == 0) {
+			layers.clear();
+			return false;
+		}
+		// The smallest finished layer that covers this one.
+		const VideoFrame* from = &src;
+		for (size_t j : done) {
+			const VideoFrame& candidate = layers[j];
+			if (candidate.width >= layer.size.width && candidate.height >= layer.size.height &&
+				static_cast<uint64_t>(candidate.width) * candidate.height <
+				static_cast<uint64_t>(from->width) * from->height) {
+				from = &candidate;
+			}
+		}
+		VideoFrame& frame = layers[i];
+		if (from->width == layer.size.width && from->height == layer.size.height) {
+			frame = *from;
+		}
+		else {
+			VideoDescription description;
+			description.width = layer.size.width;
+			description.height = layer.size.height;
+			description.video_type = src.video_type;
+			if (!layer.pool.Configure(description) || !layer.pool.CreateFrame(frame)) {
+				layers.clear();
+				return false;
+			}
+			ConfigurePlanes(*from, frame, filter_, layer.planes);
+			ScalePlanes(*from, frame, layer.planes, thread_pool_);
+		}
+		frame.timestamp_us = src.timestamp_us;
+		frame.arrival_us = src.arrival_us;
+		frame.sequence = src.sequence;
+		done.push_back(i);
+	}
+	return true;
+}
@@ -0,0 +1,66 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "video_frame.h"
+
+class ThreadPool;
+
+enum ScaleFilter {
+	// Area average. Exact 2:1 steps run dedicated 2x2 kernels.
+	kScaleFilterBox,
+	// Triangle filter, widened by the ratio when downscaling.
+	kScaleFilterBilinear,
+	// Catmull-Rom cubic, sharper than bilinear at the cost of slight ringing.
+	kScaleFilterBicubic,
+};
+
+struct ScaleSize {
+	uint32_t width{};
+	uint32_t height{};
+};
+
+// 4:2:0 formats: I420, IYUV, YV12, NV12 and NV21.
+bool CanScaleVideoFrame(VideoType video_type);
+
+// Scales |src| into the planes already allocated in |dst|, which must have the
+// same type. Output rows are split across |thread_pool| when one is given.
+bool ScaleVideoFrame(const VideoFrame& src, VideoFrame& dst, ScaleFilter filter = kScaleFilterBilinear,
+	ThreadPool* thread_pool = nullptr);
+
+// Turns each frame into a set of smaller layers, e.g. 1080p, 540p and 270p
+// for simulcast. Layers are produced largest first and every layer is scaled
+// from the smallest one already made that still covers it, so the full-size
+// source is read once and each later layer reads a quarter of the previous
+// one's bytes. A layer the size of the source shares its buffer. Filter
+// tables are built once per source size. Not thread safe.
+class VideoScaler {
+public:
+	explicit VideoScaler(ThreadPool* thread_pool = nullptr);
+	~VideoScaler();
+
+	// Sizes in any order. Each layer hands out frames from its own pool of
+	// |max_buffers|, so that many of its frames can be held downstream.
+	void SetLayers(const std::vector<ScaleSize>& sizes, size_t max_buffers = 4);
+	void SetFilter(ScaleFilter filter);
+	void SetThreadPool(ThreadPool* thread_pool);
+
+	// Fills |layers| with one frame per size, in SetLayers() order, with the
+	// timing of |src|. Fails for unsupported types and when a layer's pool is
+	// exhausted.
+	bool Scale(const VideoFrame& src, std::vector<VideoFrame>& layers);
+
+private:
+	struct Layer;
+
+	VideoScaler(const VideoScaler&) = delete;
+	VideoScaler operator =(const VideoScaler&) = delete;
+
+	ThreadPool* thread_pool_{};
+	ScaleFilter filter_{ kScaleFilterBilinear };
+	std::vector<std::unique_ptr<Layer>> layers_{};
+	// Indices into |layers_|, largest first.
+	std::vector<size_t> order_{};
+};